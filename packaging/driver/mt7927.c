@@ -19,6 +19,26 @@
 #include <linux/delay.h>
 #include <linux/dma-mapping.h>
 #include <linux/interrupt.h>
+#include <linux/sizes.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/jump_label.h>
+#include <linux/percpu.h>
+#include <linux/sort.h>
+#include <linux/bsearch.h>
+#include <linux/vmalloc.h>
+#include <linux/sched.h>
+#include <linux/sched/clock.h>
+#include <linux/jhash.h>
+#include <linux/skbuff.h>
+#include <linux/if_ether.h>
+#include <linux/netdevice.h>
+#include <linux/hrtimer.h>
+#include <linux/wait_bit.h>
+#include <linux/ieee80211.h>
+#include <net/cfg80211.h>
+#include <net/busy_poll.h>
+#include <asm/local.h>
 
 #define DRV_NAME "mt7927"
 #define DRV_VERSION "0.10.1"
@@ -29,10 +49,56 @@
 #define MT6639_DEVICE_ID	0x6639	/* Mobile variant */
 #define RZ738_DEVICE_ID		0x0738	/* AMD RZ738 variant */
 
+/*
+ * Register-level tracing. debug_regs flips a static key so the trace
+ * points in the register and descriptor helpers cost nothing when off.
+ */
+static DEFINE_STATIC_KEY_FALSE(mt7927_trace_key);
+
+/*
+ * MMIO access counting for probe timing, on only while some device has
+ * a phase running (mt7927_phase_begin() to mt7927_phase_end()).
+ */
+static DEFINE_STATIC_KEY_FALSE(mt7927_mmio_key);
+
+#ifdef CONFIG_MT7927_SELFTEST
+/* RXD sampling for debugfs rxd_bench, armed by writing to that file */
+static DEFINE_STATIC_KEY_FALSE(mt7927_rxd_rec_key);
+#endif
+
 /* Module parameters for debugging */
 static bool debug_regs = true;
-module_param(debug_regs, bool, 0644);
-MODULE_PARM_DESC(debug_regs, "Enable verbose register debugging (default: true)");
+
+static int mt7927_debug_regs_set(const char *val, const struct kernel_param *kp)
+{
+	int ret;
+
+	ret = param_set_bool(val, kp);
+	if (ret)
+		return ret;
+
+	if (debug_regs)
+		static_branch_enable(&mt7927_trace_key);
+	else
+		static_branch_disable(&mt7927_trace_key);
+
+	return 0;
+}
+
+static const struct kernel_param_ops mt7927_debug_regs_ops = {
+	.set = mt7927_debug_regs_set,
+	.get = param_get_bool,
+};
+module_param_cb(debug_regs, &mt7927_debug_regs_ops, &debug_regs, 0644);
+MODULE_PARM_DESC(debug_regs, "Record register accesses to debugfs regtrace (default: true)");
+
+static bool warm_start = true;
+module_param(warm_start, bool, 0644);
+MODULE_PARM_DESC(warm_start, "Re-attach to an already loaded patch instead of resetting (default: true)");
+
+static unsigned int pm_idle_ms = 1000;
+module_param(pm_idle_ms, uint, 0644);
+MODULE_PARM_DESC(pm_idle_ms, "Idle time before handing LPCTL ownership to firmware, 0 disables (default: 1000)");
 
 static bool try_alt_reset = false;
 module_param(try_alt_reset, bool, 0644);
@@ -40,7 +106,39 @@ MODULE_PARM_DESC(try_alt_reset, "Try alternative MT7921 reset address (default:
 
 static bool disable_aspm = false;
 module_param(disable_aspm, bool, 0644);
-MODULE_PARM_DESC(disable_aspm, "Disable ASPM during init (default: false)");
+MODULE_PARM_DESC(disable_aspm, "Keep ASPM L1 disabled instead of the dynamic policy (default: false)");
+
+static unsigned int aspm_idle_ms = 200;
+module_param(aspm_idle_ms, uint, 0644);
+MODULE_PARM_DESC(aspm_idle_ms, "Idle time before ASPM L1 is re-enabled after firmware download or MCU traffic (default: 200)");
+
+static unsigned int tx_copybreak = 512;
+module_param(tx_copybreak, uint, 0644);
+MODULE_PARM_DESC(tx_copybreak, "Copy MCU commands and data frames up to this size into pre-mapped slots, map larger ones per send; 0 maps all (default: 512)");
+
+static bool dma_36bit = true;
+module_param(dma_36bit, bool, 0444);
+MODULE_PARM_DESC(dma_36bit, "Use 36-bit DMA addressing, falls back to 32-bit if refused (default: true)");
+
+static bool hw_encap = true;
+module_param(hw_encap, bool, 0444);
+MODULE_PARM_DESC(hw_encap, "Exchange 802.3 frames with the hardware, which converts to and from 802.11 (default: true)");
+
+static unsigned int amsdu_max_len = 1536;
+module_param(amsdu_max_len, uint, 0644);
+MODULE_PARM_DESC(amsdu_max_len, "Pack small 802.3 frames into host A-MSDUs of up to this many bytes, per station/TID; 0 disables (default: 1536)");
+
+static unsigned int amsdu_max_us = 500;
+module_param(amsdu_max_us, uint, 0644);
+MODULE_PARM_DESC(amsdu_max_us, "Longest a frame waits for others to share its A-MSDU, quartered for VI/VO (default: 500)");
+
+static unsigned int mlo_policy;
+module_param(mlo_policy, uint, 0444);
+MODULE_PARM_DESC(mlo_policy, "MLO TX link selection: 0 = lowest latency, 1 = aggregate throughput (default: 0)");
+
+static bool game_mode;
+module_param(game_mode, bool, 0444);
+MODULE_PARM_DESC(game_mode, "Start in low-latency game mode, switchable later through sysfs game_mode (default: false)");
 
 static bool skip_pci_reset = true;  /* v0.10.1: Disabled by default - caused hang! */
 module_param(skip_pci_reset, bool, 0644);
@@ -161,6 +259,11 @@ MODULE_PARM_DESC(skip_pci_reset, "Skip PCI function-level reset (default: true)"
 #define MT_MCU_CMD_NORMAL_STATE		BIT(6)
 #define MT_MCU_CMD_ERROR_MASK		GENMASK(5, 1)
 
+/* Set by firmware after an assert; the host answers with a chip reset */
+#define MT7927_MCU_CMD_ASSERT		(MT_MCU_CMD_STOP_DMA_FW_RELOAD | \
+					 MT_MCU_CMD_STOP_DMA)
+#define MT7927_RESET_FW_ACK_MS		20
+
 /*
  * ROM Bootloader status bits in MT_CONN_ON_MISC (0x7c0600f0)
  * These indicate the state of the N9 processor running the ROM
@@ -184,6 +287,12 @@ MODULE_PARM_DESC(skip_pci_reset, "Skip PCI function-level reset (default: true)"
 #define MT_TX_RING_BASE			(MT_WFDMA0_BASE + 0x300)
 #define MT_RING_SIZE			0x10
 
+/* Per-ring register offsets, MT_RING_SIZE apart */
+#define MT_RING_BASE			0x00
+#define MT_RING_CNT			0x04
+#define MT_RING_CIDX			0x08
+#define MT_RING_DIDX			0x0c
+
 /* RX Ring registers */
 #define MT_RX_RING_BASE			(MT_WFDMA0_BASE + 0x500)
 
@@ -252,6 +361,11 @@ MODULE_PARM_DESC(skip_pci_reset, "Skip PCI function-level reset (default: true)"
 #define MT_HW_EMI_CTL			0x18011100
 #define MT_HW_EMI_CTL_SLPPROT_EN	BIT(1)
 
+/* MAC data path (MDP), needs remap */
+#define MT_MDP_DCR0			0x820cd000
+#define MT_MDP_DCR0_DAMSDU_EN		BIT(15)
+#define MT_MDP_DCR0_RX_HDR_TRANS_EN	BIT(19)
+
 /* Additional debug registers */
 #define MT_HIF_REMAP_L1			0x155024
 #define MT_HIF_REMAP_L1_MASK		GENMASK(31, 16)
@@ -259,6 +373,7 @@ MODULE_PARM_DESC(skip_pci_reset, "Skip PCI function-level reset (default: true)"
 #define MT_HIF_REMAP_L1_BASE		0x130000
 #define MT_INFRA_CFG_BASE		0xd1000
 #define MT_WFDMA_DUMMY_CR		(MT_WFDMA0_BASE + 0x120)
+#define MT_WFDMA_DUMMY_FW_COOKIE	GENMASK(31, 16)	/* Driver-owned, see mt7927_warm_start() */
 #define MT_MCU_WPDMA0_BASE		0x54000000
 
 /* Remap window size */
@@ -270,11 +385,18 @@ MODULE_PARM_DESC(skip_pci_reset, "Skip PCI function-level reset (default: true)"
  */
 
 #define MT792x_DRV_OWN_RETRY_COUNT	3	/* Reduced for faster debug feedback */
+#define MT7927_POLL_US			10	/* Handshake poll interval */
+#define MT7927_PM_OWN_TIMEOUT_MS	2	/* Per attempt, runtime ownership */
+#define MT7927_WD_INTERVAL_MS		100	/* DMA hang watchdog period */
+#define MT7927_WD_STALL_CHECKS		3	/* Checks without progress = hung */
+#define MT7927_RX_POLL_MS		1	/* RX ring 0 poll, tokens in flight */
 #define MT7927_TX_RING_SIZE		2048
 #define MT7927_TX_MCU_RING_SIZE		256
 #define MT7927_TX_FWDL_RING_SIZE	128
 #define MT7927_RX_MCU_RING_SIZE		512	/* RX ring for MCU events */
 #define MT7927_RX_BUF_SIZE		2048	/* Per-descriptor RX buffer */
+#define MT7927_TXP_MAX_MSDU		4	/* MSDUs per CT-mode TXD */
+#define MT7927_TX_BATCH			64	/* TX descriptors per doorbell */
 
 /* =============================================================================
  * DMA Descriptor
@@ -314,6 +436,115 @@ struct mt7927_mcu_hdr {
 	__le32 rsv1[5];		/* Reserved */
 } __packed;
 
+/*
+ * Unified command header following the TXD
+ * Used for commands to the RAM firmware (MCU_CMD_UNI)
+ */
+struct mt7927_mcu_uni_hdr {
+	__le16 len;		/* Length excluding txd */
+	__le16 cid;		/* Unified command ID */
+	u8 rsv;
+	u8 pkt_type;		/* Must be 0xa0 (MCU_PKT_ID) */
+	u8 frag_n;
+	u8 seq;			/* Sequence number */
+	__le16 checksum;
+	u8 s2d_index;		/* Source-to-destination routing */
+	u8 option;		/* MCU_CMD_* flags */
+	u8 rsv1[4];
+} __packed;
+
+/*
+ * MCU response header on RX ring 0 (mt76_connac2_mcu_rxd). @seq is the
+ * sequence number of the command answered.
+ */
+struct mt7927_mcu_rxd {
+	__le32 rxd[8];
+	__le16 len;
+	__le16 pkt_type_id;
+	u8 eid;			/* MCU_EVENT_* */
+	u8 seq;
+	u8 option;
+	u8 rsv;
+	u8 ext_eid;		/* Status byte of ROM responses */
+	u8 rsv1[2];
+	u8 s2d_index;
+} __packed;
+
+/* Result of a unified command, follows struct mt7927_mcu_rxd */
+struct mt7927_mcu_uni_event {
+	u8 cid;
+	u8 rsv[3];
+	__le32 status;		/* 0 on success */
+} __packed;
+
+/*
+ * STA_REC_UPDATE header, followed by tlv_num TLVs
+ */
+struct mt7927_sta_req_hdr {
+	u8 bss_idx;
+	u8 wlan_idx_lo;
+	__le16 tlv_num;
+	u8 is_tlv_append;
+	u8 muar_idx;		/* Own MAC index */
+	u8 wlan_idx_hi;
+	u8 rsv;
+} __packed;
+
+/* UNI_STA_REC_BA: block-ack session of one TID */
+struct mt7927_sta_rec_ba {
+	__le16 tag;
+	__le16 len;
+	u8 tid;
+	u8 ba_type;		/* MT_BA_TYPE_* */
+	u8 amsdu;
+	u8 ba_en;		/* BIT(tid) to enable, 0 to tear down */
+	__le16 ssn;
+	__le16 winsize;
+	u8 ba_rdd_rro;
+	u8 rsv[3];
+} __packed;
+
+/*
+ * BSS_INFO_UPDATE header, followed by TLVs. UNI_BSS_INFO_RLM sets the
+ * operating channel: primary, center(s) and width.
+ */
+struct mt7927_bss_req_hdr {
+	u8 bss_idx;
+	u8 rsv[3];
+} __packed;
+
+struct mt7927_bss_rlm_tlv {
+	__le16 tag;
+	__le16 len;
+	u8 control_channel;
+	u8 center_chan;
+	u8 center_chan2;	/* 80+80 only */
+	u8 bw;			/* CMD_CBW_* */
+	u8 tx_streams;
+	u8 rx_streams;
+	u8 ht_op_info;		/* 4: HT 40 MHz allowed */
+	u8 sco;			/* MT_SCO_* */
+	u8 band;		/* CMD_BAND_* */
+	u8 pad[3];
+} __packed;
+
+/*
+ * CT-mode TXP, placed right after the TXD. The MAC fetches up to four
+ * MSDUs through it, two per buf0/buf1 pair, and with MT_TXD3_HW_AMSDU
+ * packs them into one A-MSDU.
+ */
+struct mt7927_txp_ptr {
+	__le32 buf0;
+	__le16 len0;
+	__le16 len1;
+	__le32 buf1;
+} __packed __aligned(4);
+
+struct mt7927_hw_txp {
+	__le16 msdu_id[MT7927_TXP_MAX_MSDU];
+	struct mt7927_txp_ptr ptr[MT7927_TXP_MAX_MSDU / 2];
+} __packed __aligned(4);
+
 /*
  * Firmware trailer structure (at end of firmware file)
  */
@@ -428,6 +659,124 @@ struct mt7927_patch_sec {
 #define MT_TX_MCU_PORT_RX_Q0		0x20	/* MCU command queue */
 #define MT_TX_MCU_PORT_RX_FWDL		0x3e	/* Firmware download queue */
 
+/* Data TXD fields (connac3 layout, see mt76_connac3_mac.h) */
+#define MT_TXD1_WLAN_IDX		GENMASK(11, 0)
+#define MT_TXD1_TGID			GENMASK(13, 12)	/* MAC band */
+#define MT_TXD1_HDR_FORMAT		GENMASK(15, 14)
+#define MT_TXD1_HDR_INFO		GENMASK(20, 16)
+#define MT_TXD1_ETH_802_3		BIT(20)		/* Ethernet II, with 802_3 format */
+#define MT_TXD1_TID			GENMASK(24, 21)
+#define MT_TXD1_OWN_MAC			GENMASK(30, 25)
+#define MT_TXD1_FIXED_RATE		BIT(31)
+
+#define MT_TXD2_SUB_TYPE		GENMASK(3, 0)
+#define MT_TXD2_FRAME_TYPE		GENMASK(5, 4)
+
+#define MT_TXD3_PROTECT_FRAME		BIT(1)
+#define MT_TXD3_HW_AMSDU		BIT(5)
+#define MT_TXD3_REM_TX_COUNT		GENMASK(15, 11)
+#define MT_TXD3_SEQ			GENMASK(27, 16)
+#define MT_TXD3_SN_VALID		BIT(31)
+
+#define MT_TXD5_TX_STATUS_HOST		BIT(10)
+#define MT_TXD5_PID			GENMASK(7, 0)
+
+#define MT_TXD6_TX_RATE			GENMASK(21, 16)
+
+/* CT-mode TXP buffer lengths and MSDU IDs (mt76_connac_hw_txp) */
+#define MT_TXD_LEN_MASK			GENMASK(11, 0)
+#define MT_TXD_LEN_MSDU_LAST		BIT(14)
+#define MT_TXD_LEN_AMSDU_LAST		BIT(15)
+#define MT_MSDU_ID_VALID		BIT(15)
+
+/* TXD1 header formats */
+#define MT_HDR_FORMAT_802_3		0
+#define MT_HDR_FORMAT_CMD		1
+#define MT_HDR_FORMAT_802_11		2
+
+/* LMAC data queues, one per access category */
+#define MT_LMAC_AC00			0	/* Background */
+#define MT_LMAC_AC01			1	/* Best effort */
+#define MT_LMAC_AC02			2	/* Video */
+#define MT_LMAC_AC03			3	/* Voice */
+#define MT_LMAC_WMM_SETS		4
+
+/* RXD word 0, common to events and data */
+#define MT_RXD0_LENGTH			GENMASK(15, 0)
+#define MT_RXD0_PKT_TYPE		GENMASK(31, 27)
+
+#define PKT_TYPE_TXS			0	/* TX status */
+#define PKT_TYPE_NORMAL			2	/* Data frame */
+#define PKT_TYPE_TXRX_NOTIFY		6	/* TX-free event */
+
+/* Normal (data) RXD, 8 words plus the groups flagged in word 1 */
+#define MT_RXD1_NORMAL_WLAN_IDX		GENMASK(11, 0)
+#define MT_RXD1_NORMAL_GROUP_1		BIT(16)
+#define MT_RXD1_NORMAL_GROUP_2		BIT(17)
+#define MT_RXD1_NORMAL_GROUP_3		BIT(18)
+#define MT_RXD1_NORMAL_GROUP_4		BIT(19)
+#define MT_RXD1_NORMAL_GROUP_5		BIT(20)
+#define MT_RXD1_NORMAL_CM		BIT(23)
+#define MT_RXD1_NORMAL_CLM		BIT(24)
+#define MT_RXD1_NORMAL_SEC_DONE		BIT(31)
+
+#define MT_RXD2_NORMAL_HDR_TRANS	BIT(7)
+#define MT_RXD2_NORMAL_HDR_OFFSET	GENMASK(15, 13)
+#define MT_RXD2_NORMAL_SEC_MODE		GENMASK(20, 16)
+#define MT_RXD2_NORMAL_HDR_TRANS_ERROR	BIT(25)
+
+#define MT_RXD3_NORMAL_FCS_ERR		BIT(24)
+#define MT_RXD3_NORMAL_IP_SUM		BIT(26)		/* IP checksum checked */
+#define MT_RXD3_NORMAL_UDP_TCP_SUM	BIT(27)		/* L4 checksum checked */
+
+#define MT7927_RXD_WORDS		8
+
+/* RXD group 4: 802.11 header fields, words 8-11 when it comes first */
+#define MT_RXD8_FRAME_CONTROL		GENMASK(15, 0)
+#define MT_RXD10_SEQ_CTRL		GENMASK(15, 0)
+#define MT_RXD10_QOS_CTL		GENMASK(31, 16)
+
+/* RXD group 3: P-RXV, rate in word 2, per-chain RCPI in word 3 */
+#define MT_PRXV_TX_RATE			GENMASK(6, 0)
+#define MT_PRXV_NSTS			GENMASK(10, 7)
+#define MT_PRXV_FRAME_MODE		GENMASK(2, 0)	/* Bandwidth */
+#define MT_PRXV_HT_SHORT_GI		GENMASK(4, 3)
+#define MT_PRXV_TX_MODE			GENMASK(14, 11)
+#define MT_PRXV_RCPI1			GENMASK(15, 8)
+#define MT_PRXV_RCPI0			GENMASK(7, 0)
+
+/* PHY modes in MT_PRXV_TX_MODE and MT_TX_RATE_MODE */
+#define MT_PHY_TYPE_CCK			0
+#define MT_PHY_TYPE_OFDM		1
+#define MT_PHY_TYPE_HT			2
+#define MT_PHY_TYPE_HT_GF		3
+#define MT_PHY_TYPE_VHT			4
+#define MT_PHY_TYPE_HE_SU		8
+#define MT_PHY_TYPE_HE_EXT_SU		9
+#define MT_PHY_TYPE_HE_TB		10
+#define MT_PHY_TYPE_HE_MU		11
+#define MT_PHY_TYPE_EHT_SU		13
+#define MT_PHY_TYPE_EHT_TRIG		14
+#define MT_PHY_TYPE_EHT_MU		15
+
+/* TX status (PKT_TYPE_TXS), 8 words per entry after a 4 word header */
+#define MT_TXS0_BW			GENMASK(31, 29)
+#define MT_TXS0_TX_RATE			GENMASK(13, 0)
+#define MT_TXS2_WCID			GENMASK(27, 16)
+#define MT_TXS3_PID			GENMASK(31, 24)
+#define MT7927_TXS_WORDS		8
+
+#define MT_TX_RATE_IDX			GENMASK(5, 0)
+#define MT_TX_RATE_MODE			GENMASK(9, 6)
+#define MT_TX_RATE_NSS			GENMASK(12, 10)
+
+/* TX-free event (PKT_TYPE_TXRX_NOTIFY), see mt7927_tx_free_event() */
+#define MT_TXFREE0_MSDU_CNT		GENMASK(25, 16)
+#define MT_TXFREE1_VER			GENMASK(18, 16)
+#define MT_TXFREE_INFO_MSDU_ID		GENMASK(14, 0)	/* Two per word */
+#define MT_TXFREE_INFO_HEADER		BIT(30)
+#define MT_TXFREE_INFO_PAIR		BIT(31)
+
 /* MCU command IDs */
 #define MCU_CMD_TARGET_ADDRESS_LEN_REQ	0x01
 #define MCU_CMD_FW_START_REQ		0x02
@@ -441,8 +790,13 @@ struct mt7927_patch_sec {
 #define PATCH_SEM_RELEASE		0x00
 
 /* Patch semaphore response */
+#define PATCH_IS_DL			0x01	/* Patch already downloaded */
 #define PATCH_NOT_DL_SEM_SUCCESS	0x02
 
+/* MCU response event IDs (struct mt7927_mcu_rxd::eid) */
+#define MCU_EVENT_GENERIC		0x01	/* ROM commands, UNI result */
+#define MCU_EVENT_PATCH_SEM		0x04
+
 /*
  * Patch section type field interpretation:
  * The type field uses specific bits to indicate section properties.
@@ -465,8 +819,42 @@ struct mt7927_patch_sec {
 #define DL_MODE_VALID_RAM_ENTRY		BIT(5)
 #define DL_MODE_NEED_RSP		BIT(31)
 
+/* Firmware files */
+#define MT7927_PATCH_FW			"mediatek/mt7925/WIFI_MT7925_PATCH_MCU_1_1_hdr.bin"
+#define MT7927_RAM_FW			"mediatek/mt7925/WIFI_RAM_CODE_MT7925_1_1.bin"
+
 /* Firmware chunk size */
 #define MT7927_FW_CHUNK_SIZE		4096
+#define MT7927_MCU_MSG_MAX		2048	/* Largest MCU command incl. TXD */
+
+/* Pre-mapped TX slots, see mt7927_tx_map() */
+#define MT7927_TX_SLOT_SIZE		512
+#define MT7927_TX_SLOTS			64
+
+/* Data TX tokens, see mt7927_token_get() */
+#define MT7927_TOKEN_SIZE		8192
+
+/* Stations and block ack */
+#define MT7927_WTBL_SIZE		20
+#define MT7927_NUM_TIDS			8
+#define MT7927_SEQ_MASK			0xfff
+#define MT7927_BA_WIN_MAX		1024	/* 802.11be */
+
+/* TX status for rate reporting, see mt7927_txs_request() */
+#define MT7927_PID_RATE			1	/* No skb waits on it */
+#define MT7927_TXS_INTERVAL		(HZ / 4)
+
+/* PHY: 2x2, up to 320 MHz on 6 GHz */
+#define MT7927_NSS			2
+
+/* MLO: one link per MAC band, each with its own data ring */
+#define MT7927_MAX_LINKS		2
+#define MT7927_TXQ_BAND0		0
+
+#define MT7927_TX_DATA_RINGS		MT7927_MAX_LINKS
+
+/* TX completion latency: log2 buckets split in quarters */
+#define MT7927_LAT_BUCKETS		(64 * 4)
 
 /* MCU S2D (Source to Destination) routing */
 #define MCU_S2D_H2N			0x00	/* Host to WiFi Manager (N9) */
@@ -479,11 +867,475 @@ struct mt7927_patch_sec {
 #define MCU_CMD_UNI			BIT(1)
 #define MCU_CMD_SET			BIT(2)
 
+/* Unified commands, handled by the RAM firmware */
+#define MCU_UNI_CMD_STA_REC_UPDATE	0x03
+#define MCU_UNI_OPT_EXT_ACK		(MCU_CMD_ACK | MCU_CMD_UNI | MCU_CMD_SET)
+
+/* STA_REC_UPDATE TLVs */
+#define UNI_STA_REC_BA			0x06
+
+#define MT_BA_TYPE_ORIGINATOR		BIT(0)
+#define MT_BA_TYPE_RECIPIENT		BIT(1)
+
+#define MCU_UNI_CMD_BSS_INFO_UPDATE	0x02
+
+/* BSS_INFO_UPDATE TLVs */
+#define UNI_BSS_INFO_RLM		0x02
+
+/* RLM TLV channel width and band */
+#define CMD_CBW_20MHZ			0
+#define CMD_CBW_40MHZ			1
+#define CMD_CBW_80MHZ			2
+#define CMD_CBW_160MHZ			3
+#define CMD_CBW_320MHZ			7
+
+#define CMD_BAND_24G			1
+#define CMD_BAND_5G			2
+#define CMD_BAND_6G			3
+
+/* RLM TLV secondary channel offset */
+#define MT_SCO_SCN			0	/* No secondary, or centered */
+#define MT_SCO_SCA			1	/* Secondary above primary */
+#define MT_SCO_SCB			3	/* Secondary below primary */
+
 /* =============================================================================
  * Device Structure
  * =============================================================================
  */
 
+/* Probe phases, in the order mt7927_probe() runs them */
+enum mt7927_phase {
+	MT7927_PHASE_PCI_SETUP,
+	MT7927_PHASE_PM_HANDOFF,
+	MT7927_PHASE_CHIP_ID,
+	MT7927_PHASE_WARM_CHECK,
+	MT7927_PHASE_EMI,
+	MT7927_PHASE_WFSYS_RESET,
+	MT7927_PHASE_IRQ_SETUP,
+	MT7927_PHASE_DMA_INIT,
+	MT7927_PHASE_VERIFY,
+	MT7927_PHASE_ROM_READY,
+	MT7927_PHASE_PATCH,
+	__MT7927_PHASE_MAX,
+	MT7927_PHASE_NONE = __MT7927_PHASE_MAX,
+};
+
+struct mt7927_phase_stats {
+	u64 time_ns;			/* Wall time */
+	u64 sleep_ns;			/* Of which blocked in msleep/usleep_range */
+	u64 mmio_rd;
+	u64 mmio_wr;
+	bool done;
+};
+
+struct mt7927_mmio_cnt {
+	u64 rd;
+	u64 wr;
+};
+
+struct mt7927_timing {
+	ktime_t probe_start;
+	u64 probe_ns;			/* Whole probe, set when it returns */
+
+	enum mt7927_phase phase;	/* Currently running phase */
+	ktime_t phase_start;
+	u64 phase_sleep_ns;		/* Counter snapshots at phase start */
+	u64 phase_mmio_rd;
+	u64 phase_mmio_wr;
+
+	u64 sleep_ns;			/* Running total of sleep time */
+	struct mt7927_phase_stats phases[__MT7927_PHASE_MAX];
+};
+
+/* Runtime power save state, see mt7927_pm_wake() */
+struct mt7927_pm {
+	struct mutex mutex;		/* Serializes ownership changes */
+	struct delayed_work ps_work;	/* Hands ownership to FW when idle */
+	unsigned long last_activity;	/* jiffies */
+	bool fw_own;			/* Firmware currently owns LPCTL */
+
+	u32 doze_cnt;
+	u32 wake_cnt;
+	u32 fail_cnt;
+	u64 last_wake_us;
+	u64 max_wake_us;
+	u64 total_wake_us;
+
+	/* System suspend/resume, see mt7927_resume() */
+	ktime_t resume_start;
+	u32 suspend_cnt;
+	u32 resume_cold_cnt;		/* Firmware lost, full bring-up re-run */
+	u64 last_resume_us;
+	u64 max_resume_us;
+};
+
+/* Reasons for keeping ASPM L1 off, see mt7927_aspm_hold() */
+enum mt7927_aspm_reason {
+	MT7927_ASPM_FWDL,		/* Bring-up and firmware download */
+	MT7927_ASPM_MCU,		/* MCU command in flight */
+	MT7927_ASPM_GAME,		/* Game mode is on */
+	__MT7927_ASPM_MAX,
+};
+
+struct mt7927_aspm {
+	struct mutex mutex;
+	struct delayed_work work;	/* Re-enables L1 after aspm_idle_ms */
+	u16 hold[__MT7927_ASPM_MAX];	/* Holders per MT7927_ASPM_* reason */
+	unsigned int holders;		/* Sum of hold[] */
+	int states;			/* PCIE_LINK_STATE_* enabled at probe */
+	bool capable;			/* L1 was enabled on our link at probe */
+	bool l1_on;			/* L1 currently enabled */
+
+	ktime_t since;			/* Last l1_on change */
+	u64 on_ns;
+	u64 off_ns;
+	u32 enable_cnt;
+	u32 disable_cnt;
+};
+
+/* Low-latency profile, see mt7927_game_mode_set() */
+struct mt7927_game {
+	struct mutex mutex;		/* Serializes switching */
+	bool on;			/* Read locklessly on the TX path */
+	u32 enter_cnt;
+};
+
+/* Token-to-TX-free time as the host sees it, see mt7927_tx_lat_add() */
+struct mt7927_tx_lat {
+	u32 hist[MT7927_LAT_BUCKETS];
+	u64 count;
+	u64 max_ns;
+};
+
+/* Per-ring DMA hang watchdog state, see mt7927_wd_work() */
+struct mt7927_ring_wd {
+	u32 didx;			/* DIDX at the last check */
+	u8 stall;			/* Consecutive checks without progress */
+	u32 recover_cnt;
+};
+
+struct mt7927_wd {
+	struct delayed_work work;
+	struct mt7927_ring_wd tx_mcu;	/* Ring 15 */
+	struct mt7927_ring_wd tx_fwdl;	/* Ring 16 */
+	struct mt7927_ring_wd rx_mcu;	/* RX ring 0 */
+	u64 last_recover_us;
+	u64 max_recover_us;
+};
+
+/* Pre-mapped TX buffers, see mt7927_tx_map() */
+struct mt7927_tx_arena {
+	void *buf;			/* MT7927_TX_SLOTS slots, coherent */
+	dma_addr_t dma;
+	DECLARE_BITMAP(used, MT7927_TX_SLOTS);
+
+	u64 copy_cnt;			/* Sends copied into a slot */
+	u64 map_cnt;			/* dma_map_single() calls */
+	u64 unmap_cnt;
+	u32 full_cnt;			/* No free slot, mapped instead */
+	u32 map_err;
+};
+
+/* Data TXD template per station/TID, see mt7927_txd_tmpl_get() */
+struct mt7927_txd_tmpl {
+	__le32 txd[8];			/* TX_BYTES and SEQ left zero */
+	u32 gen;			/* sta->gen it was built for, 0 = never */
+	u16 seq;			/* Next sequence number for this TID */
+};
+
+/* TX block-ack session, set up in firmware by mt7927_ba_tx_start() */
+struct mt7927_ba_tx {
+	u16 ssn;
+	u16 winsize;
+	bool amsdu;
+};
+
+/*
+ * RX block-ack reorder buffer of one TID, see mt7927_rx_reorder(). Frames
+ * are held by SN modulo @size until the hole before them is filled or
+ * they time out.
+ */
+struct mt7927_rx_tid {
+	struct rcu_head rcu_head;
+	struct mt7927_dev *dev;
+	struct delayed_work reorder_work;
+	spinlock_t lock;		/* Everything below */
+
+	u64 last_pn;			/* Replay check on release */
+	u16 head;			/* Next SN expected */
+	u16 size;			/* Window, in frames */
+	u16 nframes;			/* Frames held */
+	u8 num;				/* TID */
+	bool stopped;
+
+	u64 released;
+	u32 old;			/* Behind the window, dropped */
+	u32 dup;			/* Slot already taken, dropped */
+	u32 timeout;			/* Holes skipped by the reorder timer */
+	u32 replay;			/* PN not increasing, dropped */
+
+	struct sk_buff *reorder_buf[] __counted_by(size);
+};
+
+/* Host A-MSDU flow of one station/TID, see mt7927_amsdu_add() */
+struct mt7927_amsdu {
+	struct mt7927_sta *sta;
+	struct sk_buff *skb[MT7927_TXP_MAX_MSDU];
+	u64 start_ns;			/* local_clock() at the first frame */
+	u32 max_us;			/* Longest the first frame may wait */
+	u16 max_len;			/* Most MSDU bytes per aggregate */
+	u16 len;			/* MSDU bytes held */
+	u8 nframes;
+	u8 tid;
+	bool queued;			/* On a batch's pending list */
+};
+
+/* Bands, index of dev->he_cap[] and dev->eht_cap[] */
+enum mt7927_band {
+	MT7927_BAND_2G,
+	MT7927_BAND_5G,
+	MT7927_BAND_6G,
+	MT7927_NUM_BANDS,
+};
+
+/* Operating channel, see mt7927_chandef_init() */
+struct mt7927_chandef {
+	enum mt7927_band band;
+	u8 chan;			/* Primary 20 MHz channel */
+	u8 center;			/* Center channel of the whole width */
+	u16 width;			/* MHz, 0 = not set */
+};
+
+/* MLO link: a BSS on one MAC band, see mt7927_link_add() */
+struct mt7927_link {
+	struct mt7927_chandef chandef;
+	bool active;
+	u8 band_idx;			/* TXD1 TGID */
+	u8 ring;			/* TX data ring */
+	u8 omac_idx;
+	u8 wmm_idx;
+	atomic_t inflight;		/* Bytes queued, not yet TX-freed */
+
+	u64 tx_msdus;
+	u64 tx_bytes;
+	u64 rx_msdus;
+	u64 rx_bytes;
+};
+
+enum mt7927_mlo_policy {
+	MT7927_MLO_LATENCY,		/* Keep each TID on its fastest link */
+	MT7927_MLO_THROUGHPUT,		/* Spread frames over all links */
+};
+
+/*
+ * Rate of the last frame from or to a station. mode is MT_PHY_TYPE_*,
+ * bw 0-4 for 20-320 MHz, gi the HE/EHT GI index (0.8/1.6/3.2 us) or
+ * for HT/VHT 1 for short GI.
+ */
+struct mt7927_rate {
+	u8 mode;
+	u8 mcs;
+	u8 nss;
+	u8 bw;
+	u8 gi;
+};
+
+struct mt7927_sta {
+	u16 wcid;			/* WTBL index */
+	u8 omac_idx;			/* Own MAC address index */
+	u8 wmm_idx;			/* WMM set of the BSS */
+	u8 fixed_rate;			/* TXD6 rate index, 0 = firmware RC */
+	bool protect;			/* Pairwise key installed */
+	bool eth_hdr;			/* 802.3 frames, hardware encap */
+	u32 gen;			/* Bumped on rate or key change */
+	u64 tmpl_builds;		/* Template (re)builds */
+	struct mt7927_txd_tmpl tmpl[MT7927_NUM_TIDS];
+
+	/* Block ack, changed under dev->sta_mutex */
+	unsigned long ba_tx_mask;	/* BIT(tid) with a TX session */
+	struct mt7927_ba_tx ba_tx[MT7927_NUM_TIDS];
+	struct mt7927_rx_tid __rcu *rx_tid[MT7927_NUM_TIDS];
+
+	struct mt7927_amsdu amsdu[MT7927_NUM_TIDS];
+
+	/* Rate reporting per link, written by RX and TX status without locks */
+	struct mt7927_rate rx_rate[MT7927_MAX_LINKS];
+	struct mt7927_rate tx_rate[MT7927_MAX_LINKS];
+	unsigned long txs_next;		/* jiffies of the next TXS request */
+
+	/*
+	 * MLO: the WLAN index on each link. dev->sta[] holds the station
+	 * under all of them, link 0 (wcid above) is the primary.
+	 */
+	u8 link_mask;
+	u16 link_wcid[MT7927_MAX_LINKS];
+	u8 tid_link[MT7927_NUM_TIDS];	/* Last TX link, see mt7927_mlo_select() */
+};
+
+/* TX descriptors of one burst, posted with a single doorbell */
+struct mt7927_tx_batch {
+	struct mt76_desc desc[MT7927_TX_BATCH];
+	u8 ring[MT7927_TX_BATCH];	/* Data ring of each desc */
+	struct mt7927_amsdu *pending[MT7927_TX_BATCH];	/* Flows holding frames */
+	u16 ndesc;
+	u16 npending;
+};
+
+/* Host A-MSDU stage, see mt7927_amsdu_add() */
+struct mt7927_amsdu_stats {
+	u64 msdus;			/* Frames through the stage */
+	u64 descs;			/* Ring descriptors they took */
+	u64 kicks;			/* Doorbells */
+	u64 aggs;			/* Descriptors carrying 2+ MSDUs */
+	u32 flush_full;			/* TXP slots used up */
+	u32 flush_len;			/* Next frame did not fit max_len */
+	u32 flush_time;			/* First frame waited max_us */
+	u32 flush_kick;			/* End of a burst */
+	u32 high_dma;			/* MSDU above 4 GB, sent one per TXD */
+	u32 drop;
+};
+
+/* A data frame handed to firmware, see mt7927_token_get() */
+struct mt7927_txwi {
+	struct sk_buff *skb;
+	dma_addr_t dma;
+	u32 len;
+	u8 link;			/* MLO link it was queued to */
+	bool game;			/* Queued in game mode */
+	u32 gen;			/* mt7927_token.gen when taken */
+	u64 queued_ns;			/* For the TX latency histogram */
+};
+
+/* Data frames on RX ring 0, see mt7927_rx_data() */
+struct mt7927_rx_stats {
+	u64 eth;			/* 802.3 frames delivered */
+	u64 eth_bytes;
+	u64 wlan;			/* Not translated, no 802.11 path yet */
+	u64 csum_ok;			/* Checksums verified by hardware */
+	u32 hdr_trans_err;
+	u32 fcs_err;
+	u32 bad_len;
+	u32 nomem;
+};
+
+#ifdef CONFIG_MT7927_SELFTEST
+/* Data RXDs sampled for the rxd_bench file, see mt7927_rxd_bench_write() */
+#define MT7927_RXD_REC_SAMPLES		16
+#define MT7927_RXD_REC_BYTES		256	/* All groups plus some payload */
+
+struct mt7927_rxd_rec {
+	u8 buf[MT7927_RXD_REC_SAMPLES][MT7927_RXD_REC_BYTES];
+	u16 len[MT7927_RXD_REC_SAMPLES];
+	u8 count;
+	bool armed;		/* Holds a mt7927_rxd_rec_key reference */
+};
+#endif
+
+/* Flags in mt7927_rxd_info::flags */
+#define MT7927_RXD_F_HDR_TRANS		BIT(0)	/* 802.3 frame */
+#define MT7927_RXD_F_HDR_TRANS_ERR	BIT(1)
+#define MT7927_RXD_F_FCS_ERR		BIT(2)
+#define MT7927_RXD_F_CSUM_OK		BIT(3)	/* IP and L4 checked, no error */
+#define MT7927_RXD_F_SEQ_VALID		BIT(4)	/* QoS data, seqno/tid set */
+#define MT7927_RXD_F_PN_VALID		BIT(5)	/* Decrypted, pn set */
+#define MT7927_RXD_F_RATE_VALID		BIT(6)	/* Group 3 present */
+
+/* Everything the RX path needs from one RXD, see mt7927_rxd_parse() */
+struct mt7927_rxd_info {
+	u64 pn;
+	u16 hdr_gap;			/* RXD groups plus header padding */
+	u16 len;			/* Frame bytes after hdr_gap */
+	u16 wcid;
+	u16 seqno;
+	u8 tid;
+	u8 flags;			/* MT7927_RXD_F_* */
+	u8 sec_mode;
+	u8 rate_idx;			/* MCS or legacy rate index */
+	u8 rate_mode;			/* MT_PRXV_TX_MODE */
+	u8 nss;
+	u8 bw;
+	u8 gi;
+	s8 rssi[2];			/* dBm, per chain */
+};
+
+struct mt7927_token {
+	struct mt7927_txwi *txwi;	/* MT7927_TOKEN_SIZE entries */
+	/* Atomic bitops only, see mt7927_token_get() */
+	DECLARE_BITMAP(used, MT7927_TOKEN_SIZE);	/* Taken */
+	DECLARE_BITMAP(live, MT7927_TOKEN_SIZE);	/* Entry filled, in flight */
+	atomic_t hint;			/* Where the next search starts */
+	atomic_t count;			/* Tokens in flight */
+	atomic_t full_cnt;		/* mt7927_token_get() found none */
+
+	/* TX-free side, under dma_mutex */
+	u64 free_evt;			/* TX-free events handled */
+	u64 reclaimed;			/* Tokens released by them */
+	u32 max_batch;			/* Most tokens released by one event */
+	u32 bad_id;			/* Event named an idle or invalid token */
+	u32 drained;			/* Released without an event (reset) */
+	u32 gen;			/* Bumped by drains and self-test runs */
+};
+
+/* Full chip recovery, see mt7927_reset_work() */
+struct mt7927_reset {
+	struct work_struct work;
+	const char *reason;		/* Trigger of the last reset */
+	u32 mcu_cmd;			/* MT_MCU_CMD at trigger, 0 if host side */
+	u32 cnt;
+	u32 fail_cnt;
+	u32 fw_ack_cnt;			/* Firmware reported RECOVERY_DONE */
+	u64 last_us;
+	u64 max_us;
+};
+
+/* Bits in mt7927_dev::state */
+enum {
+	MT7927_STATE_INIT_DONE,		/* Bring-up worker finished */
+	MT7927_STATE_REMOVING,		/* remove() in progress, abort bring-up */
+	MT7927_STATE_WARM_START,	/* Re-attached to running firmware */
+	MT7927_STATE_RESUMING,		/* Bring-up worker re-run by resume */
+	MT7927_STATE_RESETTING,		/* Full chip recovery queued or running */
+	MT7927_STATE_FW_RUNNING,	/* RAM firmware up, UNI commands allowed */
+};
+
+#ifdef CONFIG_MT7927_SELFTEST
+/*
+ * Stand-in for the firmware and the data rings, for mlo_test and
+ * busy_poll_bench: UNI commands are logged instead of sent, TX
+ * descriptors and RX deliveries are recorded instead of reaching
+ * hardware or the stack, and data RX frames arrive on a timer and are
+ * polled by a NAPI instance of the mock's own.
+ */
+#define MT7927_MOCK_LOG			256
+
+struct mt7927_mock {
+	u32 mcu_cmds;
+	u16 mcu_cid[MT7927_MOCK_LOG];
+	u32 queued[MT7927_TX_DATA_RINGS];	/* TX descriptors per ring */
+	u32 kicks[MT7927_TX_DATA_RINGS];	/* Doorbells per ring */
+	u16 ntx;
+	u8 tx_ring[MT7927_MOCK_LOG];	/* Ring of each descriptor, in order */
+	u16 nrx;
+	u16 rx_sn[MT7927_MOCK_LOG];	/* SN of each frame delivered */
+
+	/* Data RX ring, see mt7927_mock_napi_poll() */
+	struct mt7927_dev *dev;
+	struct net_device *napi_dev;	/* Dummy, only hosts the NAPI */
+	struct napi_struct napi;
+	bool irq_masked;		/* Data RX interrupt off */
+	struct hrtimer rx_timer;	/* A frame arrives when it fires */
+	atomic_t rx_pending;		/* Arrived, not yet polled */
+	atomic_t rx_done;		/* Delivered to the stack */
+	int rx_want;			/* rx_done the waiter is after */
+	u32 irqs;			/* Data RX interrupts taken */
+	u32 irqs_masked;		/* Arrivals while masked */
+	u8 rx_buf[MT7927_RXD_REC_BYTES];
+	int rx_len;
+
+	struct task_struct *task;	/* Self-test whose commands are mocked */
+};
+#endif
+
 struct mt7927_dev {
 	struct pci_dev *pdev;
 	void __iomem *regs;
@@ -493,212 +1345,658 @@ struct mt7927_dev {
 	struct mt76_desc *tx_ring;
 	dma_addr_t tx_ring_dma;
 	int tx_ring_size;
-	int tx_ring_head;		/* Next descriptor to use */
-	int tx_ring_tail;		/* Next descriptor to complete */
 
 	/* TX Ring 15 - MCU Commands (WM) */
 	struct mt76_desc *mcu_ring;
 	dma_addr_t mcu_ring_dma;
 	int mcu_ring_size;
-	int mcu_ring_head;
 
 	/* RX Ring 0 - MCU Events */
 	struct mt76_desc *rx_ring;
 	dma_addr_t rx_ring_dma;
 	int rx_ring_size;
-	int rx_ring_head;
 	void *rx_buf;			/* RX buffer pool */
 	dma_addr_t rx_buf_dma;
 
-	/* Firmware buffer */
-	void *fw_buf;
-	dma_addr_t fw_dma;
-	size_t fw_size;
+	/*
+	 * Hot ring indices. Senders write the heads (which double as the
+	 * CIDX doorbell shadow), TX completion and RX write the tails; each
+	 * side gets its own cache line.
+	 */
+	int tx_ring_head ____cacheline_aligned_in_smp;	/* Next descriptor to use */
+	int mcu_ring_head;
+
+	int tx_ring_tail ____cacheline_aligned_in_smp;	/* Next descriptor to complete */
+	int mcu_ring_tail;
+	int rx_ring_head;				/* Next RX descriptor to read */
+
+	/* Firmware image */
+	const struct firmware *patch_fw;	/* Cached, see mt7927_patch_fw_get() */
 
 	/* MCU command buffer (for scatter commands) */
 	void *mcu_buf;
 	dma_addr_t mcu_dma;
 
+	/* MCU commands on ring 15: built in mcu_msg, sent via the arena */
+	void *mcu_msg;
+	struct mt7927_tx_arena arena;
+
+	/* Data frames owned by firmware until a TX-free event */
+	struct mt7927_token token;
+	struct mt7927_rx_stats rx_stats;
+	struct mt7927_amsdu_stats amsdu_stats;
+#ifdef CONFIG_MT7927_SELFTEST
+	struct mt7927_rxd_rec rxd_rec;
+#endif
+	struct mt7927_tx_lat tx_lat[2];	/* Normal, game mode; under dma_mutex */
+
+	/* Stations by WLAN index, see mt7927_sta_add() */
+	struct mt7927_sta __rcu *sta[MT7927_WTBL_SIZE];
+	struct mutex sta_mutex;		/* Station table, BA sessions, channel */
+
+	/* PHY and links, see mt7927_phy_caps_init() and mt7927_link_add() */
+	struct mt7927_link link[MT7927_MAX_LINKS];
+	enum mt7927_mlo_policy mlo_policy;
+#ifdef CONFIG_MT7927_SELFTEST
+	struct mt7927_mock __rcu *mock;	/* While a self-test runs */
+#endif
+	struct ieee80211_sta_he_cap he_cap[MT7927_NUM_BANDS];
+	struct ieee80211_sta_eht_cap eht_cap[MT7927_NUM_BANDS];
+	u64 txs_cnt;			/* TX status entries handled */
+
+	/* Ring 15/16 producers and their buffers, RX ring 0, the watchdog */
+	struct mutex dma_mutex;
+	struct mt7927_wd wd;
+	struct delayed_work rx_poll;	/* See mt7927_rx_poll_work() */
+	struct mt7927_reset reset;
+
 	/* State */
+	unsigned long state;		/* MT7927_STATE_* bits */
+	struct work_struct init_work;	/* Bring-up, see mt7927_init_work() */
 	bool aspm_supported;
 	u32 chip_rev;
 	u32 chip_id;
 	u8 mcu_seq;			/* MCU command sequence number */
+	u32 conn_misc;			/* Last MT_CONN_ON_MISC value seen */
+
+	/*
+	 * MMIO access counters (BAR0, including remap window). Bumped on
+	 * every access while a probe phase runs, from any context, so per
+	 * CPU; see mt7927_mmio_count().
+	 */
+	struct mt7927_mmio_cnt __percpu *mmio;
+
+	/* DMA addressing, see mt7927_desc_set_buf() */
+	u8 dma_bits;			/* 36, or 32 if the platform refused */
+	u64 dma_high_cnt;		/* Buffers posted above 4 GB */
+
+	/* Runtime power save */
+	struct mt7927_pm pm;
+	struct mt7927_aspm aspm;
+	struct mt7927_game game;
+
+	/* Probe timing (see mt7927_phase_begin()) */
+	struct mt7927_timing timing;
+
+	/* Register access trace (see mt7927_trace()) */
+	struct mt7927_trace_buf __percpu *trace;
+	struct dentry *debugfs_dir;
 };
 
-/* =============================================================================
- * Register Access Helpers with Debug Logging and Bounds Checking
- * =============================================================================
- */
+/* Producer and consumer indices in separate cache lines */
+static_assert(IS_ALIGNED(offsetof(struct mt7927_dev, tx_ring_head), SMP_CACHE_BYTES));
+static_assert(IS_ALIGNED(offsetof(struct mt7927_dev, tx_ring_tail), SMP_CACHE_BYTES));
+static_assert(offsetofend(struct mt7927_dev, mcu_ring_head) <=
+	      offsetof(struct mt7927_dev, tx_ring_tail));
 
-/* Safe register read - checks bounds to prevent crashes */
-static inline u32 mt7927_rr(struct mt7927_dev *dev, u32 offset)
-{
-	if (offset >= dev->regs_len) {
-		if (debug_regs)
-			dev_warn(&dev->pdev->dev,
-				 "  READ  [0x%08x] OUT OF BOUNDS (max 0x%llx)\n",
-				 offset, (unsigned long long)dev->regs_len);
-		return 0xdeadbeef;
-	}
-	return readl(dev->regs + offset);
-}
+/* Rings, RX buffers and TX slots cover whole cache lines, none shared */
+static_assert(sizeof(struct mt76_desc) == 16);
+static_assert(IS_ALIGNED(MT7927_TX_FWDL_RING_SIZE * sizeof(struct mt76_desc), SMP_CACHE_BYTES));
+static_assert(IS_ALIGNED(MT7927_TX_MCU_RING_SIZE * sizeof(struct mt76_desc), SMP_CACHE_BYTES));
+static_assert(IS_ALIGNED(MT7927_RX_MCU_RING_SIZE * sizeof(struct mt76_desc), SMP_CACHE_BYTES));
+static_assert(IS_ALIGNED(MT7927_RX_BUF_SIZE, SMP_CACHE_BYTES));
+static_assert(IS_ALIGNED(MT7927_TX_SLOT_SIZE, SMP_CACHE_BYTES));
+
+#define CREATE_TRACE_POINTS
+#include "mt7927_trace.h"
 
-/* Safe register write - checks bounds to prevent crashes */
-static inline void mt7927_wr(struct mt7927_dev *dev, u32 offset, u32 val)
+static inline bool mt7927_aborted(struct mt7927_dev *dev)
 {
-	if (offset >= dev->regs_len) {
-		if (debug_regs)
-			dev_warn(&dev->pdev->dev,
-				 "  WRITE [0x%08x] OUT OF BOUNDS (max 0x%llx)\n",
-				 offset, (unsigned long long)dev->regs_len);
-		return;
-	}
-	writel(val, dev->regs + offset);
+	return test_bit(MT7927_STATE_REMOVING, &dev->state);
 }
 
 /*
- * Remapped register access for high addresses (0x7c0xxxxx range)
- * Uses HIF_REMAP_L1 to create a window into high address space
+ * Queue a full chip recovery. Only once bring-up has finished: before that
+ * the bring-up worker owns the device and handles its own failures.
  */
-static u32 mt7927_rr_remap(struct mt7927_dev *dev, u32 addr)
+static void mt7927_reset_schedule(struct mt7927_dev *dev, const char *reason,
+				  u32 mcu_cmd)
 {
-	u32 base, offset, val, remap_val;
-
-	/* Calculate base (64KB aligned) and offset within window */
-	base = addr & ~(MT_HIF_REMAP_WINDOW_SIZE - 1);
-	offset = addr & (MT_HIF_REMAP_WINDOW_SIZE - 1);
+	if (mt7927_aborted(dev) || !test_bit(MT7927_STATE_INIT_DONE, &dev->state))
+		return;
 
-	/* Check if HIF_REMAP_L1 itself is accessible */
-	if (MT_HIF_REMAP_L1 >= dev->regs_len) {
-		dev_warn(&dev->pdev->dev,
-			 "  REMAP: Cannot access HIF_REMAP_L1 (0x%x >= 0x%llx)\n",
-			 MT_HIF_REMAP_L1, (unsigned long long)dev->regs_len);
-		return 0xdeadbeef;
-	}
+	if (test_and_set_bit(MT7927_STATE_RESETTING, &dev->state))
+		return;
 
-	/* Program the remap register */
-	remap_val = FIELD_PREP(MT_HIF_REMAP_L1_MASK, base >> 16);
-	writel(remap_val, dev->regs + MT_HIF_REMAP_L1);
+	dev->reset.reason = reason;
+	dev->reset.mcu_cmd = mcu_cmd;
+	queue_work_node(dev_to_node(&dev->pdev->dev), system_unbound_wq,
+			&dev->reset.work);
+}
 
-	/* Ensure write completes */
-	(void)readl(dev->regs + MT_HIF_REMAP_L1);
+/*
+ * Self-test hooks: the mock device (see struct mt7927_mock) and RXD
+ * sampling for rxd_bench. Without CONFIG_MT7927_SELFTEST they compile
+ * to nothing. dev->mock changes under dma_mutex; RX delivery runs
+ * without it, from the reorder work and NAPI, so the mock is looked up
+ * under RCU there.
+ */
+#ifdef CONFIG_MT7927_SELFTEST
+static bool mt7927_mock_attached(struct mt7927_dev *dev)
+{
+	return rcu_access_pointer(dev->mock);
+}
 
-	/* Read through the remap window */
-	if (MT_HIF_REMAP_L1_BASE + offset >= dev->regs_len) {
-		dev_warn(&dev->pdev->dev,
-			 "  REMAP: Window offset 0x%x out of range\n",
-			 MT_HIF_REMAP_L1_BASE + offset);
-		return 0xdeadbeef;
-	}
+/* UNI command @cid from the self-test: log it instead of sending it */
+static bool mt7927_mock_mcu(struct mt7927_dev *dev, u16 cid)
+{
+	struct mt7927_mock *mock;
 
-	val = readl(dev->regs + MT_HIF_REMAP_L1_BASE + offset);
+	mock = rcu_dereference_protected(dev->mock,
+					 lockdep_is_held(&dev->dma_mutex));
+	if (!mock || mock->task != current)
+		return false;
 
-	if (debug_regs)
-		dev_info(&dev->pdev->dev,
-			 "  REMAP READ [0x%08x] = 0x%08x (window: base=0x%x, off=0x%x)\n",
-			 addr, val, base, offset);
+	if (mock->mcu_cmds < MT7927_MOCK_LOG)
+		mock->mcu_cid[mock->mcu_cmds] = cid;
+	mock->mcu_cmds++;
 
-	return val;
+	return true;
 }
 
-static void mt7927_wr_remap(struct mt7927_dev *dev, u32 addr, u32 val)
+/* Record the descriptors of @b and the doorbells of @rings */
+static void mt7927_mock_tx(struct mt7927_dev *dev,
+			   const struct mt7927_tx_batch *b,
+			   unsigned long rings)
 {
-	u32 base, offset, remap_val;
-
-	/* Calculate base (64KB aligned) and offset within window */
-	base = addr & ~(MT_HIF_REMAP_WINDOW_SIZE - 1);
-	offset = addr & (MT_HIF_REMAP_WINDOW_SIZE - 1);
+	struct mt7927_mock *mock;
+	unsigned int r;
+	u16 i;
 
-	/* Check if HIF_REMAP_L1 itself is accessible */
-	if (MT_HIF_REMAP_L1 >= dev->regs_len) {
-		dev_warn(&dev->pdev->dev,
-			 "  REMAP: Cannot access HIF_REMAP_L1 (0x%x >= 0x%llx)\n",
-			 MT_HIF_REMAP_L1, (unsigned long long)dev->regs_len);
+	mock = rcu_dereference_protected(dev->mock,
+					 lockdep_is_held(&dev->dma_mutex));
+	if (!mock || mock->task != current)
 		return;
-	}
 
-	/* Program the remap register */
-	remap_val = FIELD_PREP(MT_HIF_REMAP_L1_MASK, base >> 16);
-	writel(remap_val, dev->regs + MT_HIF_REMAP_L1);
-
-	/* Ensure remap write completes */
-	(void)readl(dev->regs + MT_HIF_REMAP_L1);
-
-	/* Write through the remap window */
-	if (MT_HIF_REMAP_L1_BASE + offset >= dev->regs_len) {
-		dev_warn(&dev->pdev->dev,
-			 "  REMAP: Window offset 0x%x out of range\n",
-			 MT_HIF_REMAP_L1_BASE + offset);
-		return;
+	for (i = 0; i < b->ndesc; i++) {
+		mock->queued[b->ring[i]]++;
+		if (mock->ntx < MT7927_MOCK_LOG)
+			mock->tx_ring[mock->ntx++] = b->ring[i];
 	}
-
-	writel(val, dev->regs + MT_HIF_REMAP_L1_BASE + offset);
-
-	if (debug_regs)
-		dev_info(&dev->pdev->dev,
-			 "  REMAP WRITE [0x%08x] = 0x%08x (window: base=0x%x, off=0x%x)\n",
-			 addr, val, base, offset);
+	for_each_set_bit(r, &rings, MT7927_TX_DATA_RINGS)
+		mock->kicks[r]++;
 }
 
-/* Debug read - logs the value */
-static u32 mt7927_rr_debug(struct mt7927_dev *dev, u32 offset, const char *name)
+/* Frame @seqno leaves the reorder stage */
+static void mt7927_mock_rx(struct mt7927_dev *dev, u16 seqno)
 {
-	u32 val = mt7927_rr(dev, offset);
-	if (debug_regs)
-		dev_info(&dev->pdev->dev, "  READ  [0x%08x] %s = 0x%08x\n",
-			 offset, name, val);
-	return val;
+	struct mt7927_mock *mock;
+
+	rcu_read_lock();
+	mock = rcu_dereference(dev->mock);
+	if (mock) {
+		if (mock->nrx < MT7927_MOCK_LOG)
+			mock->rx_sn[mock->nrx++] = seqno;
+		atomic_inc(&mock->rx_done);
+		wake_up_var(&mock->rx_done);
+	}
+	rcu_read_unlock();
 }
 
-/* Debug write - logs before and after */
-static void mt7927_wr_debug(struct mt7927_dev *dev, u32 offset, u32 val,
-			    const char *name)
+/* Keep a copy of data RXD @buf while rxd_bench sampling is armed */
+static void mt7927_rxd_rec_add(struct mt7927_dev *dev, const void *buf,
+			       int len)
 {
-	u32 before = 0, after;
-
-	if (debug_regs)
-		before = mt7927_rr(dev, offset);
+	struct mt7927_rxd_rec *rec = &dev->rxd_rec;
 
-	mt7927_wr(dev, offset, val);
+	if (!static_branch_unlikely(&mt7927_rxd_rec_key) || !rec->armed ||
+	    rec->count >= MT7927_RXD_REC_SAMPLES || mt7927_mock_attached(dev))
+		return;
 
-	if (debug_regs) {
-		after = mt7927_rr(dev, offset);
-		dev_info(&dev->pdev->dev,
-			 "  WRITE [0x%08x] %s: 0x%08x -> write 0x%08x -> read 0x%08x %s\n",
-			 offset, name, before, val, after,
-			 (after == val) ? "OK" : "MISMATCH!");
-	}
+	rec->len[rec->count] = min_t(int, len, MT7927_RXD_REC_BYTES);
+	memcpy(rec->buf[rec->count], buf, rec->len[rec->count]);
+	rec->count++;
 }
-
-static inline void mt7927_set(struct mt7927_dev *dev, u32 offset, u32 val)
+#else
+static inline bool mt7927_mock_mcu(struct mt7927_dev *dev, u16 cid)
 {
-	mt7927_wr(dev, offset, mt7927_rr(dev, offset) | val);
+	return false;
 }
 
-static inline void mt7927_clear(struct mt7927_dev *dev, u32 offset, u32 val)
+static inline void mt7927_mock_tx(struct mt7927_dev *dev,
+				  const struct mt7927_tx_batch *b,
+				  unsigned long rings)
 {
-	mt7927_wr(dev, offset, mt7927_rr(dev, offset) & ~val);
 }
 
-static inline void mt7927_rmw(struct mt7927_dev *dev, u32 offset,
-			      u32 mask, u32 val)
+static inline void mt7927_mock_rx(struct mt7927_dev *dev, u16 seqno)
 {
-	u32 cur = mt7927_rr(dev, offset);
-	mt7927_wr(dev, offset, (cur & ~mask) | val);
 }
 
-static bool mt7927_poll(struct mt7927_dev *dev, u32 offset, u32 mask,
-			u32 val, int timeout_ms)
+static inline void mt7927_rxd_rec_add(struct mt7927_dev *dev,
+				      const void *buf, int len)
 {
-	u32 cur;
-	int i;
+}
+#endif
+
+/* =============================================================================
+ * Register Access Trace
+ * =============================================================================
+ *
+ * Register and descriptor logging used to go straight to dev_info,
+ * which produced thousands of printk lines per probe and was throttled by
+ * the console. Accesses are now recorded as fixed-size binary entries in a
+ * per-CPU ring and decoded on demand from debugfs:
+ *
+ *   cat /sys/kernel/debug/mt7927/<pci-addr>/regtrace
+ *
+ * Writers only touch their own CPU's ring (local_t head, preemption
+ * disabled), so no locks are taken. Readers take an unlocked snapshot;
+ * an entry overwritten during the copy may come out torn, which is
+ * acceptable for a debug aid.
+ */
+
+#define MT7927_TRACE_ENTRIES		4096	/* Per CPU, must be a power of 2 */
+
+enum mt7927_trace_op {
+	MT7927_TRACE_WR,		/* val: before, written, read back */
+	MT7927_TRACE_RR_REMAP,		/* val: value */
+	MT7927_TRACE_WR_REMAP,		/* val: value */
+	MT7927_TRACE_DESC_MCU,		/* val: buf0, ctrl, len */
+	MT7927_TRACE_DESC_FW,		/* val: buf0, buf1, ctrl, info, new head */
+};
+
+struct mt7927_trace_ent {
+	u64 ts;				/* local_clock() in ns */
+	unsigned long ip;		/* Call site */
+	const char *name;		/* Register name (string literal) or NULL */
+	u32 offset;			/* BAR0 offset, chip address or ring index */
+	u32 val[5];
+	u16 cpu;			/* Filled in by the reader */
+	u8 op;
+};
+
+struct mt7927_trace_buf {
+	local_t head;			/* Total entries ever written */
+	struct mt7927_trace_ent *ent;
+};
+
+static void mt7927_trace_free(struct mt7927_dev *dev)
+{
+	int cpu;
+
+	if (!dev->trace)
+		return;
+
+	for_each_possible_cpu(cpu)
+		kvfree(per_cpu_ptr(dev->trace, cpu)->ent);
+
+	free_percpu(dev->trace);
+	dev->trace = NULL;
+}
+
+static int mt7927_trace_init(struct mt7927_dev *dev)
+{
+	int cpu;
+
+	dev->trace = alloc_percpu(struct mt7927_trace_buf);
+	if (!dev->trace)
+		return -ENOMEM;
+
+	for_each_possible_cpu(cpu) {
+		struct mt7927_trace_buf *buf = per_cpu_ptr(dev->trace, cpu);
+
+		local_set(&buf->head, 0);
+		buf->ent = kvmalloc_node(array_size(MT7927_TRACE_ENTRIES,
+						    sizeof(*buf->ent)),
+					 GFP_KERNEL | __GFP_ZERO,
+					 cpu_to_node(cpu));
+		if (!buf->ent) {
+			mt7927_trace_free(dev);
+			return -ENOMEM;
+		}
+	}
+
+	return 0;
+}
+
+static void mt7927_trace_rec(struct mt7927_dev *dev,
+			     const struct mt7927_trace_ent *e)
+{
+	struct mt7927_trace_buf *buf;
+	struct mt7927_trace_ent *slot;
+	unsigned long idx;
+
+	buf = get_cpu_ptr(dev->trace);
+	idx = local_inc_return(&buf->head) - 1;
+	slot = &buf->ent[idx & (MT7927_TRACE_ENTRIES - 1)];
+	*slot = *e;
+	slot->ts = local_clock();
+	put_cpu_ptr(dev->trace);
+}
+
+/*
+ * mt7927_trace - record one access if debug_regs is set
+ *
+ * The call site is taken from _RET_IP_, so the helpers using this are
+ * marked noinline to make it point at the code that asked for the access.
+ */
+#define mt7927_trace(dev, _op, _offset, _name, ...)			\
+do {									\
+	if (static_branch_unlikely(&mt7927_trace_key)) {		\
+		struct mt7927_trace_ent __ent = {			\
+			.ip = _RET_IP_,					\
+			.name = (_name),				\
+			.offset = (_offset),				\
+			.val = { __VA_ARGS__ },				\
+			.op = (_op),					\
+		};							\
+		mt7927_trace_rec(dev, &__ent);				\
+	}								\
+} while (0)
+
+/* =============================================================================
+ * Probe Timing
+ * =============================================================================
+ *
+ * Each probe phase records wall time, time blocked in sleeps and MMIO
+ * counts, so regressions in time-to-WiFi can be bisected. The remainder
+ * of wall time minus sleep is time spent polling registers or busy-waiting.
+ * Results are in debugfs (probe_timing) and sysfs (probe_time_us).
+ *
+ * MMIO accesses are only counted while a phase runs: a running phase
+ * holds a reference on mt7927_mmio_key, so the register accessors skip
+ * the counter once the device is up.
+ */
+
+static const char * const mt7927_phase_names[__MT7927_PHASE_MAX] = {
+	[MT7927_PHASE_PCI_SETUP]	= "pci_setup",
+	[MT7927_PHASE_PM_HANDOFF]	= "pm_handoff",
+	[MT7927_PHASE_CHIP_ID]		= "chip_id",
+	[MT7927_PHASE_WARM_CHECK]	= "warm_check",
+	[MT7927_PHASE_EMI]		= "emi",
+	[MT7927_PHASE_WFSYS_RESET]	= "wfsys_reset",
+	[MT7927_PHASE_IRQ_SETUP]	= "irq_setup",
+	[MT7927_PHASE_DMA_INIT]		= "dma_init",
+	[MT7927_PHASE_VERIFY]		= "verify",
+	[MT7927_PHASE_ROM_READY]	= "rom_ready",
+	[MT7927_PHASE_PATCH]		= "patch",
+};
+
+/* Sum of the per-CPU MMIO counters */
+static struct mt7927_mmio_cnt mt7927_mmio_count(struct mt7927_dev *dev)
+{
+	struct mt7927_mmio_cnt sum = {};
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		const struct mt7927_mmio_cnt *c = per_cpu_ptr(dev->mmio, cpu);
+
+		sum.rd += c->rd;
+		sum.wr += c->wr;
+	}
+
+	return sum;
+}
+
+/* Account the running phase */
+static void mt7927_phase_stop(struct mt7927_dev *dev)
+{
+	struct mt7927_timing *t = &dev->timing;
+	struct mt7927_phase_stats *ps;
+	struct mt7927_mmio_cnt mmio;
+
+	mmio = mt7927_mmio_count(dev);
+	ps = &t->phases[t->phase];
+	ps->time_ns += ktime_to_ns(ktime_sub(ktime_get(), t->phase_start));
+	ps->sleep_ns += t->sleep_ns - t->phase_sleep_ns;
+	ps->mmio_rd += mmio.rd - t->phase_mmio_rd;
+	ps->mmio_wr += mmio.wr - t->phase_mmio_wr;
+	ps->done = true;
+}
+
+static void mt7927_phase_end(struct mt7927_dev *dev)
+{
+	struct mt7927_timing *t = &dev->timing;
+
+	if (t->phase == MT7927_PHASE_NONE)
+		return;
+
+	mt7927_phase_stop(dev);
+	t->phase = MT7927_PHASE_NONE;
+	static_branch_dec(&mt7927_mmio_key);
+}
+
+/* Ends the running phase, if any, and starts @phase */
+static void mt7927_phase_begin(struct mt7927_dev *dev, enum mt7927_phase phase)
+{
+	struct mt7927_timing *t = &dev->timing;
+	struct mt7927_mmio_cnt mmio;
+
+	if (t->phase == MT7927_PHASE_NONE)
+		static_branch_inc(&mt7927_mmio_key);
+	else
+		mt7927_phase_stop(dev);
+
+	mmio = mt7927_mmio_count(dev);
+	t->phase = phase;
+	t->phase_start = ktime_get();
+	t->phase_sleep_ns = t->sleep_ns;
+	t->phase_mmio_rd = mmio.rd;
+	t->phase_mmio_wr = mmio.wr;
+}
+
+/* Sleep wrappers that account the time actually spent blocked */
+static void mt7927_msleep(struct mt7927_dev *dev, unsigned int ms)
+{
+	ktime_t start = ktime_get();
+
+	msleep(ms);
+	dev->timing.sleep_ns += ktime_to_ns(ktime_sub(ktime_get(), start));
+}
+
+static void mt7927_usleep_range(struct mt7927_dev *dev, unsigned long min,
+				unsigned long max)
+{
+	ktime_t start = ktime_get();
+
+	usleep_range(min, max);
+	dev->timing.sleep_ns += ktime_to_ns(ktime_sub(ktime_get(), start));
+}
+
+/* =============================================================================
+ * Register Access Helpers with Debug Logging and Bounds Checking
+ * =============================================================================
+ */
+
+/*
+ * Minimum BAR0 size we accept at probe time. Every MT7927 seen so far
+ * exposes a 2MB BAR0 (see tests/01_safe_basic/test_bar_map.c), which
+ * covers the WFDMA block, the PCIe MAC and the HIF remap window.
+ */
+#define MT7927_BAR0_MIN_SIZE		SZ_2M
+
+/*
+ * MT7927_REG - validate a constant register offset at build time
+ *
+ * Almost every register we touch is a compile-time constant, so instead
+ * of comparing against dev->regs_len on every access we check it once
+ * against MT7927_BAR0_MIN_SIZE here. Passing a non-constant offset is a
+ * build error - use mt7927_rr_checked()/mt7927_wr_checked() for those.
+ */
+#define MT7927_REG(offset)						\
+	((offset) + BUILD_BUG_ON_ZERO((offset) > MT7927_BAR0_MIN_SIZE - sizeof(u32)))
+
+/* Raw accessors - offset must already be known to be inside BAR0 */
+static inline u32 __mt7927_rr(struct mt7927_dev *dev, u32 offset)
+{
+	if (static_branch_unlikely(&mt7927_mmio_key))
+		this_cpu_inc(dev->mmio->rd);
+	return readl(dev->regs + offset);
+}
+
+static inline void __mt7927_wr(struct mt7927_dev *dev, u32 offset, u32 val)
+{
+	if (static_branch_unlikely(&mt7927_mmio_key))
+		this_cpu_inc(dev->mmio->wr);
+	writel(val, dev->regs + offset);
+}
+
+/* Constant-offset accessors - bounds checked at build time, no branch */
+#define mt7927_rr(dev, offset)		__mt7927_rr(dev, MT7927_REG(offset))
+#define mt7927_wr(dev, offset, val)	__mt7927_wr(dev, MT7927_REG(offset), val)
+
+/* Safe register read for computed offsets - checks bounds at runtime */
+static u32 mt7927_rr_checked(struct mt7927_dev *dev, u32 offset)
+{
+	if (offset > dev->regs_len - sizeof(u32)) {
+		if (debug_regs)
+			dev_warn(&dev->pdev->dev,
+				 "  READ  [0x%08x] OUT OF BOUNDS (max 0x%llx)\n",
+				 offset, (unsigned long long)dev->regs_len);
+		return 0xdeadbeef;
+	}
+	return __mt7927_rr(dev, offset);
+}
+
+/* Safe register write for computed offsets - checks bounds at runtime */
+static void mt7927_wr_checked(struct mt7927_dev *dev, u32 offset, u32 val)
+{
+	if (offset > dev->regs_len - sizeof(u32)) {
+		if (debug_regs)
+			dev_warn(&dev->pdev->dev,
+				 "  WRITE [0x%08x] OUT OF BOUNDS (max 0x%llx)\n",
+				 offset, (unsigned long long)dev->regs_len);
+		return;
+	}
+	__mt7927_wr(dev, offset, val);
+}
+
+/*
+ * Remapped register access for high addresses (0x7c0xxxxx range)
+ * Uses HIF_REMAP_L1 to create a window into high address space
+ */
+static_assert(MT_HIF_REMAP_L1_BASE + MT_HIF_REMAP_WINDOW_SIZE <= MT7927_BAR0_MIN_SIZE);
+
+/* Untraced remap read, for tight polling loops */
+static u32 __mt7927_rr_remap(struct mt7927_dev *dev, u32 addr)
+{
+	u32 base, offset, remap_val;
+
+	/* Calculate base (64KB aligned) and offset within window */
+	base = addr & ~(MT_HIF_REMAP_WINDOW_SIZE - 1);
+	offset = addr & (MT_HIF_REMAP_WINDOW_SIZE - 1);
+
+	/* Program the remap register */
+	remap_val = FIELD_PREP(MT_HIF_REMAP_L1_MASK, base >> 16);
+	mt7927_wr(dev, MT_HIF_REMAP_L1, remap_val);
+
+	/* Ensure write completes */
+	(void)mt7927_rr(dev, MT_HIF_REMAP_L1);
+
+	/* Read through the remap window (always inside BAR0, see above) */
+	return __mt7927_rr(dev, MT_HIF_REMAP_L1_BASE + offset);
+}
+
+static noinline u32 mt7927_rr_remap(struct mt7927_dev *dev, u32 addr)
+{
+	u32 val = __mt7927_rr_remap(dev, addr);
+
+	mt7927_trace(dev, MT7927_TRACE_RR_REMAP, addr, NULL, val);
+
+	return val;
+}
+
+static noinline void mt7927_wr_remap(struct mt7927_dev *dev, u32 addr, u32 val)
+{
+	u32 base, offset, remap_val;
+
+	/* Calculate base (64KB aligned) and offset within window */
+	base = addr & ~(MT_HIF_REMAP_WINDOW_SIZE - 1);
+	offset = addr & (MT_HIF_REMAP_WINDOW_SIZE - 1);
+
+	/* Program the remap register */
+	remap_val = FIELD_PREP(MT_HIF_REMAP_L1_MASK, base >> 16);
+	mt7927_wr(dev, MT_HIF_REMAP_L1, remap_val);
+
+	/* Ensure remap write completes */
+	(void)mt7927_rr(dev, MT_HIF_REMAP_L1);
+
+	/* Write through the remap window (always inside BAR0, see above) */
+	__mt7927_wr(dev, MT_HIF_REMAP_L1_BASE + offset, val);
+
+	mt7927_trace(dev, MT7927_TRACE_WR_REMAP, addr, NULL, val);
+}
+
+/* Read ROM/firmware state, emitting a trace event when it changes */
+static u32 mt7927_read_conn_misc(struct mt7927_dev *dev)
+{
+	u32 val = mt7927_rr_remap(dev, MT_CONN_ON_MISC);
+
+	if (val != dev->conn_misc) {
+		trace_mt7927_conn_misc(dev, dev->conn_misc, val);
+		dev->conn_misc = val;
+	}
+
+	return val;
+}
+
+/* Debug write - records the value before and after */
+static noinline void __mt7927_wr_debug(struct mt7927_dev *dev, u32 offset,
+				       u32 val, const char *name)
+{
+	u32 before, after;
+
+	if (!static_branch_unlikely(&mt7927_trace_key)) {
+		__mt7927_wr(dev, offset, val);
+		return;
+	}
+
+	before = __mt7927_rr(dev, offset);
+	__mt7927_wr(dev, offset, val);
+	after = __mt7927_rr(dev, offset);
+
+	mt7927_trace(dev, MT7927_TRACE_WR, offset, name, before, val, after);
+}
+
+static inline void __mt7927_set(struct mt7927_dev *dev, u32 offset, u32 val)
+{
+	__mt7927_wr(dev, offset, __mt7927_rr(dev, offset) | val);
+}
+
+static inline void __mt7927_clear(struct mt7927_dev *dev, u32 offset, u32 val)
+{
+	__mt7927_wr(dev, offset, __mt7927_rr(dev, offset) & ~val);
+}
+
+static inline void __mt7927_rmw(struct mt7927_dev *dev, u32 offset,
+				u32 mask, u32 val)
+{
+	u32 cur = __mt7927_rr(dev, offset);
+	__mt7927_wr(dev, offset, (cur & ~mask) | val);
+}
+
+static bool __mt7927_poll(struct mt7927_dev *dev, u32 offset, u32 mask,
+			  u32 val, int timeout_ms)
+{
+	u32 cur;
+	int i;
 
 	for (i = 0; i < timeout_ms; i++) {
-		cur = mt7927_rr(dev, offset);
+		cur = __mt7927_rr(dev, offset);
 		if ((cur & mask) == val)
 			return true;
-		usleep_range(1000, 2000);
+		mt7927_usleep_range(dev, 1000, 2000);
 	}
 
 	if (debug_regs)
@@ -709,6 +2007,17 @@ static bool mt7927_poll(struct mt7927_dev *dev, u32 offset, u32 mask,
 	return false;
 }
 
+#define mt7927_wr_debug(dev, offset, val, name)				\
+	__mt7927_wr_debug(dev, MT7927_REG(offset), val, name)
+#define mt7927_set(dev, offset, val)					\
+	__mt7927_set(dev, MT7927_REG(offset), val)
+#define mt7927_clear(dev, offset, val)					\
+	__mt7927_clear(dev, MT7927_REG(offset), val)
+#define mt7927_rmw(dev, offset, mask, val)				\
+	__mt7927_rmw(dev, MT7927_REG(offset), mask, val)
+#define mt7927_poll(dev, offset, mask, val, timeout_ms)			\
+	__mt7927_poll(dev, MT7927_REG(offset), mask, val, timeout_ms)
+
 /* =============================================================================
  * Debug Dump Functions
  * =============================================================================
@@ -746,6 +2055,11 @@ static void mt7927_dump_pci_state(struct mt7927_dev *dev)
 	}
 }
 
+/* Explicit dumps always go to the kernel log, unlike the access trace */
+#define mt7927_dump_reg(dev, offset)					\
+	dev_info(&(dev)->pdev->dev, "  READ  [0x%08x] %s = 0x%08x\n",	\
+		 offset, #offset, mt7927_rr(dev, offset))
+
 static void mt7927_dump_critical_regs(struct mt7927_dev *dev)
 {
 	dev_info(&dev->pdev->dev, "=== Critical Register Dump ===\n");
@@ -754,26 +2068,29 @@ static void mt7927_dump_critical_regs(struct mt7927_dev *dev)
 
 	/* Only read registers that are within BAR0 range */
 	/* These are the low-offset DMA registers that should always work */
-	mt7927_rr_debug(dev, MT_PCIE_MAC_INT_ENABLE, "MT_PCIE_MAC_INT_ENABLE");
-	mt7927_rr_debug(dev, MT_PCIE_MAC_INT_STATUS, "MT_PCIE_MAC_INT_STATUS");
+	mt7927_dump_reg(dev, MT_PCIE_MAC_INT_ENABLE);
+	mt7927_dump_reg(dev, MT_PCIE_MAC_INT_STATUS);
 
 	/* DMA status - these are in the 0xd4xxx range */
-	mt7927_rr_debug(dev, MT_WFDMA0_GLO_CFG, "MT_WFDMA0_GLO_CFG");
-	mt7927_rr_debug(dev, MT_WFDMA0_RST, "MT_WFDMA0_RST");
-	mt7927_rr_debug(dev, MT_WFDMA0_GLO_CFG_EXT0, "MT_WFDMA0_GLO_CFG_EXT0");
+	mt7927_dump_reg(dev, MT_WFDMA0_GLO_CFG);
+	mt7927_dump_reg(dev, MT_WFDMA0_RST);
+	mt7927_dump_reg(dev, MT_WFDMA0_GLO_CFG_EXT0);
 
 	/* Interrupts */
-	mt7927_rr_debug(dev, MT_WFDMA0_HOST_INT_ENA, "MT_WFDMA0_HOST_INT_ENA");
-	mt7927_rr_debug(dev, MT_WFDMA0_HOST_INT_STA, "MT_WFDMA0_HOST_INT_STA");
+	mt7927_dump_reg(dev, MT_WFDMA0_HOST_INT_ENA);
+	mt7927_dump_reg(dev, MT_WFDMA0_HOST_INT_STA);
 
 	/* Remap register - check if accessible */
-	mt7927_rr_debug(dev, MT_HIF_REMAP_L1, "MT_HIF_REMAP_L1");
+	mt7927_dump_reg(dev, MT_HIF_REMAP_L1);
 
 	/* These high-address registers (0x7c0xxxxx) need remapping */
 	if (dev->regs_len > MT_CONN_ON_LPCTL) {
-		mt7927_rr_debug(dev, MT_CONN_ON_LPCTL, "MT_CONN_ON_LPCTL");
-		mt7927_rr_debug(dev, MT_WFSYS_SW_RST_B, "MT_WFSYS_SW_RST_B");
-		mt7927_rr_debug(dev, MT_CONN_ON_MISC, "MT_CONN_ON_MISC");
+		dev_info(&dev->pdev->dev, "  READ  [0x%08x] MT_CONN_ON_LPCTL = 0x%08x\n",
+			 MT_CONN_ON_LPCTL, mt7927_rr_checked(dev, MT_CONN_ON_LPCTL));
+		dev_info(&dev->pdev->dev, "  READ  [0x%08x] MT_WFSYS_SW_RST_B = 0x%08x\n",
+			 MT_WFSYS_SW_RST_B, mt7927_rr_checked(dev, MT_WFSYS_SW_RST_B));
+		dev_info(&dev->pdev->dev, "  READ  [0x%08x] MT_CONN_ON_MISC = 0x%08x\n",
+			 MT_CONN_ON_MISC, mt7927_rr_checked(dev, MT_CONN_ON_MISC));
 	} else {
 		dev_info(&dev->pdev->dev,
 			 "  High registers (0x7c0xxxxx) need remapping\n");
@@ -785,28 +2102,29 @@ static void mt7927_dump_critical_regs(struct mt7927_dev *dev)
  * =============================================================================
  */
 
-/* Helper to poll a remapped register - silent version to avoid log spam */
+/*
+ * Helper to poll a remapped register - silent version to avoid log spam
+ *
+ * Polls every MT7927_POLL_US rather than every millisecond: ownership
+ * handshakes usually complete in tens of microseconds, and runtime wakeups
+ * sit on the first-packet path.
+ */
 static bool mt7927_poll_remap_quiet(struct mt7927_dev *dev, u32 addr, u32 mask,
 				    u32 val, int timeout_ms)
 {
+	ktime_t timeout = ktime_add_us(ktime_get(), timeout_ms * USEC_PER_MSEC);
 	u32 cur;
-	int i;
-	bool saved_debug = debug_regs;
 
-	/* Temporarily disable debug to avoid flooding logs during polling */
-	debug_regs = false;
-
-	for (i = 0; i < timeout_ms; i++) {
-		cur = mt7927_rr_remap(dev, addr);
-		if ((cur & mask) == val) {
-			debug_regs = saved_debug;
+	/* Untraced reads - polling would otherwise flush the trace ring */
+	for (;;) {
+		cur = __mt7927_rr_remap(dev, addr);
+		if ((cur & mask) == val)
 			return true;
-		}
-		usleep_range(1000, 2000);
+		if (ktime_after(ktime_get(), timeout))
+			break;
+		mt7927_usleep_range(dev, MT7927_POLL_US, 2 * MT7927_POLL_US);
 	}
 
-	debug_regs = saved_debug;
-
 	if (debug_regs)
 		dev_warn(&dev->pdev->dev,
 			 "  POLL TIMEOUT [0x%08x] mask=0x%08x expected=0x%08x got=0x%08x after %dms\n",
@@ -879,9 +2197,9 @@ static int mt7927_mcu_drv_pmctrl(struct mt7927_dev *dev)
 		dev_info(&dev->pdev->dev, "  [%d] Writing CLR_OWN to 0x%08x...\n", i + 1, addr);
 		mt7927_wr_remap(dev, addr, PCIE_LPCR_HOST_CLR_OWN);
 
-		/* Critical delay for ASPM */
-		if (dev->aspm_supported || disable_aspm)
-			usleep_range(2000, 3000);
+		/* Critical delay for ASPM, only needed while L1 is allowed */
+		if (dev->aspm.l1_on)
+			mt7927_usleep_range(dev, 2000, 3000);
 
 		if (mt7927_poll_remap_quiet(dev, addr, PCIE_LPCR_HOST_OWN_SYNC, 0, 10)) {
 			dev_info(&dev->pdev->dev,
@@ -904,8 +2222,8 @@ static int mt7927_mcu_drv_pmctrl(struct mt7927_dev *dev)
 	for (i = 0; i < MT792x_DRV_OWN_RETRY_COUNT; i++) {
 		mt7927_wr_remap(dev, addr, PCIE_LPCR_HOST_CLR_OWN);
 
-		if (dev->aspm_supported)
-			usleep_range(2000, 3000);
+		if (dev->aspm.l1_on)
+			mt7927_usleep_range(dev, 2000, 3000);
 
 		if (mt7927_poll_remap_quiet(dev, addr, PCIE_LPCR_HOST_OWN_SYNC, 0, 10)) {
 			dev_info(&dev->pdev->dev,
@@ -919,72 +2237,496 @@ static int mt7927_mcu_drv_pmctrl(struct mt7927_dev *dev)
 }
 
 /* =============================================================================
- * WFSYS Reset
+ * Runtime Power Save
  * =============================================================================
+ *
+ * Same scheme as mt76_connac: after pm_idle_ms without hardware access the
+ * LPCTL ownership is handed to firmware so the chip can doze, and anything
+ * that needs registers calls mt7927_pm_wake() first. Unlike the probe-time
+ * handoff above, these use the primary LPCTL address only and no logging.
+ * Game mode keeps ownership with the driver, see mt7927_game_mode_set().
  */
 
-/* Helper for remapped set/clear operations */
-static inline void mt7927_set_remap(struct mt7927_dev *dev, u32 addr, u32 val)
+static int mt7927_pm_set_own(struct mt7927_dev *dev, bool fw)
 {
-	mt7927_wr_remap(dev, addr, mt7927_rr_remap(dev, addr) | val);
-}
+	u32 cmd = fw ? PCIE_LPCR_HOST_SET_OWN : PCIE_LPCR_HOST_CLR_OWN;
+	u32 sync = fw ? PCIE_LPCR_HOST_OWN_SYNC : 0;
+	int i;
 
-static inline void mt7927_clear_remap(struct mt7927_dev *dev, u32 addr, u32 val)
-{
-	mt7927_wr_remap(dev, addr, mt7927_rr_remap(dev, addr) & ~val);
+	/*
+	 * With ASPM the write can be lost while the link leaves L1. mt76
+	 * sleeps 2-3ms after every CLR_OWN for that; we poll tightly and
+	 * only repeat the write if the first attempt does not take.
+	 */
+	for (i = 0; i < MT792x_DRV_OWN_RETRY_COUNT; i++) {
+		mt7927_wr_remap(dev, MT_CONN_ON_LPCTL, cmd);
+
+		if (mt7927_poll_remap_quiet(dev, MT_CONN_ON_LPCTL,
+					    PCIE_LPCR_HOST_OWN_SYNC, sync,
+					    MT7927_PM_OWN_TIMEOUT_MS))
+			return 0;
+	}
+
+	return -ETIMEDOUT;
 }
 
-static int mt7927_wfsys_reset(struct mt7927_dev *dev)
+/* Take LPCTL ownership back from firmware if it has it */
+static int mt7927_pm_wake(struct mt7927_dev *dev)
 {
-	u32 addr = try_alt_reset ? MT_WFSYS_SW_RST_B_ALT : MT_WFSYS_SW_RST_B;
-	u32 val_before, val_after;
+	struct mt7927_pm *pm = &dev->pm;
+	ktime_t start;
+	u64 us;
+	int ret = 0;
 
-	dev_info(&dev->pdev->dev, "=== WFSYS Reset (addr=0x%08x) ===\n", addr);
-	dev_info(&dev->pdev->dev, "  Using remapped register access\n");
+	mutex_lock(&pm->mutex);
 
-	val_before = mt7927_rr_remap(dev, addr);
-	dev_info(&dev->pdev->dev, "  Before reset: 0x%08x\n", val_before);
+	pm->last_activity = jiffies;
+	if (!pm->fw_own)
+		goto out;
 
-	/* Check if already in good state */
-	if (val_before & WFSYS_SW_INIT_DONE) {
-		dev_info(&dev->pdev->dev, "  INIT_DONE already set, still resetting...\n");
+	start = ktime_get();
+	ret = mt7927_pm_set_own(dev, false);
+	if (ret) {
+		pm->fail_cnt++;
+		dev_err(&dev->pdev->dev, "PM: driver ownership timeout\n");
+		goto out;
 	}
 
-	/* Assert reset - clear WFSYS_SW_RST_B */
-	dev_info(&dev->pdev->dev, "  Asserting reset (clearing bit 0)...\n");
-	mt7927_clear_remap(dev, addr, WFSYS_SW_RST_B);
+	us = ktime_us_delta(ktime_get(), start);
+	pm->fw_own = false;
+	pm->wake_cnt++;
+	pm->last_wake_us = us;
+	pm->max_wake_us = max(pm->max_wake_us, us);
+	pm->total_wake_us += us;
+	trace_mt7927_pm_wake(dev, us);
 
-	val_after = mt7927_rr_remap(dev, addr);
-	dev_info(&dev->pdev->dev, "  After clear: 0x%08x\n", val_after);
+out:
+	mutex_unlock(&pm->mutex);
+	return ret;
+}
 
-	/* MANDATORY 50ms delay */
-	dev_info(&dev->pdev->dev, "  Waiting 50ms...\n");
-	msleep(50);
+/*
+ * Note activity and (re)arm the idle timer. Bring-up and chip reset run
+ * with the chip awake throughout and arm it themselves when done.
+ */
+static void mt7927_pm_power_save_sched(struct mt7927_dev *dev)
+{
+	if (!pm_idle_ms || READ_ONCE(dev->game.on) || mt7927_aborted(dev) ||
+	    !test_bit(MT7927_STATE_INIT_DONE, &dev->state) ||
+	    test_bit(MT7927_STATE_RESETTING, &dev->state))
+		return;
 
-	/* Deassert reset - set WFSYS_SW_RST_B */
-	dev_info(&dev->pdev->dev, "  Deasserting reset (setting bit 0)...\n");
-	mt7927_set_remap(dev, addr, WFSYS_SW_RST_B);
+	dev->pm.last_activity = jiffies;
+	mod_delayed_work(system_wq, &dev->pm.ps_work,
+			 msecs_to_jiffies(pm_idle_ms));
+}
 
-	val_after = mt7927_rr_remap(dev, addr);
-	dev_info(&dev->pdev->dev, "  After set: 0x%08x\n", val_after);
+static void mt7927_pm_ps_work(struct work_struct *work)
+{
+	struct mt7927_dev *dev = container_of(to_delayed_work(work),
+					      struct mt7927_dev, pm.ps_work);
+	struct mt7927_pm *pm = &dev->pm;
+	unsigned long idle = msecs_to_jiffies(pm_idle_ms);
+
+	/* An MCU command or TX kick is using the chip, look again later */
+	if (!mutex_trylock(&dev->dma_mutex)) {
+		mod_delayed_work(system_wq, &pm->ps_work, idle);
+		return;
+	}
 
-	/* Poll for initialization complete (100ms for debug, prod should be 500ms) */
-	dev_info(&dev->pdev->dev, "  Polling for INIT_DONE (bit 4), timeout 100ms...\n");
+	mutex_lock(&pm->mutex);
 
-	if (!mt7927_poll_remap_quiet(dev, addr, WFSYS_SW_INIT_DONE, WFSYS_SW_INIT_DONE, 100)) {
-		val_after = mt7927_rr_remap(dev, addr);
-		dev_err(&dev->pdev->dev,
-			"  WFSYS reset TIMEOUT! Final value: 0x%08x\n", val_after);
+	if (pm->fw_own || !pm_idle_ms || READ_ONCE(dev->game.on))
+		goto out;
 
-		/* Try alternative address if primary failed */
-		if (!try_alt_reset) {
+	/* Someone touched the hardware since this was armed */
+	if (time_before(jiffies, pm->last_activity + idle)) {
+		mod_delayed_work(system_wq, &pm->ps_work,
+				 pm->last_activity + idle - jiffies);
+		goto out;
+	}
+
+	if (mt7927_pm_set_own(dev, true)) {
+		pm->fail_cnt++;
+		goto out;
+	}
+
+	pm->fw_own = true;
+	pm->doze_cnt++;
+
+out:
+	mutex_unlock(&pm->mutex);
+	mutex_unlock(&dev->dma_mutex);
+}
+
+/*
+ * Wake the chip for a command or TX kick and re-arm the idle timer.
+ * Called under dma_mutex, which keeps mt7927_pm_ps_work() from handing
+ * LPCTL back until the caller is done.
+ */
+static int mt7927_pm_access(struct mt7927_dev *dev)
+{
+	int ret;
+
+	lockdep_assert_held(&dev->dma_mutex);
+
+	ret = mt7927_pm_wake(dev);
+	if (ret)
+		return ret;
+
+	mt7927_pm_power_save_sched(dev);
+	return 0;
+}
+
+/* System resume finished, from mt7927_resume() entry to rings usable */
+static void mt7927_resume_done(struct mt7927_dev *dev)
+{
+	struct mt7927_pm *pm = &dev->pm;
+	u64 us = ktime_us_delta(ktime_get(), pm->resume_start);
+
+	pm->last_resume_us = us;
+	pm->max_resume_us = max(pm->max_resume_us, us);
+}
+
+/* =============================================================================
+ * ASPM L1 Policy
+ * =============================================================================
+ *
+ * L1 exit costs tens of microseconds per MMIO access and can drop LPCTL
+ * writes (see mt7927_mcu_drv_pmctrl()). It is switched off while anything
+ * latency sensitive is going on - bring-up/firmware download and MCU
+ * command round trips - and switched back on once nothing has held it for
+ * aspm_idle_ms. Holds are counted per reason, so overlapping holders (a
+ * resume and the bring-up it queues) do not drop each other's. L1 is
+ * switched through the ASPM core with pci_disable_link_state(), which
+ * keeps both ends of the link and the core's own state in step; L1 and
+ * the L1 substates found enabled at probe are restored together.
+ *
+ * Nothing happens if L1 was not enabled on the link to begin with, or if
+ * the platform firmware keeps ASPM control from the OS.
+ */
+
+static void mt7927_aspm_account(struct mt7927_aspm *aspm)
+{
+	ktime_t now = ktime_get();
+	u64 ns = ktime_to_ns(ktime_sub(now, aspm->since));
+
+	if (aspm->l1_on)
+		aspm->on_ns += ns;
+	else
+		aspm->off_ns += ns;
+	aspm->since = now;
+}
+
+static void mt7927_aspm_set_l1(struct mt7927_dev *dev, bool on)
+{
+	struct mt7927_aspm *aspm = &dev->aspm;
+	int ret;
+
+	if (!aspm->capable || aspm->l1_on == on)
+		return;
+
+	if (on)
+		ret = pci_enable_link_state(dev->pdev, aspm->states);
+	else
+		ret = pci_disable_link_state(dev->pdev, PCIE_LINK_STATE_L1);
+	if (ret) {
+		/* No OS control over ASPM here, leave the link alone */
+		dev_warn(&dev->pdev->dev, "ASPM L1 policy disabled: %d\n", ret);
+		aspm->capable = false;
+		return;
+	}
+
+	mt7927_aspm_account(aspm);
+	if (on)
+		aspm->enable_cnt++;
+	else
+		aspm->disable_cnt++;
+
+	aspm->l1_on = on;
+}
+
+/* Keep L1 off until the matching mt7927_aspm_release() */
+static void mt7927_aspm_hold(struct mt7927_dev *dev,
+			     enum mt7927_aspm_reason why)
+{
+	struct mt7927_aspm *aspm = &dev->aspm;
+
+	if (!aspm->capable)
+		return;
+
+	mutex_lock(&aspm->mutex);
+	aspm->hold[why]++;
+	aspm->holders++;
+	mt7927_aspm_set_l1(dev, false);
+	mutex_unlock(&aspm->mutex);
+}
+
+/* L1 comes back aspm_idle_ms after the last reason is dropped */
+static void mt7927_aspm_release(struct mt7927_dev *dev,
+				enum mt7927_aspm_reason why)
+{
+	struct mt7927_aspm *aspm = &dev->aspm;
+
+	if (!aspm->capable)
+		return;
+
+	mutex_lock(&aspm->mutex);
+	if (!WARN_ON_ONCE(!aspm->hold[why])) {
+		aspm->hold[why]--;
+		aspm->holders--;
+	}
+	if (!aspm->holders && !disable_aspm)
+		mod_delayed_work(system_wq, &aspm->work,
+				 msecs_to_jiffies(aspm_idle_ms));
+	mutex_unlock(&aspm->mutex);
+}
+
+static void mt7927_aspm_work(struct work_struct *work)
+{
+	struct mt7927_dev *dev = container_of(to_delayed_work(work),
+					      struct mt7927_dev, aspm.work);
+	struct mt7927_aspm *aspm = &dev->aspm;
+
+	mutex_lock(&aspm->mutex);
+	if (!aspm->holders && !disable_aspm)
+		mt7927_aspm_set_l1(dev, true);
+	mutex_unlock(&aspm->mutex);
+}
+
+static void mt7927_aspm_init(struct mt7927_dev *dev)
+{
+	struct mt7927_aspm *aspm = &dev->aspm;
+	u32 l1ss_ctl = 0;
+	u16 lnkctl = 0;
+	u16 l1ss;
+
+	pcie_capability_read_word(dev->pdev, PCI_EXP_LNKCTL, &lnkctl);
+	if (lnkctl & PCI_EXP_LNKCTL_ASPM_L0S)
+		aspm->states |= PCIE_LINK_STATE_L0S;
+	if (lnkctl & PCI_EXP_LNKCTL_ASPM_L1)
+		aspm->states |= PCIE_LINK_STATE_L1;
+
+	/* Turning L1 off takes its substates with it, remember which were on */
+	l1ss = pci_find_ext_capability(dev->pdev, PCI_EXT_CAP_ID_L1SS);
+	if (l1ss)
+		pci_read_config_dword(dev->pdev, l1ss + PCI_L1SS_CTL1, &l1ss_ctl);
+	if (l1ss_ctl & PCI_L1SS_CTL1_ASPM_L1_1)
+		aspm->states |= PCIE_LINK_STATE_L1_1;
+	if (l1ss_ctl & PCI_L1SS_CTL1_ASPM_L1_2)
+		aspm->states |= PCIE_LINK_STATE_L1_2;
+	if (l1ss_ctl & PCI_L1SS_CTL1_PCIPM_L1_1)
+		aspm->states |= PCIE_LINK_STATE_L1_1_PCIPM;
+	if (l1ss_ctl & PCI_L1SS_CTL1_PCIPM_L1_2)
+		aspm->states |= PCIE_LINK_STATE_L1_2_PCIPM;
+
+	aspm->capable = !!(aspm->states & PCIE_LINK_STATE_L1);
+	aspm->l1_on = aspm->capable;
+	aspm->since = ktime_get();
+
+	if (disable_aspm)
+		mt7927_aspm_set_l1(dev, false);
+}
+
+/* Stop the policy and leave L1 the way probe found it */
+static void mt7927_aspm_stop(struct mt7927_dev *dev)
+{
+	cancel_delayed_work_sync(&dev->aspm.work);
+
+	mutex_lock(&dev->aspm.mutex);
+	mt7927_aspm_set_l1(dev, true);
+	mutex_unlock(&dev->aspm.mutex);
+}
+
+/* =============================================================================
+ * Game Mode
+ * =============================================================================
+ *
+ * One switch that trades power for latency, for handhelds running games
+ * (game_mode module parameter, sysfs game_mode at runtime). While on:
+ *
+ * - The driver keeps LPCTL ownership: the runtime power save timer is
+ *   not armed, so no register access ever waits for a wake.
+ * - ASPM L1 stays off, as it does during MCU round trips.
+ * - RX ring 0, which carries MCU responses and, until there is a data
+ *   ring, TX-free events and data frames, is polled every
+ *   MT7927_POLL_US instead of every millisecond while a command waits.
+ *
+ * Interrupt coalescing, a high-priority voice ring and IRQ affinity
+ * belong here too once the driver has data rings and an interrupt
+ * handler; WFDMA delay interrupts are already off (mt7927_dma_enable()).
+ *
+ * The time from taking a token to handling its TX-free event is kept in
+ * two histograms, frames queued in game mode and the rest, so debugfs
+ * tx_latency can show the difference. With no RX interrupt that time
+ * includes the wait for the next RX ring 0 poll: up to MT7927_RX_POLL_MS
+ * between commands (mt7927_rx_poll_work(), game mode or not), or the
+ * poll interval above while a command waits. It bounds, not measures,
+ * the firmware's own completion time.
+ */
+
+static void mt7927_game_mode_set(struct mt7927_dev *dev, bool on)
+{
+	struct mt7927_game *gm = &dev->game;
+	bool up;
+
+	mutex_lock(&gm->mutex);
+	if (gm->on == on)
+		goto out;
+
+	up = test_bit(MT7927_STATE_INIT_DONE, &dev->state) &&
+	     !test_bit(MT7927_STATE_RESETTING, &dev->state) &&
+	     !mt7927_aborted(dev);
+
+	if (on) {
+		/* Set first: a power save timer that fires now sees it */
+		WRITE_ONCE(gm->on, true);
+		gm->enter_cnt++;
+		cancel_delayed_work_sync(&dev->pm.ps_work);
+		mt7927_aspm_hold(dev, MT7927_ASPM_GAME);
+		if (up) {
+			mutex_lock(&dev->dma_mutex);
+			mt7927_pm_wake(dev);
+			mutex_unlock(&dev->dma_mutex);
+		}
+	} else {
+		WRITE_ONCE(gm->on, false);
+		mt7927_aspm_release(dev, MT7927_ASPM_GAME);
+		if (up)
+			mt7927_pm_power_save_sched(dev);
+	}
+
+	dev_info(&dev->pdev->dev, "Game mode %s\n", on ? "on" : "off");
+
+out:
+	mutex_unlock(&gm->mutex);
+}
+
+/* Bucket of a @ns long completion: 2 bits of precision per power of 2 */
+static u32 mt7927_lat_bucket(u64 ns)
+{
+	u32 msb;
+
+	if (ns < 4)
+		return ns;
+
+	msb = fls64(ns) - 1;
+	return msb * 4 + ((ns >> (msb - 2)) & 3);
+}
+
+/* Shortest time that falls in bucket @b */
+static u64 mt7927_lat_bucket_ns(u32 b)
+{
+	u32 msb = b / 4;
+
+	/* 0-3 ns get a bucket each, 4 ns starts bucket 8: 4-7 stay empty */
+	if (b < 8)
+		return min(b, 4U);
+
+	return (u64)(4 | (b & 3)) << (msb - 2);
+}
+
+static void mt7927_lat_record(struct mt7927_tx_lat *lat, u64 ns)
+{
+	lat->hist[mt7927_lat_bucket(ns)]++;
+	lat->count++;
+	lat->max_ns = max(lat->max_ns, ns);
+}
+
+/* Account the time token @id was out, ahead of its release */
+static void mt7927_tx_lat_add(struct mt7927_dev *dev, u32 id, u64 now)
+{
+	const struct mt7927_txwi *txwi;
+
+	if (id >= MT7927_TOKEN_SIZE || !test_bit(id, dev->token.live))
+		return;
+
+	txwi = &dev->token.txwi[id];
+	mt7927_lat_record(&dev->tx_lat[txwi->game], now - txwi->queued_ns);
+}
+
+/* Completion time @pct percent of frames stayed under, to a quarter octave */
+static u64 mt7927_tx_lat_pct(const struct mt7927_tx_lat *lat, u32 pct)
+{
+	u64 want = div_u64(lat->count * pct + 99, 100), seen = 0;
+	u32 b;
+
+	for (b = 0; b < MT7927_LAT_BUCKETS && want; b++) {
+		seen += lat->hist[b];
+		if (seen >= want)
+			return mt7927_lat_bucket_ns(b);
+	}
+
+	return 0;
+}
+
+/* =============================================================================
+ * WFSYS Reset
+ * =============================================================================
+ */
+
+/* Helper for remapped set/clear operations */
+static inline void mt7927_set_remap(struct mt7927_dev *dev, u32 addr, u32 val)
+{
+	mt7927_wr_remap(dev, addr, mt7927_rr_remap(dev, addr) | val);
+}
+
+static inline void mt7927_clear_remap(struct mt7927_dev *dev, u32 addr, u32 val)
+{
+	mt7927_wr_remap(dev, addr, mt7927_rr_remap(dev, addr) & ~val);
+}
+
+static int mt7927_wfsys_reset(struct mt7927_dev *dev)
+{
+	u32 addr = try_alt_reset ? MT_WFSYS_SW_RST_B_ALT : MT_WFSYS_SW_RST_B;
+	u32 val_before, val_after;
+
+	dev_info(&dev->pdev->dev, "=== WFSYS Reset (addr=0x%08x) ===\n", addr);
+	dev_info(&dev->pdev->dev, "  Using remapped register access\n");
+
+	val_before = mt7927_rr_remap(dev, addr);
+	dev_info(&dev->pdev->dev, "  Before reset: 0x%08x\n", val_before);
+
+	/* Check if already in good state */
+	if (val_before & WFSYS_SW_INIT_DONE) {
+		dev_info(&dev->pdev->dev, "  INIT_DONE already set, still resetting...\n");
+	}
+
+	/* Assert reset - clear WFSYS_SW_RST_B */
+	dev_info(&dev->pdev->dev, "  Asserting reset (clearing bit 0)...\n");
+	mt7927_clear_remap(dev, addr, WFSYS_SW_RST_B);
+
+	val_after = mt7927_rr_remap(dev, addr);
+	dev_info(&dev->pdev->dev, "  After clear: 0x%08x\n", val_after);
+
+	/* MANDATORY 50ms delay */
+	dev_info(&dev->pdev->dev, "  Waiting 50ms...\n");
+	mt7927_msleep(dev, 50);
+
+	/* Deassert reset - set WFSYS_SW_RST_B */
+	dev_info(&dev->pdev->dev, "  Deasserting reset (setting bit 0)...\n");
+	mt7927_set_remap(dev, addr, WFSYS_SW_RST_B);
+
+	val_after = mt7927_rr_remap(dev, addr);
+	dev_info(&dev->pdev->dev, "  After set: 0x%08x\n", val_after);
+
+	/* Poll for initialization complete (100ms for debug, prod should be 500ms) */
+	dev_info(&dev->pdev->dev, "  Polling for INIT_DONE (bit 4), timeout 100ms...\n");
+
+	if (!mt7927_poll_remap_quiet(dev, addr, WFSYS_SW_INIT_DONE, WFSYS_SW_INIT_DONE, 100)) {
+		val_after = mt7927_rr_remap(dev, addr);
+		dev_err(&dev->pdev->dev,
+			"  WFSYS reset TIMEOUT! Final value: 0x%08x\n", val_after);
+
+		/* Try alternative address if primary failed */
+		if (!try_alt_reset) {
 			dev_info(&dev->pdev->dev,
 				 "  Trying alternative reset address 0x%08x...\n",
 				 MT_WFSYS_SW_RST_B_ALT);
 
 			addr = MT_WFSYS_SW_RST_B_ALT;
 			mt7927_clear_remap(dev, addr, WFSYS_SW_RST_B);
-			msleep(50);
+			mt7927_msleep(dev, 50);
 			mt7927_set_remap(dev, addr, WFSYS_SW_RST_B);
 
 			if (mt7927_poll_remap_quiet(dev, addr, WFSYS_SW_INIT_DONE,
@@ -1281,1233 +3023,6603 @@ static void mt7927_dma_prefetch(struct mt7927_dev *dev)
 	dev_info(&dev->pdev->dev, "  DMA prefetch configuration complete\n");
 }
 
-static int mt7927_dma_init(struct mt7927_dev *dev)
+/*
+ * Fill buf0/buf1 of a descriptor and return the matching info word.
+ *
+ * WFDMA takes 36-bit addresses: the low 32 bits go in buf0/buf1, bits
+ * 35:32 in SDP0_H/SDP1_H. Buffers above 4 GB are counted, as each would
+ * have gone through SWIOTLB with the old 32-bit mask.
+ */
+static u32 mt7927_desc_set_buf(struct mt7927_dev *dev, struct mt76_desc *desc,
+			       dma_addr_t buf0, dma_addr_t buf1)
 {
-	int ret;
-	u32 val;
+	desc->buf0 = cpu_to_le32(lower_32_bits(buf0));
+	desc->buf1 = cpu_to_le32(lower_32_bits(buf1));
 
-	dev_info(&dev->pdev->dev, "=== DMA Initialization ===\n");
+	if (upper_32_bits(buf0) || upper_32_bits(buf1))
+		dev->dma_high_cnt++;
 
-	/* First disable DMA with force reset */
-	ret = mt7927_dma_disable(dev, true);
-	if (ret)
-		return ret;
+	return FIELD_PREP(MT_DMA_CTL_SDP0_H, upper_32_bits(buf0)) |
+	       FIELD_PREP(MT_DMA_CTL_SDP1_H, upper_32_bits(buf1));
+}
 
-	/*
-	 * CRITICAL: Disable clock gating IMMEDIATELY after dma_disable!
-	 * The LOGIC_RST in dma_disable() resets WFDMA to defaults, which has
-	 * clock gating ENABLED. We must disable it BEFORE any ring register
-	 * access (including prefetch config).
-	 *
-	 * Without this, ALL ring registers (EXT_CTRL, BASE, CNT) will be
-	 * inaccessible and writes will silently fail (read back as old value).
-	 */
-	dev_info(&dev->pdev->dev, "  Disabling clock gating after DMA reset...\n");
-	val = mt7927_rr(dev, MT_WFDMA0_GLO_CFG);
-	dev_info(&dev->pdev->dev, "  GLO_CFG after reset: 0x%08x\n", val);
-	mt7927_set(dev, MT_WFDMA0_GLO_CFG, MT_WFDMA0_GLO_CFG_CLK_GAT_DIS);
-	val = mt7927_rr(dev, MT_WFDMA0_GLO_CFG);
-	dev_info(&dev->pdev->dev, "  GLO_CFG after CLK_GAT_DIS: 0x%08x\n", val);
+static dma_addr_t mt7927_desc_buf0(const struct mt76_desc *desc)
+{
+	return ((u64)FIELD_GET(MT_DMA_CTL_SDP0_H, le32_to_cpu(desc->info)) << 32) |
+	       le32_to_cpu(desc->buf0);
+}
 
-	/*
-	 * v0.4.2: The kernel driver sets additional config flags BEFORE prefetch.
-	 * Specifically CSR_DISP_BASE_PTR_CHAIN_EN which enables ring chaining.
-	 * This might be required for ring registers to be writable.
-	 */
-	dev_info(&dev->pdev->dev, "  Setting CSR_DISP_BASE_PTR_CHAIN_EN before prefetch...\n");
-	mt7927_set(dev, MT_WFDMA0_GLO_CFG, MT_WFDMA0_GLO_CFG_CSR_DISP_BASE_PTR_CHAIN_EN);
-	val = mt7927_rr(dev, MT_WFDMA0_GLO_CFG);
-	dev_info(&dev->pdev->dev, "  GLO_CFG after CHAIN_EN: 0x%08x\n", val);
+/* =============================================================================
+ * TX Buffer Arena
+ * =============================================================================
+ *
+ * With the IOMMU on, each dma_map_single()/dma_unmap_single() pair costs
+ * an IOVA allocation and an IOTLB invalidation, which dominates for short
+ * frames. Sends up to tx_copybreak, MCU commands and data frames alike,
+ * are instead copied into fixed slots of one coherent allocation that
+ * stays mapped. Longer sends, or sends while every slot is busy, are
+ * mapped as before. Slots are given back when the descriptor completes,
+ * or for data frames when their token is released.
+ *
+ * All of this runs under dma_mutex, which also covers TX completion.
+ */
 
-	/*
-	 * Now configure DMA prefetch registers.
-	 * This must happen BEFORE we try to write to ring BASE/CNT registers.
-	 */
-	mt7927_dma_prefetch(dev);
+static int mt7927_tx_arena_alloc(struct mt7927_dev *dev)
+{
+	struct mt7927_tx_arena *a = &dev->arena;
 
-	/* Allocate TX descriptor ring */
-	dev->tx_ring_size = MT7927_TX_FWDL_RING_SIZE;
-	dev->tx_ring = dma_alloc_coherent(&dev->pdev->dev,
-					  dev->tx_ring_size * sizeof(struct mt76_desc),
-					  &dev->tx_ring_dma,
-					  GFP_KERNEL);
-	if (!dev->tx_ring) {
-		dev_err(&dev->pdev->dev, "  Failed to allocate TX ring\n");
+	if (a->buf)
+		return 0;
+
+	a->buf = dma_alloc_coherent(&dev->pdev->dev,
+				    MT7927_TX_SLOTS * MT7927_TX_SLOT_SIZE,
+				    &a->dma, GFP_KERNEL);
+	if (!a->buf)
 		return -ENOMEM;
-	}
 
-	memset(dev->tx_ring, 0, dev->tx_ring_size * sizeof(struct mt76_desc));
+	bitmap_zero(a->used, MT7927_TX_SLOTS);
+	return 0;
+}
 
-	dev_info(&dev->pdev->dev, "  TX ring allocated: %d descriptors at %pad\n",
-		 dev->tx_ring_size, &dev->tx_ring_dma);
+static void mt7927_tx_arena_free(struct mt7927_dev *dev)
+{
+	struct mt7927_tx_arena *a = &dev->arena;
 
-	/*
-	 * Configure FWDL ring (ring 16)
-	 * NOTE: Prefetch was already configured in mt7927_dma_prefetch() above.
-	 * Now the ring BASE/CNT registers should accept writes.
-	 *
-	 * CRITICAL: We must verify the BASE address is actually written!
-	 * If it reads back as 0, the DMA engine will try to fetch from
-	 * address 0x0, causing IOMMU page faults.
-	 */
-	dev_info(&dev->pdev->dev, "  Configuring FWDL ring (ring 16)...\n");
-	dev_info(&dev->pdev->dev, "  Ring DMA address: 0x%08x (phys)\n",
-		 lower_32_bits(dev->tx_ring_dma));
+	if (!a->buf)
+		return;
 
-	/* Write BASE register */
-	mt7927_wr_debug(dev, MT_TX_RING_BASE + 16 * MT_RING_SIZE,
-			lower_32_bits(dev->tx_ring_dma), "RING16_BASE");
+	dma_free_coherent(&dev->pdev->dev, MT7927_TX_SLOTS * MT7927_TX_SLOT_SIZE,
+			  a->buf, a->dma);
+	a->buf = NULL;
+}
 
-	/* Verify the BASE register accepted our write */
-	{
-		u32 base_readback = mt7927_rr(dev, MT_TX_RING_BASE + 16 * MT_RING_SIZE);
-		if (base_readback != lower_32_bits(dev->tx_ring_dma)) {
-			dev_err(&dev->pdev->dev,
-				"  CRITICAL: Ring BASE not writable! Wrote 0x%08x, read 0x%08x\n",
-				lower_32_bits(dev->tx_ring_dma), base_readback);
-			dev_err(&dev->pdev->dev,
-				"  DMA will fail - device will try to fetch from address 0x%08x!\n",
-				base_readback);
-
-			/*
-			 * Try an alternative approach: maybe we need to disable DMA first
-			 * before writing ring registers, then re-enable.
-			 */
-			dev_info(&dev->pdev->dev, "  Trying workaround: disable DMA, write, re-enable...\n");
-			mt7927_clear(dev, MT_WFDMA0_GLO_CFG,
-				     MT_WFDMA0_GLO_CFG_TX_DMA_EN | MT_WFDMA0_GLO_CFG_RX_DMA_EN);
-			udelay(100);
-
-			/* Try writing again */
-			mt7927_wr(dev, MT_TX_RING_BASE + 16 * MT_RING_SIZE,
-				  lower_32_bits(dev->tx_ring_dma));
-			base_readback = mt7927_rr(dev, MT_TX_RING_BASE + 16 * MT_RING_SIZE);
-			dev_info(&dev->pdev->dev, "  After workaround: BASE = 0x%08x\n",
-				 base_readback);
+/*
+ * Get a device address for @len bytes at @data. Copied sends leave @data
+ * free for reuse at once; mapped ones need it untouched until completion.
+ */
+static int mt7927_tx_map(struct mt7927_dev *dev, void *data, int len,
+			 dma_addr_t *dma)
+{
+	struct mt7927_tx_arena *a = &dev->arena;
+	unsigned int slot;
+
+	if (a->buf && len <= min_t(unsigned int, tx_copybreak,
+				   MT7927_TX_SLOT_SIZE)) {
+		slot = find_first_zero_bit(a->used, MT7927_TX_SLOTS);
+		if (slot < MT7927_TX_SLOTS) {
+			__set_bit(slot, a->used);
+			memcpy(a->buf + slot * MT7927_TX_SLOT_SIZE, data, len);
+			*dma = a->dma + slot * MT7927_TX_SLOT_SIZE;
+			a->copy_cnt++;
+			return 0;
 		}
+		a->full_cnt++;
 	}
 
-	mt7927_wr_debug(dev, MT_TX_RING_BASE + 16 * MT_RING_SIZE + 0x04,
-			dev->tx_ring_size, "RING16_CNT");
-	mt7927_wr_debug(dev, MT_TX_RING_BASE + 16 * MT_RING_SIZE + 0x08,
-			0, "RING16_CIDX");
-	mt7927_wr_debug(dev, MT_TX_RING_BASE + 16 * MT_RING_SIZE + 0x0c,
-			0, "RING16_DIDX");
-
-	/*
-	 * v0.5.0: Also configure Ring 15 (MCU commands) and RX Ring 0 (MCU events)
-	 * These are REQUIRED for the ROM bootloader to process MCU commands
-	 * like PATCH_SEM_CONTROL and TARGET_ADDRESS_LEN_REQ.
-	 *
-	 * Without these, the ROM bootloader ignores FW_SCATTER data on Ring 16!
-	 */
-
-	/* Allocate MCU command ring (TX Ring 15) */
-	dev->mcu_ring_size = MT7927_TX_MCU_RING_SIZE;
-	dev->mcu_ring = dma_alloc_coherent(&dev->pdev->dev,
-					   dev->mcu_ring_size * sizeof(struct mt76_desc),
-					   &dev->mcu_ring_dma,
-					   GFP_KERNEL);
-	if (!dev->mcu_ring) {
-		dev_err(&dev->pdev->dev, "  Failed to allocate MCU command ring\n");
-		ret = -ENOMEM;
-		goto err_free_tx_ring;
+	*dma = dma_map_single(&dev->pdev->dev, data, len, DMA_TO_DEVICE);
+	if (dma_mapping_error(&dev->pdev->dev, *dma)) {
+		a->map_err++;
+		return -ENOMEM;
 	}
-	memset(dev->mcu_ring, 0, dev->mcu_ring_size * sizeof(struct mt76_desc));
-	dev->mcu_ring_head = 0;
-
-	dev_info(&dev->pdev->dev, "  MCU ring (Ring 15) allocated: %d descriptors at %pad\n",
-		 dev->mcu_ring_size, &dev->mcu_ring_dma);
 
-	/* Configure MCU command ring (ring 15) */
-	dev_info(&dev->pdev->dev, "  Configuring MCU ring (ring 15)...\n");
-	mt7927_wr_debug(dev, MT_TX_RING_BASE + 15 * MT_RING_SIZE,
-			lower_32_bits(dev->mcu_ring_dma), "RING15_BASE");
-	mt7927_wr_debug(dev, MT_TX_RING_BASE + 15 * MT_RING_SIZE + 0x04,
-			dev->mcu_ring_size, "RING15_CNT");
-	mt7927_wr_debug(dev, MT_TX_RING_BASE + 15 * MT_RING_SIZE + 0x08,
-			0, "RING15_CIDX");
-	mt7927_wr_debug(dev, MT_TX_RING_BASE + 15 * MT_RING_SIZE + 0x0c,
-			0, "RING15_DIDX");
+	a->map_cnt++;
+	return 0;
+}
 
-	/* Allocate RX ring (RX Ring 0) for MCU events/responses */
-	dev->rx_ring_size = MT7927_RX_MCU_RING_SIZE;
-	dev->rx_ring = dma_alloc_coherent(&dev->pdev->dev,
-					  dev->rx_ring_size * sizeof(struct mt76_desc),
-					  &dev->rx_ring_dma,
-					  GFP_KERNEL);
-	if (!dev->rx_ring) {
-		dev_err(&dev->pdev->dev, "  Failed to allocate RX ring\n");
-		ret = -ENOMEM;
-		goto err_free_mcu_ring;
-	}
-	memset(dev->rx_ring, 0, dev->rx_ring_size * sizeof(struct mt76_desc));
-	dev->rx_ring_head = 0;
+/* CPU address of arena address @dma, NULL if @dma is not in the arena */
+static void *mt7927_tx_arena_va(struct mt7927_dev *dev, dma_addr_t dma)
+{
+	struct mt7927_tx_arena *a = &dev->arena;
 
-	/* Allocate RX buffer pool */
-	dev->rx_buf = dma_alloc_coherent(&dev->pdev->dev,
-					 dev->rx_ring_size * MT7927_RX_BUF_SIZE,
-					 &dev->rx_buf_dma,
-					 GFP_KERNEL);
-	if (!dev->rx_buf) {
-		dev_err(&dev->pdev->dev, "  Failed to allocate RX buffers\n");
-		ret = -ENOMEM;
-		goto err_free_rx_ring;
-	}
+	if (!a->buf || dma < a->dma ||
+	    dma >= a->dma + MT7927_TX_SLOTS * MT7927_TX_SLOT_SIZE)
+		return NULL;
 
-	/* Initialize RX descriptors with buffer addresses (v0.8.0 FIXED) */
-	{
-		int i;
-		for (i = 0; i < dev->rx_ring_size; i++) {
-			dma_addr_t buf_dma = dev->rx_buf_dma + i * MT7927_RX_BUF_SIZE;
-			dev->rx_ring[i].buf0 = cpu_to_le32(lower_32_bits(buf_dma));
-			dev->rx_ring[i].buf1 = 0;  /* Not using scatter-gather */
-			/* Control: buffer length in bits [29:16] */
-			dev->rx_ring[i].ctrl = cpu_to_le32(
-				FIELD_PREP(MT_DMA_CTL_SD_LEN0, MT7927_RX_BUF_SIZE));
-			/* Info: upper 4 bits of address in bits [3:0] */
-			dev->rx_ring[i].info = cpu_to_le32(
-				FIELD_PREP(MT_DMA_CTL_SDP0_H, upper_32_bits(buf_dma) & 0xF));
-		}
-	}
+	return a->buf + (dma - a->dma);
+}
 
-	dev_info(&dev->pdev->dev, "  RX ring (Ring 0) allocated: %d descriptors at %pad\n",
-		 dev->rx_ring_size, &dev->rx_ring_dma);
+/* Undo mt7927_tx_map() of @len bytes at @dma: free the slot, or unmap */
+static void mt7927_tx_unmap_buf(struct mt7927_dev *dev, dma_addr_t dma,
+				u32 len)
+{
+	struct mt7927_tx_arena *a = &dev->arena;
 
-	/* Configure RX ring (ring 0) */
-	dev_info(&dev->pdev->dev, "  Configuring RX ring (ring 0)...\n");
-	mt7927_wr_debug(dev, MT_RX_RING_BASE + 0 * MT_RING_SIZE,
-			lower_32_bits(dev->rx_ring_dma), "RX_RING0_BASE");
-	mt7927_wr_debug(dev, MT_RX_RING_BASE + 0 * MT_RING_SIZE + 0x04,
-			dev->rx_ring_size, "RX_RING0_CNT");
-	mt7927_wr_debug(dev, MT_RX_RING_BASE + 0 * MT_RING_SIZE + 0x08,
-			0, "RX_RING0_CIDX");
-	mt7927_wr_debug(dev, MT_RX_RING_BASE + 0 * MT_RING_SIZE + 0x0c,
-			0, "RX_RING0_DIDX");
+	if (mt7927_tx_arena_va(dev, dma)) {
+		__clear_bit((dma - a->dma) / MT7927_TX_SLOT_SIZE, a->used);
+		return;
+	}
 
-	/* Kick RX ring - set CPU index to ring size to indicate all buffers available */
-	mt7927_wr(dev, MT_RX_RING_BASE + 0 * MT_RING_SIZE + 0x08,
-		  dev->rx_ring_size - 1);
+	dma_unmap_single(&dev->pdev->dev, dma, len, DMA_TO_DEVICE);
+	a->unmap_cnt++;
+}
 
-	/* Enable DMA */
-	ret = mt7927_dma_enable(dev);
-	if (ret)
-		goto err_free_rx_buf;
+/* Undo mt7927_tx_map() for a completed or dropped descriptor */
+static void mt7927_tx_unmap(struct mt7927_dev *dev, const struct mt76_desc *desc)
+{
+	dma_addr_t dma = mt7927_desc_buf0(desc);
 
-	return 0;
+	if (!dma)
+		return;
 
-err_free_rx_buf:
-	dma_free_coherent(&dev->pdev->dev,
-			  dev->rx_ring_size * MT7927_RX_BUF_SIZE,
-			  dev->rx_buf, dev->rx_buf_dma);
-	dev->rx_buf = NULL;
-err_free_rx_ring:
-	dma_free_coherent(&dev->pdev->dev,
-			  dev->rx_ring_size * sizeof(struct mt76_desc),
-			  dev->rx_ring, dev->rx_ring_dma);
-	dev->rx_ring = NULL;
-err_free_mcu_ring:
-	dma_free_coherent(&dev->pdev->dev,
-			  dev->mcu_ring_size * sizeof(struct mt76_desc),
-			  dev->mcu_ring, dev->mcu_ring_dma);
-	dev->mcu_ring = NULL;
-err_free_tx_ring:
-	dma_free_coherent(&dev->pdev->dev,
-			  dev->tx_ring_size * sizeof(struct mt76_desc),
-			  dev->tx_ring, dev->tx_ring_dma);
-	dev->tx_ring = NULL;
-	return ret;
+	mt7927_tx_unmap_buf(dev, dma,
+			    FIELD_GET(MT_DMA_CTL_SD_LEN0, le32_to_cpu(desc->ctrl)));
 }
 
-static void mt7927_dma_cleanup(struct mt7927_dev *dev)
-{
-	mt7927_dma_disable(dev, false);
-
-	if (dev->mcu_buf) {
-		dma_free_coherent(&dev->pdev->dev, MT7927_FW_CHUNK_SIZE + 256,
-				  dev->mcu_buf, dev->mcu_dma);
-		dev->mcu_buf = NULL;
-	}
+/* =============================================================================
+ * TX Tokens
+ * =============================================================================
+ *
+ * Data frames are not completed by ring DIDX. Each one carries a token
+ * (MSDU ID) that the firmware returns in a TX-free event on RX ring 0
+ * once the frame is out, possibly after aggregation and retries, and
+ * one event releases many tokens. The token indexes a table holding the
+ * skb and its mapping, so a whole event is reclaimed in one pass:
+ * everything is unmapped first, then the skbs are freed.
+ *
+ * RX ring 0 raises no interrupt here. While tokens are in flight it is
+ * polled every MT7927_RX_POLL_MS (mt7927_rx_poll_work()), so TX-free
+ * events are handled between MCU commands as well as during them.
+ *
+ * Allocation is lock-free: a token is a bit in the used bitmap, taken
+ * with test_and_set_bit_lock(). Its entry is filled before the token is
+ * published in the live bitmap, and release claims it by clearing that
+ * bit with test_and_clear_bit(), so a stale or repeated MSDU ID never
+ * sees a half-filled entry or frees one twice. The used bit goes back
+ * with clear_bit_unlock() once the entry is cleared.
+ *
+ * Producers never touch dma_mutex. Release does run under it (TX-free
+ * events, chip reset): it gives back the frame's TX arena slot, and it
+ * keeps the latency accounting that reads an entry just before it is
+ * released from racing another release.
+ *
+ * The table is allocated when the data path comes up, with the first
+ * station, rather than at probe: a device that never carries data does
+ * not pay for it. It stays until remove.
+ */
 
-	if (dev->fw_buf) {
-		dma_free_coherent(&dev->pdev->dev, dev->fw_size,
-				  dev->fw_buf, dev->fw_dma);
-		dev->fw_buf = NULL;
-	}
+/* Allocate the token table if it is not there yet. Called under sta_mutex. */
+static int mt7927_token_init(struct mt7927_dev *dev)
+{
+	struct mt7927_token *tk = &dev->token;
 
-	if (dev->rx_buf) {
-		dma_free_coherent(&dev->pdev->dev,
-				  dev->rx_ring_size * MT7927_RX_BUF_SIZE,
-				  dev->rx_buf, dev->rx_buf_dma);
-		dev->rx_buf = NULL;
-	}
+	lockdep_assert_held(&dev->sta_mutex);
 
-	if (dev->rx_ring) {
-		dma_free_coherent(&dev->pdev->dev,
-				  dev->rx_ring_size * sizeof(struct mt76_desc),
-				  dev->rx_ring, dev->rx_ring_dma);
-		dev->rx_ring = NULL;
-	}
+	if (tk->txwi)
+		return 0;
 
-	if (dev->mcu_ring) {
-		dma_free_coherent(&dev->pdev->dev,
-				  dev->mcu_ring_size * sizeof(struct mt76_desc),
-				  dev->mcu_ring, dev->mcu_ring_dma);
-		dev->mcu_ring = NULL;
-	}
+	tk->txwi = kvzalloc_node(MT7927_TOKEN_SIZE * sizeof(*tk->txwi),
+				 GFP_KERNEL, dev_to_node(&dev->pdev->dev));
+	if (!tk->txwi)
+		return -ENOMEM;
 
-	if (dev->tx_ring) {
-		dma_free_coherent(&dev->pdev->dev,
-				  dev->tx_ring_size * sizeof(struct mt76_desc),
-				  dev->tx_ring, dev->tx_ring_dma);
-		dev->tx_ring = NULL;
-	}
+	bitmap_zero(tk->used, MT7927_TOKEN_SIZE);
+	bitmap_zero(tk->live, MT7927_TOKEN_SIZE);
+	return 0;
 }
 
-/* =============================================================================
- * Firmware Loading via DMA Ring 16
- * =============================================================================
- */
+/* Drain RX ring 0 soon, no-op if already armed */
+static inline void mt7927_rx_poll_arm(struct mt7927_dev *dev)
+{
+	queue_delayed_work(system_wq, &dev->rx_poll,
+			   msecs_to_jiffies(MT7927_RX_POLL_MS));
+}
 
+#ifdef CONFIG_MT7927_SELFTEST
 /*
- * Build MCU TXD word 0 for firmware scatter
+ * Take a token for @skb mapped at @dma, queued to MLO link @link. Returns
+ * the token, or -ENOSPC when all MT7927_TOKEN_SIZE are in flight.
  */
-static u32 mt7927_mcu_txd0_fw(u16 len)
+static int mt7927_token_get(struct mt7927_dev *dev, struct sk_buff *skb,
+			    dma_addr_t dma, u32 len, u8 link)
 {
-	return FIELD_PREP(MT_TXD0_TX_BYTES, len) |
-	       FIELD_PREP(MT_TXD0_PKT_FMT, MT_TX_TYPE_FW) |
-	       FIELD_PREP(MT_TXD0_Q_IDX, MT_TX_MCU_PORT_RX_FWDL);
+	struct mt7927_token *tk = &dev->token;
+	unsigned int start, id;
+	int pass;
+
+	if (!tk->txwi)
+		return -ENODEV;
+
+	start = (unsigned int)atomic_read(&tk->hint) % MT7927_TOKEN_SIZE;
+
+	for (pass = 0; pass < 2; pass++) {
+		id = find_next_zero_bit(tk->used, MT7927_TOKEN_SIZE, start);
+		while (id < MT7927_TOKEN_SIZE) {
+			if (!test_and_set_bit_lock(id, tk->used))
+				goto found;
+			id = find_next_zero_bit(tk->used, MT7927_TOKEN_SIZE,
+						id + 1);
+		}
+		start = 0;
+	}
+
+	atomic_inc(&tk->full_cnt);
+	return -ENOSPC;
+
+found:
+	tk->txwi[id].skb = skb;
+	tk->txwi[id].dma = dma;
+	tk->txwi[id].len = len;
+	tk->txwi[id].link = link;
+	tk->txwi[id].game = READ_ONCE(dev->game.on);
+	tk->txwi[id].gen = READ_ONCE(tk->gen);
+	tk->txwi[id].queued_ns = ktime_get_ns();
+	atomic_set(&tk->hint, id + 1);
+	atomic_inc(&tk->count);
+	atomic_add(len, &dev->link[link].inflight);
+
+	/* Publish the filled entry, pairs with mt7927_token_release() */
+	smp_mb__before_atomic();
+	set_bit(id, tk->live);
+	mt7927_rx_poll_arm(dev);
+
+	return id;
 }
+#endif
 
 /*
- * Get next MCU sequence number (1-15, wraps)
+ * Give back token @id and return its skb, unmapped or its arena slot
+ * freed (mt7927_tx_unmap_buf()). The skb is not freed
+ * so callers can batch that. Returns NULL for a token not in flight.
+ * Called under dma_mutex.
  */
-static u8 mt7927_mcu_next_seq(struct mt7927_dev *dev)
+static struct sk_buff *mt7927_token_release(struct mt7927_dev *dev, u32 id)
 {
-	dev->mcu_seq = (dev->mcu_seq + 1) & 0xf;
-	if (dev->mcu_seq == 0)
-		dev->mcu_seq = 1;
-	return dev->mcu_seq;
+	struct mt7927_token *tk = &dev->token;
+	struct mt7927_txwi txwi;
+
+	/* Fully ordered: the entry is complete once the bit is ours */
+	if (id >= MT7927_TOKEN_SIZE || !test_and_clear_bit(id, tk->live))
+		return NULL;
+
+	txwi = tk->txwi[id];
+	memset(&tk->txwi[id], 0, sizeof(tk->txwi[id]));
+	clear_bit_unlock(id, tk->used);
+	atomic_dec(&tk->count);
+	atomic_sub(txwi.len, &dev->link[txwi.link].inflight);
+
+	mt7927_tx_unmap_buf(dev, txwi.dma, txwi.len);
+
+	return txwi.skb;
 }
 
-/*
- * Build MCU TXD word 0 for MCU commands (via Ring 15)
- */
-static u32 mt7927_mcu_txd0_cmd(u16 len)
+static void mt7927_tx_skb_list_free(struct sk_buff *list)
 {
-	return FIELD_PREP(MT_TXD0_TX_BYTES, len) |
-	       FIELD_PREP(MT_TXD0_PKT_FMT, MT_TX_TYPE_CMD) |
-	       FIELD_PREP(MT_TXD0_Q_IDX, MT_TX_MCU_PORT_RX_Q0);
+	struct sk_buff *skb;
+
+	while (list) {
+		skb = list;
+		list = skb->next;
+		skb->next = NULL;
+		dev_consume_skb_any(skb);
+	}
 }
 
 /*
- * Queue an MCU command to Ring 15 (MCU WM queue)
+ * Reclaim every token named in a TX-free event. Each info word carries
+ * up to two 15-bit MSDU IDs (all ones = empty); PAIR and HEADER words
+ * only carry the station and are skipped. Called under dma_mutex.
  */
-static int mt7927_dma_tx_queue_mcu(struct mt7927_dev *dev, dma_addr_t data_dma,
-				   int data_len)
+static void mt7927_tx_free_event(struct mt7927_dev *dev, const void *data,
+				 int len)
 {
-	struct mt76_desc *desc;
-	u32 ctrl;
-	int idx;
+	struct mt7927_token *tk = &dev->token;
+	const __le32 *free = data, *end = data + len;
+	struct sk_buff *list = NULL, *skb;
+	u32 count, info, msdu, batch = 0;
+	u64 now = ktime_get_ns();
+	int i;
 
-	idx = dev->mcu_ring_head;
-	desc = &dev->mcu_ring[idx];
+	if (len < 2 * sizeof(__le32))
+		return;
 
-	/*
-	 * Fill descriptor (v0.8.0 FIXED):
-	 * Using correct bit positions for ctrl field.
-	 */
-	desc->buf0 = cpu_to_le32(lower_32_bits(data_dma));
-	desc->buf1 = 0;  /* Not using scatter-gather */
-	desc->info = cpu_to_le32(
-		FIELD_PREP(MT_DMA_CTL_SDP0_H, upper_32_bits(data_dma) & 0xF));
+	count = le32_get_bits(free[0], MT_TXFREE0_MSDU_CNT);
 
-	/* Control: length in [29:16], last segment at bit 30 */
-	ctrl = FIELD_PREP(MT_DMA_CTL_SD_LEN0, data_len) |
-	       MT_DMA_CTL_LAST_SEC0;
-	desc->ctrl = cpu_to_le32(ctrl);
+	for (free += 2; free < end && count; free++) {
+		info = le32_to_cpu(*free);
+		if (info & (MT_TXFREE_INFO_PAIR | MT_TXFREE_INFO_HEADER))
+			continue;
 
-	if (debug_regs)
-		dev_info(&dev->pdev->dev,
-			 "  MCU Desc: buf0=0x%08x ctrl=0x%08x len=%d\n",
-			 le32_to_cpu(desc->buf0), le32_to_cpu(desc->ctrl), data_len);
+		for (i = 0; i < 2 && count; i++) {
+			msdu = (info >> (15 * i)) & MT_TXFREE_INFO_MSDU_ID;
+			if (msdu == MT_TXFREE_INFO_MSDU_ID)
+				continue;
 
-	/* Memory barrier before kicking DMA */
-	wmb();
+			count--;
+			mt7927_tx_lat_add(dev, msdu, now);
+			skb = mt7927_token_release(dev, msdu);
+			if (!skb) {
+				tk->bad_id++;
+				continue;
+			}
 
-	/* Advance head */
-	dev->mcu_ring_head = (idx + 1) % dev->mcu_ring_size;
+			skb->next = list;
+			list = skb;
+			batch++;
+		}
+	}
 
-	/* Kick DMA - write CPU index to Ring 15 */
-	mt7927_wr(dev, MT_TX_RING_BASE + 15 * MT_RING_SIZE + 0x08,
-		  dev->mcu_ring_head);
+	mt7927_tx_skb_list_free(list);
 
-	return 0;
+	tk->free_evt++;
+	tk->reclaimed += batch;
+	tk->max_batch = max(tk->max_batch, batch);
 }
 
 /*
- * Wait for MCU command ring to drain
+ * Release every token still in flight. The firmware that owned them is
+ * gone (reset) or about to be (teardown), so no TX-free event will come.
+ * Tokens taken from here on belong to a new generation.
  */
-static int mt7927_mcu_tx_wait(struct mt7927_dev *dev, int timeout_ms)
+static void mt7927_token_drain(struct mt7927_dev *dev)
 {
-	u32 cpu_idx, dma_idx;
-	int i;
+	struct mt7927_token *tk = &dev->token;
+	struct sk_buff *list = NULL, *skb;
+	unsigned int id;
 
-	for (i = 0; i < timeout_ms; i++) {
-		cpu_idx = mt7927_rr(dev, MT_TX_RING_BASE + 15 * MT_RING_SIZE + 0x08);
-		dma_idx = mt7927_rr(dev, MT_TX_RING_BASE + 15 * MT_RING_SIZE + 0x0c);
+	if (!tk->txwi)
+		return;
 
-		if (cpu_idx == dma_idx)
-			return 0;
+	WRITE_ONCE(tk->gen, tk->gen + 1);
 
-		usleep_range(1000, 2000);
+	for_each_set_bit(id, tk->live, MT7927_TOKEN_SIZE) {
+		skb = mt7927_token_release(dev, id);
+		if (!skb)
+			continue;
+
+		skb->next = list;
+		list = skb;
+		tk->drained++;
 	}
 
-	dev_warn(&dev->pdev->dev,
-		 "  MCU DMA wait timeout: cpu_idx=%d dma_idx=%d\n", cpu_idx, dma_idx);
-	return -ETIMEDOUT;
+	mt7927_tx_skb_list_free(list);
 }
 
-/*
- * Wait for MCU response on RX Ring 0
+static void mt7927_token_free(struct mt7927_dev *dev)
+{
+	mt7927_token_drain(dev);
+	kvfree(dev->token.txwi);
+	dev->token.txwi = NULL;
+}
+
+/* =============================================================================
+ * RX Block-Ack Reorder
+ * =============================================================================
  *
- * Returns: 0 on success, negative on error
- * On success, *resp_data and *resp_len contain the response if not NULL
+ * With an RX block-ack session the peer may send a TID's frames out of
+ * order within the window; the firmware acknowledges them and the host
+ * puts them back in order. Each session has a buffer indexed by SN modulo
+ * the window size. mt7927_rx_reorder() takes the SN and TID from RXD
+ * group 4, holds frames past a hole and releases runs of in-order frames
+ * together, so the stack gets them as one batch.
+ *
+ * A hole that is never filled (the peer gave up on the frame) is skipped
+ * by the per-TID reorder timer after 40 ms (VI/VO) or 100 ms (BE/BK), as
+ * in mt76. Frames carrying a PN are checked for replay as they are
+ * released, when they are in order again.
  */
-static int mt7927_mcu_wait_response(struct mt7927_dev *dev, int timeout_ms,
-				    u8 expected_seq)
-{
-	u32 cpu_idx, dma_idx;
-	int i;
 
-	dev_info(&dev->pdev->dev, "  Waiting for MCU response (seq=%d)...\n",
-		 expected_seq);
+#define mt7927_rx_cb(skb)	((struct mt7927_rx_cb *)(skb)->cb)
 
-	for (i = 0; i < timeout_ms; i++) {
-		cpu_idx = mt7927_rr(dev, MT_RX_RING_BASE + 0 * MT_RING_SIZE + 0x08);
-		dma_idx = mt7927_rr(dev, MT_RX_RING_BASE + 0 * MT_RING_SIZE + 0x0c);
+/* Per-frame RX info, in skb->cb */
+struct mt7927_rx_cb {
+	u64 pn;				/* From RXD group 1, if pn_valid */
+	unsigned long reorder_time;	/* jiffies when buffered */
+	u16 seqno;			/* From RXD group 4, if seq_valid */
+	u8 tid;
+	bool seq_valid;
+	bool pn_valid;
+};
 
-		/* If DMA has advanced past our last processed index, we have data */
-		if (cpu_idx != dma_idx) {
-			/* For now, just log that we got something */
-			struct mt76_desc *desc = &dev->rx_ring[cpu_idx];
-			u32 ctrl = le32_to_cpu(desc->ctrl);
+static_assert(sizeof(struct mt7927_rx_cb) <= sizeof_field(struct sk_buff, cb));
 
-			if (ctrl & MT_DMA_CTL_DMA_DONE) {
-				int len = FIELD_GET(MT_DMA_CTL_SD_LEN0, ctrl);
-				dev_info(&dev->pdev->dev,
-					 "  MCU response received: idx=%d len=%d\n",
-					 cpu_idx, len);
+/* Hand a batch of in-order frames to the stack */
+static void mt7927_rx_deliver(struct mt7927_dev *dev,
+			      struct sk_buff_head *frames)
+{
+	struct sk_buff *skb;
 
-				/* Recycle descriptor - clear DMA_DONE and advance */
-				desc->ctrl = cpu_to_le32(
-					FIELD_PREP(MT_DMA_CTL_SD_LEN0, MT7927_RX_BUF_SIZE));
-				wmb();
+	/* No netdev yet, napi_gro_receive() goes here */
+	while ((skb = __skb_dequeue(frames))) {
+		mt7927_mock_rx(dev, mt7927_rx_cb(skb)->seqno);
+		dev_consume_skb_any(skb);
+	}
+}
 
-				/* Advance CPU index */
-				mt7927_wr(dev, MT_RX_RING_BASE + 0 * MT_RING_SIZE + 0x08,
-					  (cpu_idx + 1) % dev->rx_ring_size);
+static bool mt7927_sn_less(u16 sn1, u16 sn2)
+{
+	return ((sn1 - sn2) & MT7927_SEQ_MASK) > (MT7927_SEQ_MASK + 1) / 2;
+}
 
-				return 0;
-			}
-		}
+static u16 mt7927_sn_add(u16 sn, u16 n)
+{
+	return (sn + n) & MT7927_SEQ_MASK;
+}
 
-		usleep_range(1000, 2000);
-	}
-
-	dev_warn(&dev->pdev->dev,
-		 "  MCU response timeout: cpu_idx=%d dma_idx=%d\n", cpu_idx, dma_idx);
-	return -ETIMEDOUT;
+static unsigned long mt7927_rx_tid_timeout(u8 tid)
+{
+	return HZ / (tid >= 4 ? 25 : 10);
 }
 
-/*
- * Send MCU command and optionally wait for response
- *
- * This builds the MCU TXD header and sends the command via Ring 15.
- * Used for ROM bootloader commands like PATCH_SEM_CONTROL.
- */
-static int mt7927_mcu_send_msg(struct mt7927_dev *dev, u8 cmd,
-			       const void *data, int len, bool wait_resp)
+/* Release @skb to @frames unless its PN goes backwards */
+static void mt7927_rx_tid_queue(struct mt7927_rx_tid *tid, struct sk_buff *skb,
+				struct sk_buff_head *frames)
 {
-	struct mt7927_mcu_hdr *hdr;
-	int total_len;
-	u8 seq;
-	int ret;
+	struct mt7927_rx_cb *cb = mt7927_rx_cb(skb);
 
-	/* Allocate MCU command buffer if needed */
-	if (!dev->mcu_buf) {
-		dev->mcu_buf = dma_alloc_coherent(&dev->pdev->dev,
-						  MT7927_FW_CHUNK_SIZE + 256,
-						  &dev->mcu_dma, GFP_KERNEL);
-		if (!dev->mcu_buf)
-			return -ENOMEM;
+	if (cb->pn_valid) {
+		if (tid->last_pn && cb->pn <= tid->last_pn) {
+			tid->replay++;
+			dev_kfree_skb_any(skb);
+			return;
+		}
+		tid->last_pn = cb->pn;
 	}
 
-	/* Total packet = TXD (32 bytes) + MCU header + data */
-	total_len = sizeof(struct mt7927_mcu_txd) + sizeof(*hdr) + len;
+	tid->released++;
+	__skb_queue_tail(frames, skb);
+}
 
-	/* Build MCU header at start of buffer */
-	memset(dev->mcu_buf, 0, total_len);
+/* Move the window one SN forward, releasing the frame in that slot */
+static void mt7927_rx_tid_release_one(struct mt7927_rx_tid *tid,
+				      struct sk_buff_head *frames)
+{
+	u16 idx = tid->head % tid->size;
+	struct sk_buff *skb = tid->reorder_buf[idx];
 
-	/* First 32 bytes: TXD */
-	{
-		__le32 *txd = dev->mcu_buf;
-		txd[0] = cpu_to_le32(mt7927_mcu_txd0_cmd(total_len));
-	}
+	tid->head = mt7927_sn_add(tid->head, 1);
+	if (!skb)
+		return;
 
-	/* MCU header follows TXD */
-	hdr = dev->mcu_buf + sizeof(struct mt7927_mcu_txd);
-	seq = mt7927_mcu_next_seq(dev);
+	tid->reorder_buf[idx] = NULL;
+	tid->nframes--;
+	mt7927_rx_tid_queue(tid, skb, frames);
+}
 
-	hdr->len = cpu_to_le16(sizeof(*hdr) + len);
-	hdr->pq_id = cpu_to_le16(0x8000);  /* MCU queue ID */
-	hdr->cid = cmd;
-	hdr->pkt_type = MT_MCU_PKT_ID;
-	hdr->set_query = MCU_CMD_SET;
-	hdr->seq = seq;
-	hdr->s2d_index = MCU_S2D_H2N;
+/* Release everything before @head, holes included */
+static void mt7927_rx_tid_release_frames(struct mt7927_rx_tid *tid,
+					 struct sk_buff_head *frames, u16 head)
+{
+	while (mt7927_sn_less(tid->head, head))
+		mt7927_rx_tid_release_one(tid, frames);
+}
 
-	/* Copy payload data after header */
-	if (data && len > 0)
-		memcpy(dev->mcu_buf + sizeof(struct mt7927_mcu_txd) + sizeof(*hdr),
-		       data, len);
+/* Release the run of frames at the head of the window */
+static void mt7927_rx_tid_release_head(struct mt7927_rx_tid *tid,
+				       struct sk_buff_head *frames)
+{
+	while (tid->reorder_buf[tid->head % tid->size])
+		mt7927_rx_tid_release_one(tid, frames);
+}
 
-	/* Sync buffer to device */
-	dma_sync_single_for_device(&dev->pdev->dev, dev->mcu_dma,
-				   total_len, DMA_TO_DEVICE);
+/* Skip holes whose following frames have waited too long */
+static void mt7927_rx_tid_check_release(struct mt7927_rx_tid *tid,
+					struct sk_buff_head *frames)
+{
+	unsigned long timeout = mt7927_rx_tid_timeout(tid->num);
+	u16 start, idx, nframes;
+	struct sk_buff *skb;
 
-	dev_info(&dev->pdev->dev,
-		 "  Sending MCU cmd=0x%02x seq=%d len=%d total=%d\n",
-		 cmd, seq, len, total_len);
+	if (!tid->nframes)
+		return;
 
-	/* Queue to Ring 15 */
-	ret = mt7927_dma_tx_queue_mcu(dev, dev->mcu_dma, total_len);
-	if (ret)
-		return ret;
+	mt7927_rx_tid_release_head(tid, frames);
 
-	/* Wait for DMA to complete */
-	ret = mt7927_mcu_tx_wait(dev, 100);
-	if (ret) {
-		dev_err(&dev->pdev->dev, "  MCU command DMA timeout\n");
-		return ret;
-	}
+	start = tid->head % tid->size;
+	nframes = tid->nframes;
 
-	/* Wait for response if requested */
-	if (wait_resp) {
-		ret = mt7927_mcu_wait_response(dev, 500, seq);
-		if (ret) {
-			dev_warn(&dev->pdev->dev,
-				 "  MCU response timeout (cmd=0x%02x) - ROM may not be ready\n",
-				 cmd);
-			/* Don't fail - ROM might process command without explicit ACK */
-		}
+	for (idx = (start + 1) % tid->size; idx != start && nframes;
+	     idx = (idx + 1) % tid->size) {
+		skb = tid->reorder_buf[idx];
+		if (!skb)
+			continue;
+
+		nframes--;
+		if (!time_after(jiffies, mt7927_rx_cb(skb)->reorder_time +
+				timeout))
+			continue;
+
+		tid->timeout++;
+		mt7927_rx_tid_release_frames(tid, frames,
+					     mt7927_rx_cb(skb)->seqno);
 	}
 
-	return 0;
+	mt7927_rx_tid_release_head(tid, frames);
 }
 
-/*
- * Acquire patch semaphore from ROM bootloader
- *
- * This MUST be called before sending any firmware data!
- * The ROM bootloader uses a semaphore to coordinate patch loading.
- */
-static int mt7927_mcu_patch_sem_ctrl(struct mt7927_dev *dev, bool get)
+static void mt7927_rx_tid_work(struct work_struct *work)
 {
-	struct {
-		__le32 op;
-	} req = {
-		.op = cpu_to_le32(get ? PATCH_SEM_GET : PATCH_SEM_RELEASE),
-	};
+	struct mt7927_rx_tid *tid = container_of(work, struct mt7927_rx_tid,
+						 reorder_work.work);
+	struct sk_buff_head frames;
 
-	dev_info(&dev->pdev->dev, "=== MCU PATCH_SEM_CONTROL (%s) ===\n",
-		 get ? "GET" : "RELEASE");
-
-	return mt7927_mcu_send_msg(dev, MCU_CMD_PATCH_SEM_CTRL,
-				   &req, sizeof(req), true);
-}
+	__skb_queue_head_init(&frames);
 
-/*
- * Initialize patch download - tells ROM the target address and length
- */
-static int mt7927_mcu_init_download(struct mt7927_dev *dev, u32 addr, u32 len)
-{
-	struct {
-		__le32 addr;
-		__le32 len;
-		__le32 mode;
-	} req = {
-		.addr = cpu_to_le32(addr),
-		.len = cpu_to_le32(len),
-		.mode = cpu_to_le32(DL_MODE_NEED_RSP),
-	};
+	spin_lock_bh(&tid->lock);
+	if (tid->stopped) {
+		spin_unlock_bh(&tid->lock);
+		return;
+	}
 
-	dev_info(&dev->pdev->dev, "=== MCU TARGET_ADDRESS_LEN_REQ ===\n");
-	dev_info(&dev->pdev->dev, "  addr=0x%08x len=%d\n", addr, len);
+	mt7927_rx_tid_check_release(tid, &frames);
+	if (tid->nframes)
+		queue_delayed_work(system_wq, &tid->reorder_work,
+				   mt7927_rx_tid_timeout(tid->num));
+	spin_unlock_bh(&tid->lock);
 
-	return mt7927_mcu_send_msg(dev, MCU_CMD_TARGET_ADDRESS_LEN_REQ,
-				   &req, sizeof(req), true);
+	mt7927_rx_deliver(tid->dev, &frames);
 }
 
 /*
- * Queue a firmware chunk to the FWDL ring (ring 16)
- *
- * This sets up a DMA descriptor pointing to the firmware data
- * and kicks the DMA engine.
+ * Put @skb through the reorder buffer of its TID if @sta has an RX BA
+ * session there, otherwise pass it straight on. Frames that become
+ * in-order are appended to @frames. Called under rcu_read_lock().
  */
-static int mt7927_dma_tx_queue_fw(struct mt7927_dev *dev, dma_addr_t data_dma,
-				  int data_len)
+static void mt7927_rx_reorder(struct mt7927_sta *sta, struct sk_buff *skb,
+			      struct sk_buff_head *frames)
 {
-	struct mt76_desc *desc;
-	u32 ctrl;
-	int idx;
+	struct mt7927_rx_cb *cb = mt7927_rx_cb(skb);
+	struct mt7927_rx_tid *tid = NULL;
+	u16 seqno = cb->seqno, idx;
+
+	if (sta && cb->seq_valid)
+		tid = rcu_dereference(sta->rx_tid[cb->tid]);
+	if (!tid) {
+		__skb_queue_tail(frames, skb);
+		return;
+	}
 
-	idx = dev->tx_ring_head;
-	desc = &dev->tx_ring[idx];
+	spin_lock_bh(&tid->lock);
 
-	/* Check if descriptor is available (DMA_DONE should be set for unused) */
-	ctrl = le32_to_cpu(desc->ctrl);
-	if (!(ctrl & MT_DMA_CTL_DMA_DONE) && ctrl != 0) {
-		dev_warn(&dev->pdev->dev, "  Ring full at idx %d, ctrl=0x%08x\n",
-			 idx, ctrl);
-		return -EBUSY;
+	if (tid->stopped) {
+		__skb_queue_tail(frames, skb);
+		goto out;
 	}
 
-	/*
-	 * Fill descriptor - MT76 descriptor format (v0.8.0 CRITICAL FIX):
-	 *   buf0: lower 32 bits of DMA address
-	 *   ctrl: control flags - SD_LEN0 in bits [29:16], LAST_SEC0 at bit 30
-	 *   buf1: lower 32 bits of second buffer (for scatter-gather, usually 0)
-	 *   info: metadata - includes upper 4 bits of DMA address in bits [3:0]
-	 *
-	 * CRITICAL: Our old code had SD_LEN0 in wrong bits causing garbage!
-	 * Now using kernel-correct bit positions.
-	 */
-	desc->buf0 = cpu_to_le32(lower_32_bits(data_dma));
-	desc->buf1 = 0;  /* Not using scatter-gather second buffer */
+	/* Already released or skipped */
+	if (mt7927_sn_less(seqno, tid->head)) {
+		tid->old++;
+		dev_kfree_skb_any(skb);
+		goto out;
+	}
 
-	/* Info field: upper 4 bits of 64-bit address go in bits [3:0] */
-	desc->info = cpu_to_le32(
-		FIELD_PREP(MT_DMA_CTL_SDP0_H, upper_32_bits(data_dma) & 0xF));
+	if (seqno == tid->head) {
+		tid->head = mt7927_sn_add(tid->head, 1);
+		mt7927_rx_tid_queue(tid, skb, frames);
+		mt7927_rx_tid_release_head(tid, frames);
+		goto out;
+	}
 
-	/*
-	 * Control field (v0.8.0 FIXED bit positions):
-	 *   - SD_LEN0 in bits [29:16] = packet length
-	 *   - LAST_SEC0 at bit 30 = this is the last/only segment
-	 *   - BURST at bit 15 = burst mode for better performance
-	 */
-	ctrl = FIELD_PREP(MT_DMA_CTL_SD_LEN0, data_len) |
-	       MT_DMA_CTL_LAST_SEC0 |
-	       MT_DMA_CTL_BURST;
-	desc->ctrl = cpu_to_le32(ctrl);
+	/* Past the window: slide it so @seqno is the last slot */
+	if (!mt7927_sn_less(seqno, mt7927_sn_add(tid->head, tid->size)))
+		mt7927_rx_tid_release_frames(tid, frames,
+					     (seqno - tid->size + 1) &
+					     MT7927_SEQ_MASK);
 
-	if (debug_regs)
-		dev_info(&dev->pdev->dev,
-			 "  Desc: buf0=0x%08x buf1=0x%08x ctrl=0x%08x info=0x%08x\n",
-			 le32_to_cpu(desc->buf0), le32_to_cpu(desc->buf1),
-			 le32_to_cpu(desc->ctrl), le32_to_cpu(desc->info));
+	idx = seqno % tid->size;
+	if (tid->reorder_buf[idx]) {
+		tid->dup++;
+		dev_kfree_skb_any(skb);
+		goto out;
+	}
 
-	/* Memory barrier before kicking DMA */
-	wmb();
+	cb->reorder_time = jiffies;
+	tid->reorder_buf[idx] = skb;
+	tid->nframes++;
+	mt7927_rx_tid_release_head(tid, frames);
 
-	/* Advance head */
-	dev->tx_ring_head = (idx + 1) % dev->tx_ring_size;
+	if (tid->nframes)
+		queue_delayed_work(system_wq, &tid->reorder_work,
+				   mt7927_rx_tid_timeout(tid->num));
 
-	/* Kick DMA - write CPU index to register */
-	mt7927_wr(dev, MT_TX_RING_BASE + 16 * MT_RING_SIZE + 0x08,
-		  dev->tx_ring_head);
+out:
+	spin_unlock_bh(&tid->lock);
+}
 
-	if (debug_regs)
-		dev_info(&dev->pdev->dev,
-			 "  TX queue: idx=%d, len=%d, dma=%pad, new_head=%d\n",
-			 idx, data_len, &data_dma, dev->tx_ring_head);
+static struct mt7927_rx_tid *mt7927_rx_tid_alloc(struct mt7927_dev *dev,
+						 u8 tidno, u16 ssn, u16 size)
+{
+	struct mt7927_rx_tid *tid;
 
-	return 0;
+	tid = kzalloc_node(struct_size(tid, reorder_buf, size), GFP_KERNEL,
+			   dev_to_node(&dev->pdev->dev));
+	if (!tid)
+		return NULL;
+
+	tid->dev = dev;
+	tid->num = tidno;
+	tid->head = ssn & MT7927_SEQ_MASK;
+	tid->size = size;
+	spin_lock_init(&tid->lock);
+	INIT_DELAYED_WORK(&tid->reorder_work, mt7927_rx_tid_work);
+
+	return tid;
 }
 
-/*
- * Wait for DMA ring to drain (all descriptors completed)
- */
-static int mt7927_dma_tx_wait(struct mt7927_dev *dev, int timeout_ms)
+/* Drop held frames and free @tid once RX readers are done with it */
+static void mt7927_rx_tid_free(struct mt7927_rx_tid *tid)
 {
-	u32 cpu_idx, dma_idx;
-	int i;
-
-	for (i = 0; i < timeout_ms; i++) {
-		cpu_idx = mt7927_rr(dev, MT_TX_RING_BASE + 16 * MT_RING_SIZE + 0x08);
-		dma_idx = mt7927_rr(dev, MT_TX_RING_BASE + 16 * MT_RING_SIZE + 0x0c);
+	u16 i;
 
-		if (cpu_idx == dma_idx)
-			return 0;
+	spin_lock_bh(&tid->lock);
+	tid->stopped = true;
+	for (i = 0; i < tid->size && tid->nframes; i++) {
+		if (!tid->reorder_buf[i])
+			continue;
 
-		usleep_range(1000, 2000);
+		dev_kfree_skb_any(tid->reorder_buf[i]);
+		tid->reorder_buf[i] = NULL;
+		tid->nframes--;
 	}
+	spin_unlock_bh(&tid->lock);
 
-	/* Dump additional state on timeout for debugging */
-	{
-		u32 glo_cfg = mt7927_rr(dev, MT_WFDMA0_GLO_CFG);
-		u32 int_sta = mt7927_rr(dev, MT_WFDMA0_HOST_INT_STA);
-		u32 int_ena = mt7927_rr(dev, MT_WFDMA0_HOST_INT_ENA);
-		u32 pcie_int = mt7927_rr(dev, MT_PCIE_MAC_INT_STATUS);
-		u32 misc = mt7927_rr_remap(dev, MT_CONN_ON_MISC);
-		u32 mcu_cmd = mt7927_rr(dev, MT_MCU_CMD);
-		u32 ring_base = mt7927_rr(dev, MT_TX_RING_BASE + 16 * MT_RING_SIZE);
-		u32 ring_cnt = mt7927_rr(dev, MT_TX_RING_BASE + 16 * MT_RING_SIZE + 0x04);
+	cancel_delayed_work_sync(&tid->reorder_work);
+	kfree_rcu(tid, rcu_head);
+}
 
-		dev_warn(&dev->pdev->dev,
-			 "  DMA wait timeout: cpu_idx=%d dma_idx=%d\n", cpu_idx, dma_idx);
-		dev_warn(&dev->pdev->dev,
-			 "  === v0.9.0 Diagnostic Dump ===\n");
-		dev_warn(&dev->pdev->dev,
-			 "  GLO_CFG=0x%08x (TX_EN=%d, RX_EN=%d, BUSY=%d)\n",
-			 glo_cfg,
-			 !!(glo_cfg & MT_WFDMA0_GLO_CFG_TX_DMA_EN),
-			 !!(glo_cfg & MT_WFDMA0_GLO_CFG_RX_DMA_EN),
-			 !!(glo_cfg & (MT_WFDMA0_GLO_CFG_TX_DMA_BUSY | MT_WFDMA0_GLO_CFG_RX_DMA_BUSY)));
-		dev_warn(&dev->pdev->dev,
-			 "  INT_ENA=0x%08x INT_STA=0x%08x PCIE_INT=0x%08x\n",
-			 int_ena, int_sta, pcie_int);
-		dev_warn(&dev->pdev->dev,
-			 "  MT_CONN_ON_MISC=0x%08x (ROM state) MT_MCU_CMD=0x%08x\n",
-			 misc, mcu_cmd);
-		dev_warn(&dev->pdev->dev,
-			 "  Ring16: BASE=0x%08x CNT=%d cpu_idx=%d dma_idx=%d\n",
-			 ring_base, ring_cnt, cpu_idx, dma_idx);
+/* =============================================================================
+ * DMA Ring Setup
+ * =============================================================================
+ */
 
-		/* Check descriptor state - use dma_idx to find last attempted desc */
-		if (dev->tx_ring && dma_idx < dev->tx_ring_size) {
-			struct mt76_desc *desc = &dev->tx_ring[dma_idx];
-			dev_warn(&dev->pdev->dev,
-				 "  Desc[%d]: buf0=0x%08x ctrl=0x%08x (DMA_DONE=%d)\n",
-				 dma_idx, le32_to_cpu(desc->buf0), le32_to_cpu(desc->ctrl),
-				 !!(le32_to_cpu(desc->ctrl) & MT_DMA_CTL_DMA_DONE));
-		}
+/* Release ring 15 buffers the hardware will never complete */
+static void mt7927_mcu_ring_drop(struct mt7927_dev *dev)
+{
+	if (!dev->mcu_ring)
+		return;
 
-		/*
-		 * v0.9.0: If dma_idx is still 0 and we have a valid ring BASE,
-		 * the ROM bootloader is NOT processing our rings. Possible causes:
-		 * 1. ROM not awake/in wrong state
-		 * 2. Missing interrupt/wake signal
-		 * 3. ROM waiting for specific handshake
-		 */
-		if (dma_idx == 0 && ring_base != 0) {
-			dev_warn(&dev->pdev->dev,
-				 "  >>> DMA_IDX stuck at 0 - ROM not processing rings!\n");
-			dev_warn(&dev->pdev->dev,
-				 "  >>> ROM may be waiting for handshake or wake signal.\n");
-		}
+	while (dev->mcu_ring_tail != dev->mcu_ring_head) {
+		mt7927_tx_unmap(dev, &dev->mcu_ring[dev->mcu_ring_tail]);
+		dev->mcu_ring_tail = (dev->mcu_ring_tail + 1) % dev->mcu_ring_size;
 	}
-	return -ETIMEDOUT;
 }
 
-/*
- * Send a firmware scatter chunk
- *
- * Each chunk is wrapped with an MCU TXD header and sent via ring 16.
- * The TXD is 32 bytes (8 DWORDs), followed by the firmware data.
- */
-static int mt7927_mcu_send_fw_chunk(struct mt7927_dev *dev, const void *data,
-				    int len, u32 offset, bool last)
+/* Hand every RX descriptor back to hardware with its buffer (v0.8.0 FIXED) */
+static void mt7927_rx_ring_fill(struct mt7927_dev *dev)
 {
-	struct mt7927_mcu_txd *txd;
-	int total_len;
-	int ret;
+	int i;
 
-	/* Total packet = TXD (32 bytes) + data */
-	total_len = sizeof(struct mt7927_mcu_txd) + len;
+	memset(dev->rx_ring, 0, dev->rx_ring_size * sizeof(struct mt76_desc));
+	dev->rx_ring_head = 0;
 
-	/* Check if MCU buffer is large enough */
-	if (total_len > MT7927_FW_CHUNK_SIZE + sizeof(struct mt7927_mcu_txd)) {
-		dev_err(&dev->pdev->dev, "  FW chunk too large: %d\n", total_len);
-		return -EINVAL;
+	for (i = 0; i < dev->rx_ring_size; i++) {
+		dma_addr_t buf_dma = dev->rx_buf_dma + i * MT7927_RX_BUF_SIZE;
+		u32 info = mt7927_desc_set_buf(dev, &dev->rx_ring[i], buf_dma, 0);
+
+		/* Control: buffer length in bits [29:16] */
+		dev->rx_ring[i].ctrl = cpu_to_le32(
+			FIELD_PREP(MT_DMA_CTL_SD_LEN0, MT7927_RX_BUF_SIZE));
+		dev->rx_ring[i].info = cpu_to_le32(info);
 	}
+}
 
-	/* Build TXD in MCU buffer */
+static int mt7927_dma_init(struct mt7927_dev *dev)
+{
+	int ret;
+	u32 val;
+
+	dev_info(&dev->pdev->dev, "=== DMA Initialization ===\n");
+
+	/* First disable DMA with force reset */
+	ret = mt7927_dma_disable(dev, true);
+	if (ret)
+		return ret;
+
+	/*
+	 * CRITICAL: Disable clock gating IMMEDIATELY after dma_disable!
+	 * The LOGIC_RST in dma_disable() resets WFDMA to defaults, which has
+	 * clock gating ENABLED. We must disable it BEFORE any ring register
+	 * access (including prefetch config).
+	 *
+	 * Without this, ALL ring registers (EXT_CTRL, BASE, CNT) will be
+	 * inaccessible and writes will silently fail (read back as old value).
+	 */
+	dev_info(&dev->pdev->dev, "  Disabling clock gating after DMA reset...\n");
+	val = mt7927_rr(dev, MT_WFDMA0_GLO_CFG);
+	dev_info(&dev->pdev->dev, "  GLO_CFG after reset: 0x%08x\n", val);
+	mt7927_set(dev, MT_WFDMA0_GLO_CFG, MT_WFDMA0_GLO_CFG_CLK_GAT_DIS);
+	val = mt7927_rr(dev, MT_WFDMA0_GLO_CFG);
+	dev_info(&dev->pdev->dev, "  GLO_CFG after CLK_GAT_DIS: 0x%08x\n", val);
+
+	/*
+	 * v0.4.2: The kernel driver sets additional config flags BEFORE prefetch.
+	 * Specifically CSR_DISP_BASE_PTR_CHAIN_EN which enables ring chaining.
+	 * This might be required for ring registers to be writable.
+	 */
+	dev_info(&dev->pdev->dev, "  Setting CSR_DISP_BASE_PTR_CHAIN_EN before prefetch...\n");
+	mt7927_set(dev, MT_WFDMA0_GLO_CFG, MT_WFDMA0_GLO_CFG_CSR_DISP_BASE_PTR_CHAIN_EN);
+	val = mt7927_rr(dev, MT_WFDMA0_GLO_CFG);
+	dev_info(&dev->pdev->dev, "  GLO_CFG after CHAIN_EN: 0x%08x\n", val);
+
+	/*
+	 * Now configure DMA prefetch registers.
+	 * This must happen BEFORE we try to write to ring BASE/CNT registers.
+	 */
+	mt7927_dma_prefetch(dev);
+
+	/*
+	 * Allocate TX descriptor ring. Rings survive suspend, so when the
+	 * full bring-up is re-run after resume the existing ones are reused.
+	 */
+	dev->tx_ring_size = MT7927_TX_FWDL_RING_SIZE;
+	if (!dev->tx_ring) {
+		dev->tx_ring = dma_alloc_coherent(&dev->pdev->dev,
+						  dev->tx_ring_size * sizeof(struct mt76_desc),
+						  &dev->tx_ring_dma,
+						  GFP_KERNEL);
+		if (!dev->tx_ring) {
+			dev_err(&dev->pdev->dev, "  Failed to allocate TX ring\n");
+			return -ENOMEM;
+		}
+	}
+
+	memset(dev->tx_ring, 0, dev->tx_ring_size * sizeof(struct mt76_desc));
+
+	dev_info(&dev->pdev->dev, "  TX ring allocated: %d descriptors at %pad\n",
+		 dev->tx_ring_size, &dev->tx_ring_dma);
+
+	/*
+	 * Configure FWDL ring (ring 16)
+	 * NOTE: Prefetch was already configured in mt7927_dma_prefetch() above.
+	 * Now the ring BASE/CNT registers should accept writes.
+	 *
+	 * CRITICAL: We must verify the BASE address is actually written!
+	 * If it reads back as 0, the DMA engine will try to fetch from
+	 * address 0x0, causing IOMMU page faults.
+	 */
+	dev_info(&dev->pdev->dev, "  Configuring FWDL ring (ring 16)...\n");
+	dev_info(&dev->pdev->dev, "  Ring DMA address: %pad\n",
+		 &dev->tx_ring_dma);
+
+	/* Write BASE register */
+	mt7927_wr_debug(dev, MT_TX_RING_BASE + 16 * MT_RING_SIZE,
+			lower_32_bits(dev->tx_ring_dma), "RING16_BASE");
+
+	/* Verify the BASE register accepted our write */
+	{
+		u32 base_readback = mt7927_rr(dev, MT_TX_RING_BASE + 16 * MT_RING_SIZE);
+		if (base_readback != lower_32_bits(dev->tx_ring_dma)) {
+			dev_err(&dev->pdev->dev,
+				"  CRITICAL: Ring BASE not writable! Wrote 0x%08x, read 0x%08x\n",
+				lower_32_bits(dev->tx_ring_dma), base_readback);
+			dev_err(&dev->pdev->dev,
+				"  DMA will fail - device will try to fetch from address 0x%08x!\n",
+				base_readback);
+
+			/*
+			 * Try an alternative approach: maybe we need to disable DMA first
+			 * before writing ring registers, then re-enable.
+			 */
+			dev_info(&dev->pdev->dev, "  Trying workaround: disable DMA, write, re-enable...\n");
+			mt7927_clear(dev, MT_WFDMA0_GLO_CFG,
+				     MT_WFDMA0_GLO_CFG_TX_DMA_EN | MT_WFDMA0_GLO_CFG_RX_DMA_EN);
+			udelay(100);
+
+			/* Try writing again */
+			mt7927_wr(dev, MT_TX_RING_BASE + 16 * MT_RING_SIZE,
+				  lower_32_bits(dev->tx_ring_dma));
+			base_readback = mt7927_rr(dev, MT_TX_RING_BASE + 16 * MT_RING_SIZE);
+			dev_info(&dev->pdev->dev, "  After workaround: BASE = 0x%08x\n",
+				 base_readback);
+		}
+	}
+
+	mt7927_wr_debug(dev, MT_TX_RING_BASE + 16 * MT_RING_SIZE + MT_RING_CNT,
+			dev->tx_ring_size, "RING16_CNT");
+	mt7927_wr_debug(dev, MT_TX_RING_BASE + 16 * MT_RING_SIZE + MT_RING_CIDX,
+			0, "RING16_CIDX");
+	mt7927_wr_debug(dev, MT_TX_RING_BASE + 16 * MT_RING_SIZE + MT_RING_DIDX,
+			0, "RING16_DIDX");
+
+	/*
+	 * v0.5.0: Also configure Ring 15 (MCU commands) and RX Ring 0 (MCU events)
+	 * These are REQUIRED for the ROM bootloader to process MCU commands
+	 * like PATCH_SEM_CONTROL and TARGET_ADDRESS_LEN_REQ.
+	 *
+	 * Without these, the ROM bootloader ignores FW_SCATTER data on Ring 16!
+	 */
+
+	/* Allocate MCU command ring (TX Ring 15) */
+	mt7927_mcu_ring_drop(dev);
+	dev->mcu_ring_size = MT7927_TX_MCU_RING_SIZE;
+	if (!dev->mcu_ring) {
+		dev->mcu_ring = dma_alloc_coherent(&dev->pdev->dev,
+						   dev->mcu_ring_size * sizeof(struct mt76_desc),
+						   &dev->mcu_ring_dma,
+						   GFP_KERNEL);
+		if (!dev->mcu_ring) {
+			dev_err(&dev->pdev->dev, "  Failed to allocate MCU command ring\n");
+			ret = -ENOMEM;
+			goto err_free_tx_ring;
+		}
+	}
+	memset(dev->mcu_ring, 0, dev->mcu_ring_size * sizeof(struct mt76_desc));
+	dev->mcu_ring_head = 0;
+	dev->mcu_ring_tail = 0;
+
+	dev_info(&dev->pdev->dev, "  MCU ring (Ring 15) allocated: %d descriptors at %pad\n",
+		 dev->mcu_ring_size, &dev->mcu_ring_dma);
+
+	/* Configure MCU command ring (ring 15) */
+	dev_info(&dev->pdev->dev, "  Configuring MCU ring (ring 15)...\n");
+	mt7927_wr_debug(dev, MT_TX_RING_BASE + 15 * MT_RING_SIZE,
+			lower_32_bits(dev->mcu_ring_dma), "RING15_BASE");
+	mt7927_wr_debug(dev, MT_TX_RING_BASE + 15 * MT_RING_SIZE + MT_RING_CNT,
+			dev->mcu_ring_size, "RING15_CNT");
+	mt7927_wr_debug(dev, MT_TX_RING_BASE + 15 * MT_RING_SIZE + MT_RING_CIDX,
+			0, "RING15_CIDX");
+	mt7927_wr_debug(dev, MT_TX_RING_BASE + 15 * MT_RING_SIZE + MT_RING_DIDX,
+			0, "RING15_DIDX");
+
+	/* Allocate RX ring (RX Ring 0) for MCU events/responses */
+	dev->rx_ring_size = MT7927_RX_MCU_RING_SIZE;
+	if (!dev->rx_ring) {
+		dev->rx_ring = dma_alloc_coherent(&dev->pdev->dev,
+						  dev->rx_ring_size * sizeof(struct mt76_desc),
+						  &dev->rx_ring_dma,
+						  GFP_KERNEL);
+		if (!dev->rx_ring) {
+			dev_err(&dev->pdev->dev, "  Failed to allocate RX ring\n");
+			ret = -ENOMEM;
+			goto err_free_mcu_ring;
+		}
+	}
+
+	/* Allocate RX buffer pool */
+	if (!dev->rx_buf) {
+		dev->rx_buf = dma_alloc_coherent(&dev->pdev->dev,
+						 dev->rx_ring_size * MT7927_RX_BUF_SIZE,
+						 &dev->rx_buf_dma,
+						 GFP_KERNEL);
+		if (!dev->rx_buf) {
+			dev_err(&dev->pdev->dev, "  Failed to allocate RX buffers\n");
+			ret = -ENOMEM;
+			goto err_free_rx_ring;
+		}
+	}
+
+	mt7927_rx_ring_fill(dev);
+
+	dev_info(&dev->pdev->dev, "  RX ring (Ring 0) allocated: %d descriptors at %pad\n",
+		 dev->rx_ring_size, &dev->rx_ring_dma);
+
+	/* Configure RX ring (ring 0) */
+	dev_info(&dev->pdev->dev, "  Configuring RX ring (ring 0)...\n");
+	mt7927_wr_debug(dev, MT_RX_RING_BASE + 0 * MT_RING_SIZE,
+			lower_32_bits(dev->rx_ring_dma), "RX_RING0_BASE");
+	mt7927_wr_debug(dev, MT_RX_RING_BASE + 0 * MT_RING_SIZE + MT_RING_CNT,
+			dev->rx_ring_size, "RX_RING0_CNT");
+	mt7927_wr_debug(dev, MT_RX_RING_BASE + 0 * MT_RING_SIZE + MT_RING_CIDX,
+			0, "RX_RING0_CIDX");
+	mt7927_wr_debug(dev, MT_RX_RING_BASE + 0 * MT_RING_SIZE + MT_RING_DIDX,
+			0, "RX_RING0_DIDX");
+
+	/* Kick RX ring - set CPU index to ring size to indicate all buffers available */
+	trace_mt7927_doorbell(dev, true, 0, dev->rx_ring_size - 1);
+	mt7927_wr(dev, MT_RX_RING_BASE + 0 * MT_RING_SIZE + MT_RING_CIDX,
+		  dev->rx_ring_size - 1);
+
+	/* Enable DMA */
+	ret = mt7927_dma_enable(dev);
+	if (ret)
+		goto err_free_rx_buf;
+
+	return 0;
+
+err_free_rx_buf:
+	dma_free_coherent(&dev->pdev->dev,
+			  dev->rx_ring_size * MT7927_RX_BUF_SIZE,
+			  dev->rx_buf, dev->rx_buf_dma);
+	dev->rx_buf = NULL;
+err_free_rx_ring:
+	dma_free_coherent(&dev->pdev->dev,
+			  dev->rx_ring_size * sizeof(struct mt76_desc),
+			  dev->rx_ring, dev->rx_ring_dma);
+	dev->rx_ring = NULL;
+err_free_mcu_ring:
+	dma_free_coherent(&dev->pdev->dev,
+			  dev->mcu_ring_size * sizeof(struct mt76_desc),
+			  dev->mcu_ring, dev->mcu_ring_dma);
+	dev->mcu_ring = NULL;
+err_free_tx_ring:
+	dma_free_coherent(&dev->pdev->dev,
+			  dev->tx_ring_size * sizeof(struct mt76_desc),
+			  dev->tx_ring, dev->tx_ring_dma);
+	dev->tx_ring = NULL;
+	return ret;
+}
+
+/* Program one ring's BASE/CNT and reset both indices */
+static void __mt7927_ring_hw_setup(struct mt7927_dev *dev, u32 base,
+				   dma_addr_t dma, int size)
+{
+	__mt7927_wr(dev, base, lower_32_bits(dma));
+	__mt7927_wr(dev, base + MT_RING_CNT, size);
+	__mt7927_wr(dev, base + MT_RING_CIDX, 0);
+	__mt7927_wr(dev, base + MT_RING_DIDX, 0);
+}
+
+#define mt7927_ring_hw_setup(dev, base, dma, size)			\
+	__mt7927_ring_hw_setup(dev, MT7927_REG((base) + MT_RING_DIDX) -	\
+			       MT_RING_DIDX, dma, size)
+
+/*
+ * mt7927_dma_resume - Re-program rings that were kept across suspend
+ *
+ * Descriptor rings, RX buffers and the MCU buffer stay allocated while
+ * suspended; only the WFDMA side (prefetch, ring BASE/CNT, indices) has
+ * to be written again. Unlike mt7927_dma_init() there is no LOGIC_RST
+ * and nothing is allocated, and the ring registers are written without
+ * the per-register logging.
+ */
+static int mt7927_dma_resume(struct mt7927_dev *dev)
+{
+	u32 base;
+
+	/* Ring 16 is gone once firmware was up, see mt7927_fwdl_release() */
+	if (!dev->mcu_ring || !dev->rx_ring || !dev->rx_buf)
+		return -ENODEV;
+
+	/* Same ordering as dma_init(): clock gating off, prefetch, rings */
+	mt7927_set(dev, MT_WFDMA0_GLO_CFG,
+		   MT_WFDMA0_GLO_CFG_CLK_GAT_DIS |
+		   MT_WFDMA0_GLO_CFG_CSR_DISP_BASE_PTR_CHAIN_EN);
+	mt7927_dma_prefetch(dev);
+
+	if (dev->tx_ring)
+		mt7927_ring_hw_setup(dev, MT_TX_RING_BASE + 16 * MT_RING_SIZE,
+				     dev->tx_ring_dma, dev->tx_ring_size);
+	mt7927_ring_hw_setup(dev, MT_TX_RING_BASE + 15 * MT_RING_SIZE,
+			     dev->mcu_ring_dma, dev->mcu_ring_size);
+	mt7927_ring_hw_setup(dev, MT_RX_RING_BASE + 0 * MT_RING_SIZE,
+			     dev->rx_ring_dma, dev->rx_ring_size);
+
+	/* A BASE that did not stick means DMA would fetch from 0 */
+	base = mt7927_rr(dev, MT_TX_RING_BASE + 15 * MT_RING_SIZE);
+	if (base != lower_32_bits(dev->mcu_ring_dma)) {
+		dev_err(&dev->pdev->dev, "  Ring 15 BASE lost on resume (0x%08x)\n",
+			base);
+		return -EIO;
+	}
+
+	mt7927_mcu_ring_drop(dev);
+	dev->tx_ring_head = 0;
+	dev->tx_ring_tail = 0;
+	dev->mcu_ring_head = 0;
+	dev->mcu_ring_tail = 0;
+	mt7927_rx_ring_fill(dev);
+
+	trace_mt7927_doorbell(dev, true, 0, dev->rx_ring_size - 1);
+	mt7927_wr(dev, MT_RX_RING_BASE + 0 * MT_RING_SIZE + MT_RING_CIDX,
+		  dev->rx_ring_size - 1);
+
+	return mt7927_dma_enable(dev);
+}
+
+static void mt7927_dma_cleanup(struct mt7927_dev *dev)
+{
+	mt7927_dma_disable(dev, false);
+
+	mt7927_mcu_ring_drop(dev);
+	mt7927_token_drain(dev);
+	mt7927_tx_arena_free(dev);
+	kfree(dev->mcu_msg);
+	dev->mcu_msg = NULL;
+
+	if (dev->mcu_buf) {
+		dma_free_coherent(&dev->pdev->dev, MT7927_FW_CHUNK_SIZE + 256,
+				  dev->mcu_buf, dev->mcu_dma);
+		dev->mcu_buf = NULL;
+	}
+
+	if (dev->rx_buf) {
+		dma_free_coherent(&dev->pdev->dev,
+				  dev->rx_ring_size * MT7927_RX_BUF_SIZE,
+				  dev->rx_buf, dev->rx_buf_dma);
+		dev->rx_buf = NULL;
+	}
+
+	if (dev->rx_ring) {
+		dma_free_coherent(&dev->pdev->dev,
+				  dev->rx_ring_size * sizeof(struct mt76_desc),
+				  dev->rx_ring, dev->rx_ring_dma);
+		dev->rx_ring = NULL;
+	}
+
+	if (dev->mcu_ring) {
+		dma_free_coherent(&dev->pdev->dev,
+				  dev->mcu_ring_size * sizeof(struct mt76_desc),
+				  dev->mcu_ring, dev->mcu_ring_dma);
+		dev->mcu_ring = NULL;
+	}
+
+	if (dev->tx_ring) {
+		dma_free_coherent(&dev->pdev->dev,
+				  dev->tx_ring_size * sizeof(struct mt76_desc),
+				  dev->tx_ring, dev->tx_ring_dma);
+		dev->tx_ring = NULL;
+	}
+}
+
+/*
+ * Free what only firmware download needs
+ *
+ * Ring 16 and mcu_buf are idle once the patch is in, and together are
+ * the largest DMA allocation after the RX pool. A later download (chip
+ * reset, resume after power loss) allocates them again: mt7927_dma_init()
+ * and mt7927_load_firmware() only allocate what is missing.
+ */
+static void mt7927_fwdl_release(struct mt7927_dev *dev)
+{
+	size_t bytes = 0;
+
+	mutex_lock(&dev->dma_mutex);
+
+	if (dev->tx_ring) {
+		/* Hardware must not keep a BASE pointing at freed memory */
+		mt7927_ring_hw_setup(dev, MT_TX_RING_BASE + 16 * MT_RING_SIZE, 0, 0);
+		bytes += dev->tx_ring_size * sizeof(struct mt76_desc);
+		dma_free_coherent(&dev->pdev->dev,
+				  dev->tx_ring_size * sizeof(struct mt76_desc),
+				  dev->tx_ring, dev->tx_ring_dma);
+		dev->tx_ring = NULL;
+		dev->tx_ring_dma = 0;
+		dev->tx_ring_head = 0;
+		dev->tx_ring_tail = 0;
+	}
+
+	if (dev->mcu_buf) {
+		bytes += MT7927_FW_CHUNK_SIZE + 256;
+		dma_free_coherent(&dev->pdev->dev, MT7927_FW_CHUNK_SIZE + 256,
+				  dev->mcu_buf, dev->mcu_dma);
+		dev->mcu_buf = NULL;
+	}
+
+	mutex_unlock(&dev->dma_mutex);
+
+	if (bytes)
+		dev_info(&dev->pdev->dev, "  Released %zu bytes of firmware download buffers\n",
+			 bytes);
+}
+
+/* =============================================================================
+ * Firmware Loading via DMA Ring 16
+ * =============================================================================
+ */
+
+/*
+ * Build MCU TXD word 0 for firmware scatter
+ */
+static u32 mt7927_mcu_txd0_fw(u16 len)
+{
+	return FIELD_PREP(MT_TXD0_TX_BYTES, len) |
+	       FIELD_PREP(MT_TXD0_PKT_FMT, MT_TX_TYPE_FW) |
+	       FIELD_PREP(MT_TXD0_Q_IDX, MT_TX_MCU_PORT_RX_FWDL);
+}
+
+/*
+ * Get next MCU sequence number (1-15, wraps)
+ */
+static u8 mt7927_mcu_next_seq(struct mt7927_dev *dev)
+{
+	dev->mcu_seq = (dev->mcu_seq + 1) & 0xf;
+	if (dev->mcu_seq == 0)
+		dev->mcu_seq = 1;
+	return dev->mcu_seq;
+}
+
+/*
+ * Build MCU TXD word 0 for MCU commands (via Ring 15)
+ */
+static u32 mt7927_mcu_txd0_cmd(u16 len)
+{
+	return FIELD_PREP(MT_TXD0_TX_BYTES, len) |
+	       FIELD_PREP(MT_TXD0_PKT_FMT, MT_TX_TYPE_CMD) |
+	       FIELD_PREP(MT_TXD0_Q_IDX, MT_TX_MCU_PORT_RX_Q0);
+}
+
+/*
+ * Queue an MCU command to Ring 15 (MCU WM queue)
+ */
+/* Start watching the TX rings, no-op if already armed */
+static inline void mt7927_wd_arm(struct mt7927_dev *dev)
+{
+	queue_delayed_work(system_wq, &dev->wd.work,
+			   msecs_to_jiffies(MT7927_WD_INTERVAL_MS));
+}
+
+static noinline int mt7927_dma_tx_queue_mcu(struct mt7927_dev *dev,
+					    dma_addr_t data_dma, int data_len)
+{
+	struct mt76_desc *desc;
+	u32 ctrl;
+	int idx;
+
+	idx = dev->mcu_ring_head;
+	desc = &dev->mcu_ring[idx];
+
+	/*
+	 * Fill descriptor (v0.8.0 FIXED):
+	 * Using correct bit positions for ctrl field.
+	 */
+	desc->info = cpu_to_le32(mt7927_desc_set_buf(dev, desc, data_dma, 0));
+
+	/* Control: length in [29:16], last segment at bit 30 */
+	ctrl = FIELD_PREP(MT_DMA_CTL_SD_LEN0, data_len) |
+	       MT_DMA_CTL_LAST_SEC0;
+	desc->ctrl = cpu_to_le32(ctrl);
+
+	mt7927_trace(dev, MT7927_TRACE_DESC_MCU, idx, NULL,
+		     le32_to_cpu(desc->buf0), ctrl, data_len);
+	trace_mt7927_desc_enqueue(dev, 15, idx, data_len);
+
+	/* Memory barrier before kicking DMA */
+	wmb();
+
+	/* Advance head */
+	dev->mcu_ring_head = (idx + 1) % dev->mcu_ring_size;
+
+	/* Kick DMA - write CPU index to Ring 15 */
+	trace_mt7927_doorbell(dev, false, 15, dev->mcu_ring_head);
+	mt7927_wr(dev, MT_TX_RING_BASE + 15 * MT_RING_SIZE + MT_RING_CIDX,
+		  dev->mcu_ring_head);
+	mt7927_wd_arm(dev);
+
+	return 0;
+}
+
+/*
+ * Retire TX descriptors up to the hardware DMA index
+ *
+ * Ring 15 buffers go back to the TX arena (or are unmapped); ring 16
+ * reuses mcu_buf, so there only the tail is kept in step for tracing.
+ */
+static void mt7927_tx_complete(struct mt7927_dev *dev, u8 ring,
+			       const struct mt76_desc *descs, int size,
+			       int *tail, u32 dma_idx)
+{
+	if (dma_idx >= size)
+		return;
+
+	while (*tail != dma_idx) {
+		trace_mt7927_desc_complete(dev, ring, *tail,
+					   FIELD_GET(MT_DMA_CTL_SD_LEN0,
+						     le32_to_cpu(descs[*tail].ctrl)));
+		if (ring == 15)
+			mt7927_tx_unmap(dev, &descs[*tail]);
+		*tail = (*tail + 1) % size;
+	}
+}
+
+/* =============================================================================
+ * DMA Hang Recovery
+ * =============================================================================
+ *
+ * A ring whose DIDX stops moving while CIDX is ahead of it, or that keeps
+ * DMA_BUSY set without progress, is reset on its own: RST_DTX_PTR and
+ * RST_DRX_PTR have one bit per ring, so the other rings and the firmware
+ * are left alone. For TX, descriptors the hardware had not consumed are
+ * moved to the start of the ring and posted again.
+ *
+ * Senders retry once after a timeout (see mt7927_mcu_ring_recover()); the
+ * watchdog covers rings nobody is waiting on. A wedged queue then costs a
+ * few milliseconds instead of a PCI remove/rescan.
+ */
+
+static void mt7927_wd_account(struct mt7927_dev *dev, struct mt7927_ring_wd *rwd,
+			      ktime_t start)
+{
+	u64 us = ktime_us_delta(ktime_get(), start);
+
+	rwd->recover_cnt++;
+	rwd->stall = 0;
+	rwd->didx = 0;
+	dev->wd.last_recover_us = us;
+	dev->wd.max_recover_us = max(dev->wd.max_recover_us, us);
+}
+
+/*
+ * Reset one TX ring and re-post what it had not consumed
+ *
+ * Returns 0 if descriptors were re-posted, -ENODATA if the ring turned
+ * out to be idle (nothing to retry).
+ */
+static int mt7927_tx_ring_recover(struct mt7927_dev *dev, u8 ring,
+				  struct mt76_desc *descs, int size,
+				  int *head, int *tail,
+				  struct mt7927_ring_wd *rwd)
+{
+	u32 base = MT_TX_RING_BASE + ring * MT_RING_SIZE;
+	struct mt76_desc *tmp;
+	ktime_t start = ktime_get();
+	int pending, i;
+	u32 didx;
+
+	if (!descs)
+		return -ENODEV;
+
+	didx = mt7927_rr_checked(dev, base + MT_RING_DIDX);
+
+	/* Whatever the hardware did get through is complete */
+	mt7927_tx_complete(dev, ring, descs, size, tail, didx);
+	pending = (*head - *tail + size) % size;
+	if (!pending)
+		return -ENODATA;
+
+	tmp = kmalloc_array(pending, sizeof(*tmp), GFP_KERNEL);
+	if (!tmp)
+		return -ENOMEM;
+
+	for (i = 0; i < pending; i++) {
+		tmp[i] = descs[(*tail + i) % size];
+		tmp[i].ctrl &= ~cpu_to_le32(MT_DMA_CTL_DMA_DONE);
+	}
+
+	memset(descs, 0, size * sizeof(*descs));
+	memcpy(descs, tmp, pending * sizeof(*tmp));
+	kfree(tmp);
+	wmb();
+
+	mt7927_wr(dev, MT_WFDMA0_RST_DTX_PTR, BIT(ring));
+
+	*tail = 0;
+	*head = pending;
+	trace_mt7927_ring_reset(dev, false, ring, didx, pending);
+	trace_mt7927_doorbell(dev, false, ring, pending);
+	mt7927_wr_checked(dev, base + MT_RING_CIDX, pending);
+
+	mt7927_wd_account(dev, rwd, start);
+	dev_warn(&dev->pdev->dev, "  TX ring %u hung at DIDX %u, reset and re-posted %d\n",
+		 ring, didx, pending);
+	return 0;
+}
+
+static int mt7927_mcu_ring_recover(struct mt7927_dev *dev)
+{
+	return mt7927_tx_ring_recover(dev, 15, dev->mcu_ring,
+				      dev->mcu_ring_size, &dev->mcu_ring_head,
+				      &dev->mcu_ring_tail, &dev->wd.tx_mcu);
+}
+
+static int mt7927_fwdl_ring_recover(struct mt7927_dev *dev)
+{
+	return mt7927_tx_ring_recover(dev, 16, dev->tx_ring,
+				      dev->tx_ring_size, &dev->tx_ring_head,
+				      &dev->tx_ring_tail, &dev->wd.tx_fwdl);
+}
+
+/* RX ring 0: events in flight are lost, every buffer goes back to hardware */
+static void mt7927_rx_ring_recover(struct mt7927_dev *dev)
+{
+	ktime_t start = ktime_get();
+	u32 didx = mt7927_rr(dev, MT_RX_RING_BASE + 0 * MT_RING_SIZE +
+				  MT_RING_DIDX);
+
+	mt7927_rx_ring_fill(dev);
+	wmb();
+
+	mt7927_wr(dev, MT_WFDMA0_RST_DRX_PTR, BIT(0));
+
+	trace_mt7927_ring_reset(dev, true, 0, didx, 0);
+	trace_mt7927_doorbell(dev, true, 0, dev->rx_ring_size - 1);
+	mt7927_wr(dev, MT_RX_RING_BASE + 0 * MT_RING_SIZE + MT_RING_CIDX,
+		  dev->rx_ring_size - 1);
+
+	mt7927_wd_account(dev, &dev->wd.rx_mcu, start);
+	dev_warn(&dev->pdev->dev, "  RX ring 0 hung at DIDX %u, reset\n", didx);
+}
+
+/* One watchdog sample of a TX ring, returns true while it has work */
+static bool mt7927_wd_check_tx(struct mt7927_dev *dev, u8 ring, bool busy,
+			       struct mt7927_ring_wd *rwd,
+			       int (*recover)(struct mt7927_dev *))
+{
+	u32 base = MT_TX_RING_BASE + ring * MT_RING_SIZE;
+	u32 cidx = mt7927_rr_checked(dev, base + MT_RING_CIDX);
+	u32 didx = mt7927_rr_checked(dev, base + MT_RING_DIDX);
+
+	if (cidx == didx) {
+		rwd->stall = 0;
+		return false;
+	}
+
+	/* Progress, or DMA still reported busy on the first samples */
+	if (didx != rwd->didx || (busy && !rwd->stall)) {
+		rwd->didx = didx;
+		rwd->stall = 0;
+		return true;
+	}
+
+	if (++rwd->stall >= MT7927_WD_STALL_CHECKS)
+		recover(dev);
+
+	return true;
+}
+
+static void mt7927_wd_work(struct work_struct *work)
+{
+	struct mt7927_dev *dev = container_of(to_delayed_work(work),
+					      struct mt7927_dev, wd.work);
+	struct mt7927_ring_wd *rx = &dev->wd.rx_mcu;
+	bool pending = false;
+	u32 glo, didx, cmd;
+
+	/* Chip recovery rebuilds every ring anyway */
+	if (mt7927_aborted(dev) ||
+	    test_bit(MT7927_STATE_RESETTING, &dev->state))
+		return;
+
+	/* A sender is active and handles its own timeouts */
+	if (!mutex_trylock(&dev->dma_mutex)) {
+		mt7927_wd_arm(dev);
+		return;
+	}
+
+	/* Firmware owns the chip, registers are not reliable */
+	if (dev->pm.fw_own || !dev->mcu_ring || !dev->rx_ring)
+		goto out;
+
+	/* Firmware asserted and asks the host to stop DMA: ring resets won't help */
+	cmd = mt7927_rr(dev, MT_MCU_CMD);
+	if (cmd & MT7927_MCU_CMD_ASSERT) {
+		mt7927_wr(dev, MT_MCU_CMD, cmd);	/* W1C */
+		mt7927_reset_schedule(dev, "firmware assert", cmd);
+		goto out;
+	}
+
+	glo = mt7927_rr(dev, MT_WFDMA0_GLO_CFG);
+
+	pending |= mt7927_wd_check_tx(dev, 15, glo & MT_WFDMA0_GLO_CFG_TX_DMA_BUSY,
+				      &dev->wd.tx_mcu, mt7927_mcu_ring_recover);
+	if (dev->tx_ring)
+		pending |= mt7927_wd_check_tx(dev, 16,
+					      glo & MT_WFDMA0_GLO_CFG_TX_DMA_BUSY,
+					      &dev->wd.tx_fwdl,
+					      mt7927_fwdl_ring_recover);
+
+	/* RX: busy with the DMA index not moving */
+	didx = mt7927_rr(dev, MT_RX_RING_BASE + 0 * MT_RING_SIZE +
+			      MT_RING_DIDX);
+	if ((glo & MT_WFDMA0_GLO_CFG_RX_DMA_BUSY) && didx == rx->didx) {
+		pending = true;
+		if (++rx->stall >= MT7927_WD_STALL_CHECKS)
+			mt7927_rx_ring_recover(dev);
+	} else {
+		rx->didx = didx;
+		rx->stall = 0;
+	}
+
+out:
+	mutex_unlock(&dev->dma_mutex);
+	if (pending)
+		mt7927_wd_arm(dev);
+}
+
+/*
+ * Wait for MCU command ring to drain
+ */
+static int mt7927_mcu_tx_wait(struct mt7927_dev *dev, int timeout_ms)
+{
+	u32 cpu_idx, dma_idx;
+	int i;
+
+	/* CIDX is what we last wrote, no need to read it back */
+	cpu_idx = dev->mcu_ring_head;
+
+	for (i = 0; i < timeout_ms; i++) {
+		dma_idx = mt7927_rr(dev, MT_TX_RING_BASE + 15 * MT_RING_SIZE +
+					 MT_RING_DIDX);
+
+		if (cpu_idx == dma_idx) {
+			mt7927_tx_complete(dev, 15, dev->mcu_ring,
+					   dev->mcu_ring_size,
+					   &dev->mcu_ring_tail, dma_idx);
+			return 0;
+		}
+
+		mt7927_usleep_range(dev, 1000, 2000);
+	}
+
+	dev_warn(&dev->pdev->dev,
+		 "  MCU DMA wait timeout: cpu_idx=%d dma_idx=%d\n", cpu_idx, dma_idx);
+	return -ETIMEDOUT;
+}
+
+/*
+ * Decode the RXD at @buf (@len bytes) into @ri in one pass: the four
+ * fixed words are read once, each optional group is visited once, in
+ * hardware order (4, 1, 2, 3, 5), and only the fields the RX path uses
+ * are kept. Returns -EINVAL if the RXD
+ * or its groups run past @len.
+ */
+static int mt7927_rxd_parse(const void *buf, int len,
+			    struct mt7927_rxd_info *ri)
+{
+	const __le32 *rxd = buf;
+	u32 rxd1, rxd2, rxd3, v;
+	int words;
+
+	if (len < MT7927_RXD_WORDS * sizeof(*rxd))
+		return -EINVAL;
+
+	rxd1 = le32_to_cpu(rxd[1]);
+	rxd2 = le32_to_cpu(rxd[2]);
+	rxd3 = le32_to_cpu(rxd[3]);
+
+	words = MT7927_RXD_WORDS +
+		(rxd1 & MT_RXD1_NORMAL_GROUP_4 ? 4 : 0) +
+		(rxd1 & MT_RXD1_NORMAL_GROUP_1 ? 4 : 0) +
+		(rxd1 & MT_RXD1_NORMAL_GROUP_2 ? 2 : 0) +
+		(rxd1 & MT_RXD1_NORMAL_GROUP_3 ? 4 : 0) +
+		(rxd1 & MT_RXD1_NORMAL_GROUP_5 ? 24 : 0);
+
+	ri->hdr_gap = words * sizeof(*rxd) +
+		      2 * FIELD_GET(MT_RXD2_NORMAL_HDR_OFFSET, rxd2);
+	if (ri->hdr_gap > len)
+		return -EINVAL;
+
+	ri->len = len - ri->hdr_gap;
+	ri->wcid = FIELD_GET(MT_RXD1_NORMAL_WLAN_IDX, rxd1);
+	ri->sec_mode = FIELD_GET(MT_RXD2_NORMAL_SEC_MODE, rxd2);
+	ri->flags = 0;
+
+	if (rxd2 & MT_RXD2_NORMAL_HDR_TRANS)
+		ri->flags |= MT7927_RXD_F_HDR_TRANS;
+	if (rxd2 & MT_RXD2_NORMAL_HDR_TRANS_ERROR)
+		ri->flags |= MT7927_RXD_F_HDR_TRANS_ERR;
+	if (rxd3 & MT_RXD3_NORMAL_FCS_ERR)
+		ri->flags |= MT7927_RXD_F_FCS_ERR;
+	/*
+	 * Checksum status comes from the RXD alone: the descriptor info
+	 * word carries SDP0_H, not status, in the bits mt7925 reads there.
+	 * A frame the MAC could not translate or that failed FCS is not
+	 * trusted either way.
+	 */
+	if ((rxd3 & (MT_RXD3_NORMAL_IP_SUM | MT_RXD3_NORMAL_UDP_TCP_SUM)) ==
+	    (MT_RXD3_NORMAL_IP_SUM | MT_RXD3_NORMAL_UDP_TCP_SUM) &&
+	    !(rxd3 & MT_RXD3_NORMAL_FCS_ERR) &&
+	    !(rxd2 & MT_RXD2_NORMAL_HDR_TRANS_ERROR))
+		ri->flags |= MT7927_RXD_F_CSUM_OK;
+
+	rxd += MT7927_RXD_WORDS;
+
+	if (rxd1 & MT_RXD1_NORMAL_GROUP_4) {
+		u16 fc = le32_get_bits(rxd[0], MT_RXD8_FRAME_CONTROL);
+
+		v = le32_to_cpu(rxd[2]);
+		if (ieee80211_is_data_qos(cpu_to_le16(fc))) {
+			ri->seqno = (FIELD_GET(MT_RXD10_SEQ_CTRL, v) &
+				     IEEE80211_SCTL_SEQ) >> 4;
+			ri->tid = FIELD_GET(MT_RXD10_QOS_CTL, v) &
+				  IEEE80211_QOS_CTL_TID_MASK;
+			if (ri->tid < MT7927_NUM_TIDS)
+				ri->flags |= MT7927_RXD_F_SEQ_VALID;
+		}
+		rxd += 4;
+	}
+
+	if (rxd1 & MT_RXD1_NORMAL_GROUP_1) {
+		if ((rxd1 & MT_RXD1_NORMAL_SEC_DONE) &&
+		    !(rxd1 & (MT_RXD1_NORMAL_CM | MT_RXD1_NORMAL_CLM)) &&
+		    ri->sec_mode) {
+			ri->pn = get_unaligned_le48(rxd);
+			ri->flags |= MT7927_RXD_F_PN_VALID;
+		}
+		rxd += 4;
+	}
+
+	if (rxd1 & MT_RXD1_NORMAL_GROUP_2)
+		rxd += 2;
+
+	if (rxd1 & MT_RXD1_NORMAL_GROUP_3) {
+		v = le32_to_cpu(rxd[0]);
+		ri->rate_idx = FIELD_GET(MT_PRXV_TX_RATE, v);
+		ri->nss = FIELD_GET(MT_PRXV_NSTS, v) + 1;
+
+		v = le32_to_cpu(rxd[2]);
+		ri->rate_mode = FIELD_GET(MT_PRXV_TX_MODE, v);
+		ri->bw = FIELD_GET(MT_PRXV_FRAME_MODE, v);
+		ri->gi = FIELD_GET(MT_PRXV_HT_SHORT_GI, v);
+
+		/* RCPI is 2 * (dBm + 110) */
+		v = le32_to_cpu(rxd[3]);
+		ri->rssi[0] = ((int)FIELD_GET(MT_PRXV_RCPI0, v) - 220) / 2;
+		ri->rssi[1] = ((int)FIELD_GET(MT_PRXV_RCPI1, v) - 220) / 2;
+		ri->flags |= MT7927_RXD_F_RATE_VALID;
+	}
+
+	return 0;
+}
+
+/* Link of @sta that WLAN index @wcid belongs to */
+static u8 mt7927_sta_link(const struct mt7927_sta *sta, u16 wcid)
+{
+	u8 l;
+
+	for (l = 1; l < MT7927_MAX_LINKS; l++)
+		if ((sta->link_mask & BIT(l)) && sta->link_wcid[l] == wcid)
+			return l;
+
+	return 0;
+}
+
+/*
+ * RX data frames. With hw_encap the MAC has already replaced the 802.11
+ * header (and LLC/SNAP) by an Ethernet header, so the payload after the
+ * RXD groups and header padding is a complete 802.3 frame, ready for
+ * eth_type_trans() and GRO. Untranslated 802.11 frames have no host path
+ * yet and are only counted.
+ *
+ * The sequence number, TID and PN from mt7927_rxd_parse() feed the
+ * block-ack reorder buffer of the sending station; for an MLD that is
+ * one buffer per TID whichever link the frame came in on, which merges
+ * the links back into one sequence. When the MAC verified
+ * both the IP and the TCP/UDP checksum the frame is marked
+ * CHECKSUM_UNNECESSARY, so the stack does not checksum it again.
+ */
+static void mt7927_rx_data(struct mt7927_dev *dev, const void *buf, int len)
+{
+	struct mt7927_rx_stats *st = &dev->rx_stats;
+	struct mt7927_rxd_info ri;
+	struct mt7927_rx_cb *cb;
+	struct sk_buff_head frames;
+	struct mt7927_sta *sta;
+	struct sk_buff *skb;
+	u8 l;
+
+	mt7927_rxd_rec_add(dev, buf, len);
+
+	if (mt7927_rxd_parse(buf, len, &ri)) {
+		st->bad_len++;
+		return;
+	}
+
+	if (ri.flags & MT7927_RXD_F_FCS_ERR) {
+		st->fcs_err++;
+		return;
+	}
+
+	if (ri.flags & MT7927_RXD_F_HDR_TRANS_ERR) {
+		st->hdr_trans_err++;
+		return;
+	}
+
+	if (!(ri.flags & MT7927_RXD_F_HDR_TRANS)) {
+		st->wlan++;
+		return;
+	}
+
+	if (ri.len < ETH_HLEN) {
+		st->bad_len++;
+		return;
+	}
+
+	skb = alloc_skb(NET_IP_ALIGN + ri.len, GFP_ATOMIC);
+	if (!skb) {
+		st->nomem++;
+		return;
+	}
+
+	skb_reserve(skb, NET_IP_ALIGN);
+	skb_put_data(skb, buf + ri.hdr_gap, ri.len);
+
+	if (ri.flags & MT7927_RXD_F_CSUM_OK) {
+		skb->ip_summed = CHECKSUM_UNNECESSARY;
+		st->csum_ok++;
+	}
+
+	cb = mt7927_rx_cb(skb);
+	memset(cb, 0, sizeof(*cb));
+	if (ri.flags & MT7927_RXD_F_SEQ_VALID) {
+		cb->seqno = ri.seqno;
+		cb->tid = ri.tid;
+		cb->seq_valid = true;
+	}
+	if (ri.flags & MT7927_RXD_F_PN_VALID) {
+		cb->pn = ri.pn;
+		cb->pn_valid = true;
+	}
+
+	st->eth++;
+	st->eth_bytes += skb->len;
+
+	__skb_queue_head_init(&frames);
+
+	rcu_read_lock();
+	sta = ri.wcid < MT7927_WTBL_SIZE ? rcu_dereference(dev->sta[ri.wcid]) :
+					   NULL;
+	if (sta) {
+		/* MLD level from here: all links share the reorder buffer */
+		l = mt7927_sta_link(sta, ri.wcid);
+		dev->link[l].rx_msdus++;
+		dev->link[l].rx_bytes += skb->len;
+		if (ri.flags & MT7927_RXD_F_RATE_VALID) {
+			sta->rx_rate[l].mode = ri.rate_mode;
+			sta->rx_rate[l].mcs = ri.rate_idx;
+			sta->rx_rate[l].nss = ri.nss;
+			sta->rx_rate[l].bw = ri.bw;
+			sta->rx_rate[l].gi = ri.gi;
+		}
+	}
+	mt7927_rx_reorder(sta, skb, &frames);
+	rcu_read_unlock();
+
+	mt7927_rx_deliver(dev, &frames);
+}
+
+/*
+ * TX status entries. Only those asked for by mt7927_txs_request() are
+ * used: they carry the rate, NSS and bandwidth of the last transmission
+ * attempt, which is what the firmware rate control settled on. TXS has
+ * no GI field, so the station keeps the last GI seen.
+ */
+static void mt7927_txs_event(struct mt7927_dev *dev, const void *buf, int len)
+{
+	const __le32 *txs = buf;
+	const __le32 *end = buf + len;
+	struct mt7927_rate *r;
+	struct mt7927_sta *sta;
+	u32 rate;
+	u16 wcid;
+
+	rcu_read_lock();
+	for (txs += 4; txs + MT7927_TXS_WORDS <= end; txs += MT7927_TXS_WORDS) {
+		if (le32_get_bits(txs[3], MT_TXS3_PID) != MT7927_PID_RATE)
+			continue;
+
+		wcid = le32_get_bits(txs[2], MT_TXS2_WCID);
+		sta = wcid < MT7927_WTBL_SIZE ? rcu_dereference(dev->sta[wcid]) :
+						NULL;
+		if (!sta)
+			continue;
+
+		r = &sta->tx_rate[mt7927_sta_link(sta, wcid)];
+		rate = le32_get_bits(txs[0], MT_TXS0_TX_RATE);
+		r->mode = FIELD_GET(MT_TX_RATE_MODE, rate);
+		r->mcs = FIELD_GET(MT_TX_RATE_IDX, rate);
+		r->nss = FIELD_GET(MT_TX_RATE_NSS, rate) + 1;
+		r->bw = le32_get_bits(txs[0], MT_TXS0_BW);
+		dev->txs_cnt++;
+	}
+	rcu_read_unlock();
+}
+
+/*
+ * Handle RX ring 0 buffers that are not MCU responses. Returns true if
+ * @buf was consumed here.
+ */
+static bool mt7927_rx_event(struct mt7927_dev *dev, const void *buf, int len)
+{
+	const __le32 *rxd = buf;
+
+	if (len < sizeof(*rxd))
+		return false;
+
+	switch (le32_get_bits(rxd[0], MT_RXD0_PKT_TYPE)) {
+	case PKT_TYPE_NORMAL:
+		mt7927_rx_data(dev, buf,
+			       min_t(int, len,
+				     le32_get_bits(rxd[0], MT_RXD0_LENGTH)));
+		return true;
+	case PKT_TYPE_TXRX_NOTIFY:
+		mt7927_tx_free_event(dev, buf,
+				     min_t(int, len,
+					   le32_get_bits(rxd[0], MT_RXD0_LENGTH)));
+		return true;
+	case PKT_TYPE_TXS:
+		/*
+		 * Type 0 is also what a bare ROM-stage response looks like.
+		 * The pending command's own response never gets here (see
+		 * mt7927_rx_poll()), and only the RAM firmware reports TX
+		 * status.
+		 */
+		if (!test_bit(MT7927_STATE_FW_RUNNING, &dev->state))
+			return false;
+		mt7927_txs_event(dev, buf,
+				 min_t(int, len,
+				       le32_get_bits(rxd[0], MT_RXD0_LENGTH)));
+		return true;
+	default:
+		return false;
+	}
+}
+
+/*
+ * Give RX descriptor @idx back to hardware and move on to the next one.
+ * The buffer words are written again too, as mt7927_rx_ring_fill() did:
+ * completion may have overwritten info, which holds SDP0_H.
+ */
+static void mt7927_rx_recycle(struct mt7927_dev *dev, int idx)
+{
+	struct mt76_desc *desc = &dev->rx_ring[idx];
+	u32 info;
+
+	info = mt7927_desc_set_buf(dev, desc,
+				   dev->rx_buf_dma + idx * MT7927_RX_BUF_SIZE, 0);
+	desc->info = cpu_to_le32(info);
+	desc->ctrl =
+		cpu_to_le32(FIELD_PREP(MT_DMA_CTL_SD_LEN0, MT7927_RX_BUF_SIZE));
+	wmb();
+
+	/* CIDX names the last descriptor handed back */
+	trace_mt7927_doorbell(dev, true, 0, idx);
+	mt7927_wr(dev, MT_RX_RING_BASE + 0 * MT_RING_SIZE + MT_RING_CIDX, idx);
+	dev->rx_ring_head = (idx + 1) % dev->rx_ring_size;
+}
+
+/* Is @buf the response to the command with @seq, answered with @eid? */
+static bool mt7927_mcu_resp_match(const void *buf, int len, u8 eid, u8 seq)
+{
+	const struct mt7927_mcu_rxd *rxd = buf;
+
+	return len >= sizeof(*rxd) && rxd->seq == seq && rxd->eid == eid;
+}
+
+/*
+ * Handle completed RX ring 0 buffers in order, up to the response with
+ * @seq and event ID @eid. Returns the response's index, left for the
+ * caller to recycle, or -ENODATA once the ring is empty; with @seq < 0
+ * every buffer is consumed. Events are handled on the way (see
+ * mt7927_rx_event()), stale responses dropped. Called under dma_mutex.
+ */
+static int mt7927_rx_poll(struct mt7927_dev *dev, u8 eid, int seq)
+{
+	for (;;) {
+		int idx = dev->rx_ring_head;
+		u32 ctrl = le32_to_cpu(dev->rx_ring[idx].ctrl);
+		int len = FIELD_GET(MT_DMA_CTL_SD_LEN0, ctrl);
+		void *buf = dev->rx_buf + idx * MT7927_RX_BUF_SIZE;
+
+		if (!(ctrl & MT_DMA_CTL_DMA_DONE))
+			return -ENODATA;
+
+		if (seq >= 0 && mt7927_mcu_resp_match(buf, len, eid, seq))
+			return idx;
+
+		if (!mt7927_rx_event(dev, buf, len))
+			dev_dbg(&dev->pdev->dev,
+				"  Dropping stale MCU event: idx=%d len=%d\n",
+				idx, len);
+		mt7927_rx_recycle(dev, idx);
+	}
+}
+
+/*
+ * Drain RX ring 0 between MCU commands, re-armed while tokens are in
+ * flight. A sender holding dma_mutex drains the ring itself while it
+ * waits, so a busy mutex just means trying again next period.
+ */
+static void mt7927_rx_poll_work(struct work_struct *work)
+{
+	struct mt7927_dev *dev = container_of(to_delayed_work(work),
+					      struct mt7927_dev, rx_poll);
+
+	/* Chip recovery drains every token itself */
+	if (mt7927_aborted(dev) ||
+	    test_bit(MT7927_STATE_RESETTING, &dev->state))
+		return;
+
+	if (mutex_trylock(&dev->dma_mutex)) {
+		if (!dev->pm.fw_own && dev->rx_ring)
+			mt7927_rx_poll(dev, 0, -1);
+		mutex_unlock(&dev->dma_mutex);
+	}
+
+	if (atomic_read(&dev->token.count))
+		mt7927_rx_poll_arm(dev);
+}
+
+/*
+ * Firmware status in response @buf: the status byte for PATCH_SEM_CTRL
+ * (as mt76 reads it), the result word for unified commands, 0 for the
+ * other ROM commands, which carry none.
+ */
+static int mt7927_mcu_resp_status(const void *buf, int len, u16 cmd, bool uni)
+{
+	const struct mt7927_mcu_rxd *rxd = buf;
+	const struct mt7927_mcu_uni_event *evt = buf + sizeof(*rxd);
+
+	if (uni)
+		return len >= sizeof(*rxd) + sizeof(*evt) ?
+		       le32_to_cpu(evt->status) : 0;
+	if (cmd == MCU_CMD_PATCH_SEM_CTRL)
+		return rxd->ext_eid;
+	return 0;
+}
+
+/*
+ * Wait for the response to MCU command @cmd, sent with @expected_seq, on
+ * RX Ring 0
+ *
+ * The response is told apart from other RX ring 0 traffic by its
+ * sequence number and event ID; whatever is queued ahead of it goes
+ * through mt7927_rx_poll(). Between commands mt7927_rx_poll_work()
+ * drains the ring instead.
+ *
+ * Returns: firmware status (>= 0, see mt7927_mcu_resp_status()) on
+ * success, negative on error
+ */
+static int mt7927_mcu_wait_response(struct mt7927_dev *dev, int timeout_ms,
+				    u16 cmd, bool uni, u8 expected_seq)
+{
+	u8 eid = !uni && cmd == MCU_CMD_PATCH_SEM_CTRL ? MCU_EVENT_PATCH_SEM :
+							 MCU_EVENT_GENERIC;
+	ktime_t timeout = ktime_add_us(ktime_get(), timeout_ms * USEC_PER_MSEC);
+	unsigned long poll_us = READ_ONCE(dev->game.on) ? MT7927_POLL_US :
+							  USEC_PER_MSEC;
+	u32 cpu_idx, dma_idx;
+
+	dev_info(&dev->pdev->dev, "  Waiting for MCU response (seq=%d)...\n",
+		 expected_seq);
+
+	do {
+		int idx = mt7927_rx_poll(dev, eid, expected_seq);
+
+		if (idx >= 0) {
+			u32 ctrl = le32_to_cpu(dev->rx_ring[idx].ctrl);
+			int len = FIELD_GET(MT_DMA_CTL_SD_LEN0, ctrl);
+			void *buf = dev->rx_buf + idx * MT7927_RX_BUF_SIZE;
+			int status;
+
+			status = mt7927_mcu_resp_status(buf, len, cmd, uni);
+			mt7927_rx_recycle(dev, idx);
+
+			dev_info(&dev->pdev->dev,
+				 "  MCU response received: idx=%d len=%d status=%d\n",
+				 idx, len, status);
+			return status;
+		}
+
+		mt7927_usleep_range(dev, poll_us, 2 * poll_us);
+	} while (!ktime_after(ktime_get(), timeout));
+
+	cpu_idx = mt7927_rr(dev, MT_RX_RING_BASE + 0 * MT_RING_SIZE +
+				 MT_RING_CIDX);
+	dma_idx = mt7927_rr(dev, MT_RX_RING_BASE + 0 * MT_RING_SIZE +
+				 MT_RING_DIDX);
+	dev_warn(&dev->pdev->dev,
+		 "  MCU response timeout: cpu_idx=%d dma_idx=%d\n", cpu_idx, dma_idx);
+	return -ETIMEDOUT;
+}
+
+/*
+ * Make sure dev->mcu_msg exists and clear the first @total_len bytes
+ */
+static int mt7927_mcu_msg_prep(struct mt7927_dev *dev, int total_len)
+{
+	if (total_len > MT7927_MCU_MSG_MAX)
+		return -EINVAL;
+
+	/* Allocate MCU message buffer if needed */
+	if (!dev->mcu_msg) {
+		dev->mcu_msg = kmalloc_node(MT7927_MCU_MSG_MAX, GFP_KERNEL,
+					    dev_to_node(&dev->pdev->dev));
+		if (!dev->mcu_msg)
+			return -ENOMEM;
+	}
+
+	/* Without the arena every command is mapped, which still works */
+	mt7927_tx_arena_alloc(dev);
+
+	memset(dev->mcu_msg, 0, total_len);
+
+	/* First 32 bytes: TXD */
+	((__le32 *)dev->mcu_msg)[0] = cpu_to_le32(mt7927_mcu_txd0_cmd(total_len));
+
+	return 0;
+}
+
+/*
+ * Queue the message built in dev->mcu_msg on ring 15 and wait for the
+ * DMA to complete
+ */
+static int mt7927_mcu_msg_xmit(struct mt7927_dev *dev, u8 cmd, u8 seq,
+			       int total_len)
+{
+	dma_addr_t dma;
+	int ret;
+
+	/* Copy into a pre-mapped slot, or map if too long */
+	ret = mt7927_tx_map(dev, dev->mcu_msg, total_len, &dma);
+	if (ret)
+		return ret;
+
+	/* Queue to Ring 15 */
+	trace_mt7927_mcu_send(dev, cmd, seq, total_len);
+	ret = mt7927_dma_tx_queue_mcu(dev, dma, total_len);
+	if (ret)
+		return ret;
+
+	/* Wait for DMA to complete, one ring reset and retry if it hangs */
+	ret = mt7927_mcu_tx_wait(dev, 100);
+	if (ret && !mt7927_mcu_ring_recover(dev))
+		ret = mt7927_mcu_tx_wait(dev, 100);
+	if (ret) {
+		dev_err(&dev->pdev->dev, "  MCU command DMA timeout\n");
+		mt7927_reset_schedule(dev, "mcu dma timeout", 0);
+		return ret;
+	}
+
+	return 0;
+}
+
+/*
+ * Send MCU command and optionally wait for response
+ *
+ * This builds the MCU TXD header and sends the command via Ring 15.
+ * Used for ROM bootloader commands like PATCH_SEM_CONTROL.
+ *
+ * Returns: the firmware status of the response (PATCH_SEM_CTRL only, 0
+ * otherwise or when no response came), negative on DMA error
+ */
+static int __mt7927_mcu_send_msg(struct mt7927_dev *dev, u8 cmd,
+				 const void *data, int len, bool wait_resp)
+{
+	struct mt7927_mcu_hdr *hdr;
+	ktime_t start;
+	int total_len;
+	u8 seq;
+	int ret;
+
+	/* Total packet = TXD (32 bytes) + MCU header + data */
+	total_len = sizeof(struct mt7927_mcu_txd) + sizeof(*hdr) + len;
+	ret = mt7927_mcu_msg_prep(dev, total_len);
+	if (ret)
+		return ret;
+
+	/* MCU header follows TXD */
+	hdr = dev->mcu_msg + sizeof(struct mt7927_mcu_txd);
+	seq = mt7927_mcu_next_seq(dev);
+
+	hdr->len = cpu_to_le16(sizeof(*hdr) + len);
+	hdr->pq_id = cpu_to_le16(0x8000);  /* MCU queue ID */
+	hdr->cid = cmd;
+	hdr->pkt_type = MT_MCU_PKT_ID;
+	hdr->set_query = MCU_CMD_SET;
+	hdr->seq = seq;
+	hdr->s2d_index = MCU_S2D_H2N;
+
+	/* Copy payload data after header */
+	if (data && len > 0)
+		memcpy(dev->mcu_msg + sizeof(struct mt7927_mcu_txd) + sizeof(*hdr),
+		       data, len);
+
+	dev_info(&dev->pdev->dev,
+		 "  Sending MCU cmd=0x%02x seq=%d len=%d total=%d\n",
+		 cmd, seq, len, total_len);
+
+	start = ktime_get();
+	ret = mt7927_mcu_msg_xmit(dev, cmd, seq, total_len);
+	if (ret)
+		return ret;
+
+	/* Wait for response if requested */
+	if (wait_resp) {
+		ret = mt7927_mcu_wait_response(dev, 500, cmd, false, seq);
+		trace_mt7927_mcu_response(dev, cmd, seq,
+					  ktime_us_delta(ktime_get(), start), ret);
+		if (ret >= 0)
+			return ret;
+
+		dev_warn(&dev->pdev->dev,
+			 "  MCU response timeout (cmd=0x%02x) - ROM may not be ready\n",
+			 cmd);
+		/*
+		 * Don't fail - ROM might process command without explicit
+		 * ACK. Only a silent RAM firmware is worth a chip reset.
+		 */
+		if (test_bit(MT7927_STATE_FW_RUNNING, &dev->state))
+			mt7927_reset_schedule(dev, "mcu response timeout", 0);
+	}
+
+	return 0;
+}
+
+static int mt7927_mcu_send_msg(struct mt7927_dev *dev, u8 cmd,
+			       const void *data, int len, bool wait_resp)
+{
+	int ret;
+
+	mutex_lock(&dev->dma_mutex);
+	mt7927_aspm_hold(dev, MT7927_ASPM_MCU);
+	ret = mt7927_pm_access(dev);
+	if (!ret)
+		ret = __mt7927_mcu_send_msg(dev, cmd, data, len, wait_resp);
+	mt7927_aspm_release(dev, MT7927_ASPM_MCU);
+	mutex_unlock(&dev->dma_mutex);
+
+	return ret;
+}
+
+/*
+ * Send a unified command to the RAM firmware and wait for its response.
+ * Unlike the ROM commands above, a missing response is an error, and so
+ * is a non-zero status in it. Before the RAM firmware is up there is
+ * nobody to answer, so the command is not sent at all.
+ */
+static int __mt7927_mcu_send_uni(struct mt7927_dev *dev, u16 cid,
+				 const void *data, int len)
+{
+	struct mt7927_mcu_uni_hdr *hdr;
+	ktime_t start;
+	int total_len;
+	u8 seq;
+	int ret;
+
+	if (mt7927_mock_mcu(dev, cid))
+		return 0;
+
+	if (!test_bit(MT7927_STATE_FW_RUNNING, &dev->state))
+		return -ENODEV;
+
+	total_len = sizeof(struct mt7927_mcu_txd) + sizeof(*hdr) + len;
+	ret = mt7927_mcu_msg_prep(dev, total_len);
+	if (ret)
+		return ret;
+
+	hdr = dev->mcu_msg + sizeof(struct mt7927_mcu_txd);
+	seq = mt7927_mcu_next_seq(dev);
+
+	hdr->len = cpu_to_le16(sizeof(*hdr) + len);
+	hdr->cid = cpu_to_le16(cid);
+	hdr->pkt_type = MT_MCU_PKT_ID;
+	hdr->seq = seq;
+	hdr->s2d_index = MCU_S2D_H2N;
+	hdr->option = MCU_UNI_OPT_EXT_ACK;
+
+	if (data && len > 0)
+		memcpy(hdr + 1, data, len);
+
+	start = ktime_get();
+	ret = mt7927_mcu_msg_xmit(dev, cid, seq, total_len);
+	if (ret)
+		return ret;
+
+	ret = mt7927_mcu_wait_response(dev, 500, cid, true, seq);
+	trace_mt7927_mcu_response(dev, cid, seq,
+				  ktime_us_delta(ktime_get(), start), ret);
+	if (ret < 0) {
+		dev_warn(&dev->pdev->dev, "  MCU UNI cmd 0x%02x: no response\n",
+			 cid);
+		mt7927_reset_schedule(dev, "mcu response timeout", 0);
+		return ret;
+	}
+	if (ret) {
+		dev_warn(&dev->pdev->dev, "  MCU UNI cmd 0x%02x: status %d\n",
+			 cid, ret);
+		return -EIO;
+	}
+
+	return 0;
+}
+
+static int mt7927_mcu_send_uni(struct mt7927_dev *dev, u16 cid,
+			       const void *data, int len)
+{
+	int ret;
+
+	mutex_lock(&dev->dma_mutex);
+	mt7927_aspm_hold(dev, MT7927_ASPM_MCU);
+	ret = mt7927_pm_access(dev);
+	if (!ret)
+		ret = __mt7927_mcu_send_uni(dev, cid, data, len);
+	mt7927_aspm_release(dev, MT7927_ASPM_MCU);
+	mutex_unlock(&dev->dma_mutex);
+
+	return ret;
+}
+
+/*
+ * Acquire patch semaphore from ROM bootloader
+ *
+ * This MUST be called before sending any firmware data!
+ * The ROM bootloader uses a semaphore to coordinate patch loading.
+ */
+static int mt7927_mcu_patch_sem_ctrl(struct mt7927_dev *dev, bool get)
+{
+	struct {
+		__le32 op;
+	} req = {
+		.op = cpu_to_le32(get ? PATCH_SEM_GET : PATCH_SEM_RELEASE),
+	};
+
+	dev_info(&dev->pdev->dev, "=== MCU PATCH_SEM_CONTROL (%s) ===\n",
+		 get ? "GET" : "RELEASE");
+
+	return mt7927_mcu_send_msg(dev, MCU_CMD_PATCH_SEM_CTRL,
+				   &req, sizeof(req), true);
+}
+
+/*
+ * Initialize patch download - tells ROM the target address and length
+ */
+static int mt7927_mcu_init_download(struct mt7927_dev *dev, u32 addr, u32 len)
+{
+	struct {
+		__le32 addr;
+		__le32 len;
+		__le32 mode;
+	} req = {
+		.addr = cpu_to_le32(addr),
+		.len = cpu_to_le32(len),
+		.mode = cpu_to_le32(DL_MODE_NEED_RSP),
+	};
+
+	dev_info(&dev->pdev->dev, "=== MCU TARGET_ADDRESS_LEN_REQ ===\n");
+	dev_info(&dev->pdev->dev, "  addr=0x%08x len=%d\n", addr, len);
+
+	return mt7927_mcu_send_msg(dev, MCU_CMD_TARGET_ADDRESS_LEN_REQ,
+				   &req, sizeof(req), true);
+}
+
+/*
+ * Queue a firmware chunk to the FWDL ring (ring 16)
+ *
+ * This sets up a DMA descriptor pointing to the firmware data
+ * and kicks the DMA engine.
+ */
+static noinline int mt7927_dma_tx_queue_fw(struct mt7927_dev *dev,
+					   dma_addr_t data_dma, int data_len)
+{
+	struct mt76_desc *desc;
+	u32 ctrl;
+	int idx;
+
+	if (!dev->tx_ring)
+		return -ENODEV;
+
+	idx = dev->tx_ring_head;
+	desc = &dev->tx_ring[idx];
+
+	/* Check if descriptor is available (DMA_DONE should be set for unused) */
+	ctrl = le32_to_cpu(desc->ctrl);
+	if (!(ctrl & MT_DMA_CTL_DMA_DONE) && ctrl != 0) {
+		dev_warn(&dev->pdev->dev, "  Ring full at idx %d, ctrl=0x%08x\n",
+			 idx, ctrl);
+		return -EBUSY;
+	}
+
+	/*
+	 * Fill descriptor - MT76 descriptor format (v0.8.0 CRITICAL FIX):
+	 *   buf0: lower 32 bits of DMA address
+	 *   ctrl: control flags - SD_LEN0 in bits [29:16], LAST_SEC0 at bit 30
+	 *   buf1: lower 32 bits of second buffer (for scatter-gather, usually 0)
+	 *   info: metadata - bits 35:32 of buf0/buf1 in SDP0_H/SDP1_H
+	 *
+	 * CRITICAL: Our old code had SD_LEN0 in wrong bits causing garbage!
+	 * Now using kernel-correct bit positions.
+	 */
+	desc->info = cpu_to_le32(mt7927_desc_set_buf(dev, desc, data_dma, 0));
+
+	/*
+	 * Control field (v0.8.0 FIXED bit positions):
+	 *   - SD_LEN0 in bits [29:16] = packet length
+	 *   - LAST_SEC0 at bit 30 = this is the last/only segment
+	 *   - BURST at bit 15 = burst mode for better performance
+	 */
+	ctrl = FIELD_PREP(MT_DMA_CTL_SD_LEN0, data_len) |
+	       MT_DMA_CTL_LAST_SEC0 |
+	       MT_DMA_CTL_BURST;
+	desc->ctrl = cpu_to_le32(ctrl);
+
+	/* Memory barrier before kicking DMA */
+	wmb();
+
+	/* Advance head */
+	dev->tx_ring_head = (idx + 1) % dev->tx_ring_size;
+
+	/* Kick DMA - write CPU index to register */
+	trace_mt7927_desc_enqueue(dev, 16, idx, data_len);
+	trace_mt7927_doorbell(dev, false, 16, dev->tx_ring_head);
+	mt7927_wr(dev, MT_TX_RING_BASE + 16 * MT_RING_SIZE + MT_RING_CIDX,
+		  dev->tx_ring_head);
+	mt7927_wd_arm(dev);
+
+	mt7927_trace(dev, MT7927_TRACE_DESC_FW, idx, NULL,
+		     le32_to_cpu(desc->buf0), le32_to_cpu(desc->buf1),
+		     ctrl, le32_to_cpu(desc->info), dev->tx_ring_head);
+
+	return 0;
+}
+
+/*
+ * Wait for DMA ring to drain (all descriptors completed)
+ */
+static int mt7927_dma_tx_wait(struct mt7927_dev *dev, int timeout_ms)
+{
+	u32 cpu_idx, dma_idx;
+	int i;
+
+	for (i = 0; i < timeout_ms; i++) {
+		cpu_idx = mt7927_rr(dev, MT_TX_RING_BASE + 16 * MT_RING_SIZE +
+					 MT_RING_CIDX);
+		dma_idx = mt7927_rr(dev, MT_TX_RING_BASE + 16 * MT_RING_SIZE +
+					 MT_RING_DIDX);
+
+		if (cpu_idx == dma_idx) {
+			mt7927_tx_complete(dev, 16, dev->tx_ring,
+					   dev->tx_ring_size,
+					   &dev->tx_ring_tail, dma_idx);
+			return 0;
+		}
+
+		mt7927_usleep_range(dev, 1000, 2000);
+	}
+
+	/* Dump additional state on timeout for debugging */
+	{
+		u32 glo_cfg = mt7927_rr(dev, MT_WFDMA0_GLO_CFG);
+		u32 int_sta = mt7927_rr(dev, MT_WFDMA0_HOST_INT_STA);
+		u32 int_ena = mt7927_rr(dev, MT_WFDMA0_HOST_INT_ENA);
+		u32 pcie_int = mt7927_rr(dev, MT_PCIE_MAC_INT_STATUS);
+		u32 misc = mt7927_read_conn_misc(dev);
+		u32 mcu_cmd = mt7927_rr(dev, MT_MCU_CMD);
+		u32 ring_base = mt7927_rr(dev, MT_TX_RING_BASE + 16 * MT_RING_SIZE);
+		u32 ring_cnt = mt7927_rr(dev, MT_TX_RING_BASE +
+					 16 * MT_RING_SIZE + MT_RING_CNT);
+
+		dev_warn(&dev->pdev->dev,
+			 "  DMA wait timeout: cpu_idx=%d dma_idx=%d\n", cpu_idx, dma_idx);
+		dev_warn(&dev->pdev->dev,
+			 "  === v0.9.0 Diagnostic Dump ===\n");
+		dev_warn(&dev->pdev->dev,
+			 "  GLO_CFG=0x%08x (TX_EN=%d, RX_EN=%d, BUSY=%d)\n",
+			 glo_cfg,
+			 !!(glo_cfg & MT_WFDMA0_GLO_CFG_TX_DMA_EN),
+			 !!(glo_cfg & MT_WFDMA0_GLO_CFG_RX_DMA_EN),
+			 !!(glo_cfg & (MT_WFDMA0_GLO_CFG_TX_DMA_BUSY | MT_WFDMA0_GLO_CFG_RX_DMA_BUSY)));
+		dev_warn(&dev->pdev->dev,
+			 "  INT_ENA=0x%08x INT_STA=0x%08x PCIE_INT=0x%08x\n",
+			 int_ena, int_sta, pcie_int);
+		dev_warn(&dev->pdev->dev,
+			 "  MT_CONN_ON_MISC=0x%08x (ROM state) MT_MCU_CMD=0x%08x\n",
+			 misc, mcu_cmd);
+		dev_warn(&dev->pdev->dev,
+			 "  Ring16: BASE=0x%08x CNT=%d cpu_idx=%d dma_idx=%d\n",
+			 ring_base, ring_cnt, cpu_idx, dma_idx);
+
+		/* Check descriptor state - use dma_idx to find last attempted desc */
+		if (dev->tx_ring && dma_idx < dev->tx_ring_size) {
+			struct mt76_desc *desc = &dev->tx_ring[dma_idx];
+			dev_warn(&dev->pdev->dev,
+				 "  Desc[%d]: buf0=0x%08x ctrl=0x%08x (DMA_DONE=%d)\n",
+				 dma_idx, le32_to_cpu(desc->buf0), le32_to_cpu(desc->ctrl),
+				 !!(le32_to_cpu(desc->ctrl) & MT_DMA_CTL_DMA_DONE));
+		}
+
+		/*
+		 * v0.9.0: If dma_idx is still 0 and we have a valid ring BASE,
+		 * the ROM bootloader is NOT processing our rings. Possible causes:
+		 * 1. ROM not awake/in wrong state
+		 * 2. Missing interrupt/wake signal
+		 * 3. ROM waiting for specific handshake
+		 */
+		if (dma_idx == 0 && ring_base != 0) {
+			dev_warn(&dev->pdev->dev,
+				 "  >>> DMA_IDX stuck at 0 - ROM not processing rings!\n");
+			dev_warn(&dev->pdev->dev,
+				 "  >>> ROM may be waiting for handshake or wake signal.\n");
+		}
+	}
+	return -ETIMEDOUT;
+}
+
+/*
+ * Send a firmware scatter chunk
+ *
+ * Each chunk is wrapped with an MCU TXD header and sent via ring 16.
+ * The TXD is 32 bytes (8 DWORDs), followed by the firmware data.
+ */
+static int mt7927_mcu_send_fw_chunk(struct mt7927_dev *dev, const void *data,
+				    int len, u32 offset, bool last)
+{
+	struct mt7927_mcu_txd *txd;
+	int total_len;
+	int ret;
+
+	/* Total packet = TXD (32 bytes) + data */
+	total_len = sizeof(struct mt7927_mcu_txd) + len;
+
+	/* Check if MCU buffer is large enough */
+	if (total_len > MT7927_FW_CHUNK_SIZE + sizeof(struct mt7927_mcu_txd)) {
+		dev_err(&dev->pdev->dev, "  FW chunk too large: %d\n", total_len);
+		return -EINVAL;
+	}
+
+	/* Build TXD in MCU buffer */
 	txd = dev->mcu_buf;
 	memset(txd, 0, sizeof(*txd));
 
-	/* TXD word 0: packet length + format + queue */
-	txd->txd[0] = cpu_to_le32(mt7927_mcu_txd0_fw(total_len));
+	/* TXD word 0: packet length + format + queue */
+	txd->txd[0] = cpu_to_le32(mt7927_mcu_txd0_fw(total_len));
+
+	/* TXD word 1: reserved */
+	txd->txd[1] = 0;
+
+	/* Copy firmware data after TXD */
+	memcpy(dev->mcu_buf + sizeof(*txd), data, len);
+
+	/* Ensure data is visible to DMA */
+	dma_sync_single_for_device(&dev->pdev->dev, dev->mcu_dma,
+				   total_len, DMA_TO_DEVICE);
+
+	/* Queue to DMA ring */
+	ret = mt7927_dma_tx_queue_fw(dev, dev->mcu_dma, total_len);
+	if (ret)
+		return ret;
+
+	/* Wait for this chunk to complete before sending next */
+	ret = mt7927_dma_tx_wait(dev, 100);
+	if (ret && !mt7927_fwdl_ring_recover(dev))
+		ret = mt7927_dma_tx_wait(dev, 100);
+	if (ret) {
+		dev_err(&dev->pdev->dev, "  FW chunk DMA timeout at offset 0x%x\n",
+			offset);
+		return ret;
+	}
+
+	return 0;
+}
+
+/*
+ * Send firmware data in chunks via FW_SCATTER command
+ *
+ * The firmware is split into 4KB chunks, each wrapped with an MCU TXD
+ * and sent via the FWDL ring (ring 16).
+ */
+static int mt7927_mcu_send_firmware(struct mt7927_dev *dev, const void *data,
+				    int len)
+{
+	int chunk_size = MT7927_FW_CHUNK_SIZE;
+	u32 offset = 0;
+	int ret;
+
+	dev_info(&dev->pdev->dev, "  Sending %d bytes in %d-byte chunks...\n",
+		 len, chunk_size);
+
+	while (len > 0) {
+		int cur_len = min(len, chunk_size);
+		bool last = (len <= chunk_size);
+
+		if (mt7927_aborted(dev))
+			return -ECANCELED;
+
+		if (debug_regs && (offset % (64 * 1024) == 0 || last))
+			dev_info(&dev->pdev->dev, "    Chunk: offset=0x%x len=%d%s\n",
+				 offset, cur_len, last ? " (last)" : "");
+
+		mutex_lock(&dev->dma_mutex);
+		ret = mt7927_mcu_send_fw_chunk(dev, data, cur_len, offset, last);
+		mutex_unlock(&dev->dma_mutex);
+		if (ret) {
+			dev_err(&dev->pdev->dev,
+				"  Failed to send chunk at offset 0x%x: %d\n",
+				offset, ret);
+			return ret;
+		}
+
+		data += cur_len;
+		offset += cur_len;
+		len -= cur_len;
+	}
+
+	dev_info(&dev->pdev->dev, "  Firmware data sent: %d bytes total\n", offset);
+	return 0;
+}
+
+/*
+ * Patch identity cookie
+ *
+ * A 16-bit hash of the patch header (build date, versions, CRC) that we
+ * park in the upper half of MT_WFDMA_DUMMY_CR after a successful
+ * download. 0 and 0xffff are avoided since that is what the register
+ * reads after a reset.
+ */
+static u16 mt7927_patch_cookie(const struct mt7927_patch_hdr *hdr)
+{
+	u32 hash = jhash(hdr, sizeof(*hdr), 0);
+	u16 cookie = (hash >> 16) ^ (hash & 0xffff);
+
+	if (cookie == 0 || cookie == 0xffff)
+		cookie = 0x7927;
+
+	return cookie;
+}
+
+/*
+ * Patch image, requested once and then kept until remove. Resume runs
+ * before the root filesystem is back, so a reload after the firmware was
+ * lost in suspend has to come from memory.
+ */
+static int mt7927_patch_fw_get(struct mt7927_dev *dev)
+{
+	int ret;
+
+	if (dev->patch_fw)
+		return 0;
+
+	ret = request_firmware(&dev->patch_fw, MT7927_PATCH_FW, &dev->pdev->dev);
+	if (ret)
+		return ret;
+
+	if (dev->patch_fw->size < sizeof(struct mt7927_patch_hdr)) {
+		release_firmware(dev->patch_fw);
+		dev->patch_fw = NULL;
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
+/* Cookie of the patch file on disk */
+static int mt7927_patch_file_cookie(struct mt7927_dev *dev, u16 *cookie)
+{
+	int ret;
+
+	ret = mt7927_patch_fw_get(dev);
+	if (ret)
+		return ret;
+
+	*cookie = mt7927_patch_cookie((const struct mt7927_patch_hdr *)dev->patch_fw->data);
+	return 0;
+}
+
+/*
+ * Ask the ROM whether a patch is loaded, as mt76 does before a download:
+ * PATCH_SEM_CTRL GET answers PATCH_IS_DL then. If we got the semaphore
+ * instead, nothing is loaded and it is handed back. Needs the MCU ring.
+ */
+static bool mt7927_patch_loaded(struct mt7927_dev *dev)
+{
+	int sem = mt7927_mcu_patch_sem_ctrl(dev, true);
+
+	if (sem == PATCH_NOT_DL_SEM_SUCCESS)
+		mt7927_mcu_patch_sem_ctrl(dev, false);
+
+	return sem == PATCH_IS_DL;
+}
+
+/*
+ * Parse patch firmware and send to device
+ */
+static int mt7927_load_patch(struct mt7927_dev *dev)
+{
+	const struct firmware *fw;
+	const struct mt7927_patch_hdr *hdr;
+	const struct mt7927_patch_sec *sec;
+	const u8 *fw_data;
+	u32 n_section;
+	u32 ring_base;
+	ktime_t start;
+	int ret, i;
+
+	dev_info(&dev->pdev->dev, "=== Loading Patch Firmware ===\n");
+
+	/*
+	 * CRITICAL: Verify ring BASE is non-zero before attempting DMA!
+	 * If the ring BASE is 0, the device will try to DMA from address 0,
+	 * causing IOMMU page faults.
+	 */
+	ring_base = mt7927_rr(dev, MT_TX_RING_BASE + 16 * MT_RING_SIZE);
+	dev_info(&dev->pdev->dev, "  Pre-DMA check: Ring 16 BASE = 0x%08x\n", ring_base);
+	if (ring_base == 0) {
+		dev_err(&dev->pdev->dev,
+			"  ABORT: Ring BASE is 0! DMA would cause page faults.\n");
+		dev_err(&dev->pdev->dev,
+			"  Ring registers are not writable. Check DMA initialization.\n");
+		return -EIO;
+	}
+
+	/* Request patch firmware (cached after the first load) */
+	ret = mt7927_patch_fw_get(dev);
+	if (ret) {
+		dev_err(&dev->pdev->dev,
+			"  Failed to load patch firmware: %d\n", ret);
+		return ret;
+	}
+	fw = dev->patch_fw;
+
+	dev_info(&dev->pdev->dev, "  Patch firmware loaded: %zu bytes\n", fw->size);
+
+	/* Parse patch header */
+	hdr = (const struct mt7927_patch_hdr *)fw->data;
+
+	dev_info(&dev->pdev->dev, "  Patch build: %.16s\n", hdr->build_date);
+	dev_info(&dev->pdev->dev, "  Platform: %.4s\n", hdr->platform);
+	dev_info(&dev->pdev->dev, "  HW/SW version: 0x%08x\n",
+		 be32_to_cpu(hdr->hw_sw_ver));
+	dev_info(&dev->pdev->dev, "  Patch version: 0x%08x\n",
+		 be32_to_cpu(hdr->patch_ver));
+
+	n_section = be32_to_cpu(hdr->desc.n_region);
+	dev_info(&dev->pdev->dev, "  Number of sections: %d\n", n_section);
+
+	if (n_section == 0 || n_section > 64) {
+		dev_err(&dev->pdev->dev, "  Invalid section count: %d\n", n_section);
+		return -EINVAL;
+	}
+
+	/*
+	 * v0.5.0: Acquire patch semaphore from ROM bootloader FIRST!
+	 * This tells the ROM we're about to download a patch.
+	 * Without this, the ROM ignores our FW_SCATTER data.
+	 */
+	ret = mt7927_mcu_patch_sem_ctrl(dev, true);
+	if (ret) {
+		dev_warn(&dev->pdev->dev,
+			 "  PATCH_SEM_CONTROL failed: %d (continuing anyway)\n", ret);
+		/* Don't fail - try downloading anyway */
+	}
+
+	/* Section headers follow the main header */
+	sec = (const struct mt7927_patch_sec *)(fw->data + sizeof(*hdr));
+
+	/* Process each section */
+	for (i = 0; i < n_section; i++) {
+		u32 sec_type = be32_to_cpu(sec[i].type);
+		u32 sec_offs = be32_to_cpu(sec[i].offs);
+		u32 sec_size = be32_to_cpu(sec[i].size);
+		u32 sec_addr = be32_to_cpu(sec[i].info.addr);
+
+		dev_info(&dev->pdev->dev,
+			 "  Section %d: type=0x%x offs=0x%x size=%d addr=0x%08x\n",
+			 i, sec_type, sec_offs, sec_size, sec_addr);
+
+		/* Check bounds */
+		if (sec_offs + sec_size > fw->size) {
+			dev_err(&dev->pdev->dev,
+				"  Section %d exceeds file size\n", i);
+			ret = -EINVAL;
+			goto out_release_sem;
+		}
+
+		/*
+		 * v0.5.0: Send TARGET_ADDRESS_LEN_REQ to tell ROM where to put data
+		 * This MUST be sent before FW_SCATTER for each section!
+		 */
+		ret = mt7927_mcu_init_download(dev, sec_addr, sec_size);
+		if (ret) {
+			dev_warn(&dev->pdev->dev,
+				 "  TARGET_ADDRESS_LEN_REQ failed: %d (continuing)\n", ret);
+			/* Don't fail - try downloading anyway */
+		}
+
+		/*
+		 * Download all sections - the type field indicates encryption,
+		 * not whether to download. The kernel driver downloads all
+		 * sections unless feature_set has FW_FEATURE_NON_DL.
+		 *
+		 * sec_type interpretation (from kernel):
+		 *   - Bits 0-1: Section type
+		 *   - Bit 24+: Encryption flags
+		 */
+		fw_data = fw->data + sec_offs;
+
+		dev_info(&dev->pdev->dev,
+			 "  Downloading section %d (%d bytes) to 0x%08x...\n",
+			 i, sec_size, sec_addr);
+
+		trace_mt7927_region_start(dev, i, sec_addr, sec_size);
+		start = ktime_get();
+
+		ret = mt7927_mcu_send_firmware(dev, fw_data, sec_size);
+
+		trace_mt7927_region_finish(dev, i, sec_addr,
+					   ktime_us_delta(ktime_get(), start),
+					   ret);
+		if (ret) {
+			dev_err(&dev->pdev->dev,
+				"  Section %d download failed: %d\n", i, ret);
+			goto out_release_sem;
+		}
+	}
+
+	dev_info(&dev->pdev->dev, "  Patch firmware download complete\n");
+	ret = 0;
+
+	/* Remember which patch is loaded for the next warm start */
+	mt7927_rmw(dev, MT_WFDMA_DUMMY_CR, MT_WFDMA_DUMMY_FW_COOKIE,
+		   FIELD_PREP(MT_WFDMA_DUMMY_FW_COOKIE, mt7927_patch_cookie(hdr)));
+
+out_release_sem:
+	/* Release patch semaphore */
+	mt7927_mcu_patch_sem_ctrl(dev, false);
+	return ret;
+}
+
+/*
+ * v0.9.0: Wake ROM bootloader and wait for it to be ready for firmware download
+ *
+ * The ROM bootloader after WFSYS reset may be in a sleep/idle state.
+ * We need to wake it up and wait for it to start polling the DMA rings.
+ *
+ * Key registers:
+ *   MT_MCU_CMD (0xd41f0): Send commands/wake signals to MCU
+ *   MT_CONN_ON_MISC (0x7c0600f0): Read ROM state
+ *
+ * The ROM transitions through states:
+ *   0 -> INITIAL (just after reset)
+ *   1 -> FW_DOWNLOAD (ready to receive firmware)
+ *   2-7 -> Various operational states
+ */
+static int mt7927_wait_for_rom_ready(struct mt7927_dev *dev)
+{
+	u32 status, mcu_cmd, state;
+	int i;
+
+	dev_info(&dev->pdev->dev, "=== v0.9.0: Wait for ROM Bootloader Ready ===\n");
+
+	/* Read initial state */
+	status = mt7927_read_conn_misc(dev);
+	mcu_cmd = mt7927_rr(dev, MT_MCU_CMD);
+	dev_info(&dev->pdev->dev, "  Initial: MT_CONN_ON_MISC=0x%08x MT_MCU_CMD=0x%08x\n",
+		 status, mcu_cmd);
+
+	state = status & MT_TOP_MISC2_FW_STATE;
+	dev_info(&dev->pdev->dev, "  FW state=%d (0=INITIAL, 1=FW_DOWNLOAD, 7=RDY)\n", state);
+
+	/*
+	 * Try to wake the ROM bootloader by signaling INIT_DONE.
+	 * This tells the ROM that the driver has completed initialization
+	 * and is ready for firmware download.
+	 */
+	dev_info(&dev->pdev->dev, "  Setting MCU_CMD_INIT_DONE to wake ROM...\n");
+	mt7927_wr(dev, MT_MCU_CMD, MT_MCU_CMD_INIT_DONE);
+	udelay(100);
+
+	/* Read back */
+	mcu_cmd = mt7927_rr(dev, MT_MCU_CMD);
+	dev_info(&dev->pdev->dev, "  After INIT_DONE: MT_MCU_CMD=0x%08x\n", mcu_cmd);
+
+	/*
+	 * Poll for ROM to enter a ready state.
+	 * In v0.8.0 we saw MT_CONN_ON_MISC=0x00000000 which means ROM isn't responding.
+	 * We'll poll for any non-zero state indicating the ROM is alive.
+	 */
+	dev_info(&dev->pdev->dev, "  Polling MT_CONN_ON_MISC for ROM ready (500ms)...\n");
+
+	for (i = 0; i < 500; i++) {
+		if (mt7927_aborted(dev))
+			return -ECANCELED;
+
+		status = mt7927_read_conn_misc(dev);
+		state = status & MT_TOP_MISC2_FW_STATE;
+
+		if (i % 100 == 0)
+			dev_info(&dev->pdev->dev, "    [%dms] MT_CONN_ON_MISC=0x%08x state=%d\n",
+				 i, status, state);
+
+		/* Check if ROM indicates any activity */
+		if (status != 0 && status != 0xdeadbeef) {
+			dev_info(&dev->pdev->dev,
+				 "  ROM responding! MT_CONN_ON_MISC=0x%08x\n", status);
+			return 0;
+		}
+
+		/* Also check if N9_RDY bits are set */
+		if ((status & MT_TOP_MISC2_FW_N9_RDY) == MT_TOP_MISC2_FW_N9_RDY) {
+			dev_info(&dev->pdev->dev, "  ROM N9_RDY! Ready for commands.\n");
+			return 0;
+		}
+
+		mt7927_usleep_range(dev, 1000, 2000);
+	}
+
+	/*
+	 * ROM didn't respond. This could mean:
+	 * 1. WFSYS reset didn't complete properly
+	 * 2. ROM is stuck waiting for something else
+	 * 3. Wrong register address for this chip variant
+	 *
+	 * Let's try an alternative approach - check WFSYS reset status again
+	 * and try alternative wake methods.
+	 */
+	dev_warn(&dev->pdev->dev, "  ROM not responding after 500ms!\n");
+
+	/* Check WFSYS status */
+	status = mt7927_rr_remap(dev, MT_WFSYS_SW_RST_B);
+	dev_info(&dev->pdev->dev, "  WFSYS_SW_RST_B=0x%08x (INIT_DONE=%d)\n",
+		 status, !!(status & WFSYS_SW_INIT_DONE));
+
+	/* Try alternative: write to MCU command register with different flags */
+	dev_info(&dev->pdev->dev, "  Trying NORMAL_STATE wake...\n");
+	mt7927_wr(dev, MT_MCU_CMD, MT_MCU_CMD_NORMAL_STATE);
+	mt7927_msleep(dev, 10);
+
+	status = mt7927_read_conn_misc(dev);
+	dev_info(&dev->pdev->dev, "  After NORMAL_STATE: MT_CONN_ON_MISC=0x%08x\n", status);
+
+	/*
+	 * Even if ROM doesn't respond to our wake attempts, let's try
+	 * firmware download anyway - the ROM might be polling the rings
+	 * but not updating status registers.
+	 */
+	dev_info(&dev->pdev->dev, "  Continuing with firmware download attempt...\n");
+
+	return 0;  /* Don't fail - let's see what happens with DMA */
+}
+
+static int mt7927_load_firmware(struct mt7927_dev *dev)
+{
+	int ret;
+	u32 status;
+
+	dev_info(&dev->pdev->dev, "=== Firmware Loading ===\n");
+
+	/* Whatever ran before is gone; only the ROM answers until N9 is up */
+	clear_bit(MT7927_STATE_FW_RUNNING, &dev->state);
+
+	mt7927_phase_begin(dev, MT7927_PHASE_ROM_READY);
+
+	/* Allocate MCU command buffer for DMA (kept across suspend/resume) */
+	if (!dev->mcu_buf)
+		dev->mcu_buf = dma_alloc_coherent(&dev->pdev->dev,
+						  MT7927_FW_CHUNK_SIZE + 256,
+						  &dev->mcu_dma, GFP_KERNEL);
+	if (!dev->mcu_buf) {
+		dev_err(&dev->pdev->dev, "  Failed to allocate MCU buffer\n");
+		return -ENOMEM;
+	}
+
+	dev_info(&dev->pdev->dev, "  MCU DMA buffer at %pad\n", &dev->mcu_dma);
+
+	/*
+	 * v0.9.0: Wait for ROM bootloader to be ready before firmware download.
+	 * This addresses the dma_idx stuck at 0 issue from v0.8.0.
+	 */
+	ret = mt7927_wait_for_rom_ready(dev);
+	if (ret == -ECANCELED)
+		return ret;
+	if (ret) {
+		dev_warn(&dev->pdev->dev, "  ROM ready wait failed: %d\n", ret);
+		/* Continue anyway */
+	}
+
+	/* Check firmware status before download */
+	status = mt7927_read_conn_misc(dev);
+	dev_info(&dev->pdev->dev, "  MT_CONN_ON_MISC before: 0x%08x\n", status);
+
+	/* Initialize ring head/tail */
+	dev->tx_ring_head = 0;
+	dev->tx_ring_tail = 0;
+	dev->mcu_seq = 0;
+
+	/* Load and download patch firmware */
+	mt7927_phase_begin(dev, MT7927_PHASE_PATCH);
+	ret = mt7927_load_patch(dev);
+	if (ret) {
+		dev_err(&dev->pdev->dev, "  Patch loading failed: %d\n", ret);
+		/* Continue to check status anyway */
+	}
+
+	mt7927_phase_end(dev);
+
+	/* Check firmware status after download */
+	status = mt7927_read_conn_misc(dev);
+	dev_info(&dev->pdev->dev, "  MT_CONN_ON_MISC after: 0x%08x\n", status);
+
+	/*
+	 * Expected: bits 0-1 should become 0x3 when firmware is ready.
+	 * If still 0, the firmware hasn't started (expected at this stage
+	 * since we haven't sent the start command yet).
+	 */
+	if ((status & MT_TOP_MISC2_FW_N9_RDY) == MT_TOP_MISC2_FW_N9_RDY) {
+		dev_info(&dev->pdev->dev, "  Firmware N9 is READY!\n");
+		set_bit(MT7927_STATE_FW_RUNNING, &dev->state);
+	} else {
+		dev_info(&dev->pdev->dev,
+			 "  Firmware not ready yet (need FW_START command)\n");
+	}
+
+	return ret;
+}
+
+/* =============================================================================
+ * Channels and PHY Capabilities
+ * =============================================================================
+ *
+ * What sets the MT7927 apart from the MT7925 is 320 MHz on 6 GHz. The
+ * operating channel goes to the firmware with BSS_INFO_UPDATE and an RLM
+ * TLV: primary channel, center of the whole width, width and band.
+ * 160 MHz works on 5 and 6 GHz, 320 MHz only on 6 GHz, where the 320-1
+ * (centers 31, 95, 159) and 320-2 (63, 127, 191) channels overlap by
+ * 160 MHz.
+ *
+ * The HE and EHT capabilities are what each band will advertise. With
+ * no mac80211 registration yet they are built at probe time, in the
+ * form the iftype data of a band takes, and shown in debugfs (phy_caps).
+ * The rates a station actually negotiated come back from the RXD P-RXV
+ * and from TX status, see mt7927_txs_event(); mt7927_rate_kbps() turns
+ * them into a PHY rate.
+ */
+
+static const char * const mt7927_band_name[MT7927_NUM_BANDS] = {
+	[MT7927_BAND_2G] = "2g",
+	[MT7927_BAND_5G] = "5g",
+	[MT7927_BAND_6G] = "6g",
+};
+
+static const u8 mt7927_band_cmd[MT7927_NUM_BANDS] = {
+	[MT7927_BAND_2G] = CMD_BAND_24G,
+	[MT7927_BAND_5G] = CMD_BAND_5G,
+	[MT7927_BAND_6G] = CMD_BAND_6G,
+};
+
+static const u16 mt7927_band_max_width[MT7927_NUM_BANDS] = {
+	[MT7927_BAND_2G] = 40,
+	[MT7927_BAND_5G] = 160,
+	[MT7927_BAND_6G] = 320,
+};
+
+/*
+ * Check @chan and @width on @band and fill @c. A @center of 0 picks the
+ * channel of that width containing @chan (320-1 for 320 MHz). Which
+ * channels the regulatory domain allows is left to the firmware.
+ */
+static int mt7927_chandef_init(struct mt7927_chandef *c,
+			       enum mt7927_band band, u8 chan, u16 width,
+			       u8 center)
+{
+	int span, half, step, base, last;
+
+	if (band >= MT7927_NUM_BANDS || !chan)
+		return -EINVAL;
+
+	switch (width) {
+	case 20:
+	case 40:
+	case 80:
+	case 160:
+	case 320:
+		break;
+	default:
+		return -EINVAL;
+	}
+	if (width > mt7927_band_max_width[band])
+		return -EINVAL;
+
+	/* Channel numbers are 5 MHz apart, primary and center 20 MHz wide */
+	span = width / 5;
+	half = span / 2 - 2;
+
+	if (band == MT7927_BAND_2G) {
+		last = width == 20 ? 14 : 13;
+		if (!center)
+			center = width == 20 ? chan :
+				 chan <= 7 ? chan + 2 : chan - 2;
+		if (abs(center - chan) != half || center < 1 + half ||
+		    center + half > last)
+			return -EINVAL;
+	} else {
+		base = band == MT7927_BAND_6G ? 1 : chan >= 149 ? 149 : 36;
+		last = band == MT7927_BAND_6G ? 233 : 177;
+		if (chan < base || chan > last || (chan - base) % 4)
+			return -EINVAL;
+
+		/* 320 MHz channels start every 160 MHz */
+		step = width == 320 ? span / 2 : span;
+		if (!center)
+			center = base + (chan - base) / span * span + half;
+		if (center < base + half || (center - base - half) % step ||
+		    center + half > last || abs(center - chan) > half)
+			return -EINVAL;
+	}
+
+	c->band = band;
+	c->chan = chan;
+	c->center = center;
+	c->width = width;
+
+	return 0;
+}
+
+static u8 mt7927_width_to_cbw(u16 width)
+{
+	switch (width) {
+	case 40:
+		return CMD_CBW_40MHZ;
+	case 80:
+		return CMD_CBW_80MHZ;
+	case 160:
+		return CMD_CBW_160MHZ;
+	case 320:
+		return CMD_CBW_320MHZ;
+	default:
+		return CMD_CBW_20MHZ;
+	}
+}
+
+static int mt7927_mcu_set_chan(struct mt7927_dev *dev, u8 bss_idx,
+			       const struct mt7927_chandef *c)
+{
+	struct {
+		struct mt7927_bss_req_hdr hdr;
+		struct mt7927_bss_rlm_tlv rlm;
+	} __packed req = {
+		.hdr = {
+			.bss_idx = bss_idx,
+		},
+		.rlm = {
+			.tag = cpu_to_le16(UNI_BSS_INFO_RLM),
+			.len = cpu_to_le16(sizeof(struct mt7927_bss_rlm_tlv)),
+			.control_channel = c->chan,
+			.center_chan = c->center,
+			.bw = mt7927_width_to_cbw(c->width),
+			.tx_streams = MT7927_NSS,
+			.rx_streams = MT7927_NSS,
+			.ht_op_info = 4,	/* HT 40 MHz allowed */
+			.band = mt7927_band_cmd[c->band],
+		},
+	};
+
+	if (c->chan < c->center)
+		req.rlm.sco = MT_SCO_SCA;
+	else if (c->chan > c->center)
+		req.rlm.sco = MT_SCO_SCB;
+
+	return mt7927_mcu_send_uni(dev, MCU_UNI_CMD_BSS_INFO_UPDATE, &req,
+				   sizeof(req));
+}
+
+static void mt7927_init_he_cap(enum mt7927_band band,
+			       struct ieee80211_sta_he_cap *he)
+{
+	struct ieee80211_he_cap_elem *elem = &he->he_cap_elem;
+	struct ieee80211_he_mcs_nss_supp *mcs = &he->he_mcs_nss_supp;
+	u16 mcs_map = 0;
+	int nss;
+
+	for (nss = 0; nss < 8; nss++)
+		mcs_map |= (nss < MT7927_NSS ? IEEE80211_HE_MCS_SUPPORT_0_11 :
+				IEEE80211_HE_MCS_NOT_SUPPORTED) << (nss * 2);
+
+	memset(he, 0, sizeof(*he));
+	he->has_he = true;
+
+	elem->mac_cap_info[0] = IEEE80211_HE_MAC_CAP0_HTC_HE;
+	if (band == MT7927_BAND_2G)
+		elem->phy_cap_info[0] =
+			IEEE80211_HE_PHY_CAP0_CHANNEL_WIDTH_SET_40MHZ_IN_2G;
+	else
+		elem->phy_cap_info[0] =
+			IEEE80211_HE_PHY_CAP0_CHANNEL_WIDTH_SET_40MHZ_80MHZ_IN_5G |
+			IEEE80211_HE_PHY_CAP0_CHANNEL_WIDTH_SET_160MHZ_IN_5G;
+	elem->phy_cap_info[1] = IEEE80211_HE_PHY_CAP1_LDPC_CODING_IN_PAYLOAD;
+
+	mcs->rx_mcs_80 = cpu_to_le16(mcs_map);
+	mcs->tx_mcs_80 = cpu_to_le16(mcs_map);
+	mcs->rx_mcs_160 = cpu_to_le16(band == MT7927_BAND_2G ? 0xffff : mcs_map);
+	mcs->tx_mcs_160 = cpu_to_le16(band == MT7927_BAND_2G ? 0xffff : mcs_map);
+	mcs->rx_mcs_80p80 = cpu_to_le16(0xffff);
+	mcs->tx_mcs_80p80 = cpu_to_le16(0xffff);
+}
+
+/* As mt7925_init_eht_caps(), plus 320 MHz on 6 GHz */
+static void mt7927_init_eht_cap(enum mt7927_band band,
+				struct ieee80211_sta_eht_cap *eht)
+{
+	struct ieee80211_eht_cap_elem_fixed *elem = &eht->eht_cap_elem;
+	struct ieee80211_eht_mcs_nss_supp *mcs = &eht->eht_mcs_nss_supp;
+	u8 sts = 2 * MT7927_NSS - 1;	/* Beamformee STS, minus one */
+	u8 val;
+
+	memset(eht, 0, sizeof(*eht));
+	eht->has_eht = true;
+
+	elem->mac_cap_info[0] =
+		IEEE80211_EHT_MAC_CAP0_OM_CONTROL |
+		u8_encode_bits(IEEE80211_EHT_MAC_CAP0_MAX_MPDU_LEN_11454,
+			       IEEE80211_EHT_MAC_CAP0_MAX_MPDU_LEN_MASK);
+
+	elem->phy_cap_info[0] =
+		IEEE80211_EHT_PHY_CAP0_242_TONE_RU_GT20MHZ |
+		IEEE80211_EHT_PHY_CAP0_NDP_4_EHT_LFT_32_GI |
+		IEEE80211_EHT_PHY_CAP0_SU_BEAMFORMEE |
+		u8_encode_bits(u8_get_bits(sts, BIT(0)),
+			       IEEE80211_EHT_PHY_CAP0_BEAMFORMEE_SS_80MHZ_MASK);
+	elem->phy_cap_info[1] =
+		u8_encode_bits(u8_get_bits(sts, GENMASK(2, 1)),
+			       IEEE80211_EHT_PHY_CAP1_BEAMFORMEE_SS_80MHZ_MASK);
+	if (band != MT7927_BAND_2G)
+		elem->phy_cap_info[1] |=
+			u8_encode_bits(sts,
+				       IEEE80211_EHT_PHY_CAP1_BEAMFORMEE_SS_160MHZ_MASK);
+	if (band == MT7927_BAND_6G) {
+		elem->phy_cap_info[0] |= IEEE80211_EHT_PHY_CAP0_320MHZ_IN_6GHZ;
+		elem->phy_cap_info[1] |=
+			u8_encode_bits(sts,
+				       IEEE80211_EHT_PHY_CAP1_BEAMFORMEE_SS_320MHZ_MASK);
+	}
+
+	/* MCS 0-13 on both streams, at every width the band has */
+	val = u8_encode_bits(MT7927_NSS, IEEE80211_EHT_MCS_NSS_RX) |
+	      u8_encode_bits(MT7927_NSS, IEEE80211_EHT_MCS_NSS_TX);
+
+	mcs->bw._80.rx_tx_mcs9_max_nss = val;
+	mcs->bw._80.rx_tx_mcs11_max_nss = val;
+	mcs->bw._80.rx_tx_mcs13_max_nss = val;
+	if (band != MT7927_BAND_2G) {
+		mcs->bw._160.rx_tx_mcs9_max_nss = val;
+		mcs->bw._160.rx_tx_mcs11_max_nss = val;
+		mcs->bw._160.rx_tx_mcs13_max_nss = val;
+	}
+	if (band == MT7927_BAND_6G) {
+		mcs->bw._320.rx_tx_mcs9_max_nss = val;
+		mcs->bw._320.rx_tx_mcs11_max_nss = val;
+		mcs->bw._320.rx_tx_mcs13_max_nss = val;
+	}
+}
+
+static void mt7927_phy_caps_init(struct mt7927_dev *dev)
+{
+	enum mt7927_band band;
+
+	for (band = 0; band < MT7927_NUM_BANDS; band++) {
+		mt7927_init_he_cap(band, &dev->he_cap[band]);
+		mt7927_init_eht_cap(band, &dev->eht_cap[band]);
+	}
+}
+
+/* Data subcarriers by width, 20 MHz up */
+static const u16 mt7927_nsd_ht[] = { 52, 108, 234, 468 };
+static const u16 mt7927_nsd_he[] = { 234, 468, 980, 1960, 3920 };
+
+/* Coded bits per subcarrier times 12, MCS 0-13 */
+static const u8 mt7927_mcs_bits12[] = {
+	6, 12, 18, 24, 36, 48, 54, 60, 72, 80, 90, 100, 108, 120
+};
+
+/* Legacy rates in 100 kbps: CCK by index, OFDM by L-SIG rate code */
+static const u8 mt7927_cck_rate[] = { 10, 20, 55, 110 };
+static const u16 mt7927_ofdm_rate[16] = {
+	[0xb] = 60, [0xf] = 90, [0xa] = 120, [0xe] = 180,
+	[0x9] = 240, [0xd] = 360, [0x8] = 480, [0xc] = 540,
+};
+
+/*
+ * PHY rate of @r in kbps, 0 if unknown. HT/VHT symbols last 3.2 us plus
+ * a 0.8 or 0.4 us GI, HE/EHT symbols 12.8 us plus 0.8, 1.6 or 3.2 us.
+ * MU and TB frames are counted as if they had the whole width.
+ */
+static u32 mt7927_rate_kbps(const struct mt7927_rate *r)
+{
+	u32 nsd, sym10, mcs = r->mcs, nss = r->nss;
+
+	switch (r->mode) {
+	case MT_PHY_TYPE_CCK:
+		return mt7927_cck_rate[mcs & 3] * 100;
+	case MT_PHY_TYPE_OFDM:
+		return mt7927_ofdm_rate[mcs & 0xf] * 100;
+	case MT_PHY_TYPE_HT:
+	case MT_PHY_TYPE_HT_GF:
+		nss = mcs / 8 + 1;
+		mcs %= 8;
+		fallthrough;
+	case MT_PHY_TYPE_VHT:
+		if (r->bw >= ARRAY_SIZE(mt7927_nsd_ht) || mcs > 9)
+			return 0;
+		nsd = mt7927_nsd_ht[r->bw];
+		sym10 = r->gi ? 36 : 40;
+		break;
+	case MT_PHY_TYPE_HE_SU:
+	case MT_PHY_TYPE_HE_EXT_SU:
+	case MT_PHY_TYPE_HE_TB:
+	case MT_PHY_TYPE_HE_MU:
+	case MT_PHY_TYPE_EHT_SU:
+	case MT_PHY_TYPE_EHT_TRIG:
+	case MT_PHY_TYPE_EHT_MU:
+		if (r->bw >= ARRAY_SIZE(mt7927_nsd_he) ||
+		    mcs >= ARRAY_SIZE(mt7927_mcs_bits12) || r->gi > 2)
+			return 0;
+		nsd = mt7927_nsd_he[r->bw];
+		sym10 = 128 + (8 << r->gi);
+		break;
+	default:
+		return 0;
+	}
+
+	return div_u64((u64)nsd * mt7927_mcs_bits12[mcs] * nss * 10000,
+		       12 * sym10);
+}
+
+/* Best rate @c allows: EHT MCS 13 on all streams, 0.8 us GI */
+static u32 mt7927_chandef_peak_kbps(const struct mt7927_chandef *c)
+{
+	struct mt7927_rate r = {
+		.mode = MT_PHY_TYPE_EHT_SU,
+		.mcs = 13,
+		.nss = MT7927_NSS,
+	};
+
+	if (!c->width)
+		return 0;
+
+	r.bw = ilog2(c->width / 20);
+	return mt7927_rate_kbps(&r);
+}
+
+static const char *mt7927_phy_mode_name(u8 mode)
+{
+	switch (mode) {
+	case MT_PHY_TYPE_CCK:
+		return "CCK";
+	case MT_PHY_TYPE_OFDM:
+		return "OFDM";
+	case MT_PHY_TYPE_HT:
+	case MT_PHY_TYPE_HT_GF:
+		return "HT";
+	case MT_PHY_TYPE_VHT:
+		return "VHT";
+	case MT_PHY_TYPE_HE_SU:
+	case MT_PHY_TYPE_HE_EXT_SU:
+	case MT_PHY_TYPE_HE_TB:
+	case MT_PHY_TYPE_HE_MU:
+		return "HE";
+	case MT_PHY_TYPE_EHT_SU:
+	case MT_PHY_TYPE_EHT_TRIG:
+	case MT_PHY_TYPE_EHT_MU:
+		return "EHT";
+	default:
+		return "?";
+	}
+}
+
+/* =============================================================================
+ * Multi-Link Operation
+ * =============================================================================
+ *
+ * Each MLO link is a BSS on its own MAC band: link @l uses BSS, band,
+ * own MAC, WMM set and data ring @l. TX descriptors for a link carry its
+ * TGID, own MAC and LMAC queue and go to its ring, so a busy 5 GHz link
+ * does not hold up 6 GHz frames behind it.
+ *
+ * An MLD station is one struct mt7927_sta with a WLAN index per link,
+ * and dev->sta[] holds it under each of them. RX from any link therefore
+ * finds the same block-ack reorder buffers and leaves as one sequence.
+ *
+ * The TX link is picked per descriptor by mt7927_mlo_select(), from the
+ * time until the frame would be out on each link: the bytes queued
+ * there and not yet TX-freed, plus the frame, at the link's rate (the
+ * last TXS rate, else the channel's peak).
+ *
+ * - MT7927_MLO_THROUGHPUT takes the link that finishes first, frame by
+ *   frame, which loads the links in proportion to their rates.
+ * - MT7927_MLO_LATENCY keeps a TID on its link and moves it only when
+ *   another is at least 25% faster, so a flow does not bounce between
+ *   links and wait in the peer's reorder buffer for the slower one.
+ */
+
+/* Set up MLO link @l on @c, or move it there. Needs the RAM firmware. */
+static int mt7927_link_add(struct mt7927_dev *dev, u8 l,
+			   const struct mt7927_chandef *c)
+{
+	struct mt7927_link *link;
+	int ret;
+
+	lockdep_assert_held(&dev->sta_mutex);
+
+	if (l >= MT7927_MAX_LINKS)
+		return -EINVAL;
+
+	ret = mt7927_mcu_set_chan(dev, l, c);
+	if (ret)
+		return ret;
+
+	link = &dev->link[l];
+	link->chandef = *c;
+	link->band_idx = l;
+	link->ring = MT7927_TXQ_BAND0 + l;
+	link->omac_idx = l;
+	link->wmm_idx = l;
+	link->active = true;
+
+	dev_info(&dev->pdev->dev, "Link %u: channel %u (%s), %u MHz, center %u\n",
+		 l, c->chan, mt7927_band_name[c->band], c->width, c->center);
+
+	return 0;
+}
+
+/* Stop picking link @l for TX. Frames already queued on it complete. */
+static void mt7927_link_remove(struct mt7927_dev *dev, u8 l)
+{
+	lockdep_assert_held(&dev->sta_mutex);
+
+	if (l < MT7927_MAX_LINKS)
+		dev->link[l].active = false;
+}
+
+#ifdef CONFIG_MT7927_SELFTEST
+/* Expected ns until @len more bytes are out on link @l of @sta */
+static u64 mt7927_link_cost(struct mt7927_dev *dev,
+			    const struct mt7927_sta *sta, u8 l, u32 len)
+{
+	const struct mt7927_link *link = &dev->link[l];
+	u32 kbps = 0;
+	u64 bytes;
+
+	/* nss stays 0 until a TXS reports a rate */
+	if (sta->tx_rate[l].nss)
+		kbps = mt7927_rate_kbps(&sta->tx_rate[l]);
+	if (!kbps)
+		kbps = mt7927_chandef_peak_kbps(&link->chandef);
+	if (!kbps)
+		return U64_MAX;
+
+	bytes = max(atomic_read(&link->inflight), 0) + len;
+
+	/* bits / kbps is ms */
+	return div_u64(bytes * 8 * NSEC_PER_MSEC, kbps);
+}
+
+/* Link of @sta to queue @len bytes of @tid on, see above */
+static u8 mt7927_mlo_select(struct mt7927_dev *dev, struct mt7927_sta *sta,
+			    u8 tid, u32 len)
+{
+	unsigned long mask = sta->link_mask;
+	u64 cost, cur_cost = U64_MAX, best_cost = U64_MAX;
+	u8 cur = sta->tid_link[tid], best = cur;
+	unsigned int l;
+
+	if (!(mask & (mask - 1)))
+		return cur;
+
+	for_each_set_bit(l, &mask, MT7927_MAX_LINKS) {
+		if (!dev->link[l].active)
+			continue;
+
+		cost = mt7927_link_cost(dev, sta, l, len);
+		if (l == cur)
+			cur_cost = cost;
+		if (cost < best_cost) {
+			best_cost = cost;
+			best = l;
+		}
+	}
+
+	if (dev->mlo_policy == MT7927_MLO_LATENCY && cur_cost != U64_MAX &&
+	    best_cost > cur_cost - cur_cost / 4)
+		best = cur;
+
+	sta->tid_link[tid] = best;
+	return best;
+}
+#endif
+
+/* =============================================================================
+ * Data TX Descriptor Templates
+ * =============================================================================
+ *
+ * A data TXD is the same 32 bytes as an MCU TXD, but apart from the byte
+ * count and the 802.11 sequence number everything in it only depends on
+ * the station, TID and queue: WLAN index, own-MAC, header format, LMAC
+ * queue, protection and (optionally) a fixed rate. Those words are built
+ * once per station/TID into a template; per packet, mt7927_txd_write()
+ * copies the template and patches TX_BYTES and SEQ in.
+ *
+ * Templates are invalidated lazily: a rate or key change bumps sta->gen,
+ * and a template whose gen does not match is rebuilt on next use. The
+ * debugfs file txd_bench times both paths and checks they agree.
+ *
+ * With hw_encap, stations take 802.3 frames (HDR_FORMAT_802_3) and the
+ * MAC builds the 802.11 header, LLC/SNAP and sequence number itself, so
+ * there is no header to build or SEQ to patch on the host.
+ *
+ * Nothing hands frames to the data path before there is a netdev, so
+ * its TX side (templates here, A-MSDU below, link selection and token
+ * allocation) is only built with CONFIG_MT7927_SELFTEST, where the
+ * self-tests drive it against the mock device.
+ */
+
+#define MT7927_TXD_SIZE			sizeof(struct mt7927_mcu_txd)
+#define MT7927_TXD_REM_TX_COUNT		15
+
+/* IEEE 802.11 QoS data frame */
+#define MT7927_FC_TYPE_DATA		2
+#define MT7927_FC_STYPE_QOS_DATA	8
+#define MT7927_QOS_HDR_LEN		26
+
+static void mt7927_sta_init(struct mt7927_sta *sta, u16 wcid, u8 omac_idx,
+			    u8 wmm_idx)
+{
+	u8 tid;
+
+	memset(sta, 0, sizeof(*sta));
+	sta->wcid = wcid;
+	sta->omac_idx = omac_idx;
+	sta->wmm_idx = wmm_idx;
+	sta->eth_hdr = hw_encap;
+	sta->gen = 1;
+	sta->link_mask = BIT(0);
+	sta->link_wcid[0] = wcid;
+
+	for (tid = 0; tid < MT7927_NUM_TIDS; tid++) {
+		struct mt7927_amsdu *a = &sta->amsdu[tid];
+
+		a->sta = sta;
+		a->tid = tid;
+		a->max_len = min_t(unsigned int, amsdu_max_len,
+				   MT_TXD_LEN_MASK);
+		a->max_us = tid >= 4 ? amsdu_max_us / 4 : amsdu_max_us;
+	}
+}
+
+#ifdef CONFIG_MT7927_SELFTEST
+/* 802.1D user priority to LMAC queue, as in mt76_connac_lmac_mapping() */
+static const u8 mt7927_tid_to_lmac[MT7927_NUM_TIDS] = {
+	MT_LMAC_AC01, MT_LMAC_AC00, MT_LMAC_AC00, MT_LMAC_AC01,
+	MT_LMAC_AC02, MT_LMAC_AC02, MT_LMAC_AC03, MT_LMAC_AC03,
+};
+
+/* Invalidate all templates of @sta; gen 0 is reserved for "never built" */
+static void mt7927_sta_invalidate(struct mt7927_sta *sta)
+{
+	if (++sta->gen == 0)
+		sta->gen = 1;
+}
+
+static void mt7927_sta_set_rate(struct mt7927_sta *sta, u8 fixed_rate)
+{
+	if (sta->fixed_rate == fixed_rate)
+		return;
+
+	sta->fixed_rate = fixed_rate;
+	mt7927_sta_invalidate(sta);
+}
+
+static void mt7927_sta_set_key(struct mt7927_sta *sta, bool protect)
+{
+	if (sta->protect == protect)
+		return;
+
+	sta->protect = protect;
+	mt7927_sta_invalidate(sta);
+}
+
+static void mt7927_sta_set_encap(struct mt7927_sta *sta, bool eth_hdr)
+{
+	if (sta->eth_hdr == eth_hdr)
+		return;
+
+	sta->eth_hdr = eth_hdr;
+	mt7927_sta_invalidate(sta);
+}
+
+/*
+ * Build a data TXD from scratch. @bytes is the TX_BYTES value (TXD plus
+ * frame). This is the slow path, used to fill templates.
+ */
+static void mt7927_txd_build(const struct mt7927_sta *sta, u8 tid, u16 bytes,
+			     u16 seq, __le32 *txd)
+{
+	u8 q_idx = sta->wmm_idx * MT_LMAC_WMM_SETS + mt7927_tid_to_lmac[tid];
+	u32 val;
+
+	memset(txd, 0, MT7927_TXD_SIZE);
+
+	txd[0] = cpu_to_le32(FIELD_PREP(MT_TXD0_TX_BYTES, bytes) |
+			     FIELD_PREP(MT_TXD0_PKT_FMT, MT_TX_TYPE_SF) |
+			     FIELD_PREP(MT_TXD0_Q_IDX, q_idx));
+
+	val = FIELD_PREP(MT_TXD1_WLAN_IDX, sta->wcid) |
+	      FIELD_PREP(MT_TXD1_TID, tid) |
+	      FIELD_PREP(MT_TXD1_OWN_MAC, sta->omac_idx);
+	if (sta->eth_hdr)
+		val |= FIELD_PREP(MT_TXD1_HDR_FORMAT, MT_HDR_FORMAT_802_3) |
+		       MT_TXD1_ETH_802_3;
+	else
+		val |= FIELD_PREP(MT_TXD1_HDR_FORMAT, MT_HDR_FORMAT_802_11) |
+		       FIELD_PREP(MT_TXD1_HDR_INFO, MT7927_QOS_HDR_LEN / 2);
+	if (sta->fixed_rate)
+		val |= MT_TXD1_FIXED_RATE;
+	txd[1] = cpu_to_le32(val);
+
+	txd[2] = cpu_to_le32(FIELD_PREP(MT_TXD2_FRAME_TYPE,
+					MT7927_FC_TYPE_DATA) |
+			     FIELD_PREP(MT_TXD2_SUB_TYPE,
+					MT7927_FC_STYPE_QOS_DATA));
+
+	val = FIELD_PREP(MT_TXD3_REM_TX_COUNT, MT7927_TXD_REM_TX_COUNT);
+	if (!sta->eth_hdr)
+		val |= FIELD_PREP(MT_TXD3_SEQ, seq) | MT_TXD3_SN_VALID;
+	if (sta->protect)
+		val |= MT_TXD3_PROTECT_FRAME;
+	txd[3] = cpu_to_le32(val);
+
+	if (sta->fixed_rate)
+		txd[6] = cpu_to_le32(FIELD_PREP(MT_TXD6_TX_RATE,
+						sta->fixed_rate));
+}
+
+static struct mt7927_txd_tmpl *mt7927_txd_tmpl_get(struct mt7927_sta *sta,
+						   u8 tid)
+{
+	struct mt7927_txd_tmpl *t = &sta->tmpl[tid];
+
+	if (unlikely(t->gen != sta->gen)) {
+		mt7927_txd_build(sta, tid, 0, 0, t->txd);
+		t->gen = sta->gen;
+		sta->tmpl_builds++;
+	}
+
+	return t;
+}
+
+/*
+ * Fast path: write the TXD for a @len byte frame on @tid into @txd and,
+ * for 802.11 frames, consume one sequence number. Returns the sequence
+ * number used (0 for 802.3 frames, the MAC assigns it).
+ */
+static u16 mt7927_txd_write(struct mt7927_sta *sta, u8 tid, u16 len,
+			    __le32 *txd)
+{
+	struct mt7927_txd_tmpl *t = mt7927_txd_tmpl_get(sta, tid);
+	u16 seq = 0;
+
+	memcpy(txd, t->txd, MT7927_TXD_SIZE);
+	txd[0] |= cpu_to_le32(FIELD_PREP(MT_TXD0_TX_BYTES,
+					 MT7927_TXD_SIZE + len));
+	if (!sta->eth_hdr) {
+		seq = t->seq;
+		txd[3] |= cpu_to_le32(FIELD_PREP(MT_TXD3_SEQ, seq));
+		t->seq = (seq + 1) & MT7927_SEQ_MASK;
+	}
+
+	return seq;
+}
+
+/*
+ * Every MT7927_TXS_INTERVAL, have the MAC report the status of one frame
+ * of @sta. mt7927_txs_event() takes the rate the firmware rate control
+ * actually used from it; the template stays free of per-frame bits.
+ */
+static void mt7927_txs_request(struct mt7927_sta *sta, __le32 *txd)
+{
+	if (time_before(jiffies, sta->txs_next))
+		return;
+
+	sta->txs_next = jiffies + MT7927_TXS_INTERVAL;
+	txd[5] |= cpu_to_le32(MT_TXD5_TX_STATUS_HOST |
+			      FIELD_PREP(MT_TXD5_PID, MT7927_PID_RATE));
+}
+
+/*
+ * Put the TXD in front of @skb, which holds an 802.3 frame if the station
+ * is in hw_encap mode and an 802.11 frame otherwise. Needs
+ * MT7927_TXD_SIZE bytes of headroom.
+ */
+static int mt7927_tx_write_txd(struct mt7927_sta *sta, u8 tid,
+			       struct sk_buff *skb)
+{
+	const struct ethhdr *eth = (const struct ethhdr *)skb->data;
+	__le32 *txd;
+
+	if (skb_headroom(skb) < MT7927_TXD_SIZE)
+		return -ENOSPC;
+	if (sta->eth_hdr && skb->len < ETH_HLEN)
+		return -EINVAL;
+
+	txd = skb_push(skb, MT7927_TXD_SIZE);
+	mt7927_txd_write(sta, tid, skb->len - MT7927_TXD_SIZE, txd);
+	mt7927_txs_request(sta, txd);
+
+	/* Length/LLC frames: the MAC must not add a SNAP header */
+	if (sta->eth_hdr && be16_to_cpu(eth->h_proto) < ETH_P_802_3_MIN)
+		txd[1] &= ~cpu_to_le32(MT_TXD1_ETH_802_3);
+
+	return 0;
+}
+
+/*
+ * Templates are built for MLO link 0. For another link @l, give @txd
+ * that link's WLAN index, own MAC, band and LMAC queue.
+ */
+static void mt7927_txd_set_link(struct mt7927_dev *dev,
+				const struct mt7927_sta *sta, u8 l, u8 tid,
+				__le32 *txd)
+{
+	const struct mt7927_link *link = &dev->link[l];
+	u8 q_idx = link->wmm_idx * MT_LMAC_WMM_SETS + mt7927_tid_to_lmac[tid];
+
+	if (!l)
+		return;
+
+	txd[0] &= ~cpu_to_le32(MT_TXD0_Q_IDX);
+	txd[0] |= cpu_to_le32(FIELD_PREP(MT_TXD0_Q_IDX, q_idx));
+	txd[1] &= ~cpu_to_le32(MT_TXD1_WLAN_IDX | MT_TXD1_OWN_MAC |
+			       MT_TXD1_TGID);
+	txd[1] |= cpu_to_le32(FIELD_PREP(MT_TXD1_WLAN_IDX, sta->link_wcid[l]) |
+			      FIELD_PREP(MT_TXD1_OWN_MAC, link->omac_idx) |
+			      FIELD_PREP(MT_TXD1_TGID, link->band_idx));
+}
+#endif /* CONFIG_MT7927_SELFTEST */
+
+/* =============================================================================
+ * TX A-MSDU Aggregation
+ * =============================================================================
+ *
+ * Game and VoIP traffic is mostly frames of a few hundred bytes, where
+ * the per-frame TXD, ring descriptor and doorbell cost more than the
+ * copy. Small 802.3 frames of one station/TID are therefore held briefly
+ * and sent up to MT7927_TXP_MAX_MSDU at a time behind a single CT-mode
+ * TXD: the TXP after it points at each frame (two per buf0/buf1 pair)
+ * and MT_TXD3_HW_AMSDU has the MAC build the A-MSDU subframes.
+ *
+ * A flow is flushed when its TXP is full, when the next frame would take
+ * it past max_len, when its first frame has waited max_us, and at the
+ * end of every burst (@more false, as with xmit_more). Descriptors are
+ * collected in a struct mt7927_tx_batch and posted with one doorbell.
+ *
+ * Callers serialize per station/TID, as for mt7927_txd_write(), and hold
+ * dma_mutex for the TX arena: frames up to tx_copybreak are copied into
+ * it (mt7927_tx_map()), longer ones mapped. The TXD and TXP go in the
+ * headroom of the first frame; each frame holds its own token and slot
+ * or mapping, so TX-free events reclaim them as usual.
+ */
+
+#define MT7927_TXP_HDR_SIZE	(MT7927_TXD_SIZE + sizeof(struct mt7927_hw_txp))
+
+#ifdef CONFIG_MT7927_SELFTEST
+/*
+ * Post the descriptors of @b with one doorbell per ring. Called under
+ * dma_mutex. If the chip cannot be woken the descriptors are dropped,
+ * as they are on this tree anyway until there is a ring to copy them to.
+ */
+static void mt7927_tx_batch_kick(struct mt7927_dev *dev,
+				 struct mt7927_tx_batch *b)
+{
+	unsigned long rings = 0;
+	u16 i;
+
+	if (!b->ndesc)
+		return;
+
+	/* pm.fail_cnt counts these */
+	if (mt7927_pm_access(dev)) {
+		b->ndesc = 0;
+		return;
+	}
+
+	/*
+	 * No data ring is set up yet. Once there is, each desc[] entry is
+	 * copied to its ring here, followed by wmb() and one CIDX write per
+	 * ring used.
+	 */
+	for (i = 0; i < b->ndesc; i++)
+		rings |= BIT(b->ring[i]);
+
+	mt7927_mock_tx(dev, b, rings);
+
+	dev->amsdu_stats.kicks += hweight8(rings);
+	b->ndesc = 0;
+}
+
+static void mt7927_tx_batch_add(struct mt7927_dev *dev,
+				struct mt7927_tx_batch *b, dma_addr_t dma,
+				u16 len, u8 ring)
+{
+	struct mt76_desc *desc = &b->desc[b->ndesc];
+
+	b->ring[b->ndesc++] = ring;
+
+	desc->info = cpu_to_le32(mt7927_desc_set_buf(dev, desc, dma, 0));
+	desc->ctrl = cpu_to_le32(FIELD_PREP(MT_DMA_CTL_SD_LEN0, len) |
+				 MT_DMA_CTL_LAST_SEC0);
+	dev->amsdu_stats.descs++;
+
+	if (b->ndesc == MT7927_TX_BATCH)
+		mt7927_tx_batch_kick(dev, b);
+}
+
+/* One frame, one SF-mode descriptor: the path without aggregation */
+static int mt7927_tx_single(struct mt7927_dev *dev, struct mt7927_sta *sta,
+			    u8 tid, struct sk_buff *skb,
+			    struct mt7927_tx_batch *b)
+{
+	dma_addr_t dma;
+	int ret, id;
+	u8 l;
+
+	ret = mt7927_tx_write_txd(sta, tid, skb);
+	if (ret)
+		goto drop;
+
+	l = mt7927_mlo_select(dev, sta, tid, skb->len);
+	mt7927_txd_set_link(dev, sta, l, tid, (__le32 *)skb->data);
+
+	ret = mt7927_tx_map(dev, skb->data, skb->len, &dma);
+	if (ret)
+		goto drop;
+
+	id = mt7927_token_get(dev, skb, dma, skb->len, l);
+	if (id < 0) {
+		mt7927_tx_unmap_buf(dev, dma, skb->len);
+		ret = id;
+		goto drop;
+	}
+
+	mt7927_tx_batch_add(dev, b, dma, skb->len, dev->link[l].ring);
+	dev->link[l].tx_msdus++;
+	dev->link[l].tx_bytes += skb->len;
+	return 0;
+
+drop:
+	dev->amsdu_stats.drop++;
+	dev_kfree_skb_any(skb);
+	return ret;
+}
+
+/*
+ * Map and tokenize the frames of @a behind one TXD+TXP. Returns -ERANGE,
+ * with nothing taken, if a frame lands above 4 GB: TXP pointers only
+ * carry 32 bits. Arena slots never do.
+ *
+ * The TXP lives in the first frame, which is mapped or copied before the
+ * token IDs and addresses it holds are known. Once filled in it is copied
+ * to the arena slot again, or synced to the device (the mapping may be a
+ * bounce buffer, or not coherent).
+ */
+static int mt7927_amsdu_map(struct mt7927_dev *dev, struct mt7927_amsdu *a,
+			    u8 link, dma_addr_t *hdr_dma)
+{
+	struct mt7927_hw_txp *txp = (void *)a->skb[0]->data + MT7927_TXD_SIZE;
+	int id[MT7927_TXP_MAX_MSDU];
+	struct mt7927_txp_ptr *ptr;
+	struct sk_buff *skb;
+	dma_addr_t dma;
+	void *slot;
+	u16 len;
+	int i, ret;
+
+	for (i = 0; i < a->nframes; i++) {
+		skb = a->skb[i];
+		ret = mt7927_tx_map(dev, skb->data, skb->len, &dma);
+		if (ret)
+			goto unwind;
+
+		if (upper_32_bits(dma + skb->len - 1)) {
+			mt7927_tx_unmap_buf(dev, dma, skb->len);
+			ret = -ERANGE;
+			goto unwind;
+		}
+
+		id[i] = mt7927_token_get(dev, skb, dma, skb->len, link);
+		if (id[i] < 0) {
+			mt7927_tx_unmap_buf(dev, dma, skb->len);
+			ret = id[i];
+			goto unwind;
+		}
+
+		/* The first frame's mapping also covers the TXD and TXP */
+		if (!i) {
+			*hdr_dma = dma;
+			dma += MT7927_TXP_HDR_SIZE;
+		}
+
+		len = FIELD_PREP(MT_TXD_LEN_MASK,
+				 skb->len - (i ? 0 : MT7927_TXP_HDR_SIZE)) |
+		      MT_TXD_LEN_MSDU_LAST;
+		if (i == a->nframes - 1)
+			len |= MT_TXD_LEN_AMSDU_LAST;
+
+		txp->msdu_id[i] = cpu_to_le16(id[i] | MT_MSDU_ID_VALID);
+		ptr = &txp->ptr[i / 2];
+		if (i & 1) {
+			ptr->buf1 = cpu_to_le32(dma);
+			ptr->len1 = cpu_to_le16(len);
+		} else {
+			ptr->buf0 = cpu_to_le32(dma);
+			ptr->len0 = cpu_to_le16(len);
+		}
+	}
+
+	slot = mt7927_tx_arena_va(dev, *hdr_dma);
+	if (slot)
+		memcpy(slot, a->skb[0]->data, MT7927_TXP_HDR_SIZE);
+	else
+		dma_sync_single_for_device(&dev->pdev->dev, *hdr_dma,
+					   MT7927_TXP_HDR_SIZE, DMA_TO_DEVICE);
+
+	return 0;
+
+unwind:
+	while (i--)
+		mt7927_token_release(dev, id[i]);
+	return ret;
+}
+
+/* Send what @a holds. Frames that cannot be sent are dropped. */
+static void mt7927_amsdu_flush(struct mt7927_dev *dev, struct mt7927_amsdu *a,
+			       struct mt7927_tx_batch *b)
+{
+	struct mt7927_amsdu_stats *st = &dev->amsdu_stats;
+	struct sk_buff *head = a->skb[0];
+	struct mt7927_hw_txp *txp;
+	dma_addr_t dma;
+	__le32 *txd;
+	int i;
+	u8 l;
+
+	if (!a->nframes)
+		return;
+
+	/* A lone frame needs no TXP */
+	if (a->nframes == 1) {
+		mt7927_tx_single(dev, a->sta, a->tid, head, b);
+		goto out;
+	}
+
+	txd = skb_push(head, MT7927_TXP_HDR_SIZE);
+	txp = (void *)txd + MT7927_TXD_SIZE;
+	memset(txp, 0, sizeof(*txp));
+
+	mt7927_txd_write(a->sta, a->tid, a->len, txd);
+	txd[0] &= ~cpu_to_le32(MT_TXD0_PKT_FMT);	/* MT_TX_TYPE_CT */
+	txd[3] |= cpu_to_le32(MT_TXD3_HW_AMSDU);
+	mt7927_txs_request(a->sta, txd);
+	l = mt7927_mlo_select(dev, a->sta, a->tid, a->len);
+	mt7927_txd_set_link(dev, a->sta, l, a->tid, txd);
+
+	switch (mt7927_amsdu_map(dev, a, l, &dma)) {
+	case 0:
+		mt7927_tx_batch_add(dev, b, dma, MT7927_TXP_HDR_SIZE,
+				    dev->link[l].ring);
+		dev->link[l].tx_msdus += a->nframes;
+		dev->link[l].tx_bytes += a->len;
+		st->aggs++;
+		break;
+	case -ERANGE:
+		st->high_dma++;
+		skb_pull(head, MT7927_TXP_HDR_SIZE);
+		for (i = 0; i < a->nframes; i++)
+			mt7927_tx_single(dev, a->sta, a->tid, a->skb[i], b);
+		break;
+	default:
+		for (i = 0; i < a->nframes; i++) {
+			dev_kfree_skb_any(a->skb[i]);
+			st->drop++;
+		}
+		break;
+	}
+
+out:
+	memset(a->skb, 0, sizeof(a->skb));
+	a->nframes = 0;
+	a->len = 0;
+}
+
+/* Flush every flow holding frames, then post the batch */
+static void mt7927_tx_batch_flush(struct mt7927_dev *dev,
+				  struct mt7927_tx_batch *b)
+{
+	u16 i;
+
+	for (i = 0; i < b->npending; i++) {
+		mt7927_amsdu_flush(dev, b->pending[i], b);
+		b->pending[i]->queued = false;
+	}
+	b->npending = 0;
+
+	mt7927_tx_batch_kick(dev, b);
+}
+
+/*
+ * Send the 802.3 frame @skb on @sta/@tid through the A-MSDU stage. @more
+ * tells that another frame follows at once; without it all held frames
+ * go out and @b is posted. Frames that cannot join an aggregate (too
+ * big, no Ethernet II type, no headroom, 802.11 station) take the
+ * single-frame path, after whatever the flow holds.
+ */
+static void mt7927_amsdu_add(struct mt7927_dev *dev, struct mt7927_sta *sta,
+			     u8 tid, struct sk_buff *skb,
+			     struct mt7927_tx_batch *b, bool more)
+{
+	struct mt7927_amsdu_stats *st = &dev->amsdu_stats;
+	struct mt7927_amsdu *a = &sta->amsdu[tid];
+	const struct ethhdr *eth = (const struct ethhdr *)skb->data;
+
+	st->msdus++;
+
+	if (!sta->eth_hdr || skb->len < ETH_HLEN || skb->len > a->max_len ||
+	    be16_to_cpu(eth->h_proto) < ETH_P_802_3_MIN) {
+		mt7927_amsdu_flush(dev, a, b);
+		mt7927_tx_single(dev, sta, tid, skb, b);
+		goto out;
+	}
+
+	if (a->nframes) {
+		if (a->len + skb->len > a->max_len) {
+			st->flush_len++;
+			mt7927_amsdu_flush(dev, a, b);
+		} else if (local_clock() - a->start_ns >
+			   (u64)a->max_us * NSEC_PER_USEC) {
+			st->flush_time++;
+			mt7927_amsdu_flush(dev, a, b);
+		}
+	}
+
+	if (!a->nframes) {
+		/* The first frame carries the TXD and TXP */
+		if (skb_headroom(skb) < MT7927_TXP_HDR_SIZE) {
+			mt7927_tx_single(dev, sta, tid, skb, b);
+			goto out;
+		}
+
+		if (!a->queued) {
+			if (b->npending == MT7927_TX_BATCH)
+				mt7927_tx_batch_flush(dev, b);
+			b->pending[b->npending++] = a;
+			a->queued = true;
+		}
+		a->start_ns = local_clock();
+	}
+
+	a->skb[a->nframes++] = skb;
+	a->len += skb->len;
+
+	if (a->nframes == MT7927_TXP_MAX_MSDU) {
+		st->flush_full++;
+		mt7927_amsdu_flush(dev, a, b);
+	}
+
+out:
+	if (!more) {
+		if (b->npending)
+			st->flush_kick++;
+		mt7927_tx_batch_flush(dev, b);
+	}
+}
+#endif /* CONFIG_MT7927_SELFTEST */
+
+/* =============================================================================
+ * Block Ack Sessions
+ * =============================================================================
+ *
+ * A-MPDU aggregation is run by the firmware: once a TID has a TX session
+ * it builds A-MPDUs and handles the BARs and block acks, and with an RX
+ * session it sends the block acks for the peer's A-MPDUs. The host only
+ * sets sessions up and tears them down with STA_REC_UPDATE and a BA TLV,
+ * and for RX keeps the reorder buffer above.
+ *
+ * Stations live in dev->sta[], indexed by WLAN (WTBL) index, which is how
+ * mt7927_rx_data() finds them from the RXD. They are published and
+ * retired with RCU; the table and all sessions are changed under
+ * sta_mutex. With no mac80211 attached yet, stations and sessions are
+ * created from debugfs (files sta and ba).
+ */
+
+static int mt7927_mcu_sta_ba(struct mt7927_dev *dev,
+			     const struct mt7927_sta *sta, u8 tid, bool tx,
+			     bool enable, u16 ssn, u16 winsize, bool amsdu)
+{
+	struct {
+		struct mt7927_sta_req_hdr hdr;
+		struct mt7927_sta_rec_ba ba;
+	} __packed req = {
+		.hdr = {
+			.bss_idx = sta->omac_idx,
+			.wlan_idx_lo = sta->wcid & 0xff,
+			.tlv_num = cpu_to_le16(1),
+			.is_tlv_append = 1,
+			.muar_idx = sta->omac_idx,
+			.wlan_idx_hi = sta->wcid >> 8,
+		},
+		.ba = {
+			.tag = cpu_to_le16(UNI_STA_REC_BA),
+			.len = cpu_to_le16(sizeof(struct mt7927_sta_rec_ba)),
+			.tid = tid,
+			.ba_type = tx ? MT_BA_TYPE_ORIGINATOR :
+					MT_BA_TYPE_RECIPIENT,
+			.amsdu = amsdu,
+			.ba_en = enable << tid,
+			.ssn = cpu_to_le16(ssn),
+			.winsize = cpu_to_le16(winsize),
+		},
+	};
+
+	return mt7927_mcu_send_uni(dev, MCU_UNI_CMD_STA_REC_UPDATE, &req,
+				   sizeof(req));
+}
+
+static int mt7927_ba_tx_start(struct mt7927_dev *dev, struct mt7927_sta *sta,
+			      u8 tid, u16 ssn, u16 winsize, bool amsdu)
+{
+	int ret;
+
+	lockdep_assert_held(&dev->sta_mutex);
+
+	if (tid >= MT7927_NUM_TIDS || !winsize || winsize > MT7927_BA_WIN_MAX)
+		return -EINVAL;
+
+	ret = mt7927_mcu_sta_ba(dev, sta, tid, true, true, ssn, winsize,
+				amsdu);
+	if (ret)
+		return ret;
+
+	sta->ba_tx[tid].ssn = ssn & MT7927_SEQ_MASK;
+	sta->ba_tx[tid].winsize = winsize;
+	sta->ba_tx[tid].amsdu = amsdu;
+	set_bit(tid, &sta->ba_tx_mask);
+
+	return 0;
+}
+
+static int mt7927_ba_tx_stop(struct mt7927_dev *dev, struct mt7927_sta *sta,
+			     u8 tid)
+{
+	lockdep_assert_held(&dev->sta_mutex);
+
+	if (tid >= MT7927_NUM_TIDS)
+		return -EINVAL;
+
+	if (!test_and_clear_bit(tid, &sta->ba_tx_mask))
+		return 0;
+
+	return mt7927_mcu_sta_ba(dev, sta, tid, true, false, 0, 0, false);
+}
+
+/*
+ * Tear down the RX session of @tid. The reorder buffer goes away even if
+ * the firmware does not answer, its held frames are dropped.
+ */
+static int mt7927_ba_rx_stop(struct mt7927_dev *dev, struct mt7927_sta *sta,
+			     u8 tid)
+{
+	struct mt7927_rx_tid *rx_tid;
+
+	lockdep_assert_held(&dev->sta_mutex);
+
+	if (tid >= MT7927_NUM_TIDS)
+		return -EINVAL;
+
+	rx_tid = rcu_dereference_protected(sta->rx_tid[tid],
+					   lockdep_is_held(&dev->sta_mutex));
+	if (!rx_tid)
+		return 0;
+
+	RCU_INIT_POINTER(sta->rx_tid[tid], NULL);
+	mt7927_rx_tid_free(rx_tid);
+
+	return mt7927_mcu_sta_ba(dev, sta, tid, false, false, 0, 0, false);
+}
+
+static int mt7927_ba_rx_start(struct mt7927_dev *dev, struct mt7927_sta *sta,
+			      u8 tid, u16 ssn, u16 winsize)
+{
+	struct mt7927_rx_tid *rx_tid;
+	int ret;
+
+	lockdep_assert_held(&dev->sta_mutex);
+
+	if (tid >= MT7927_NUM_TIDS || !winsize || winsize > MT7927_BA_WIN_MAX)
+		return -EINVAL;
+
+	/* A new ADDBA replaces the old session */
+	mt7927_ba_rx_stop(dev, sta, tid);
+
+	rx_tid = mt7927_rx_tid_alloc(dev, tid, ssn, winsize);
+	if (!rx_tid)
+		return -ENOMEM;
+
+	ret = mt7927_mcu_sta_ba(dev, sta, tid, false, true, ssn, winsize,
+				false);
+	if (ret) {
+		kfree(rx_tid);
+		return ret;
+	}
+
+	rcu_assign_pointer(sta->rx_tid[tid], rx_tid);
+
+	return 0;
+}
+
+static struct mt7927_sta *mt7927_sta_get(struct mt7927_dev *dev, u16 wcid)
+{
+	if (wcid >= MT7927_WTBL_SIZE)
+		return NULL;
+
+	return rcu_dereference_protected(dev->sta[wcid],
+					 lockdep_is_held(&dev->sta_mutex));
+}
+
+static int mt7927_sta_add(struct mt7927_dev *dev, u16 wcid, u8 omac_idx,
+			  u8 wmm_idx)
+{
+	struct mt7927_sta *sta;
+	int ret;
+
+	lockdep_assert_held(&dev->sta_mutex);
+
+	if (wcid >= MT7927_WTBL_SIZE)
+		return -EINVAL;
+
+	if (mt7927_sta_get(dev, wcid))
+		return -EEXIST;
+
+	/* First station: the data path needs its tokens now */
+	ret = mt7927_token_init(dev);
+	if (ret)
+		return ret;
+
+	sta = kzalloc(sizeof(*sta), GFP_KERNEL);
+	if (!sta)
+		return -ENOMEM;
+
+	mt7927_sta_init(sta, wcid, omac_idx, wmm_idx);
+	rcu_assign_pointer(dev->sta[wcid], sta);
+
+	return 0;
+}
+
+/*
+ * Make @sta an MLD station with WLAN index @wcid on link @l. Frames from
+ * @wcid then go through the station's reorder buffers. Host side only,
+ * like mt7927_sta_add(): no STA_REC goes to the firmware, that is for
+ * the connection code to send once it exists.
+ */
+static int mt7927_sta_add_link(struct mt7927_dev *dev, struct mt7927_sta *sta,
+			       u8 l, u16 wcid)
+{
+	lockdep_assert_held(&dev->sta_mutex);
+
+	if (!l || l >= MT7927_MAX_LINKS || wcid >= MT7927_WTBL_SIZE ||
+	    (sta->link_mask & BIT(l)))
+		return -EINVAL;
+
+	if (mt7927_sta_get(dev, wcid))
+		return -EEXIST;
+
+	sta->link_wcid[l] = wcid;
+	sta->link_mask |= BIT(l);
+	rcu_assign_pointer(dev->sta[wcid], sta);
+
+	return 0;
+}
+
+/* Stop all sessions of station @wcid, on any of its links, and free it */
+static int mt7927_sta_remove(struct mt7927_dev *dev, u16 wcid)
+{
+	struct mt7927_sta *sta;
+	u8 tid, l;
+
+	lockdep_assert_held(&dev->sta_mutex);
+
+	sta = mt7927_sta_get(dev, wcid);
+	if (!sta)
+		return -ENOENT;
+
+	for (tid = 0; tid < MT7927_NUM_TIDS; tid++) {
+		mt7927_ba_tx_stop(dev, sta, tid);
+		mt7927_ba_rx_stop(dev, sta, tid);
+	}
+
+	for (l = 0; l < MT7927_MAX_LINKS; l++)
+		if (sta->link_mask & BIT(l))
+			RCU_INIT_POINTER(dev->sta[sta->link_wcid[l]], NULL);
+	synchronize_rcu();
+	kfree(sta);
+
+	return 0;
+}
+
+/* Driver unbind: free all stations without telling the firmware */
+static void mt7927_sta_free_all(struct mt7927_dev *dev)
+{
+	struct mt7927_sta *sta[MT7927_WTBL_SIZE];
+	struct mt7927_rx_tid *rx_tid;
+	u16 wcid;
+	u8 tid;
+
+	mutex_lock(&dev->sta_mutex);
+	for (wcid = 0; wcid < MT7927_WTBL_SIZE; wcid++) {
+		sta[wcid] = mt7927_sta_get(dev, wcid);
+		if (!sta[wcid])
+			continue;
+
+		/* MLD link entries: the station goes with its primary */
+		RCU_INIT_POINTER(dev->sta[wcid], NULL);
+		if (sta[wcid]->wcid != wcid) {
+			sta[wcid] = NULL;
+			continue;
+		}
+
+		for (tid = 0; tid < MT7927_NUM_TIDS; tid++) {
+			rx_tid = rcu_dereference_protected(sta[wcid]->rx_tid[tid],
+							   true);
+			if (rx_tid)
+				mt7927_rx_tid_free(rx_tid);
+		}
+	}
+	mutex_unlock(&dev->sta_mutex);
+
+	synchronize_rcu();
+	for (wcid = 0; wcid < MT7927_WTBL_SIZE; wcid++)
+		kfree(sta[wcid]);
+}
+
+/*
+ * Send the BA sessions of @sta to the firmware again, TX from the TID's
+ * next sequence number and RX from the reorder window's head. Without
+ * @replay, or if the firmware refuses, the session is torn down on the
+ * host only.
+ */
+static void mt7927_sta_restore_ba(struct mt7927_dev *dev,
+				  struct mt7927_sta *sta, bool replay)
+{
+	struct mt7927_rx_tid *rx_tid;
+	struct mt7927_ba_tx *ba;
+	u16 ssn;
+	u8 tid;
+
+	for (tid = 0; tid < MT7927_NUM_TIDS; tid++) {
+		if (test_bit(tid, &sta->ba_tx_mask)) {
+			ba = &sta->ba_tx[tid];
+			ssn = sta->tmpl[tid].seq & MT7927_SEQ_MASK;
+			if (replay &&
+			    !mt7927_mcu_sta_ba(dev, sta, tid, true, true, ssn,
+					       ba->winsize, ba->amsdu))
+				ba->ssn = ssn;
+			else
+				clear_bit(tid, &sta->ba_tx_mask);
+		}
+
+		rx_tid = rcu_dereference_protected(sta->rx_tid[tid],
+						   lockdep_is_held(&dev->sta_mutex));
+		if (!rx_tid)
+			continue;
+
+		spin_lock_bh(&rx_tid->lock);
+		ssn = rx_tid->head;
+		spin_unlock_bh(&rx_tid->lock);
+
+		if (replay &&
+		    !mt7927_mcu_sta_ba(dev, sta, tid, false, true, ssn,
+				       rx_tid->size, false))
+			continue;
+
+		RCU_INIT_POINTER(sta->rx_tid[tid], NULL);
+		mt7927_rx_tid_free(rx_tid);
+	}
+}
+
+/*
+ * A chip reset wiped the link channels and BA sessions in firmware.
+ * With @replay they are sent again; whatever is not restored (the reset
+ * failed, or the firmware refused) is torn down on the host, so no link
+ * or session stays marked live that the firmware does not know. Station
+ * entries are host side only (see mt7927_sta_add_link()) and stay.
+ */
+static void mt7927_sta_restore(struct mt7927_dev *dev, bool replay)
+{
+	struct mt7927_link *link;
+	struct mt7927_sta *sta;
+	u16 wcid;
+	u8 l;
+
+	mutex_lock(&dev->sta_mutex);
+
+	for (l = 0; l < MT7927_MAX_LINKS; l++) {
+		link = &dev->link[l];
+		if (!link->active ||
+		    (replay && !mt7927_mcu_set_chan(dev, l, &link->chandef)))
+			continue;
+
+		dev_warn(&dev->pdev->dev, "Link %u not restored after reset\n",
+			 l);
+		mt7927_link_remove(dev, l);
+	}
+
+	for (wcid = 0; wcid < MT7927_WTBL_SIZE; wcid++) {
+		sta = mt7927_sta_get(dev, wcid);
+
+		/* MLD link entries: the sessions live with the primary */
+		if (sta && sta->wcid == wcid)
+			mt7927_sta_restore_ba(dev, sta, replay);
+	}
+
+	mutex_unlock(&dev->sta_mutex);
+}
+
+/* =============================================================================
+ * Debugfs
+ * =============================================================================
+ */
+
+static struct dentry *mt7927_debugfs_root;
+
+/* Sorted, flattened copy of all per-CPU trace rings */
+struct mt7927_trace_snap {
+	size_t n;
+	struct mt7927_trace_ent ent[];
+};
+
+static int mt7927_trace_cmp(const void *a, const void *b)
+{
+	const struct mt7927_trace_ent *ea = a, *eb = b;
+
+	if (ea->ts == eb->ts)
+		return 0;
+	return ea->ts < eb->ts ? -1 : 1;
+}
+
+static void *mt7927_trace_seq_start(struct seq_file *s, loff_t *pos)
+{
+	struct mt7927_trace_snap *snap = s->private;
+
+	return *pos < snap->n ? &snap->ent[*pos] : NULL;
+}
+
+static void *mt7927_trace_seq_next(struct seq_file *s, void *v, loff_t *pos)
+{
+	++*pos;
+	return mt7927_trace_seq_start(s, pos);
+}
+
+static void mt7927_trace_seq_stop(struct seq_file *s, void *v)
+{
+}
+
+static void mt7927_trace_seq_prefix(struct seq_file *s,
+				    const struct mt7927_trace_ent *e)
+{
+	u64 ts = e->ts;
+	u32 rem_ns = do_div(ts, NSEC_PER_SEC);
+
+	seq_printf(s, "[%5llu.%06u] cpu%u ", ts, rem_ns / 1000, e->cpu);
+}
+
+/*
+ * Decode one entry into the same text the old dev_info logging printed,
+ * prefixed with timestamp/CPU and suffixed with the call site.
+ */
+static int mt7927_trace_seq_show(struct seq_file *s, void *v)
+{
+	const struct mt7927_trace_ent *e = v;
+	u32 base = e->offset & ~(MT_HIF_REMAP_WINDOW_SIZE - 1);
+	u32 off = e->offset & (MT_HIF_REMAP_WINDOW_SIZE - 1);
+	dma_addr_t dma;
+
+	mt7927_trace_seq_prefix(s, e);
+
+	switch (e->op) {
+	case MT7927_TRACE_WR:
+		seq_printf(s, "  WRITE [0x%08x] %s: 0x%08x -> write 0x%08x -> read 0x%08x %s",
+			   e->offset, e->name, e->val[0], e->val[1], e->val[2],
+			   (e->val[2] == e->val[1]) ? "OK" : "MISMATCH!");
+		break;
+	case MT7927_TRACE_RR_REMAP:
+		seq_printf(s, "  REMAP READ [0x%08x] = 0x%08x (window: base=0x%x, off=0x%x)",
+			   e->offset, e->val[0], base, off);
+		break;
+	case MT7927_TRACE_WR_REMAP:
+		seq_printf(s, "  REMAP WRITE [0x%08x] = 0x%08x (window: base=0x%x, off=0x%x)",
+			   e->offset, e->val[0], base, off);
+		break;
+	case MT7927_TRACE_DESC_MCU:
+		seq_printf(s, "  MCU Desc: buf0=0x%08x ctrl=0x%08x len=%d",
+			   e->val[0], e->val[1], e->val[2]);
+		break;
+	case MT7927_TRACE_DESC_FW:
+		seq_printf(s, "  Desc: buf0=0x%08x buf1=0x%08x ctrl=0x%08x info=0x%08x (%pS)\n",
+			   e->val[0], e->val[1], e->val[2], e->val[3],
+			   (void *)e->ip);
+		dma = ((u64)FIELD_GET(MT_DMA_CTL_SDP0_H, e->val[3]) << 32) |
+		      e->val[0];
+		mt7927_trace_seq_prefix(s, e);
+		seq_printf(s, "  TX queue: idx=%u, len=%lu, dma=%pad, new_head=%u",
+			   e->offset, FIELD_GET(MT_DMA_CTL_SD_LEN0, e->val[2]),
+			   &dma, e->val[4]);
+		break;
+	default:
+		seq_printf(s, "  op %u [0x%08x]", e->op, e->offset);
+		break;
+	}
+
+	seq_printf(s, " (%pS)\n", (void *)e->ip);
+	return 0;
+}
+
+static const struct seq_operations mt7927_trace_seq_ops = {
+	.start = mt7927_trace_seq_start,
+	.next = mt7927_trace_seq_next,
+	.stop = mt7927_trace_seq_stop,
+	.show = mt7927_trace_seq_show,
+};
+
+static int mt7927_trace_open(struct inode *inode, struct file *file)
+{
+	struct mt7927_dev *dev = inode->i_private;
+	struct mt7927_trace_snap *snap;
+	size_t n = 0;
+	int cpu, ret;
+
+	snap = vmalloc(struct_size(snap, ent, (size_t)num_possible_cpus() *
+				   MT7927_TRACE_ENTRIES));
+	if (!snap)
+		return -ENOMEM;
+
+	for_each_possible_cpu(cpu) {
+		struct mt7927_trace_buf *buf = per_cpu_ptr(dev->trace, cpu);
+		unsigned long head = local_read(&buf->head);
+		unsigned long i = 0;
+
+		if (head > MT7927_TRACE_ENTRIES)
+			i = head - MT7927_TRACE_ENTRIES;
+
+		for (; i < head; i++) {
+			snap->ent[n] = buf->ent[i & (MT7927_TRACE_ENTRIES - 1)];
+			snap->ent[n].cpu = cpu;
+			n++;
+		}
+	}
+	snap->n = n;
+
+	sort(snap->ent, n, sizeof(snap->ent[0]), mt7927_trace_cmp, NULL);
+
+	ret = seq_open(file, &mt7927_trace_seq_ops);
+	if (ret) {
+		vfree(snap);
+		return ret;
+	}
+
+	((struct seq_file *)file->private_data)->private = snap;
+	return 0;
+}
+
+static int mt7927_trace_release(struct inode *inode, struct file *file)
+{
+	vfree(((struct seq_file *)file->private_data)->private);
+	return seq_release(inode, file);
+}
+
+/* Any write clears the trace */
+static ssize_t mt7927_trace_write(struct file *file, const char __user *ubuf,
+				  size_t count, loff_t *ppos)
+{
+	struct mt7927_dev *dev = file_inode(file)->i_private;
+	int cpu;
+
+	for_each_possible_cpu(cpu)
+		local_set(&per_cpu_ptr(dev->trace, cpu)->head, 0);
+
+	return count;
+}
+
+static const struct file_operations mt7927_trace_fops = {
+	.owner = THIS_MODULE,
+	.open = mt7927_trace_open,
+	.read = seq_read,
+	.write = mt7927_trace_write,
+	.llseek = seq_lseek,
+	.release = mt7927_trace_release,
+};
+
+static int mt7927_probe_timing_show(struct seq_file *s, void *data)
+{
+	struct mt7927_dev *dev = s->private;
+	const struct mt7927_timing *t = &dev->timing;
+	struct mt7927_mmio_cnt mmio = mt7927_mmio_count(dev);
+	int i;
+
+	seq_printf(s, "%-12s %10s %10s %10s %8s %8s\n", "phase",
+		   "total_us", "sleep_us", "poll_us", "mmio_rd", "mmio_wr");
+
+	for (i = 0; i < __MT7927_PHASE_MAX; i++) {
+		const struct mt7927_phase_stats *ps = &t->phases[i];
+
+		if (!ps->done) {
+			seq_printf(s, "%-12s %10s\n", mt7927_phase_names[i], "-");
+			continue;
+		}
+
+		seq_printf(s, "%-12s %10llu %10llu %10llu %8llu %8llu\n",
+			   mt7927_phase_names[i],
+			   div_u64(ps->time_ns, NSEC_PER_USEC),
+			   div_u64(ps->sleep_ns, NSEC_PER_USEC),
+			   div_u64(ps->time_ns - ps->sleep_ns, NSEC_PER_USEC),
+			   ps->mmio_rd, ps->mmio_wr);
+	}
+
+	seq_printf(s, "%-12s %10llu %10s %10s %8llu %8llu\n", "probe",
+		   div_u64(t->probe_ns, NSEC_PER_USEC), "", "",
+		   mmio.rd, mmio.wr);
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(mt7927_probe_timing);
+
+static int mt7927_pm_stats_show(struct seq_file *s, void *data)
+{
+	struct mt7927_dev *dev = s->private;
+	struct mt7927_pm *pm = &dev->pm;
+
+	mutex_lock(&pm->mutex);
+	seq_printf(s, "idle_ms:       %u\n", pm_idle_ms);
+	seq_printf(s, "owner:         %s\n", pm->fw_own ? "firmware" : "driver");
+	seq_printf(s, "doze:          %u\n", pm->doze_cnt);
+	seq_printf(s, "wake:          %u\n", pm->wake_cnt);
+	seq_printf(s, "fail:          %u\n", pm->fail_cnt);
+	seq_printf(s, "wake_last_us:  %llu\n", pm->last_wake_us);
+	seq_printf(s, "wake_max_us:   %llu\n", pm->max_wake_us);
+	seq_printf(s, "wake_avg_us:   %llu\n",
+		   pm->wake_cnt ? div_u64(pm->total_wake_us, pm->wake_cnt) : 0);
+	seq_printf(s, "suspend:       %u\n", pm->suspend_cnt);
+	seq_printf(s, "resume_cold:   %u\n", pm->resume_cold_cnt);
+	seq_printf(s, "resume_last_us: %llu\n", pm->last_resume_us);
+	seq_printf(s, "resume_max_us: %llu\n", pm->max_resume_us);
+	mutex_unlock(&pm->mutex);
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(mt7927_pm_stats);
+
+static int mt7927_aspm_show(struct seq_file *s, void *data)
+{
+	struct mt7927_dev *dev = s->private;
+	struct mt7927_aspm *aspm = &dev->aspm;
+
+	mutex_lock(&aspm->mutex);
+	if (aspm->capable)
+		mt7927_aspm_account(aspm);
+	seq_printf(s, "capable:       %s\n", aspm->capable ? "yes" : "no");
+	seq_printf(s, "l1:            %s\n", aspm->l1_on ? "enabled" : "disabled");
+	seq_printf(s, "hold:          fwdl=%u mcu=%u game=%u\n",
+		   aspm->hold[MT7927_ASPM_FWDL], aspm->hold[MT7927_ASPM_MCU],
+		   aspm->hold[MT7927_ASPM_GAME]);
+	seq_printf(s, "idle_ms:       %u\n", aspm_idle_ms);
+	seq_printf(s, "l1_on_ms:      %llu\n", div_u64(aspm->on_ns, NSEC_PER_MSEC));
+	seq_printf(s, "l1_off_ms:     %llu\n", div_u64(aspm->off_ns, NSEC_PER_MSEC));
+	seq_printf(s, "enable:        %u\n", aspm->enable_cnt);
+	seq_printf(s, "disable:       %u\n", aspm->disable_cnt);
+	mutex_unlock(&aspm->mutex);
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(mt7927_aspm);
+
+static int mt7927_dma_wd_show(struct seq_file *s, void *data)
+{
+	struct mt7927_dev *dev = s->private;
+	struct mt7927_wd *wd = &dev->wd;
+
+	seq_printf(s, "tx15_recover:  %u\n", wd->tx_mcu.recover_cnt);
+	seq_printf(s, "tx16_recover:  %u\n", wd->tx_fwdl.recover_cnt);
+	seq_printf(s, "rx0_recover:   %u\n", wd->rx_mcu.recover_cnt);
+	seq_printf(s, "last_us:       %llu\n", wd->last_recover_us);
+	seq_printf(s, "max_us:        %llu\n", wd->max_recover_us);
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(mt7927_dma_wd);
+
+static int mt7927_dma_addr_show(struct seq_file *s, void *data)
+{
+	struct mt7927_dev *dev = s->private;
+
+	seq_printf(s, "mask_bits:     %u\n", dev->dma_bits);
+	seq_printf(s, "ring16:        %pad\n", &dev->tx_ring_dma);
+	seq_printf(s, "ring15:        %pad\n", &dev->mcu_ring_dma);
+	seq_printf(s, "rx_ring0:      %pad\n", &dev->rx_ring_dma);
+	seq_printf(s, "rx_buf:        %pad\n", &dev->rx_buf_dma);
+	seq_printf(s, "above_4g:      %llu\n", dev->dma_high_cnt);
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(mt7927_dma_addr);
+
+static void mt7927_memory_line(struct seq_file *s, const char *name,
+			       size_t bytes, size_t *total)
+{
+	seq_printf(s, "%-14s %8zu\n", name, bytes);
+	*total += bytes;
+}
+
+/* Resident footprint per allocation, in bytes */
+static int mt7927_memory_show(struct seq_file *s, void *data)
+{
+	struct mt7927_dev *dev = s->private;
+	size_t desc = sizeof(struct mt76_desc);
+	size_t total = 0;
+
+	mutex_lock(&dev->dma_mutex);
+	mt7927_memory_line(s, "dev", sizeof(*dev), &total);
+	mt7927_memory_line(s, "ring16_fwdl",
+			   dev->tx_ring ? dev->tx_ring_size * desc : 0, &total);
+	mt7927_memory_line(s, "ring15_mcu",
+			   dev->mcu_ring ? dev->mcu_ring_size * desc : 0, &total);
+	mt7927_memory_line(s, "rx_ring0",
+			   dev->rx_ring ? dev->rx_ring_size * desc : 0, &total);
+	mt7927_memory_line(s, "rx_buf",
+			   dev->rx_buf ? dev->rx_ring_size * MT7927_RX_BUF_SIZE : 0,
+			   &total);
+	mt7927_memory_line(s, "mcu_buf",
+			   dev->mcu_buf ? MT7927_FW_CHUNK_SIZE + 256 : 0, &total);
+	mt7927_memory_line(s, "mcu_msg",
+			   dev->mcu_msg ? MT7927_MCU_MSG_MAX : 0, &total);
+	mt7927_memory_line(s, "tx_arena",
+			   dev->arena.buf ?
+			   MT7927_TX_SLOTS * MT7927_TX_SLOT_SIZE : 0, &total);
+	mt7927_memory_line(s, "tokens",
+			   dev->token.txwi ?
+			   MT7927_TOKEN_SIZE * sizeof(struct mt7927_txwi) : 0,
+			   &total);
+	mt7927_memory_line(s, "patch_fw",
+			   dev->patch_fw ? dev->patch_fw->size : 0, &total);
+	mt7927_memory_line(s, "regtrace",
+			   num_possible_cpus() *
+			   array_size(MT7927_TRACE_ENTRIES,
+				      sizeof(struct mt7927_trace_ent)), &total);
+	mutex_unlock(&dev->dma_mutex);
+
+	seq_printf(s, "%-14s %8zu\n", "total", total);
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(mt7927_memory);
+
+static int mt7927_tx_arena_show(struct seq_file *s, void *data)
+{
+	struct mt7927_dev *dev = s->private;
+	struct mt7927_tx_arena *a = &dev->arena;
+
+	mutex_lock(&dev->dma_mutex);
+	seq_printf(s, "slots:         %u x %u bytes%s\n", MT7927_TX_SLOTS,
+		   MT7927_TX_SLOT_SIZE, a->buf ? "" : " (not allocated)");
+	seq_printf(s, "slots_used:    %u\n",
+		   bitmap_weight(a->used, MT7927_TX_SLOTS));
+	seq_printf(s, "copybreak:     %u\n", tx_copybreak);
+	seq_printf(s, "copied:        %llu\n", a->copy_cnt);
+	seq_printf(s, "mapped:        %llu\n", a->map_cnt);
+	seq_printf(s, "unmapped:      %llu\n", a->unmap_cnt);
+	seq_printf(s, "slots_full:    %u\n", a->full_cnt);
+	seq_printf(s, "map_errors:    %u\n", a->map_err);
+	mutex_unlock(&dev->dma_mutex);
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(mt7927_tx_arena);
+
+static int mt7927_rx_data_show(struct seq_file *s, void *data)
+{
+	struct mt7927_dev *dev = s->private;
+	struct mt7927_rx_stats *st = &dev->rx_stats;
+
+	mutex_lock(&dev->dma_mutex);
+	seq_printf(s, "hw_encap:      %s\n", hw_encap ? "on" : "off");
+	seq_printf(s, "eth_frames:    %llu\n", st->eth);
+	seq_printf(s, "eth_bytes:     %llu\n", st->eth_bytes);
+	seq_printf(s, "wlan_frames:   %llu\n", st->wlan);
+	seq_printf(s, "csum_ok:       %llu\n", st->csum_ok);
+	seq_printf(s, "hdr_trans_err: %u\n", st->hdr_trans_err);
+	seq_printf(s, "fcs_err:       %u\n", st->fcs_err);
+	seq_printf(s, "bad_len:       %u\n", st->bad_len);
+	seq_printf(s, "nomem:         %u\n", st->nomem);
+	mutex_unlock(&dev->dma_mutex);
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(mt7927_rx_data);
+
+static int mt7927_tokens_show(struct seq_file *s, void *data)
+{
+	struct mt7927_dev *dev = s->private;
+	struct mt7927_token *tk = &dev->token;
+
+	mutex_lock(&dev->dma_mutex);
+	seq_printf(s, "tokens:        %u\n", MT7927_TOKEN_SIZE);
+	seq_printf(s, "in_flight:     %d\n", atomic_read(&tk->count));
+	seq_printf(s, "full:          %d\n", atomic_read(&tk->full_cnt));
+	seq_printf(s, "free_events:   %llu\n", tk->free_evt);
+	seq_printf(s, "reclaimed:     %llu\n", tk->reclaimed);
+	seq_printf(s, "max_batch:     %u\n", tk->max_batch);
+	seq_printf(s, "bad_id:        %u\n", tk->bad_id);
+	seq_printf(s, "drained:       %u\n", tk->drained);
+	mutex_unlock(&dev->dma_mutex);
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(mt7927_tokens);
+
+static void mt7927_tx_lat_show(struct seq_file *s, const char *name,
+			       const struct mt7927_tx_lat *lat)
+{
+	seq_printf(s, "%-15s%llu frames, p50 %llu us, p99 %llu us, max %llu us\n",
+		   name, lat->count,
+		   div_u64(mt7927_tx_lat_pct(lat, 50), NSEC_PER_USEC),
+		   div_u64(mt7927_tx_lat_pct(lat, 99), NSEC_PER_USEC),
+		   div_u64(lat->max_ns, NSEC_PER_USEC));
+}
+
+/*
+ * Game mode state and the time from token to handled TX-free event of
+ * frames queued with and without it. That includes the RX ring 0 poll
+ * delay, see Game Mode. Percentiles are rounded down to a quarter
+ * octave. Any write clears the histograms.
+ */
+static int mt7927_tx_latency_show(struct seq_file *s, void *data)
+{
+	struct mt7927_dev *dev = s->private;
+	struct mt7927_game *gm = &dev->game;
+
+	mutex_lock(&gm->mutex);
+	seq_printf(s, "game_mode:     %s\n", gm->on ? "on" : "off");
+	seq_printf(s, "entered:       %u\n", gm->enter_cnt);
+	mutex_unlock(&gm->mutex);
+
+	seq_printf(s, "measured:      token to TX-free event handled, RX polled every %u ms\n",
+		   MT7927_RX_POLL_MS);
+	mutex_lock(&dev->dma_mutex);
+	mt7927_tx_lat_show(s, "normal:", &dev->tx_lat[0]);
+	mt7927_tx_lat_show(s, "game:", &dev->tx_lat[1]);
+	mutex_unlock(&dev->dma_mutex);
+
+	return 0;
+}
+
+static int mt7927_tx_latency_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, mt7927_tx_latency_show, inode->i_private);
+}
+
+static ssize_t mt7927_tx_latency_write(struct file *file,
+				       const char __user *ubuf,
+				       size_t count, loff_t *ppos)
+{
+	struct mt7927_dev *dev = file_inode(file)->i_private;
+
+	mutex_lock(&dev->dma_mutex);
+	memset(dev->tx_lat, 0, sizeof(dev->tx_lat));
+	mutex_unlock(&dev->dma_mutex);
+
+	return count;
+}
+
+static const struct file_operations mt7927_tx_latency_fops = {
+	.owner = THIS_MODULE,
+	.open = mt7927_tx_latency_open,
+	.read = seq_read,
+	.write = mt7927_tx_latency_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static void mt7927_rate_show(struct seq_file *s, const char *dir,
+			     const struct mt7927_rate *r)
+{
+	if (!r->nss)
+		return;
+
+	seq_printf(s, "    %s: %s mcs %u nss %u %u MHz gi %u: %u kbps\n", dir,
+		   mt7927_phy_mode_name(r->mode), r->mcs, r->nss,
+		   20 << r->bw, r->gi, mt7927_rate_kbps(r));
+}
+
+static int mt7927_sta_show(struct seq_file *s, void *data)
+{
+	struct mt7927_dev *dev = s->private;
+	struct mt7927_sta *sta;
+	unsigned long rx_mask;
+	u16 wcid;
+	u8 tid, l;
+
+	mutex_lock(&dev->sta_mutex);
+	for (wcid = 0; wcid < MT7927_WTBL_SIZE; wcid++) {
+		sta = mt7927_sta_get(dev, wcid);
+		if (!sta || sta->wcid != wcid)
+			continue;
+
+		rx_mask = 0;
+		for (tid = 0; tid < MT7927_NUM_TIDS; tid++)
+			if (rcu_access_pointer(sta->rx_tid[tid]))
+				rx_mask |= BIT(tid);
+
+		seq_printf(s, "wcid %u: omac=%u wmm=%u %s tx_ba=0x%02lx rx_ba=0x%02lx\n",
+			   wcid, sta->omac_idx, sta->wmm_idx,
+			   sta->eth_hdr ? "802.3" : "802.11",
+			   sta->ba_tx_mask, rx_mask);
+		for (l = 0; l < MT7927_MAX_LINKS; l++) {
+			if (!(sta->link_mask & BIT(l)))
+				continue;
+
+			seq_printf(s, "  link %u: wcid %u\n", l, sta->link_wcid[l]);
+			mt7927_rate_show(s, "rx", &sta->rx_rate[l]);
+			mt7927_rate_show(s, "tx", &sta->tx_rate[l]);
+		}
+	}
+	mutex_unlock(&dev->sta_mutex);
+
+	return 0;
+}
+
+static int mt7927_sta_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, mt7927_sta_show, inode->i_private);
+}
+
+/*
+ * "add <wcid>" or "del <wcid>", "link <wcid> <link> <link wcid>" makes
+ * station <wcid> an MLD with another link
+ */
+static ssize_t mt7927_sta_write(struct file *file, const char __user *ubuf,
+				size_t count, loff_t *ppos)
+{
+	struct mt7927_dev *dev = file_inode(file)->i_private;
+	struct mt7927_sta *sta;
+	u16 wcid, link_wcid;
+	char cmd[8];
+	char *buf;
+	int n, ret;
+	u8 l;
+
+	buf = memdup_user_nul(ubuf, count);
+	if (IS_ERR(buf))
+		return PTR_ERR(buf);
+
+	n = sscanf(buf, "%7s %hu %hhu %hu", cmd, &wcid, &l, &link_wcid);
+	kfree(buf);
+	if (n < 2)
+		return -EINVAL;
+
+	mutex_lock(&dev->sta_mutex);
+	if (!strcmp(cmd, "add")) {
+		ret = mt7927_sta_add(dev, wcid, 0, 0);
+	} else if (!strcmp(cmd, "del")) {
+		ret = mt7927_sta_remove(dev, wcid);
+	} else if (!strcmp(cmd, "link") && n == 4) {
+		sta = mt7927_sta_get(dev, wcid);
+		ret = sta ? mt7927_sta_add_link(dev, sta, l, link_wcid) :
+			    -ENOENT;
+	} else {
+		ret = -EINVAL;
+	}
+	mutex_unlock(&dev->sta_mutex);
+
+	return ret ? ret : count;
+}
+
+static const struct file_operations mt7927_sta_fops = {
+	.owner = THIS_MODULE,
+	.open = mt7927_sta_open,
+	.read = seq_read,
+	.write = mt7927_sta_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static int mt7927_ba_show(struct seq_file *s, void *data)
+{
+	struct mt7927_dev *dev = s->private;
+	struct mt7927_rx_tid *rx_tid;
+	struct mt7927_sta *sta;
+	u16 wcid;
+	u8 tid;
+
+	mutex_lock(&dev->sta_mutex);
+	for (wcid = 0; wcid < MT7927_WTBL_SIZE; wcid++) {
+		sta = mt7927_sta_get(dev, wcid);
+		if (!sta || sta->wcid != wcid)
+			continue;
+
+		for (tid = 0; tid < MT7927_NUM_TIDS; tid++) {
+			if (test_bit(tid, &sta->ba_tx_mask))
+				seq_printf(s, "wcid %u tid %u tx: ssn=%u win=%u amsdu=%d\n",
+					   wcid, tid, sta->ba_tx[tid].ssn,
+					   sta->ba_tx[tid].winsize,
+					   sta->ba_tx[tid].amsdu);
+
+			rx_tid = rcu_dereference_protected(sta->rx_tid[tid],
+							   lockdep_is_held(&dev->sta_mutex));
+			if (!rx_tid)
+				continue;
+
+			spin_lock_bh(&rx_tid->lock);
+			seq_printf(s, "wcid %u tid %u rx: head=%u win=%u held=%u released=%llu old=%u dup=%u timeout=%u replay=%u\n",
+				   wcid, tid, rx_tid->head, rx_tid->size,
+				   rx_tid->nframes, rx_tid->released,
+				   rx_tid->old, rx_tid->dup, rx_tid->timeout,
+				   rx_tid->replay);
+			spin_unlock_bh(&rx_tid->lock);
+		}
+	}
+	mutex_unlock(&dev->sta_mutex);
+
+	return 0;
+}
+
+static int mt7927_ba_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, mt7927_ba_show, inode->i_private);
+}
+
+/* Feed a dummy QoS data frame with sequence number @sn to the reorder path */
+static int mt7927_ba_inject(struct mt7927_dev *dev, struct mt7927_sta *sta,
+			    u8 tid, u16 sn)
+{
+	struct mt7927_rx_cb *cb;
+	struct sk_buff_head frames;
+	struct sk_buff *skb;
+
+	if (tid >= MT7927_NUM_TIDS)
+		return -EINVAL;
+
+	skb = alloc_skb(ETH_HLEN, GFP_KERNEL);
+	if (!skb)
+		return -ENOMEM;
+
+	skb_put_zero(skb, ETH_HLEN);
+	cb = mt7927_rx_cb(skb);
+	memset(cb, 0, sizeof(*cb));
+	cb->seqno = sn & MT7927_SEQ_MASK;
+	cb->tid = tid;
+	cb->seq_valid = true;
+
+	__skb_queue_head_init(&frames);
+
+	rcu_read_lock();
+	mt7927_rx_reorder(sta, skb, &frames);
+	rcu_read_unlock();
+
+	mt7927_rx_deliver(dev, &frames);
+
+	return 0;
+}
+
+/*
+ * "tx|rx <wcid> <tid> <ssn> <win>" starts a session, "tx|rx <wcid> <tid>
+ * off" stops it. "frame <wcid> <tid> <sn>" runs a dummy frame through
+ * the reorder buffer, to check the counters above without a peer.
+ */
+static ssize_t mt7927_ba_write(struct file *file, const char __user *ubuf,
+			       size_t count, loff_t *ppos)
+{
+	struct mt7927_dev *dev = file_inode(file)->i_private;
+	u16 wcid, ssn, win;
+	struct mt7927_sta *sta;
+	char cmd[8], arg[4];
+	char *buf;
+	int n, ret;
+	u8 tid;
+
+	buf = memdup_user_nul(ubuf, count);
+	if (IS_ERR(buf))
+		return PTR_ERR(buf);
+
+	n = sscanf(buf, "%7s %hu %hhu %hu %hu", cmd, &wcid, &tid, &ssn, &win);
+	if (n == 3 && (sscanf(buf, "%*s %*u %*u %3s", arg) != 1 ||
+		       strcmp(arg, "off")))
+		n = -1;
+	kfree(buf);
+
+	mutex_lock(&dev->sta_mutex);
+	sta = n >= 3 ? mt7927_sta_get(dev, wcid) : NULL;
+	if (!sta) {
+		ret = n >= 3 ? -ENOENT : -EINVAL;
+	} else if (!strcmp(cmd, "tx")) {
+		if (n == 5)
+			ret = mt7927_ba_tx_start(dev, sta, tid, ssn, win, false);
+		else
+			ret = n == 3 ? mt7927_ba_tx_stop(dev, sta, tid) : -EINVAL;
+	} else if (!strcmp(cmd, "rx")) {
+		if (n == 5)
+			ret = mt7927_ba_rx_start(dev, sta, tid, ssn, win);
+		else
+			ret = n == 3 ? mt7927_ba_rx_stop(dev, sta, tid) : -EINVAL;
+	} else if (!strcmp(cmd, "frame") && n == 4) {
+		ret = mt7927_ba_inject(dev, sta, tid, ssn);
+	} else {
+		ret = -EINVAL;
+	}
+	mutex_unlock(&dev->sta_mutex);
+
+	return ret ? ret : count;
+}
+
+static const struct file_operations mt7927_ba_fops = {
+	.owner = THIS_MODULE,
+	.open = mt7927_ba_open,
+	.read = seq_read,
+	.write = mt7927_ba_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static int mt7927_chan_show(struct seq_file *s, void *data)
+{
+	struct mt7927_dev *dev = s->private;
+	const struct mt7927_link *link;
+	u8 l;
+
+	mutex_lock(&dev->sta_mutex);
+	for (l = 0; l < MT7927_MAX_LINKS; l++) {
+		link = &dev->link[l];
+		if (!link->active) {
+			seq_printf(s, "link %u: off\n", l);
+			continue;
+		}
+
+		seq_printf(s, "link %u: %s channel %u center %u %u MHz, peak %u kbps\n",
+			   l, mt7927_band_name[link->chandef.band],
+			   link->chandef.chan, link->chandef.center,
+			   link->chandef.width,
+			   mt7927_chandef_peak_kbps(&link->chandef));
+	}
+	mutex_unlock(&dev->sta_mutex);
+
+	return 0;
+}
+
+static int mt7927_chan_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, mt7927_chan_show, inode->i_private);
+}
+
+/* "<link> <2g|5g|6g> <chan> <width> [center]" or "<link> off" */
+static ssize_t mt7927_chan_write(struct file *file, const char __user *ubuf,
+				 size_t count, loff_t *ppos)
+{
+	struct mt7927_dev *dev = file_inode(file)->i_private;
+	struct mt7927_chandef c;
+	enum mt7927_band band;
+	u8 l, chan, center = 0;
+	char name[4];
+	u16 width;
+	char *buf;
+	int ret;
+
+	buf = memdup_user_nul(ubuf, count);
+	if (IS_ERR(buf))
+		return PTR_ERR(buf);
+
+	ret = sscanf(buf, "%hhu %3s %hhu %hu %hhu", &l, name, &chan, &width,
+		     &center);
+	kfree(buf);
+	if (ret < 2 || l >= MT7927_MAX_LINKS)
+		return -EINVAL;
+
+	if (!strcmp(name, "off")) {
+		mutex_lock(&dev->sta_mutex);
+		mt7927_link_remove(dev, l);
+		mutex_unlock(&dev->sta_mutex);
+		return count;
+	}
+	if (ret < 4)
+		return -EINVAL;
+
+	for (band = 0; band < MT7927_NUM_BANDS; band++)
+		if (!strcmp(name, mt7927_band_name[band]))
+			break;
+
+	ret = mt7927_chandef_init(&c, band, chan, width, center);
+	if (ret)
+		return ret;
+
+	mutex_lock(&dev->sta_mutex);
+	ret = mt7927_link_add(dev, l, &c);
+	mutex_unlock(&dev->sta_mutex);
+
+	return ret ? ret : count;
+}
+
+static const struct file_operations mt7927_chan_fops = {
+	.owner = THIS_MODULE,
+	.open = mt7927_chan_open,
+	.read = seq_read,
+	.write = mt7927_chan_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+/* HE/EHT capabilities per band and the peak rates they allow */
+static int mt7927_phy_caps_show(struct seq_file *s, void *data)
+{
+	struct mt7927_dev *dev = s->private;
+	const struct ieee80211_sta_he_cap *he;
+	const struct ieee80211_sta_eht_cap *eht;
+	struct mt7927_rate he_peak = {
+		.mode = MT_PHY_TYPE_HE_SU,
+		.mcs = 11,
+		.nss = MT7927_NSS,
+	};
+	struct mt7927_rate eht_peak = {
+		.mode = MT_PHY_TYPE_EHT_SU,
+		.mcs = 13,
+		.nss = MT7927_NSS,
+	};
+	enum mt7927_band band;
+	u16 width;
+
+	for (band = 0; band < MT7927_NUM_BANDS; band++) {
+		he = &dev->he_cap[band];
+		eht = &dev->eht_cap[band];
+		width = mt7927_band_max_width[band];
+
+		/* HE tops out at 160 MHz, EHT adds 320 MHz */
+		he_peak.bw = ilog2(min_t(u16, width, 160) / 20);
+		eht_peak.bw = ilog2(width / 20);
+
+		seq_printf(s, "%s: max %u MHz\n", mt7927_band_name[band], width);
+		seq_printf(s, "  he:  mac0=0x%02x phy0=0x%02x phy1=0x%02x mcs80=0x%04x mcs160=0x%04x\n",
+			   he->he_cap_elem.mac_cap_info[0],
+			   he->he_cap_elem.phy_cap_info[0],
+			   he->he_cap_elem.phy_cap_info[1],
+			   le16_to_cpu(he->he_mcs_nss_supp.rx_mcs_80),
+			   le16_to_cpu(he->he_mcs_nss_supp.rx_mcs_160));
+		seq_printf(s, "  eht: mac0=0x%02x phy0=0x%02x phy1=0x%02x nss80=0x%02x nss160=0x%02x nss320=0x%02x\n",
+			   eht->eht_cap_elem.mac_cap_info[0],
+			   eht->eht_cap_elem.phy_cap_info[0],
+			   eht->eht_cap_elem.phy_cap_info[1],
+			   eht->eht_mcs_nss_supp.bw._80.rx_tx_mcs13_max_nss,
+			   eht->eht_mcs_nss_supp.bw._160.rx_tx_mcs13_max_nss,
+			   eht->eht_mcs_nss_supp.bw._320.rx_tx_mcs13_max_nss);
+		seq_printf(s, "  peak: he %u kbps, eht %u kbps\n",
+			   mt7927_rate_kbps(&he_peak),
+			   mt7927_rate_kbps(&eht_peak));
+	}
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(mt7927_phy_caps);
+
+static int mt7927_amsdu_show(struct seq_file *s, void *data)
+{
+	struct mt7927_dev *dev = s->private;
+	struct mt7927_amsdu_stats *st = &dev->amsdu_stats;
+
+	mutex_lock(&dev->dma_mutex);
+	seq_printf(s, "max_len:       %u\n", amsdu_max_len);
+	seq_printf(s, "max_us:        %u\n", amsdu_max_us);
+	seq_printf(s, "msdus:         %llu\n", st->msdus);
+	seq_printf(s, "descriptors:   %llu\n", st->descs);
+	seq_printf(s, "aggregates:    %llu\n", st->aggs);
+	seq_printf(s, "doorbells:     %llu\n", st->kicks);
+	seq_printf(s, "flush_full:    %u\n", st->flush_full);
+	seq_printf(s, "flush_len:     %u\n", st->flush_len);
+	seq_printf(s, "flush_time:    %u\n", st->flush_time);
+	seq_printf(s, "flush_kick:    %u\n", st->flush_kick);
+	seq_printf(s, "high_dma:      %u\n", st->high_dma);
+	seq_printf(s, "dropped:       %u\n", st->drop);
+	mutex_unlock(&dev->dma_mutex);
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(mt7927_amsdu);
+
+static const char * const mt7927_mlo_policy_name[] = {
+	[MT7927_MLO_LATENCY] = "latency",
+	[MT7927_MLO_THROUGHPUT] = "throughput",
+};
+
+static int mt7927_mlo_show(struct seq_file *s, void *data)
+{
+	struct mt7927_dev *dev = s->private;
+	const struct mt7927_link *link;
+	u8 l;
+
+	mutex_lock(&dev->sta_mutex);
+	seq_printf(s, "policy:        %s\n",
+		   mt7927_mlo_policy_name[dev->mlo_policy]);
+	for (l = 0; l < MT7927_MAX_LINKS; l++) {
+		link = &dev->link[l];
+		seq_printf(s, "link %u: %s band %u ring %u inflight %d, tx %llu/%llu rx %llu/%llu msdus/bytes\n",
+			   l, link->active ? "on" : "off", link->band_idx,
+			   link->ring, atomic_read(&link->inflight),
+			   link->tx_msdus, link->tx_bytes,
+			   link->rx_msdus, link->rx_bytes);
+	}
+	mutex_unlock(&dev->sta_mutex);
+
+	return 0;
+}
+
+static int mt7927_mlo_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, mt7927_mlo_show, inode->i_private);
+}
+
+/* "latency" or "throughput" */
+static ssize_t mt7927_mlo_write(struct file *file, const char __user *ubuf,
+				size_t count, loff_t *ppos)
+{
+	struct mt7927_dev *dev = file_inode(file)->i_private;
+	enum mt7927_mlo_policy policy;
+	char name[12];
+	char *buf;
+	int ret;
+
+	buf = memdup_user_nul(ubuf, count);
+	if (IS_ERR(buf))
+		return PTR_ERR(buf);
+
+	ret = sscanf(buf, "%11s", name);
+	kfree(buf);
+	if (ret != 1)
+		return -EINVAL;
+
+	for (policy = 0; policy < ARRAY_SIZE(mt7927_mlo_policy_name); policy++)
+		if (!strcmp(name, mt7927_mlo_policy_name[policy]))
+			break;
+	if (policy == ARRAY_SIZE(mt7927_mlo_policy_name))
+		return -EINVAL;
+
+	mutex_lock(&dev->sta_mutex);
+	dev->mlo_policy = policy;
+	mutex_unlock(&dev->sta_mutex);
+
+	return count;
+}
+
+static const struct file_operations mt7927_mlo_fops = {
+	.owner = THIS_MODULE,
+	.open = mt7927_mlo_open,
+	.read = seq_read,
+	.write = mt7927_mlo_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+#ifdef CONFIG_MT7927_SELFTEST
+/* =============================================================================
+ * Self-tests
+ * =============================================================================
+ *
+ * Benchmarks and self-tests in debugfs. They drive the driver against
+ * scratch state or the mock device, so they are only built with
+ * CONFIG_MT7927_SELFTEST=y (see Kbuild) and never ship in the module a
+ * distribution builds.
+ *
+ * Each run sits between mt7927_selftest_begin() and
+ * mt7927_selftest_end(): it holds sta_mutex, works on a scratch station
+ * and TX batch, and the counters it bumps are put back afterwards, so
+ * the tokens, rx_data, amsdu, tx_latency and mlo files only count real
+ * traffic.
+ *
+ * busy_poll_bench models data RX through NAPI ahead of the data RX ring
+ * (ring 2), which this tree does not set up yet: a frame arriving on the
+ * mock raises a data RX "interrupt" that masks itself and schedules a
+ * NAPI instance on a dummy netdev, and the poll unmasks it once nothing
+ * is pending. While a busy-poller owns the instance napi_complete_done()
+ * fails, so the interrupt stays masked until the poller's last pass.
+ */
+
+static void mt7927_mock_rx_irq(struct mt7927_mock *mock)
+{
+	if (READ_ONCE(mock->irq_masked)) {
+		mock->irqs_masked++;
+		return;
+	}
+
+	mock->irqs++;
+	WRITE_ONCE(mock->irq_masked, true);
+	napi_schedule(&mock->napi);
+}
+
+/* The mock's response frame arrives: raise the data RX interrupt */
+static enum hrtimer_restart mt7927_mock_rx_timer(struct hrtimer *t)
+{
+	struct mt7927_mock *mock = container_of(t, struct mt7927_mock,
+						rx_timer);
+
+	atomic_inc(&mock->rx_pending);
+	smp_mb__after_atomic();
+	mt7927_mock_rx_irq(mock);
+
+	return HRTIMER_NORESTART;
+}
+
+static int mt7927_mock_napi_poll(struct napi_struct *napi, int budget)
+{
+	struct mt7927_mock *mock = container_of(napi, struct mt7927_mock,
+						napi);
+	int done = 0;
+
+	/* A busy-poller gets here without the interrupt having fired */
+	WRITE_ONCE(mock->irq_masked, true);
+
+	while (done < budget && atomic_add_unless(&mock->rx_pending, -1, 0)) {
+		mt7927_rx_data(mock->dev, mock->rx_buf, mock->rx_len);
+		done++;
+	}
+	if (done == budget || !napi_complete_done(napi, done))
+		return done;
+
+	WRITE_ONCE(mock->irq_masked, false);
+
+	/* A frame that landed before the unmask raised no interrupt */
+	smp_mb();
+	if (atomic_read(&mock->rx_pending))
+		mt7927_mock_rx_irq(mock);
+
+	return done;
+}
+
+static int mt7927_mock_rx_init(struct mt7927_mock *mock)
+{
+	mock->napi_dev = alloc_netdev_dummy(0);
+	if (!mock->napi_dev)
+		return -ENOMEM;
+
+	hrtimer_setup(&mock->rx_timer, mt7927_mock_rx_timer, CLOCK_MONOTONIC,
+		      HRTIMER_MODE_REL);
+	netif_napi_add(mock->napi_dev, &mock->napi, mt7927_mock_napi_poll);
+	napi_enable(&mock->napi);
+
+	return 0;
+}
+
+/* Stop arrivals and wait out a running poll */
+static void mt7927_mock_rx_free(struct mt7927_mock *mock)
+{
+	if (!mock->napi_dev)
+		return;
+
+	hrtimer_cancel(&mock->rx_timer);
+	napi_disable(&mock->napi);
+	netif_napi_del(&mock->napi);
+	free_netdev(mock->napi_dev);
+	mock->napi_dev = NULL;
+}
+
+static struct mt7927_mock *mt7927_mock_alloc(struct mt7927_dev *dev)
+{
+	struct mt7927_mock *mock;
+
+	mock = kzalloc(sizeof(*mock), GFP_KERNEL);
+	if (!mock)
+		return NULL;
+
+	mock->dev = dev;
+
+	return mock;
+}
+
+/*
+ * Divert the MCU commands and TX doorbells of the calling task to @mock,
+ * and record every RX delivery in it. Called under sta_mutex.
+ */
+static void mt7927_mock_attach(struct mt7927_dev *dev, struct mt7927_mock *mock)
+{
+	lockdep_assert_held(&dev->sta_mutex);
+
+	mock->task = current;
+
+	mutex_lock(&dev->dma_mutex);
+	rcu_assign_pointer(dev->mock, mock);
+	mutex_unlock(&dev->dma_mutex);
+}
+
+/*
+ * Undo mt7927_mock_attach(). Reorder work of any station may still be
+ * delivering frames to the mock; once this returns it is not, and the
+ * mock can be freed.
+ */
+static void mt7927_mock_detach(struct mt7927_dev *dev)
+{
+	lockdep_assert_held(&dev->sta_mutex);
+
+	mutex_lock(&dev->dma_mutex);
+	RCU_INIT_POINTER(dev->mock, NULL);
+	mutex_unlock(&dev->dma_mutex);
+
+	synchronize_rcu();
+}
+
+/* What a self-test run leaves as it found it, see mt7927_selftest_begin() */
+struct mt7927_selftest {
+	struct mt7927_dev *dev;
+	struct mt7927_mock *mock;	/* Attached for the run, if asked for */
+	struct mt7927_sta *sta;		/* Scratch station, WLAN index 1 */
+	struct mt7927_tx_batch *b;	/* Scratch TX batch */
+
+	/* Counters fed by the data path, put back at the end */
+	struct mt7927_rx_stats rx_stats;
+	struct mt7927_amsdu_stats amsdu_stats;
+	struct mt7927_tx_lat tx_lat[2];
+	struct mt7927_link link[MT7927_MAX_LINKS];
+	u64 free_evt;
+	u64 reclaimed;
+	u32 max_batch;
+	u32 bad_id;
+	u32 drained;
+
+	u32 gen;			/* Token generation of the run */
+};
+
+/*
+ * Start a self-test run: allocate a scratch station and TX batch, and
+ * with @mock a mock device attached for the run, make sure the token
+ * table exists and note the counters the run will bump. The run holds
+ * sta_mutex until mt7927_selftest_end(), so runs never overlap and the
+ * station table stays put.
+ */
+static struct mt7927_selftest *mt7927_selftest_begin(struct mt7927_dev *dev,
+						     bool mock)
+{
+	struct mt7927_token *tk = &dev->token;
+	struct mt7927_selftest *st;
+	int ret = -ENOMEM;
+
+	st = kzalloc(sizeof(*st), GFP_KERNEL);
+	if (!st)
+		return ERR_PTR(-ENOMEM);
+
+	st->dev = dev;
+	st->sta = kzalloc(sizeof(*st->sta), GFP_KERNEL);
+	st->b = kzalloc(sizeof(*st->b), GFP_KERNEL);
+	if (mock)
+		st->mock = mt7927_mock_alloc(dev);
+	if (!st->sta || !st->b || (mock && !st->mock))
+		goto err;
+
+	mt7927_sta_init(st->sta, 1, 0, 0);
+
+	mutex_lock(&dev->sta_mutex);
+	ret = mt7927_token_init(dev);
+	if (ret) {
+		mutex_unlock(&dev->sta_mutex);
+		goto err;
+	}
+
+	mutex_lock(&dev->dma_mutex);
+	st->rx_stats = dev->rx_stats;
+	st->amsdu_stats = dev->amsdu_stats;
+	memcpy(st->tx_lat, dev->tx_lat, sizeof(st->tx_lat));
+	memcpy(st->link, dev->link, sizeof(st->link));
+	st->free_evt = tk->free_evt;
+	st->reclaimed = tk->reclaimed;
+	st->max_batch = tk->max_batch;
+	st->bad_id = tk->bad_id;
+	st->drained = tk->drained;
+	st->gen = tk->gen + 1;
+	WRITE_ONCE(tk->gen, st->gen);
+	mutex_unlock(&dev->dma_mutex);
+
+	if (st->mock)
+		mt7927_mock_attach(dev, st->mock);
+
+	return st;
+
+err:
+	kfree(st->mock);
+	kfree(st->b);
+	kfree(st->sta);
+	kfree(st);
+	return ERR_PTR(ret);
+}
+
+/*
+ * End a run started by mt7927_selftest_begin(). Every token the run
+ * took must have been released by now.
+ */
+static void mt7927_selftest_end(struct mt7927_selftest *st)
+{
+	struct mt7927_dev *dev = st->dev;
+	struct mt7927_token *tk = &dev->token;
+	u8 l;
+
+	if (st->mock) {
+		mt7927_mock_rx_free(st->mock);
+		mt7927_mock_detach(dev);
+	}
+
+	mutex_lock(&dev->dma_mutex);
+	dev->rx_stats = st->rx_stats;
+	dev->amsdu_stats = st->amsdu_stats;
+	memcpy(dev->tx_lat, st->tx_lat, sizeof(st->tx_lat));
+	for (l = 0; l < MT7927_MAX_LINKS; l++) {
+		dev->link[l].tx_msdus = st->link[l].tx_msdus;
+		dev->link[l].tx_bytes = st->link[l].tx_bytes;
+		dev->link[l].rx_msdus = st->link[l].rx_msdus;
+		dev->link[l].rx_bytes = st->link[l].rx_bytes;
+	}
+	tk->free_evt = st->free_evt;
+	tk->reclaimed = st->reclaimed;
+	tk->max_batch = st->max_batch;
+	tk->bad_id = st->bad_id;
+	tk->drained = st->drained;
+	mutex_unlock(&dev->dma_mutex);
+
+	mutex_unlock(&dev->sta_mutex);
+
+	kfree(st->mock);
+	kfree(st->b);
+	kfree(st->sta);
+	kfree(st);
+}
 
-	/* TXD word 1: reserved */
-	txd->txd[1] = 0;
+#define MT7927_TXD_BENCH_ITERS		100000
+#define MT7927_TXD_BENCH_LEN		1500
 
-	/* Copy firmware data after TXD */
-	memcpy(dev->mcu_buf + sizeof(*txd), data, len);
+/*
+ * Time MT7927_TXD_BENCH_ITERS data TXDs built from scratch against the
+ * template path on a scratch station, then check that both produce the
+ * same bytes, also right after a rate change.
+ */
+static int mt7927_txd_bench_show(struct seq_file *s, void *data)
+{
+	struct mt7927_dev *dev = s->private;
+	struct mt7927_selftest *st;
+	struct mt7927_sta *sta;
+	__le32 a[8], b[8];
+	u64 t0, scratch_ns, tmpl_ns, builds;
+	bool same, rebuilt;
+	u16 seq;
+	int i;
 
-	/* Ensure data is visible to DMA */
-	dma_sync_single_for_device(&dev->pdev->dev, dev->mcu_dma,
-				   total_len, DMA_TO_DEVICE);
+	st = mt7927_selftest_begin(dev, false);
+	if (IS_ERR(st))
+		return PTR_ERR(st);
 
-	/* Queue to DMA ring */
-	ret = mt7927_dma_tx_queue_fw(dev, dev->mcu_dma, total_len);
-	if (ret)
-		return ret;
+	sta = st->sta;
+	mt7927_sta_set_key(sta, true);
 
-	/* Wait for this chunk to complete before sending next */
-	ret = mt7927_dma_tx_wait(dev, 100);
-	if (ret) {
-		dev_err(&dev->pdev->dev, "  FW chunk DMA timeout at offset 0x%x\n",
-			offset);
-		return ret;
+	t0 = local_clock();
+	for (i = 0; i < MT7927_TXD_BENCH_ITERS; i++) {
+		mt7927_txd_build(sta, i % MT7927_NUM_TIDS,
+				 MT7927_TXD_SIZE + MT7927_TXD_BENCH_LEN,
+				 i & MT7927_SEQ_MASK, a);
+		barrier_data(a);
+	}
+	scratch_ns = local_clock() - t0;
+
+	t0 = local_clock();
+	for (i = 0; i < MT7927_TXD_BENCH_ITERS; i++) {
+		mt7927_txd_write(sta, i % MT7927_NUM_TIDS,
+				 MT7927_TXD_BENCH_LEN, b);
+		barrier_data(b);
 	}
+	tmpl_ns = local_clock() - t0;
+
+	seq = mt7927_txd_write(sta, 5, MT7927_TXD_BENCH_LEN, b);
+	mt7927_txd_build(sta, 5, MT7927_TXD_SIZE + MT7927_TXD_BENCH_LEN,
+			 seq, a);
+	same = !memcmp(a, b, MT7927_TXD_SIZE);
+
+	builds = sta->tmpl_builds;
+	mt7927_sta_set_rate(sta, 0x0b);
+	seq = mt7927_txd_write(sta, 5, MT7927_TXD_BENCH_LEN, b);
+	mt7927_txd_build(sta, 5, MT7927_TXD_SIZE + MT7927_TXD_BENCH_LEN,
+			 seq, a);
+	rebuilt = sta->tmpl_builds == builds + 1;
+	same = same && !memcmp(a, b, MT7927_TXD_SIZE);
+
+	seq_printf(s, "format:        %s\n", sta->eth_hdr ? "802.3" : "802.11");
+	seq_printf(s, "iterations:    %u\n", MT7927_TXD_BENCH_ITERS);
+	seq_printf(s, "scratch_ns:    %llu (%llu ns/txd)\n", scratch_ns,
+		   div_u64(scratch_ns, MT7927_TXD_BENCH_ITERS));
+	seq_printf(s, "template_ns:   %llu (%llu ns/txd)\n", tmpl_ns,
+		   div_u64(tmpl_ns, MT7927_TXD_BENCH_ITERS));
+	seq_printf(s, "tmpl_builds:   %llu\n", sta->tmpl_builds);
+	seq_printf(s, "identical:     %s\n", same ? "yes" : "NO");
+	seq_printf(s, "rate_rebuild:  %s\n", rebuilt ? "yes" : "NO");
+
+	mt7927_selftest_end(st);
 
 	return 0;
 }
+DEFINE_SHOW_ATTRIBUTE(mt7927_txd_bench);
+
+#define MT7927_TOKEN_TEST_FRAMES	FIELD_MAX(MT_TXFREE0_MSDU_CNT)
+#define MT7927_TOKEN_TEST_LEN		256
 
 /*
- * Send firmware data in chunks via FW_SCATTER command
- *
- * The firmware is split into 4KB chunks, each wrapped with an MCU TXD
- * and sent via the FWDL ring (ring 16).
+ * Run MT7927_TOKEN_TEST_FRAMES dummy 802.3 frames through the TX path:
+ * each gets its TXD from the scratch hw_encap station, is mapped and
+ * given a token, then all are reclaimed by one synthetic TX-free event.
+ * Shows what that event did; the tokens file only counts real events.
  */
-static int mt7927_mcu_send_firmware(struct mt7927_dev *dev, const void *data,
-				    int len)
+static int mt7927_token_test_show(struct seq_file *s, void *data)
 {
-	int chunk_size = MT7927_FW_CHUNK_SIZE;
-	u32 offset = 0;
-	int ret;
+	struct mt7927_dev *dev = s->private;
+	struct device *d = &dev->pdev->dev;
+	struct mt7927_token *tk = &dev->token;
+	u32 n = MT7927_TOKEN_TEST_FRAMES;
+	struct mt7927_selftest *st;
+	u64 reclaimed, t0, event_ns;
+	u32 i, words, info, shift;
+	int in_flight[2], id;
+	struct sk_buff *skb;
+	struct ethhdr *eth;
+	dma_addr_t dma;
+	__le32 *evt;
+	u32 bad_id;
+
+	words = 2 + DIV_ROUND_UP(n, 2);
+	evt = kcalloc(words, sizeof(*evt), GFP_KERNEL);
+	if (!evt)
+		return -ENOMEM;
 
-	dev_info(&dev->pdev->dev, "  Sending %d bytes in %d-byte chunks...\n",
-		 len, chunk_size);
+	st = mt7927_selftest_begin(dev, false);
+	if (IS_ERR(st)) {
+		kfree(evt);
+		return PTR_ERR(st);
+	}
 
-	while (len > 0) {
-		int cur_len = min(len, chunk_size);
-		bool last = (len <= chunk_size);
+	mt7927_sta_set_encap(st->sta, true);
 
-		if (debug_regs && (offset % (64 * 1024) == 0 || last))
-			dev_info(&dev->pdev->dev, "    Chunk: offset=0x%x len=%d%s\n",
-				 offset, cur_len, last ? " (last)" : "");
+	/* Both MSDU slots of every info word start out empty */
+	for (i = 2; i < words; i++)
+		evt[i] = cpu_to_le32(MT_TXFREE_INFO_MSDU_ID << 15 |
+				     MT_TXFREE_INFO_MSDU_ID);
 
-		ret = mt7927_mcu_send_fw_chunk(dev, data, cur_len, offset, last);
-		if (ret) {
-			dev_err(&dev->pdev->dev,
-				"  Failed to send chunk at offset 0x%x: %d\n",
-				offset, ret);
-			return ret;
+	in_flight[0] = atomic_read(&tk->count);
+
+	for (i = 0; i < n; i++) {
+		skb = alloc_skb(MT7927_TXD_SIZE + MT7927_TOKEN_TEST_LEN,
+				GFP_KERNEL);
+		if (!skb)
+			break;
+		skb_reserve(skb, MT7927_TXD_SIZE);
+		eth = skb_put_zero(skb, MT7927_TOKEN_TEST_LEN);
+		eth->h_proto = cpu_to_be16(ETH_P_IP);
+
+		if (mt7927_tx_write_txd(st->sta, i % MT7927_NUM_TIDS, skb)) {
+			kfree_skb(skb);
+			break;
 		}
 
-		data += cur_len;
-		offset += cur_len;
-		len -= cur_len;
+		dma = dma_map_single(d, skb->data, skb->len, DMA_TO_DEVICE);
+		if (dma_mapping_error(d, dma)) {
+			kfree_skb(skb);
+			break;
+		}
+
+		id = mt7927_token_get(dev, skb, dma, skb->len, 0);
+		if (id < 0) {
+			dma_unmap_single(d, dma, skb->len, DMA_TO_DEVICE);
+			kfree_skb(skb);
+			break;
+		}
+
+		shift = 15 * (i % 2);
+		info = le32_to_cpu(evt[2 + i / 2]);
+		info &= ~(MT_TXFREE_INFO_MSDU_ID << shift);
+		evt[2 + i / 2] = cpu_to_le32(info | id << shift);
 	}
 
-	dev_info(&dev->pdev->dev, "  Firmware data sent: %d bytes total\n", offset);
+	evt[0] = cpu_to_le32(FIELD_PREP(MT_RXD0_LENGTH, words * sizeof(*evt)) |
+			     FIELD_PREP(MT_TXFREE0_MSDU_CNT, i) |
+			     FIELD_PREP(MT_RXD0_PKT_TYPE, PKT_TYPE_TXRX_NOTIFY));
+	evt[1] = cpu_to_le32(FIELD_PREP(MT_TXFREE1_VER, 4));
+
+	mutex_lock(&dev->dma_mutex);
+	reclaimed = tk->reclaimed;
+	bad_id = tk->bad_id;
+	t0 = local_clock();
+	mt7927_rx_event(dev, evt, words * sizeof(*evt));
+	event_ns = local_clock() - t0;
+	reclaimed = tk->reclaimed - reclaimed;
+	bad_id = tk->bad_id - bad_id;
+	mutex_unlock(&dev->dma_mutex);
+
+	in_flight[1] = atomic_read(&tk->count);
+
+	seq_printf(s, "frames:        %u of %u\n", i, n);
+	seq_printf(s, "reclaimed:     %llu\n", reclaimed);
+	seq_printf(s, "bad_id:        %u\n", bad_id);
+	seq_printf(s, "in_flight:     %d before, %d after\n", in_flight[0],
+		   in_flight[1]);
+	seq_printf(s, "event_ns:      %llu\n", event_ns);
+
+	mt7927_selftest_end(st);
+	kfree(evt);
+
 	return 0;
 }
+DEFINE_SHOW_ATTRIBUTE(mt7927_token_test);
+
+#define MT7927_RXD_BENCH_ITERS		100000
+#define MT7927_RXD_BENCH_SAMPLES	4
 
 /*
- * Parse patch firmware and send to device
+ * Built-in RXD sample @n, for when no data frame has been received yet:
+ * 0 is a bare 802.3 frame with checksums verified, 1 adds the QoS and
+ * PN groups, 2 the P-RXV group, 3 has every group and header padding.
  */
-static int mt7927_load_patch(struct mt7927_dev *dev)
+static int mt7927_rxd_sample_build(u8 *buf, int n)
 {
-	const struct firmware *fw;
-	const struct mt7927_patch_hdr *hdr;
-	const struct mt7927_patch_sec *sec;
-	const u8 *fw_data;
-	u32 n_section;
-	u32 ring_base;
-	int ret, i;
+	static const u32 groups[MT7927_RXD_BENCH_SAMPLES] = {
+		0,
+		MT_RXD1_NORMAL_GROUP_4 | MT_RXD1_NORMAL_GROUP_1,
+		MT_RXD1_NORMAL_GROUP_3,
+		MT_RXD1_NORMAL_GROUP_4 | MT_RXD1_NORMAL_GROUP_1 |
+		MT_RXD1_NORMAL_GROUP_2 | MT_RXD1_NORMAL_GROUP_3 |
+		MT_RXD1_NORMAL_GROUP_5,
+	};
+	__le32 *rxd = (__le32 *)buf, *g;
+	u32 rxd1 = FIELD_PREP(MT_RXD1_NORMAL_WLAN_IDX, 1) | groups[n];
+	u32 rxd2 = MT_RXD2_NORMAL_HDR_TRANS;
+	struct ethhdr *eth;
+	int len;
+
+	memset(buf, 0, MT7927_RXD_REC_BYTES);
+	g = rxd + MT7927_RXD_WORDS;
+
+	if (rxd1 & MT_RXD1_NORMAL_GROUP_4) {
+		g[0] = cpu_to_le32(FIELD_PREP(MT_RXD8_FRAME_CONTROL,
+					      IEEE80211_FTYPE_DATA |
+					      IEEE80211_STYPE_QOS_DATA));
+		g[2] = cpu_to_le32(FIELD_PREP(MT_RXD10_SEQ_CTRL, 100 << 4) |
+				   FIELD_PREP(MT_RXD10_QOS_CTL, 5));
+		g += 4;
+	}
+	if (rxd1 & MT_RXD1_NORMAL_GROUP_1) {
+		rxd1 |= MT_RXD1_NORMAL_SEC_DONE;
+		rxd2 |= FIELD_PREP(MT_RXD2_NORMAL_SEC_MODE, 4);
+		g[0] = cpu_to_le32(0x1234);
+		g += 4;
+	}
+	if (rxd1 & MT_RXD1_NORMAL_GROUP_2)
+		g += 2;
+	if (rxd1 & MT_RXD1_NORMAL_GROUP_3) {
+		g[0] = cpu_to_le32(FIELD_PREP(MT_PRXV_TX_RATE, 9) |
+				   FIELD_PREP(MT_PRXV_NSTS, 1));
+		g[2] = cpu_to_le32(FIELD_PREP(MT_PRXV_TX_MODE, 8) |
+				   FIELD_PREP(MT_PRXV_FRAME_MODE, 2));
+		g[3] = cpu_to_le32(FIELD_PREP(MT_PRXV_RCPI0, 140) |
+				   FIELD_PREP(MT_PRXV_RCPI1, 136));
+		g += 4;
+	}
+	if (rxd1 & MT_RXD1_NORMAL_GROUP_5)
+		g += 24;
+	if (n == 3) {
+		rxd2 |= FIELD_PREP(MT_RXD2_NORMAL_HDR_OFFSET, 1);
+		g = (void *)g + 2;
+	}
 
-	dev_info(&dev->pdev->dev, "=== Loading Patch Firmware ===\n");
+	eth = (struct ethhdr *)g;
+	eth->h_proto = cpu_to_be16(ETH_P_IP);
+	len = min_t(int, (u8 *)(eth + 1) - buf + 4, MT7927_RXD_REC_BYTES);
 
-	/*
-	 * CRITICAL: Verify ring BASE is non-zero before attempting DMA!
-	 * If the ring BASE is 0, the device will try to DMA from address 0,
-	 * causing IOMMU page faults.
-	 */
-	ring_base = mt7927_rr(dev, MT_TX_RING_BASE + 16 * MT_RING_SIZE);
-	dev_info(&dev->pdev->dev, "  Pre-DMA check: Ring 16 BASE = 0x%08x\n", ring_base);
-	if (ring_base == 0) {
-		dev_err(&dev->pdev->dev,
-			"  ABORT: Ring BASE is 0! DMA would cause page faults.\n");
-		dev_err(&dev->pdev->dev,
-			"  Ring registers are not writable. Check DMA initialization.\n");
-		return -EIO;
+	rxd[0] = cpu_to_le32(FIELD_PREP(MT_RXD0_LENGTH, len) |
+			     FIELD_PREP(MT_RXD0_PKT_TYPE, PKT_TYPE_NORMAL));
+	rxd[1] = cpu_to_le32(rxd1);
+	rxd[2] = cpu_to_le32(rxd2);
+	rxd[3] = cpu_to_le32(MT_RXD3_NORMAL_IP_SUM |
+			     MT_RXD3_NORMAL_UDP_TCP_SUM);
+
+	return len;
+}
+
+/* Stop RXD sampling once the record is full or the device goes away */
+static void mt7927_rxd_rec_disarm(struct mt7927_dev *dev)
+{
+	bool armed;
+
+	mutex_lock(&dev->dma_mutex);
+	armed = dev->rxd_rec.armed;
+	dev->rxd_rec.armed = false;
+	mutex_unlock(&dev->dma_mutex);
+
+	if (armed)
+		static_branch_dec(&mt7927_rxd_rec_key);
+}
+
+/*
+ * Time mt7927_rxd_parse() over the RXD samples recorded since the last
+ * write to this file, or the built-in ones if none were recorded, and
+ * show what it decoded.
+ */
+static int mt7927_rxd_bench_show(struct seq_file *s, void *data)
+{
+	struct mt7927_dev *dev = s->private;
+	struct mt7927_rxd_rec *rec;
+	struct mt7927_rxd_info ri;
+	bool recorded;
+	u64 t0, ns;
+	int i, n, ret;
+
+	rec = kmalloc(sizeof(*rec), GFP_KERNEL);
+	if (!rec)
+		return -ENOMEM;
+
+	mutex_lock(&dev->dma_mutex);
+	*rec = dev->rxd_rec;
+	mutex_unlock(&dev->dma_mutex);
+
+	if (rec->count == MT7927_RXD_REC_SAMPLES)
+		mt7927_rxd_rec_disarm(dev);
+
+	recorded = rec->count;
+	if (!recorded) {
+		for (n = 0; n < MT7927_RXD_BENCH_SAMPLES; n++)
+			rec->len[n] = mt7927_rxd_sample_build(rec->buf[n], n);
+		rec->count = MT7927_RXD_BENCH_SAMPLES;
 	}
 
-	/* Request patch firmware */
-	ret = request_firmware(&fw,
-			       "mediatek/mt7925/WIFI_MT7925_PATCH_MCU_1_1_hdr.bin",
-			       &dev->pdev->dev);
-	if (ret) {
-		dev_err(&dev->pdev->dev,
-			"  Failed to load patch firmware: %d\n", ret);
-		return ret;
+	t0 = local_clock();
+	for (i = 0; i < MT7927_RXD_BENCH_ITERS; i++) {
+		n = i % rec->count;
+		mt7927_rxd_parse(rec->buf[n], rec->len[n], &ri);
+		barrier_data(&ri);
 	}
+	ns = local_clock() - t0;
+
+	seq_printf(s, "samples:       %u (%s%s)\n", rec->count,
+		   recorded ? "recorded" : "built-in",
+		   rec->armed && rec->count < MT7927_RXD_REC_SAMPLES ?
+		   ", sampling" : "");
+	seq_printf(s, "iterations:    %u\n", MT7927_RXD_BENCH_ITERS);
+	seq_printf(s, "parse_ns:      %llu (%llu ns/rxd)\n", ns,
+		   div_u64(ns, MT7927_RXD_BENCH_ITERS));
+
+	for (n = 0; n < rec->count; n++) {
+		memset(&ri, 0, sizeof(ri));
+		ret = mt7927_rxd_parse(rec->buf[n], rec->len[n], &ri);
+		if (ret) {
+			seq_printf(s, "%2d: invalid (%d)\n", n, ret);
+			continue;
+		}
 
-	dev_info(&dev->pdev->dev, "  Patch firmware loaded: %zu bytes\n", fw->size);
+		seq_printf(s, "%2d: wcid=%u gap=%u len=%u flags=0x%02x sn=%u tid=%u pn=%llu rate=%u/%u nss=%u bw=%u rssi=%d,%d\n",
+			   n, ri.wcid, ri.hdr_gap, ri.len, ri.flags, ri.seqno,
+			   ri.tid, ri.pn, ri.rate_mode, ri.rate_idx, ri.nss,
+			   ri.bw, ri.rssi[0], ri.rssi[1]);
+	}
 
-	if (fw->size < sizeof(*hdr)) {
-		dev_err(&dev->pdev->dev, "  Patch file too small\n");
-		ret = -EINVAL;
-		goto out;
+	kfree(rec);
+
+	return 0;
+}
+
+static int mt7927_rxd_bench_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, mt7927_rxd_bench_show, inode->i_private);
+}
+
+/*
+ * Any write drops the recorded samples and arms a one-shot capture of the
+ * next MT7927_RXD_REC_SAMPLES data RXDs. mt7927_rxd_rec_add() only looks at
+ * the record while mt7927_rxd_rec_key is enabled.
+ */
+static ssize_t mt7927_rxd_bench_write(struct file *file,
+				      const char __user *ubuf,
+				      size_t count, loff_t *ppos)
+{
+	struct mt7927_dev *dev = file_inode(file)->i_private;
+	bool arm;
+
+	mutex_lock(&dev->dma_mutex);
+	dev->rxd_rec.count = 0;
+	arm = !dev->rxd_rec.armed;
+	dev->rxd_rec.armed = true;
+	mutex_unlock(&dev->dma_mutex);
+
+	if (arm)
+		static_branch_inc(&mt7927_rxd_rec_key);
+
+	return count;
+}
+
+static const struct file_operations mt7927_rxd_bench_fops = {
+	.owner = THIS_MODULE,
+	.open = mt7927_rxd_bench_open,
+	.read = seq_read,
+	.write = mt7927_rxd_bench_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+#define MT7927_AMSDU_BENCH_FRAMES	1024
+#define MT7927_AMSDU_BENCH_LEN		128
+#define MT7927_AMSDU_BENCH_BURST	32
+
+static int mt7927_ptr_cmp(const void *a, const void *b)
+{
+	const void *pa = *(void * const *)a, *pb = *(void * const *)b;
+
+	if (pa == pb)
+		return 0;
+	return pa < pb ? -1 : 1;
+}
+
+/*
+ * Take back, as a TX-free event would, the tokens holding any of the
+ * @n frames in @skbs (sorted here), and free those frames. @skbs is only
+ * compared against, since frames the TX path dropped are already gone.
+ * So are frames a chip reset drained, and their addresses may have been
+ * handed out again: only tokens of @st's generation are looked at, which
+ * leaves those and the tokens of other senders alone. Called under
+ * dma_mutex.
+ */
+static void mt7927_token_release_skbs(struct mt7927_selftest *st,
+				      struct sk_buff **skbs, int n)
+{
+	struct mt7927_dev *dev = st->dev;
+	struct mt7927_token *tk = &dev->token;
+	struct sk_buff *skb, *list = NULL;
+	unsigned int id;
+
+	sort(skbs, n, sizeof(*skbs), mt7927_ptr_cmp, NULL);
+
+	for_each_set_bit(id, tk->live, MT7927_TOKEN_SIZE) {
+		if (tk->txwi[id].gen != st->gen)
+			continue;
+
+		skb = READ_ONCE(tk->txwi[id].skb);
+		if (!skb || !bsearch(&skb, skbs, n, sizeof(*skbs),
+				     mt7927_ptr_cmp))
+			continue;
+
+		skb = mt7927_token_release(dev, id);
+		if (!skb)
+			continue;
+
+		skb->next = list;
+		list = skb;
 	}
+	mt7927_tx_skb_list_free(list);
+}
 
-	/* Parse patch header */
-	hdr = (const struct mt7927_patch_hdr *)fw->data;
+/*
+ * One pass of mt7927_amsdu_bench_show(): send the frames, then take
+ * their tokens back as a TX-free event would. Only the send is timed.
+ */
+static int mt7927_amsdu_bench_run(struct mt7927_selftest *st, bool agg,
+				  u64 *ns)
+{
+	struct mt7927_dev *dev = st->dev;
+	struct mt7927_sta *sta = st->sta;
+	struct mt7927_tx_batch *b = st->b;
+	struct sk_buff **skbs;
+	struct ethhdr *eth;
+	u64 t0;
+	int i;
 
-	dev_info(&dev->pdev->dev, "  Patch build: %.16s\n", hdr->build_date);
-	dev_info(&dev->pdev->dev, "  Platform: %.4s\n", hdr->platform);
-	dev_info(&dev->pdev->dev, "  HW/SW version: 0x%08x\n",
-		 be32_to_cpu(hdr->hw_sw_ver));
-	dev_info(&dev->pdev->dev, "  Patch version: 0x%08x\n",
-		 be32_to_cpu(hdr->patch_ver));
+	skbs = kcalloc(MT7927_AMSDU_BENCH_FRAMES, sizeof(*skbs), GFP_KERNEL);
+	if (!skbs)
+		return -ENOMEM;
 
-	n_section = be32_to_cpu(hdr->desc.n_region);
-	dev_info(&dev->pdev->dev, "  Number of sections: %d\n", n_section);
+	for (i = 0; i < MT7927_AMSDU_BENCH_FRAMES; i++) {
+		skbs[i] = alloc_skb(MT7927_TXP_HDR_SIZE + MT7927_AMSDU_BENCH_LEN,
+				    GFP_KERNEL);
+		if (!skbs[i])
+			goto err;
 
-	if (n_section == 0 || n_section > 64) {
-		dev_err(&dev->pdev->dev, "  Invalid section count: %d\n", n_section);
-		ret = -EINVAL;
-		goto out;
+		skb_reserve(skbs[i], MT7927_TXP_HDR_SIZE);
+		eth = skb_put_zero(skbs[i], MT7927_AMSDU_BENCH_LEN);
+		eth->h_proto = cpu_to_be16(ETH_P_IP);
 	}
 
-	/*
-	 * v0.5.0: Acquire patch semaphore from ROM bootloader FIRST!
-	 * This tells the ROM we're about to download a patch.
-	 * Without this, the ROM ignores our FW_SCATTER data.
-	 */
-	ret = mt7927_mcu_patch_sem_ctrl(dev, true);
-	if (ret) {
-		dev_warn(&dev->pdev->dev,
-			 "  PATCH_SEM_CONTROL failed: %d (continuing anyway)\n", ret);
-		/* Don't fail - try downloading anyway */
+	t0 = local_clock();
+	for (i = 0; i < MT7927_AMSDU_BENCH_FRAMES; i++) {
+		if (agg) {
+			mt7927_amsdu_add(dev, sta, 0, skbs[i], b,
+					 (i + 1) % MT7927_AMSDU_BENCH_BURST);
+		} else {
+			mt7927_tx_single(dev, sta, 0, skbs[i], b);
+			mt7927_tx_batch_kick(dev, b);
+		}
 	}
+	*ns = local_clock() - t0;
 
-	/* Section headers follow the main header */
-	sec = (const struct mt7927_patch_sec *)(fw->data + sizeof(*hdr));
+	mt7927_token_release_skbs(st, skbs, MT7927_AMSDU_BENCH_FRAMES);
 
-	/* Process each section */
-	for (i = 0; i < n_section; i++) {
-		u32 sec_type = be32_to_cpu(sec[i].type);
-		u32 sec_offs = be32_to_cpu(sec[i].offs);
-		u32 sec_size = be32_to_cpu(sec[i].size);
-		u32 sec_addr = be32_to_cpu(sec[i].info.addr);
+	kfree(skbs);
+	return 0;
 
-		dev_info(&dev->pdev->dev,
-			 "  Section %d: type=0x%x offs=0x%x size=%d addr=0x%08x\n",
-			 i, sec_type, sec_offs, sec_size, sec_addr);
+err:
+	while (i--)
+		kfree_skb(skbs[i]);
+	kfree(skbs);
+	return -ENOMEM;
+}
 
-		/* Check bounds */
-		if (sec_offs + sec_size > fw->size) {
-			dev_err(&dev->pdev->dev,
-				"  Section %d exceeds file size\n", i);
-			ret = -EINVAL;
-			goto out_release_sem;
-		}
+/*
+ * Time MT7927_AMSDU_BENCH_FRAMES small 802.3 frames through the TX path
+ * with one TXD and doorbell per frame, then through the A-MSDU stage in
+ * bursts of MT7927_AMSDU_BENCH_BURST, on a scratch hw_encap station.
+ * There is no data ring yet, so descriptors land in the batch and
+ * doorbells are counted rather than written. The live counters in the
+ * amsdu file are left as they were.
+ */
+static int mt7927_amsdu_bench_show(struct seq_file *s, void *data)
+{
+	struct mt7927_dev *dev = s->private;
+	struct mt7927_amsdu_stats one, agg;
+	struct mt7927_selftest *st;
+	u64 one_ns = 0, agg_ns = 0;
+	int ret;
 
-		/*
-		 * v0.5.0: Send TARGET_ADDRESS_LEN_REQ to tell ROM where to put data
-		 * This MUST be sent before FW_SCATTER for each section!
-		 */
-		ret = mt7927_mcu_init_download(dev, sec_addr, sec_size);
-		if (ret) {
-			dev_warn(&dev->pdev->dev,
-				 "  TARGET_ADDRESS_LEN_REQ failed: %d (continuing)\n", ret);
-			/* Don't fail - try downloading anyway */
+	st = mt7927_selftest_begin(dev, false);
+	if (IS_ERR(st))
+		return PTR_ERR(st);
+
+	mt7927_sta_set_encap(st->sta, true);
+
+	/* Holding dma_mutex keeps TX-free events off the tokens */
+	mutex_lock(&dev->dma_mutex);
+	memset(&dev->amsdu_stats, 0, sizeof(dev->amsdu_stats));
+	ret = mt7927_amsdu_bench_run(st, false, &one_ns);
+	one = dev->amsdu_stats;
+
+	memset(&dev->amsdu_stats, 0, sizeof(dev->amsdu_stats));
+	if (!ret)
+		ret = mt7927_amsdu_bench_run(st, true, &agg_ns);
+	agg = dev->amsdu_stats;
+	mutex_unlock(&dev->dma_mutex);
+
+	if (ret)
+		goto out;
+
+	seq_printf(s, "frames:        %u x %u bytes, bursts of %u\n",
+		   MT7927_AMSDU_BENCH_FRAMES, MT7927_AMSDU_BENCH_LEN,
+		   MT7927_AMSDU_BENCH_BURST);
+	seq_printf(s, "max_len:       %u\n", st->sta->amsdu[0].max_len);
+	seq_printf(s, "single:        %llu pkt/s, %llu descriptors, %llu doorbells\n",
+		   div64_u64((u64)MT7927_AMSDU_BENCH_FRAMES * NSEC_PER_SEC,
+			     max_t(u64, one_ns, 1)),
+		   one.descs, one.kicks);
+	seq_printf(s, "amsdu:         %llu pkt/s, %llu descriptors, %llu doorbells\n",
+		   div64_u64((u64)MT7927_AMSDU_BENCH_FRAMES * NSEC_PER_SEC,
+			     max_t(u64, agg_ns, 1)),
+		   agg.descs, agg.kicks);
+	seq_printf(s, "dropped:       %u / %u\n", one.drop, agg.drop);
+
+out:
+	mt7927_selftest_end(st);
+	return ret;
+}
+DEFINE_SHOW_ATTRIBUTE(mt7927_amsdu_bench);
+
+#define MT7927_MLO_TEST_BURSTS		16
+#define MT7927_MLO_TEST_BURST		16
+#define MT7927_MLO_TEST_LEN		1500
+#define MT7927_MLO_TEST_RX		64
+
+/*
+ * One TX pass of mt7927_mlo_test_show(): bursts of 1500-byte frames on
+ * TID 0, with the tokens of each burst taken back after it as a TX-free
+ * event would. Returns how often consecutive descriptors changed link.
+ */
+static int mt7927_mlo_test_tx(struct mt7927_selftest *st,
+			      struct mt7927_sta *sta)
+{
+	struct mt7927_dev *dev = st->dev;
+	struct mt7927_mock *mock = st->mock;
+	struct mt7927_tx_batch *b = st->b;
+	struct sk_buff *skbs[MT7927_MLO_TEST_BURST];
+	struct ethhdr *eth;
+	int i, j, moves = 0;
+
+	memset(mock->queued, 0, sizeof(mock->queued));
+	memset(mock->kicks, 0, sizeof(mock->kicks));
+	mock->ntx = 0;
+	memset(sta->tid_link, 0, sizeof(sta->tid_link));
+
+	for (i = 0; i < MT7927_MLO_TEST_BURSTS; i++) {
+		for (j = 0; j < MT7927_MLO_TEST_BURST; j++) {
+			skbs[j] = alloc_skb(MT7927_TXP_HDR_SIZE +
+					    MT7927_MLO_TEST_LEN, GFP_KERNEL);
+			if (!skbs[j])
+				break;
+
+			skb_reserve(skbs[j], MT7927_TXP_HDR_SIZE);
+			eth = skb_put_zero(skbs[j], MT7927_MLO_TEST_LEN);
+			eth->h_proto = cpu_to_be16(ETH_P_IP);
+			mt7927_amsdu_add(dev, sta, 0, skbs[j], b,
+					 j + 1 < MT7927_MLO_TEST_BURST);
 		}
 
-		/*
-		 * Download all sections - the type field indicates encryption,
-		 * not whether to download. The kernel driver downloads all
-		 * sections unless feature_set has FW_FEATURE_NON_DL.
-		 *
-		 * sec_type interpretation (from kernel):
-		 *   - Bits 0-1: Section type
-		 *   - Bit 24+: Encryption flags
-		 */
-		fw_data = fw->data + sec_offs;
+		if (j < MT7927_MLO_TEST_BURST)
+			mt7927_tx_batch_flush(dev, b);
+		mt7927_token_release_skbs(st, skbs, j);
+		if (j < MT7927_MLO_TEST_BURST)
+			return -ENOMEM;
+	}
+
+	for (i = 1; i < mock->ntx; i++)
+		moves += mock->tx_ring[i] != mock->tx_ring[i - 1];
+
+	return moves;
+}
+
+/*
+ * Feed MT7927_MLO_TEST_RX QoS frames of one TID, alternating between the
+ * WLAN indexes of both links and swapped in pairs, through mt7927_rx_data().
+ * Returns how many came out of the reorder buffer in sequence.
+ */
+static int mt7927_mlo_test_rx(struct mt7927_dev *dev,
+			      struct mt7927_mock *mock, struct mt7927_sta *sta)
+{
+	__le32 *rxd;
+	u8 *buf;
+	int i, len, in_order = 0;
+	u16 sn;
+
+	buf = kmalloc(MT7927_RXD_REC_BYTES, GFP_KERNEL);
+	if (!buf)
+		return -ENOMEM;
+
+	mock->nrx = 0;
+	rxd = (__le32 *)buf;
+	for (i = 0; i < MT7927_MLO_TEST_RX; i++) {
+		sn = i ^ 1;
+		len = mt7927_rxd_sample_build(buf, 1);
+		rxd[1] = cpu_to_le32((le32_to_cpu(rxd[1]) &
+				      ~MT_RXD1_NORMAL_WLAN_IDX) |
+				     FIELD_PREP(MT_RXD1_NORMAL_WLAN_IDX,
+						sta->link_wcid[sn & 1]));
+		rxd[MT7927_RXD_WORDS + 2] =
+			cpu_to_le32(FIELD_PREP(MT_RXD10_SEQ_CTRL, sn << 4));
+		rxd[MT7927_RXD_WORDS + 4] = cpu_to_le32(sn + 1);
+		mt7927_rx_data(dev, buf, len);
+	}
+
+	for (i = 0; i < mock->nrx; i++)
+		in_order += mock->rx_sn[i] == i;
+
+	kfree(buf);
+	return in_order;
+}
+
+/*
+ * MLO self-test against a mock device: MCU commands, TX doorbells and
+ * RX deliveries go to dev->mock instead of the chip. Sets up 5 GHz
+ * channel 36/80 as link 0 and 6 GHz channel 37/320 as link 1, an MLD
+ * station on the top two WLAN indexes and a block-ack session on TID 0,
+ * then shows how each policy spreads a bulk flow over the link rings and
+ * checks that RX split over both links leaves in sequence. Links,
+ * policy and counters are put back afterwards.
+ */
+static int mt7927_mlo_test_show(struct seq_file *s, void *data)
+{
+	struct mt7927_dev *dev = s->private;
+	struct mt7927_link saved[MT7927_MAX_LINKS];
+	enum mt7927_mlo_policy saved_policy;
+	u16 wcid = MT7927_WTBL_SIZE - 2;
+	struct mt7927_chandef c[MT7927_MAX_LINKS];
+	u32 queued[2][MT7927_MAX_LINKS], kicks[2][MT7927_MAX_LINKS];
+	int moves[2], in_order = 0, ret;
+	struct mt7927_selftest *st;
+	struct mt7927_mock *mock;
+	struct mt7927_sta *sta;
+	u32 mcu_cmds = 0;
+	u8 l, p;
+
+	ret = mt7927_chandef_init(&c[0], MT7927_BAND_5G, 36, 80, 0);
+	if (!ret)
+		ret = mt7927_chandef_init(&c[1], MT7927_BAND_6G, 37, 320, 0);
+	if (ret)
+		return ret;
 
-		dev_info(&dev->pdev->dev,
-			 "  Downloading section %d (%d bytes) to 0x%08x...\n",
-			 i, sec_size, sec_addr);
+	st = mt7927_selftest_begin(dev, true);
+	if (IS_ERR(st))
+		return PTR_ERR(st);
+	mock = st->mock;
 
-		ret = mt7927_mcu_send_firmware(dev, fw_data, sec_size);
-		if (ret) {
-			dev_err(&dev->pdev->dev,
-				"  Section %d download failed: %d\n", i, ret);
-			goto out_release_sem;
-		}
+	if (mt7927_sta_get(dev, wcid) || mt7927_sta_get(dev, wcid + 1)) {
+		ret = -EBUSY;
+		goto out;
 	}
 
-	dev_info(&dev->pdev->dev, "  Patch firmware download complete\n");
+	memcpy(saved, dev->link, sizeof(saved));
+	saved_policy = dev->mlo_policy;
+
+	for (l = 0; l < MT7927_MAX_LINKS && !ret; l++)
+		ret = mt7927_link_add(dev, l, &c[l]);
+	if (!ret)
+		ret = mt7927_sta_add(dev, wcid, 0, 0);
+	if (ret)
+		goto restore;
+
+	sta = mt7927_sta_get(dev, wcid);
+	mt7927_sta_set_encap(sta, true);
+	ret = mt7927_sta_add_link(dev, sta, 1, wcid + 1);
+	if (!ret)
+		ret = mt7927_ba_rx_start(dev, sta, 0, 0, MT7927_MLO_TEST_RX);
+	if (ret)
+		goto remove;
+
+	/* Holding dma_mutex keeps TX-free events off the tokens */
+	mutex_lock(&dev->dma_mutex);
+	for (p = 0; p < 2 && ret >= 0; p++) {
+		dev->mlo_policy = p ? MT7927_MLO_THROUGHPUT : MT7927_MLO_LATENCY;
+		ret = mt7927_mlo_test_tx(st, sta);
+		moves[p] = ret;
+		memcpy(queued[p], mock->queued, sizeof(queued[p]));
+		memcpy(kicks[p], mock->kicks, sizeof(kicks[p]));
+	}
+	if (ret >= 0)
+		ret = in_order = mt7927_mlo_test_rx(dev, mock, sta);
+	mutex_unlock(&dev->dma_mutex);
+
+remove:
+	mt7927_sta_remove(dev, wcid);
+restore:
+	mcu_cmds = mock->mcu_cmds;
+	memcpy(dev->link, saved, sizeof(saved));
+	dev->mlo_policy = saved_policy;
+
+	if (ret < 0)
+		goto out;
 	ret = 0;
 
-out_release_sem:
-	/* Release patch semaphore */
-	mt7927_mcu_patch_sem_ctrl(dev, false);
+	seq_printf(s, "links:         %s %u/%u MHz, %s %u/%u MHz\n",
+		   mt7927_band_name[c[0].band], c[0].chan, c[0].width,
+		   mt7927_band_name[c[1].band], c[1].chan, c[1].width);
+	seq_printf(s, "mcu_cmds:      %u (mocked)\n", mcu_cmds);
+	seq_printf(s, "frames:        %u x %u bytes, bursts of %u\n",
+		   MT7927_MLO_TEST_BURSTS * MT7927_MLO_TEST_BURST,
+		   MT7927_MLO_TEST_LEN, MT7927_MLO_TEST_BURST);
+	for (p = 0; p < 2; p++)
+		seq_printf(s, "%-11s    descriptors %u/%u, doorbells %u/%u, link moves %d\n",
+			   mt7927_mlo_policy_name[p], queued[p][0],
+			   queued[p][1], kicks[p][0], kicks[p][1], moves[p]);
+	seq_printf(s, "rx_in_order:   %d/%u, %s\n", in_order, MT7927_MLO_TEST_RX,
+		   in_order == MT7927_MLO_TEST_RX ? "yes" : "NO");
+
 out:
-	release_firmware(fw);
+	mt7927_selftest_end(st);
 	return ret;
 }
+DEFINE_SHOW_ATTRIBUTE(mt7927_mlo_test);
+
+#define MT7927_BUSY_POLL_ROUNDS		1000
+#define MT7927_BUSY_POLL_AIR_US		20
+
+#ifdef CONFIG_NET_RX_BUSY_POLL
+static bool mt7927_busy_poll_end(void *arg, unsigned long start_time)
+{
+	struct mt7927_mock *mock = arg;
+
+	return atomic_read(&mock->rx_done) >= mock->rx_want;
+}
+#endif
 
 /*
- * v0.9.0: Wake ROM bootloader and wait for it to be ready for firmware download
- *
- * The ROM bootloader after WFSYS reset may be in a sleep/idle state.
- * We need to wake it up and wait for it to start polling the DMA rings.
- *
- * Key registers:
- *   MT_MCU_CMD (0xd41f0): Send commands/wake signals to MCU
- *   MT_CONN_ON_MISC (0x7c0600f0): Read ROM state
- *
- * The ROM transitions through states:
- *   0 -> INITIAL (just after reset)
- *   1 -> FW_DOWNLOAD (ready to receive firmware)
- *   2-7 -> Various operational states
+ * One request/response round trip against the mock device: the response
+ * arrives MT7927_BUSY_POLL_AIR_US after the request, then is either
+ * waited for (interrupt, NAPI softirq, wake-up) or busy-polled for the
+ * way a SO_BUSY_POLL socket would.
  */
-static int mt7927_wait_for_rom_ready(struct mt7927_dev *dev)
+static int mt7927_busy_poll_round(struct mt7927_mock *mock, bool busy,
+				  u64 *ns)
 {
-	u32 status, mcu_cmd, state;
-	int i;
+	unsigned long timeout = jiffies + HZ / 10;
+	u64 t0;
+
+	mock->rx_want = atomic_read(&mock->rx_done) + 1;
+
+	t0 = ktime_get_ns();
+	hrtimer_start(&mock->rx_timer, us_to_ktime(MT7927_BUSY_POLL_AIR_US),
+		      HRTIMER_MODE_REL);
+
+	if (busy) {
+#ifdef CONFIG_NET_RX_BUSY_POLL
+		while (atomic_read(&mock->rx_done) < mock->rx_want &&
+		       time_before(jiffies, timeout))
+			napi_busy_loop(mock->napi.napi_id,
+				       mt7927_busy_poll_end, mock, false,
+				       BUSY_POLL_BUDGET);
+#endif
+	} else {
+		wait_var_event_timeout(&mock->rx_done,
+				       atomic_read(&mock->rx_done) >=
+				       mock->rx_want,
+				       timeout - jiffies);
+	}
+	*ns = ktime_get_ns() - t0;
 
-	dev_info(&dev->pdev->dev, "=== v0.9.0: Wait for ROM Bootloader Ready ===\n");
+	return atomic_read(&mock->rx_done) >= mock->rx_want ? 0 : -ETIMEDOUT;
+}
 
-	/* Read initial state */
-	status = mt7927_rr_remap(dev, MT_CONN_ON_MISC);
-	mcu_cmd = mt7927_rr(dev, MT_MCU_CMD);
-	dev_info(&dev->pdev->dev, "  Initial: MT_CONN_ON_MISC=0x%08x MT_MCU_CMD=0x%08x\n",
-		 status, mcu_cmd);
+/*
+ * Round-trip time of MT7927_BUSY_POLL_ROUNDS single-frame exchanges with
+ * the mock device, through the mock's NAPI instance, with interrupts
+ * and then with busy polling, and how many data RX interrupts each took.
+ * Busy polling needs CONFIG_NET_RX_BUSY_POLL.
+ */
+static int mt7927_busy_poll_bench_show(struct seq_file *s, void *data)
+{
+	static const char * const name[] = { "irq:", "busy_poll:" };
+	int passes = IS_ENABLED(CONFIG_NET_RX_BUSY_POLL) ? 2 : 1;
+	struct mt7927_dev *dev = s->private;
+	struct mt7927_selftest *st;
+	u32 irqs[2], masked[2];
+	struct mt7927_tx_lat *lat;
+	struct mt7927_mock *mock;
+	int i, p, ret = 0;
+	u64 ns;
+
+	lat = kcalloc(2, sizeof(*lat), GFP_KERNEL);
+	if (!lat)
+		return -ENOMEM;
 
-	state = status & MT_TOP_MISC2_FW_STATE;
-	dev_info(&dev->pdev->dev, "  FW state=%d (0=INITIAL, 1=FW_DOWNLOAD, 7=RDY)\n", state);
+	st = mt7927_selftest_begin(dev, true);
+	if (IS_ERR(st)) {
+		kfree(lat);
+		return PTR_ERR(st);
+	}
+	mock = st->mock;
 
-	/*
-	 * Try to wake the ROM bootloader by signaling INIT_DONE.
-	 * This tells the ROM that the driver has completed initialization
-	 * and is ready for firmware download.
-	 */
-	dev_info(&dev->pdev->dev, "  Setting MCU_CMD_INIT_DONE to wake ROM...\n");
-	mt7927_wr(dev, MT_MCU_CMD, MT_MCU_CMD_INIT_DONE);
-	udelay(100);
+	ret = mt7927_mock_rx_init(mock);
+	if (ret)
+		goto out;
 
-	/* Read back */
-	mcu_cmd = mt7927_rr(dev, MT_MCU_CMD);
-	dev_info(&dev->pdev->dev, "  After INIT_DONE: MT_MCU_CMD=0x%08x\n", mcu_cmd);
+	mock->rx_len = mt7927_rxd_sample_build(mock->rx_buf, 0);
 
-	/*
-	 * Poll for ROM to enter a ready state.
-	 * In v0.8.0 we saw MT_CONN_ON_MISC=0x00000000 which means ROM isn't responding.
-	 * We'll poll for any non-zero state indicating the ROM is alive.
-	 */
-	dev_info(&dev->pdev->dev, "  Polling MT_CONN_ON_MISC for ROM ready (500ms)...\n");
+	for (p = 0; p < passes && !ret; p++) {
+		mock->irqs = 0;
+		mock->irqs_masked = 0;
+		for (i = 0; i < MT7927_BUSY_POLL_ROUNDS && !ret; i++) {
+			ret = mt7927_busy_poll_round(mock, p, &ns);
+			if (!ret)
+				mt7927_lat_record(&lat[p], ns);
+		}
+		irqs[p] = mock->irqs;
+		masked[p] = mock->irqs_masked;
+	}
 
-	for (i = 0; i < 500; i++) {
-		status = mt7927_rr_remap(dev, MT_CONN_ON_MISC);
-		state = status & MT_TOP_MISC2_FW_STATE;
+	/* No more arrivals once the numbers are in */
+	mt7927_mock_rx_free(mock);
 
-		if (i % 100 == 0)
-			dev_info(&dev->pdev->dev, "    [%dms] MT_CONN_ON_MISC=0x%08x state=%d\n",
-				 i, status, state);
+	if (ret)
+		goto out;
 
-		/* Check if ROM indicates any activity */
-		if (status != 0 && status != 0xdeadbeef) {
-			dev_info(&dev->pdev->dev,
-				 "  ROM responding! MT_CONN_ON_MISC=0x%08x\n", status);
-			return 0;
-		}
+	seq_printf(s, "rounds:        %u, response after %u us\n",
+		   MT7927_BUSY_POLL_ROUNDS, MT7927_BUSY_POLL_AIR_US);
+	for (p = 0; p < passes; p++)
+		seq_printf(s, "%-15srtt p50 %llu us, p99 %llu us, max %llu us, %u interrupts, %u suppressed\n",
+			   name[p],
+			   div_u64(mt7927_tx_lat_pct(&lat[p], 50), NSEC_PER_USEC),
+			   div_u64(mt7927_tx_lat_pct(&lat[p], 99), NSEC_PER_USEC),
+			   div_u64(lat[p].max_ns, NSEC_PER_USEC),
+			   irqs[p], masked[p]);
+	if (passes == 1)
+		seq_puts(s, "busy_poll:     not built (CONFIG_NET_RX_BUSY_POLL)\n");
 
-		/* Also check if N9_RDY bits are set */
-		if ((status & MT_TOP_MISC2_FW_N9_RDY) == MT_TOP_MISC2_FW_N9_RDY) {
-			dev_info(&dev->pdev->dev, "  ROM N9_RDY! Ready for commands.\n");
-			return 0;
-		}
+out:
+	mt7927_selftest_end(st);
+	kfree(lat);
+	return ret;
+}
+DEFINE_SHOW_ATTRIBUTE(mt7927_busy_poll_bench);
+#else
+static inline void mt7927_rxd_rec_disarm(struct mt7927_dev *dev)
+{
+}
+#endif /* CONFIG_MT7927_SELFTEST */
 
-		usleep_range(1000, 2000);
-	}
+static int mt7927_chip_reset_show(struct seq_file *s, void *data)
+{
+	struct mt7927_dev *dev = s->private;
+	struct mt7927_reset *rst = &dev->reset;
+
+	seq_printf(s, "state:         %s\n",
+		   test_bit(MT7927_STATE_RESETTING, &dev->state) ?
+		   "resetting" : "idle");
+	seq_printf(s, "last_reason:   %s\n", rst->reason ?: "none");
+	seq_printf(s, "last_mcu_cmd:  0x%08x\n", rst->mcu_cmd);
+	seq_printf(s, "recovered:     %u\n", rst->cnt);
+	seq_printf(s, "failed:        %u\n", rst->fail_cnt);
+	seq_printf(s, "fw_ack:        %u\n", rst->fw_ack_cnt);
+	seq_printf(s, "last_us:       %llu\n", rst->last_us);
+	seq_printf(s, "max_us:        %llu\n", rst->max_us);
 
-	/*
-	 * ROM didn't respond. This could mean:
-	 * 1. WFSYS reset didn't complete properly
-	 * 2. ROM is stuck waiting for something else
-	 * 3. Wrong register address for this chip variant
-	 *
-	 * Let's try an alternative approach - check WFSYS reset status again
-	 * and try alternative wake methods.
-	 */
-	dev_warn(&dev->pdev->dev, "  ROM not responding after 500ms!\n");
+	return 0;
+}
 
-	/* Check WFSYS status */
-	status = mt7927_rr_remap(dev, MT_WFSYS_SW_RST_B);
-	dev_info(&dev->pdev->dev, "  WFSYS_SW_RST_B=0x%08x (INIT_DONE=%d)\n",
-		 status, !!(status & WFSYS_SW_INIT_DONE));
+static int mt7927_chip_reset_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, mt7927_chip_reset_show, inode->i_private);
+}
 
-	/* Try alternative: write to MCU command register with different flags */
-	dev_info(&dev->pdev->dev, "  Trying NORMAL_STATE wake...\n");
-	mt7927_wr(dev, MT_MCU_CMD, MT_MCU_CMD_NORMAL_STATE);
-	msleep(10);
+/* Any write triggers a recovery, for testing the path */
+static ssize_t mt7927_chip_reset_write(struct file *file,
+				       const char __user *ubuf,
+				       size_t count, loff_t *ppos)
+{
+	struct mt7927_dev *dev = file_inode(file)->i_private;
 
-	status = mt7927_rr_remap(dev, MT_CONN_ON_MISC);
-	dev_info(&dev->pdev->dev, "  After NORMAL_STATE: MT_CONN_ON_MISC=0x%08x\n", status);
+	mt7927_reset_schedule(dev, "debugfs", 0);
 
-	/*
-	 * Even if ROM doesn't respond to our wake attempts, let's try
-	 * firmware download anyway - the ROM might be polling the rings
-	 * but not updating status registers.
-	 */
-	dev_info(&dev->pdev->dev, "  Continuing with firmware download attempt...\n");
+	return count;
+}
 
-	return 0;  /* Don't fail - let's see what happens with DMA */
+static const struct file_operations mt7927_chip_reset_fops = {
+	.owner = THIS_MODULE,
+	.open = mt7927_chip_reset_open,
+	.read = seq_read,
+	.write = mt7927_chip_reset_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static void mt7927_debugfs_init(struct mt7927_dev *dev)
+{
+	dev->debugfs_dir = debugfs_create_dir(pci_name(dev->pdev),
+					      mt7927_debugfs_root);
+
+	debugfs_create_file("regtrace", 0600, dev->debugfs_dir, dev,
+			    &mt7927_trace_fops);
+	debugfs_create_file("probe_timing", 0400, dev->debugfs_dir, dev,
+			    &mt7927_probe_timing_fops);
+	debugfs_create_file("aspm", 0400, dev->debugfs_dir, dev,
+			    &mt7927_aspm_fops);
+	debugfs_create_file("dma_wd", 0400, dev->debugfs_dir, dev,
+			    &mt7927_dma_wd_fops);
+	debugfs_create_file("dma_addr", 0400, dev->debugfs_dir, dev,
+			    &mt7927_dma_addr_fops);
+	debugfs_create_file("memory", 0400, dev->debugfs_dir, dev,
+			    &mt7927_memory_fops);
+	debugfs_create_file("tx_arena", 0400, dev->debugfs_dir, dev,
+			    &mt7927_tx_arena_fops);
+	debugfs_create_file("tokens", 0400, dev->debugfs_dir, dev,
+			    &mt7927_tokens_fops);
+	debugfs_create_file("tx_latency", 0600, dev->debugfs_dir, dev,
+			    &mt7927_tx_latency_fops);
+	debugfs_create_file("rx_data", 0400, dev->debugfs_dir, dev,
+			    &mt7927_rx_data_fops);
+	debugfs_create_file("amsdu", 0400, dev->debugfs_dir, dev,
+			    &mt7927_amsdu_fops);
+	debugfs_create_file("sta", 0600, dev->debugfs_dir, dev,
+			    &mt7927_sta_fops);
+	debugfs_create_file("ba", 0600, dev->debugfs_dir, dev,
+			    &mt7927_ba_fops);
+	debugfs_create_file("chan", 0600, dev->debugfs_dir, dev,
+			    &mt7927_chan_fops);
+	debugfs_create_file("phy_caps", 0400, dev->debugfs_dir, dev,
+			    &mt7927_phy_caps_fops);
+	debugfs_create_file("mlo", 0600, dev->debugfs_dir, dev,
+			    &mt7927_mlo_fops);
+#ifdef CONFIG_MT7927_SELFTEST
+	debugfs_create_file("txd_bench", 0400, dev->debugfs_dir, dev,
+			    &mt7927_txd_bench_fops);
+	debugfs_create_file("token_test", 0400, dev->debugfs_dir, dev,
+			    &mt7927_token_test_fops);
+	debugfs_create_file("rxd_bench", 0600, dev->debugfs_dir, dev,
+			    &mt7927_rxd_bench_fops);
+	debugfs_create_file("amsdu_bench", 0400, dev->debugfs_dir, dev,
+			    &mt7927_amsdu_bench_fops);
+	debugfs_create_file("mlo_test", 0400, dev->debugfs_dir, dev,
+			    &mt7927_mlo_test_fops);
+	debugfs_create_file("busy_poll_bench", 0400, dev->debugfs_dir, dev,
+			    &mt7927_busy_poll_bench_fops);
+#endif
+	debugfs_create_file("chip_reset", 0600, dev->debugfs_dir, dev,
+			    &mt7927_chip_reset_fops);
+	debugfs_create_file("pm_stats", 0400, dev->debugfs_dir, dev,
+			    &mt7927_pm_stats_fops);
 }
 
-static int mt7927_load_firmware(struct mt7927_dev *dev)
+/* =============================================================================
+ * PCI Probe
+ * =============================================================================
+ */
+
+static void mt7927_irq_setup(struct mt7927_dev *dev)
 {
-	int ret;
-	u32 status;
+	mt7927_wr_debug(dev, MT_WFDMA0_HOST_INT_ENA, 0, "HOST_INT_ENA");
+	mt7927_wr_debug(dev, MT_PCIE_MAC_INT_ENABLE, 0xff, "PCIE_MAC_INT_EN");
+}
 
-	dev_info(&dev->pdev->dev, "=== Firmware Loading ===\n");
+/*
+ * MAC settings the host owns once firmware runs. RX header translation
+ * follows hw_encap, so data frames on RX arrive as 802.3 (see
+ * mt7927_rx_data()). Lost with WFSYS, so re-applied after a chip reset.
+ */
+static void mt7927_mac_init(struct mt7927_dev *dev)
+{
+	u32 val = mt7927_rr_remap(dev, MT_MDP_DCR0);
 
-	/* Allocate MCU command buffer for DMA */
-	dev->mcu_buf = dma_alloc_coherent(&dev->pdev->dev,
-					  MT7927_FW_CHUNK_SIZE + 256,
-					  &dev->mcu_dma, GFP_KERNEL);
-	if (!dev->mcu_buf) {
-		dev_err(&dev->pdev->dev, "  Failed to allocate MCU buffer\n");
-		return -ENOMEM;
-	}
+	if (hw_encap)
+		val |= MT_MDP_DCR0_RX_HDR_TRANS_EN;
+	else
+		val &= ~MT_MDP_DCR0_RX_HDR_TRANS_EN;
+	mt7927_wr_remap(dev, MT_MDP_DCR0, val);
 
-	dev_info(&dev->pdev->dev, "  MCU DMA buffer at %pad\n", &dev->mcu_dma);
+	dev_info(&dev->pdev->dev, "  RX header translation %s\n",
+		 hw_encap ? "on (802.3)" : "off (802.11)");
+}
 
-	/*
-	 * v0.9.0: Wait for ROM bootloader to be ready before firmware download.
-	 * This addresses the dma_idx stuck at 0 issue from v0.8.0.
-	 */
-	ret = mt7927_wait_for_rom_ready(dev);
+/*
+ * Warm start - re-attach to a patch that is already loaded
+ *
+ * After a driver reload or kexec the WFSYS may still be up with our patch
+ * loaded. If the cookie left in MT_WFDMA_DUMMY_CR matches the patch file
+ * on disk, the host DMA rings are rebuilt and the ROM is asked whether
+ * the patch is still there (mt7927_patch_loaded()). If so, WFSYS reset
+ * and firmware download are skipped.
+ *
+ * Returns 0 when attached. On any mismatch or failure, DMA state is torn
+ * down again and the caller continues with the cold path.
+ */
+static int mt7927_warm_start(struct mt7927_dev *dev)
+{
+	struct device *d = &dev->pdev->dev;
+	u16 cookie, expected;
+	int ret;
+
+	mt7927_phase_begin(dev, MT7927_PHASE_WARM_CHECK);
+	dev_info(d, "\n=== Warm Start Check ===\n");
+
+	cookie = FIELD_GET(MT_WFDMA_DUMMY_FW_COOKIE,
+			   mt7927_rr(dev, MT_WFDMA_DUMMY_CR));
+	ret = mt7927_patch_file_cookie(dev, &expected);
 	if (ret) {
-		dev_warn(&dev->pdev->dev, "  ROM ready wait failed: %d\n", ret);
-		/* Continue anyway */
+		dev_info(d, "  Cannot read patch file (%d), cold start\n", ret);
+		return ret;
 	}
 
-	/* Check firmware status before download */
-	status = mt7927_rr_remap(dev, MT_CONN_ON_MISC);
-	dev_info(&dev->pdev->dev, "  MT_CONN_ON_MISC before: 0x%08x\n", status);
+	if (cookie != expected) {
+		dev_info(d, "  Patch mismatch (running 0x%04x, file 0x%04x), cold start\n",
+			 cookie, expected);
+		return -ESTALE;
+	}
 
-	/* Initialize ring head/tail */
-	dev->tx_ring_head = 0;
-	dev->tx_ring_tail = 0;
-	dev->mcu_seq = 0;
+	dev_info(d, "  Patch 0x%04x left behind - re-initializing DMA only\n",
+		 cookie);
 
-	/* Load and download patch firmware */
-	ret = mt7927_load_patch(dev);
-	if (ret) {
-		dev_err(&dev->pdev->dev, "  Patch loading failed: %d\n", ret);
-		/* Continue to check status anyway */
-	}
+	mt7927_phase_begin(dev, MT7927_PHASE_IRQ_SETUP);
+	mt7927_irq_setup(dev);
 
-	/* Check firmware status after download */
-	status = mt7927_rr_remap(dev, MT_CONN_ON_MISC);
-	dev_info(&dev->pdev->dev, "  MT_CONN_ON_MISC after: 0x%08x\n", status);
+	mt7927_phase_begin(dev, MT7927_PHASE_DMA_INIT);
+	ret = mt7927_dma_init(dev);
+	if (ret)
+		goto fail;
 
-	/*
-	 * Expected: bits 0-1 should become 0x3 when firmware is ready.
-	 * If still 0, the firmware hasn't started (expected at this stage
-	 * since we haven't sent the start command yet).
-	 */
-	if ((status & MT_TOP_MISC2_FW_N9_RDY) == MT_TOP_MISC2_FW_N9_RDY) {
-		dev_info(&dev->pdev->dev, "  Firmware N9 is READY!\n");
-	} else {
-		dev_info(&dev->pdev->dev,
-			 "  Firmware not ready yet (need FW_START command)\n");
+	/* The cookie is only our note; the ROM knows whether the patch is there */
+	if (!mt7927_patch_loaded(dev)) {
+		ret = -ENOENT;
+		goto fail;
 	}
 
+	set_bit(MT7927_STATE_WARM_START, &dev->state);
+	return 0;
+
+fail:
+	dev_warn(d, "  Warm start failed (%d), falling back to cold start\n", ret);
+	mt7927_dma_cleanup(dev);
 	return ret;
 }
 
 /* =============================================================================
- * PCI Probe
+ * Chip Recovery
  * =============================================================================
+ *
+ * When the firmware asserts (MT_MCU_CMD reports STOP_DMA/STOP_DMA_FW_RELOAD,
+ * seen by the DMA watchdog) or stops answering MCU commands after bring-up,
+ * the per-ring resets in mt7927_wd_work() are not enough. The whole WFSYS is
+ * reset and the patch downloaded again, like mt792x does on L0.5 reset:
+ *
+ *   1. Stop DMA and tell the MCU (STOP_DMA_FW_RELOAD)
+ *   2. EMI sleep protection, WFSYS reset
+ *   3. Re-program the existing rings (mt7927_dma_init() reuses them)
+ *   4. Download the patch from dev->patch_fw, no filesystem access
+ *   5. Report RESET_DONE, wait briefly for RECOVERY_DONE, NORMAL_STATE
+ *   6. Send link channels and BA sessions again (mt7927_sta_restore())
+ *
+ * The PCI function stays bound and all host allocations are kept. MCU
+ * senders block on dma_mutex while the rings are rebuilt and continue on
+ * the fresh rings afterwards. Time-to-recovered is logged and exported in
+ * debugfs (chip_reset) and sysfs (reset_time_us).
  */
 
-static int mt7927_probe(struct pci_dev *pdev, const struct pci_device_id *id)
+static void mt7927_reset_work(struct work_struct *work)
 {
-	struct mt7927_dev *dev;
+	struct mt7927_dev *dev = container_of(work, struct mt7927_dev,
+					      reset.work);
+	struct mt7927_reset *rst = &dev->reset;
+	struct device *d = &dev->pdev->dev;
+	ktime_t start = ktime_get();
+	bool fw_ack = false;
 	int ret;
-	u32 val;
 
-	dev_info(&pdev->dev, "\n");
-	dev_info(&pdev->dev, "############################################\n");
-	dev_info(&pdev->dev, "# MT7927 WiFi 7 Driver v%s\n", DRV_VERSION);
-	dev_info(&pdev->dev, "# Device: %04x:%04x (AMD RZ738 compatible)\n",
-		 pdev->vendor, pdev->device);
-	dev_info(&pdev->dev, "############################################\n");
+	dev_warn(d, "Chip reset: %s (MT_MCU_CMD=0x%08x)\n", rst->reason,
+		 rst->mcu_cmd);
 
-	/* Allocate device structure */
-	dev = kzalloc(sizeof(*dev), GFP_KERNEL);
-	if (!dev)
-		return -ENOMEM;
+	mt7927_aspm_hold(dev, MT7927_ASPM_FWDL);
+	cancel_delayed_work_sync(&dev->wd.work);
+	cancel_delayed_work_sync(&dev->rx_poll);
+	cancel_delayed_work_sync(&dev->pm.ps_work);
 
-	dev->pdev = pdev;
-	pci_set_drvdata(pdev, dev);
+	ret = mt7927_pm_wake(dev);
+	if (ret)
+		goto out;
 
-	/* === Phase 1: PCI Setup === */
-	dev_info(&pdev->dev, "\n=== Phase 1: PCI Setup ===\n");
+	mutex_lock(&dev->dma_mutex);
 
-	/*
-	 * v0.10.0: Try PCI function-level reset (FLR) to ensure clean state.
-	 * This is especially important if a previous driver load left the
-	 * device in a bad state (e.g., ROM confused by incorrect DMA descriptors).
-	 */
-	if (!skip_pci_reset) {
-		dev_info(&pdev->dev, "  Attempting PCI function-level reset...\n");
-		if (pci_reset_function(pdev) == 0) {
-			dev_info(&pdev->dev, "  PCI FLR successful\n");
-			msleep(100);  /* Give device time to reinitialize */
-		} else {
-			dev_info(&pdev->dev, "  PCI FLR not supported or failed (non-fatal)\n");
-		}
-	} else {
-		dev_info(&pdev->dev, "  Skipping PCI FLR (skip_pci_reset=1)\n");
-	}
+	/* Only the ROM answers until the reload below brings N9 back */
+	clear_bit(MT7927_STATE_FW_RUNNING, &dev->state);
+	mt7927_wr(dev, MT_MCU_CMD, MT_MCU_CMD_STOP_DMA_FW_RELOAD);
+	mt7927_dma_disable(dev, false);
+	mt7927_wr(dev, MT_WFDMA0_HOST_INT_ENA, 0);
 
-	ret = pcim_enable_device(pdev);
-	if (ret) {
-		dev_err(&pdev->dev, "Failed to enable PCI device\n");
-		goto err_free;
-	}
+	/* Frames in flight die with the firmware, free them before the rings */
+	mt7927_token_drain(dev);
 
-	ret = pcim_iomap_regions(pdev, BIT(0), DRV_NAME);
-	if (ret) {
-		dev_err(&pdev->dev, "Failed to map BAR0\n");
-		goto err_free;
+	/* The patch is gone after this, don't let warm start find the cookie */
+	mt7927_clear(dev, MT_WFDMA_DUMMY_CR, MT_WFDMA_DUMMY_FW_COOKIE);
+	mt7927_wr_remap(dev, MT_HW_EMI_CTL,
+			mt7927_rr_remap(dev, MT_HW_EMI_CTL) |
+			MT_HW_EMI_CTL_SLPPROT_EN);
+
+	ret = mt7927_wfsys_reset(dev);
+	if (!ret) {
+		mt7927_irq_setup(dev);
+		ret = mt7927_dma_init(dev);
 	}
 
-	/* Ensure memory access is enabled */
-	pci_read_config_word(pdev, PCI_COMMAND, (u16 *)&val);
-	if (!(val & PCI_COMMAND_MEMORY)) {
-		val |= PCI_COMMAND_MEMORY;
-		pci_write_config_word(pdev, PCI_COMMAND, val);
-	}
+	mutex_unlock(&dev->dma_mutex);
+
+	if (!ret && mt7927_aborted(dev))
+		ret = -ECANCELED;
+	if (ret)
+		goto out;
+
+	ret = mt7927_load_firmware(dev);
+	if (ret)
+		goto out;
 
-	pci_set_master(pdev);
+	mt7927_fwdl_release(dev);
+	mt7927_wr(dev, MT_MCU_CMD, MT_MCU_CMD_RESET_DONE);
+	fw_ack = mt7927_poll(dev, MT_MCU_CMD, MT_MCU_CMD_RECOVERY_DONE,
+			     MT_MCU_CMD_RECOVERY_DONE, MT7927_RESET_FW_ACK_MS);
+	mt7927_wr(dev, MT_MCU_CMD, MT_MCU_CMD_NORMAL_STATE);
+	mt7927_mac_init(dev);
 
-	ret = dma_set_mask_and_coherent(&pdev->dev, DMA_BIT_MASK(32));
-	if (ret) {
-		dev_err(&pdev->dev, "Failed to set DMA mask\n");
-		goto err_free;
-	}
+out:
+	mt7927_sta_restore(dev, !ret);
+	rst->last_us = ktime_us_delta(ktime_get(), start);
+	trace_mt7927_chip_reset(dev, rst->mcu_cmd, rst->last_us, ret);
 
-	dev->regs = pcim_iomap_table(pdev)[0];
-	if (!dev->regs) {
-		dev_err(&pdev->dev, "Failed to get MMIO pointer\n");
-		ret = -ENOMEM;
-		goto err_free;
+	if (ret) {
+		/* Stop automatic retries, a reload or resume starts over */
+		rst->fail_cnt++;
+		clear_bit(MT7927_STATE_INIT_DONE, &dev->state);
+		dev_err(d, "Chip reset failed (%d) after %llu us\n", ret,
+			rst->last_us);
+	} else {
+		rst->cnt++;
+		rst->fw_ack_cnt += fw_ack;
+		rst->max_us = max(rst->max_us, rst->last_us);
+		dev_info(d, "Chip recovered in %llu us%s\n", rst->last_us,
+			 fw_ack ? "" : " (no RECOVERY_DONE from firmware)");
 	}
 
-	/* Get BAR0 size for bounds checking */
-	dev->regs_len = pci_resource_len(pdev, 0);
-	dev_info(&pdev->dev, "  BAR0 mapped: %pR (size: 0x%llx)\n",
-		 &pdev->resource[0], (unsigned long long)dev->regs_len);
+	mt7927_aspm_release(dev, MT7927_ASPM_FWDL);
+	clear_bit(MT7927_STATE_RESETTING, &dev->state);
 
-	dev->aspm_supported = pcie_aspm_enabled(pdev);
+	if (!ret)
+		mt7927_pm_power_save_sched(dev);
+}
 
-	mt7927_dump_pci_state(dev);
+/*
+ * Device bring-up worker
+ *
+ * Runs phases 2-9 after mt7927_probe() has mapped resources. Removal sets
+ * MT7927_STATE_REMOVING, which is checked between phases and in the long
+ * firmware/ROM loops, then waits for the worker with cancel_work_sync().
+ */
+static void mt7927_init_work(struct work_struct *work)
+{
+	struct mt7927_dev *dev = container_of(work, struct mt7927_dev, init_work);
+	struct pci_dev *pdev = dev->pdev;
+	int ret;
+	u32 val;
 
-	/* Dump initial register state */
-	dev_info(&pdev->dev, "\n=== Initial Register State ===\n");
-	mt7927_dump_critical_regs(dev);
+	mt7927_aspm_hold(dev, MT7927_ASPM_FWDL);
 
 	/* === Phase 2: Power Management Handoff === */
+	mt7927_phase_begin(dev, MT7927_PHASE_PM_HANDOFF);
 	dev_info(&pdev->dev, "\n=== Phase 2: Power Management Handoff ===\n");
 
 	ret = mt7927_mcu_fw_pmctrl(dev);
@@ -2521,7 +9633,11 @@ static int mt7927_probe(struct pci_dev *pdev, const struct pci_device_id *id)
 		/* Continue anyway for debugging */
 	}
 
+	if (mt7927_aborted(dev))
+		goto out;
+
 	/* === Phase 3: Read Chip ID === */
+	mt7927_phase_begin(dev, MT7927_PHASE_CHIP_ID);
 	dev_info(&pdev->dev, "\n=== Phase 3: Chip Identification ===\n");
 
 	/*
@@ -2557,7 +9673,24 @@ static int mt7927_probe(struct pci_dev *pdev, const struct pci_device_id *id)
 		dev_warn(&pdev->dev, "  This may indicate remap not working or chip in reset\n");
 	}
 
+	if (mt7927_aborted(dev))
+		goto out;
+
+	if (warm_start && !mt7927_warm_start(dev)) {
+		mt7927_fwdl_release(dev);
+		mt7927_mac_init(dev);
+		set_bit(MT7927_STATE_INIT_DONE, &dev->state);
+		goto out;
+	}
+
+	/* Cold path: drop any stale patch cookie before resetting WFSYS */
+	mt7927_clear(dev, MT_WFDMA_DUMMY_CR, MT_WFDMA_DUMMY_FW_COOKIE);
+
+	if (mt7927_aborted(dev))
+		goto out;
+
 	/* === Phase 4: EMI Sleep Protection === */
+	mt7927_phase_begin(dev, MT7927_PHASE_EMI);
 	dev_info(&pdev->dev, "\n=== Phase 4: EMI Sleep Protection ===\n");
 
 	/*
@@ -2575,7 +9708,11 @@ static int mt7927_probe(struct pci_dev *pdev, const struct pci_device_id *id)
 			 emi_val, !!(emi_val & MT_HW_EMI_CTL_SLPPROT_EN));
 	}
 
+	if (mt7927_aborted(dev))
+		goto out;
+
 	/* === Phase 5: WFSYS Reset === */
+	mt7927_phase_begin(dev, MT7927_PHASE_WFSYS_RESET);
 	dev_info(&pdev->dev, "\n=== Phase 5: WFSYS Reset ===\n");
 
 	ret = mt7927_wfsys_reset(dev);
@@ -2584,13 +9721,20 @@ static int mt7927_probe(struct pci_dev *pdev, const struct pci_device_id *id)
 		/* Continue anyway for debugging */
 	}
 
+	if (mt7927_aborted(dev))
+		goto out;
+
 	/* === Phase 6: Interrupt Setup === */
+	mt7927_phase_begin(dev, MT7927_PHASE_IRQ_SETUP);
 	dev_info(&pdev->dev, "\n=== Phase 6: Interrupt Setup ===\n");
 
-	mt7927_wr_debug(dev, MT_WFDMA0_HOST_INT_ENA, 0, "HOST_INT_ENA");
-	mt7927_wr_debug(dev, MT_PCIE_MAC_INT_ENABLE, 0xff, "PCIE_MAC_INT_EN");
+	mt7927_irq_setup(dev);
+
+	if (mt7927_aborted(dev))
+		goto out;
 
 	/* === Phase 7: DMA Initialization === */
+	mt7927_phase_begin(dev, MT7927_PHASE_DMA_INIT);
 	dev_info(&pdev->dev, "\n=== Phase 7: DMA Initialization ===\n");
 
 	ret = mt7927_dma_init(dev);
@@ -2599,7 +9743,11 @@ static int mt7927_probe(struct pci_dev *pdev, const struct pci_device_id *id)
 		/* Continue anyway */
 	}
 
+	if (mt7927_aborted(dev))
+		goto out;
+
 	/* === Phase 8: Verify Register State === */
+	mt7927_phase_begin(dev, MT7927_PHASE_VERIFY);
 	dev_info(&pdev->dev, "\n=== Phase 8: Final Register Verification ===\n");
 
 	val = mt7927_rr(dev, MT_WFDMA0_GLO_CFG);
@@ -2616,24 +9764,232 @@ static int mt7927_probe(struct pci_dev *pdev, const struct pci_device_id *id)
 	/* Dump final state */
 	mt7927_dump_critical_regs(dev);
 
+	if (mt7927_aborted(dev))
+		goto out;
+
 	/* === Phase 9: Load Firmware === */
 	dev_info(&pdev->dev, "\n=== Phase 9: Firmware Loading ===\n");
 
 	ret = mt7927_load_firmware(dev);
+	if (mt7927_aborted(dev))
+		goto out;
 	if (ret) {
 		dev_warn(&pdev->dev, "Firmware loading incomplete: %d\n", ret);
+	} else {
+		mt7927_fwdl_release(dev);
+		mt7927_mac_init(dev);
+	}
+
+	set_bit(MT7927_STATE_INIT_DONE, &dev->state);
+
+out:
+	mt7927_phase_end(dev);
+	mt7927_aspm_release(dev, MT7927_ASPM_FWDL);
+
+	/* Re-run by mt7927_resume() after firmware was lost */
+	if (test_and_clear_bit(MT7927_STATE_RESUMING, &dev->state)) {
+		if (!test_bit(MT7927_STATE_INIT_DONE, &dev->state))
+			return;
+
+		mt7927_resume_done(dev);
+		dev_info(&pdev->dev, "Resume complete (full bring-up) in %llu us\n",
+			 dev->pm.last_resume_us);
+		mt7927_pm_power_save_sched(dev);
+		return;
+	}
+
+	dev->timing.probe_ns = ktime_to_ns(ktime_sub(ktime_get(),
+						     dev->timing.probe_start));
+
+	if (!test_bit(MT7927_STATE_INIT_DONE, &dev->state)) {
+		dev_info(&pdev->dev, "Bring-up cancelled (device removed)\n");
+		return;
 	}
 
+	mt7927_pm_power_save_sched(dev);
+
 	/* === Summary === */
 	dev_info(&pdev->dev, "\n############################################\n");
 	dev_info(&pdev->dev, "# MT7927 Driver Initialization Complete\n");
+	dev_info(&pdev->dev, "# Probe time: %llu ms (see debugfs probe_timing)\n",
+		 div_u64(dev->timing.probe_ns, NSEC_PER_MSEC));
+	dev_info(&pdev->dev, "# Start: %s\n",
+		 test_bit(MT7927_STATE_WARM_START, &dev->state) ?
+		 "warm (firmware already running)" : "cold");
 	dev_info(&pdev->dev, "# Status: Device bound, debugging enabled\n");
 	dev_info(&pdev->dev, "# Next: Check dmesg for register values\n");
 	dev_info(&pdev->dev, "############################################\n\n");
 
+}
+
+static int mt7927_probe(struct pci_dev *pdev, const struct pci_device_id *id)
+{
+	struct mt7927_dev *dev;
+	int ret;
+	u16 cmd;
+
+	dev_info(&pdev->dev, "\n");
+	dev_info(&pdev->dev, "############################################\n");
+	dev_info(&pdev->dev, "# MT7927 WiFi 7 Driver v%s\n", DRV_VERSION);
+	dev_info(&pdev->dev, "# Device: %04x:%04x (AMD RZ738 compatible)\n",
+		 pdev->vendor, pdev->device);
+	dev_info(&pdev->dev, "############################################\n");
+
+	/* Allocate device structure */
+	/*
+	 * Ring indices and counters are touched on every send/completion, keep
+	 * them on the device's node. dma_alloc_coherent() already allocates
+	 * rings and buffers from dev_to_node(), with or without the IOMMU.
+	 */
+	dev = kzalloc_node(sizeof(*dev), GFP_KERNEL, dev_to_node(&pdev->dev));
+	if (!dev)
+		return -ENOMEM;
+
+	dev->pdev = pdev;
+	dev->timing.phase = MT7927_PHASE_NONE;
+	dev->timing.probe_start = ktime_get();
+	mutex_init(&dev->pm.mutex);
+	INIT_DELAYED_WORK(&dev->pm.ps_work, mt7927_pm_ps_work);
+	mutex_init(&dev->aspm.mutex);
+	INIT_DELAYED_WORK(&dev->aspm.work, mt7927_aspm_work);
+	mutex_init(&dev->game.mutex);
+	mutex_init(&dev->dma_mutex);
+	mutex_init(&dev->sta_mutex);
+	mt7927_phy_caps_init(dev);
+	dev->mlo_policy = mlo_policy ? MT7927_MLO_THROUGHPUT :
+				       MT7927_MLO_LATENCY;
+	INIT_DELAYED_WORK(&dev->wd.work, mt7927_wd_work);
+	INIT_DELAYED_WORK(&dev->rx_poll, mt7927_rx_poll_work);
+	INIT_WORK(&dev->reset.work, mt7927_reset_work);
+	pci_set_drvdata(pdev, dev);
+
+	dev->mmio = alloc_percpu(struct mt7927_mmio_cnt);
+	if (!dev->mmio) {
+		ret = -ENOMEM;
+		goto err_free;
+	}
+
+	ret = mt7927_trace_init(dev);
+	if (ret)
+		goto err_free;
+
+	mt7927_debugfs_init(dev);
+
+	/* === Phase 1: PCI Setup === */
+	mt7927_phase_begin(dev, MT7927_PHASE_PCI_SETUP);
+	dev_info(&pdev->dev, "\n=== Phase 1: PCI Setup ===\n");
+
+	/*
+	 * v0.10.0: Try PCI function-level reset (FLR) to ensure clean state.
+	 * This is especially important if a previous driver load left the
+	 * device in a bad state (e.g., ROM confused by incorrect DMA descriptors).
+	 */
+	if (!skip_pci_reset) {
+		dev_info(&pdev->dev, "  Attempting PCI function-level reset...\n");
+		if (pci_reset_function(pdev) == 0) {
+			dev_info(&pdev->dev, "  PCI FLR successful\n");
+			mt7927_msleep(dev, 100);  /* Give device time to reinitialize */
+		} else {
+			dev_info(&pdev->dev, "  PCI FLR not supported or failed (non-fatal)\n");
+		}
+	} else {
+		dev_info(&pdev->dev, "  Skipping PCI FLR (skip_pci_reset=1)\n");
+	}
+
+	ret = pcim_enable_device(pdev);
+	if (ret) {
+		dev_err(&pdev->dev, "Failed to enable PCI device\n");
+		goto err_free;
+	}
+
+	ret = pcim_iomap_regions(pdev, BIT(0), DRV_NAME);
+	if (ret) {
+		dev_err(&pdev->dev, "Failed to map BAR0\n");
+		goto err_free;
+	}
+
+	/* Ensure memory access is enabled */
+	pci_read_config_word(pdev, PCI_COMMAND, &cmd);
+	if (!(cmd & PCI_COMMAND_MEMORY)) {
+		cmd |= PCI_COMMAND_MEMORY;
+		pci_write_config_word(pdev, PCI_COMMAND, cmd);
+	}
+
+	pci_set_master(pdev);
+
+	/*
+	 * Descriptors take 36-bit buffer addresses (SDP0_H/SDP1_H), so with
+	 * a 36-bit streaming mask buffers above 4 GB need no SWIOTLB bounce.
+	 * Where the ring BASE high bits go is not known for this chip, so
+	 * coherent memory (rings, RX and MCU buffers, TX arena) stays below
+	 * 4 GB, as mt7996 does.
+	 */
+	dev->dma_bits = dma_36bit ? 36 : 32;
+	ret = dma_set_mask(&pdev->dev, DMA_BIT_MASK(dev->dma_bits));
+	if (ret && dev->dma_bits > 32) {
+		dev_warn(&pdev->dev, "  36-bit DMA refused, using 32-bit\n");
+		dev->dma_bits = 32;
+		ret = dma_set_mask(&pdev->dev, DMA_BIT_MASK(32));
+	}
+	if (!ret)
+		ret = dma_set_coherent_mask(&pdev->dev, DMA_BIT_MASK(32));
+	if (ret) {
+		dev_err(&pdev->dev, "Failed to set DMA mask\n");
+		goto err_free;
+	}
+	dev_info(&pdev->dev, "  DMA mask: %u bits\n", dev->dma_bits);
+
+	dev->regs = pcim_iomap_table(pdev)[0];
+	if (!dev->regs) {
+		dev_err(&pdev->dev, "Failed to get MMIO pointer\n");
+		ret = -ENOMEM;
+		goto err_free;
+	}
+
+	/* Get BAR0 size for bounds checking */
+	dev->regs_len = pci_resource_len(pdev, 0);
+	dev_info(&pdev->dev, "  BAR0 mapped: %pR (size: 0x%llx)\n",
+		 &pdev->resource[0], (unsigned long long)dev->regs_len);
+
+	/*
+	 * Constant-offset accessors are only checked against the minimum
+	 * BAR0 size at build time, so refuse anything smaller here.
+	 */
+	if (dev->regs_len < MT7927_BAR0_MIN_SIZE) {
+		dev_err(&pdev->dev, "BAR0 too small: 0x%llx < 0x%x\n",
+			(unsigned long long)dev->regs_len, MT7927_BAR0_MIN_SIZE);
+		ret = -ENODEV;
+		goto err_free;
+	}
+
+	dev->aspm_supported = pcie_aspm_enabled(pdev);
+	mt7927_aspm_init(dev);
+	if (game_mode)
+		mt7927_game_mode_set(dev, true);
+
+	mt7927_dump_pci_state(dev);
+
+	/* Dump initial register state */
+	dev_info(&pdev->dev, "\n=== Initial Register State ===\n");
+	mt7927_dump_critical_regs(dev);
+
+	/*
+	 * Everything past resource mapping (resets, DMA, firmware) can take
+	 * seconds, so it runs from a worker instead of the probe thread.
+	 */
+	mt7927_phase_end(dev);
+	INIT_WORK(&dev->init_work, mt7927_init_work);
+	queue_work_node(dev_to_node(&pdev->dev), system_unbound_wq,
+			&dev->init_work);
+
 	return 0;
 
 err_free:
+	mt7927_phase_end(dev);
+	debugfs_remove_recursive(dev->debugfs_dir);
+	mt7927_trace_free(dev);
+	mt7927_token_free(dev);
+	free_percpu(dev->mmio);
 	kfree(dev);
 	return ret;
 }
@@ -2645,11 +10001,150 @@ static void mt7927_remove(struct pci_dev *pdev)
 	dev_info(&pdev->dev, "Removing MT7927 driver\n");
 
 	if (dev) {
+		set_bit(MT7927_STATE_REMOVING, &dev->state);
+		cancel_work_sync(&dev->init_work);
+		cancel_work_sync(&dev->reset.work);
+		cancel_delayed_work_sync(&dev->wd.work);
+		cancel_delayed_work_sync(&dev->rx_poll);
+		cancel_delayed_work_sync(&dev->pm.ps_work);
+		mt7927_game_mode_set(dev, false);
+		mt7927_aspm_stop(dev);
+
+		/* Registers are needed for teardown */
+		mt7927_pm_wake(dev);
+
+		debugfs_remove_recursive(dev->debugfs_dir);
+		mt7927_rxd_rec_disarm(dev);
+		mt7927_sta_free_all(dev);
 		mt7927_dma_cleanup(dev);
+		release_firmware(dev->patch_fw);
+		mt7927_trace_free(dev);
+		mt7927_token_free(dev);
+		mt7927_phase_end(dev);	/* Chip reset stopped halfway */
+		free_percpu(dev->mmio);
 		kfree(dev);
 	}
 }
 
+/* =============================================================================
+ * System Suspend/Resume
+ * =============================================================================
+ *
+ * Suspend only quiesces the device: the MCU is told to stop DMA, the host
+ * engines are disabled and LPCTL ownership goes to firmware. Descriptor
+ * rings, RX buffers, the MCU buffer and the cached patch image all stay
+ * allocated, so resume normally re-programs the rings and carries on with
+ * the firmware that is still running.
+ *
+ * If the firmware did not survive (D3cold, or the patch cookie in
+ * MT_WFDMA_DUMMY_CR is gone) the bring-up worker is queued again. It
+ * reuses the same allocations and downloads the patch from memory.
+ */
+
+/*
+ * Our patch still in place? The cookie is checked before the rings are
+ * touched; with @rings_up the ROM is asked as well (mt7927_patch_loaded()).
+ */
+static bool mt7927_fw_alive(struct mt7927_dev *dev, bool rings_up)
+{
+	u16 cookie, expected;
+
+	if (mt7927_patch_file_cookie(dev, &expected))
+		return false;
+
+	cookie = FIELD_GET(MT_WFDMA_DUMMY_FW_COOKIE,
+			   mt7927_rr(dev, MT_WFDMA_DUMMY_CR));
+	if (cookie != expected)
+		return false;
+
+	return !rings_up || mt7927_patch_loaded(dev);
+}
+
+static int mt7927_suspend(struct device *d)
+{
+	struct mt7927_dev *dev = pci_get_drvdata(to_pci_dev(d));
+
+	/* Let a bring-up in progress finish rather than stop it halfway */
+	flush_work(&dev->init_work);
+	flush_work(&dev->reset.work);
+	cancel_delayed_work_sync(&dev->wd.work);
+	cancel_delayed_work_sync(&dev->rx_poll);
+	cancel_delayed_work_sync(&dev->pm.ps_work);
+	mt7927_aspm_stop(dev);
+
+	if (mt7927_pm_wake(dev))
+		dev_warn(d, "Suspend: no driver ownership, quiescing anyway\n");
+
+	if (dev->mcu_ring) {
+		/* Let queued MCU commands drain, then stop both sides */
+		mutex_lock(&dev->dma_mutex);
+		mt7927_mcu_tx_wait(dev, 100);
+		mt7927_wr(dev, MT_MCU_CMD, MT_MCU_CMD_STOP_DMA);
+		mt7927_dma_disable(dev, false);
+		mt7927_wr(dev, MT_WFDMA0_HOST_INT_ENA, 0);
+		mutex_unlock(&dev->dma_mutex);
+	}
+
+	/* Let the chip doze while the host is asleep */
+	mutex_lock(&dev->pm.mutex);
+	if (!mt7927_pm_set_own(dev, true))
+		dev->pm.fw_own = true;
+	dev->pm.suspend_cnt++;
+	mutex_unlock(&dev->pm.mutex);
+
+	return 0;
+}
+
+static int mt7927_resume(struct device *d)
+{
+	struct mt7927_dev *dev = pci_get_drvdata(to_pci_dev(d));
+	int ret;
+
+	dev->pm.resume_start = ktime_get();
+	mt7927_aspm_hold(dev, MT7927_ASPM_FWDL);
+
+	ret = mt7927_pm_wake(dev);
+	if (!ret && !mt7927_fw_alive(dev, false))
+		ret = -ESTALE;
+	if (!ret) {
+		mt7927_irq_setup(dev);
+		ret = mt7927_dma_resume(dev);
+	}
+	/* The ring re-init must not have knocked the patch out */
+	if (!ret && !mt7927_fw_alive(dev, true))
+		ret = -EIO;
+
+	if (ret) {
+		dev_info(d, "Resume: firmware lost (%d), re-running bring-up\n",
+			 ret);
+		dev->pm.resume_cold_cnt++;
+		dev->pm.fw_own = false;	/* Phase 2 takes ownership again */
+		clear_bit(MT7927_STATE_INIT_DONE, &dev->state);
+		clear_bit(MT7927_STATE_WARM_START, &dev->state);
+		set_bit(MT7927_STATE_RESUMING, &dev->state);
+		mt7927_aspm_release(dev, MT7927_ASPM_FWDL);	/* Worker holds its own */
+		queue_work_node(dev_to_node(d), system_unbound_wq,
+				&dev->init_work);
+		return 0;
+	}
+
+	/* Clears the STOP_DMA request left by suspend */
+	mt7927_wr(dev, MT_MCU_CMD, MT_MCU_CMD_NORMAL_STATE);
+	mt7927_aspm_release(dev, MT7927_ASPM_FWDL);
+
+	mt7927_resume_done(dev);
+	dev_info(d, "Resumed in %llu us (firmware kept running)\n",
+		 dev->pm.last_resume_us);
+
+	/* Frames sent before suspend may still be owed a TX-free event */
+	if (atomic_read(&dev->token.count))
+		mt7927_rx_poll_arm(dev);
+	mt7927_pm_power_save_sched(dev);
+	return 0;
+}
+
+static DEFINE_SIMPLE_DEV_PM_OPS(mt7927_pm_ops, mt7927_suspend, mt7927_resume);
+
 /* =============================================================================
  * Module Definition
  * =============================================================================
@@ -2663,18 +10158,111 @@ static const struct pci_device_id mt7927_pci_ids[] = {
 };
 MODULE_DEVICE_TABLE(pci, mt7927_pci_ids);
 
+/* Total probe time, for boot-time regression scripts */
+static ssize_t probe_time_us_show(struct device *d,
+				  struct device_attribute *attr, char *buf)
+{
+	struct mt7927_dev *dev = pci_get_drvdata(to_pci_dev(d));
+
+	return sysfs_emit(buf, "%llu\n",
+			  div_u64(dev->timing.probe_ns, NSEC_PER_USEC));
+}
+static DEVICE_ATTR_RO(probe_time_us);
+
+/* Last system resume, until rings are usable again */
+static ssize_t resume_time_us_show(struct device *d,
+				   struct device_attribute *attr, char *buf)
+{
+	struct mt7927_dev *dev = pci_get_drvdata(to_pci_dev(d));
+
+	return sysfs_emit(buf, "%llu\n", dev->pm.last_resume_us);
+}
+static DEVICE_ATTR_RO(resume_time_us);
+
+/* Last full chip recovery, see mt7927_reset_work() */
+static ssize_t reset_time_us_show(struct device *d,
+				  struct device_attribute *attr, char *buf)
+{
+	struct mt7927_dev *dev = pci_get_drvdata(to_pci_dev(d));
+
+	return sysfs_emit(buf, "%llu\n", dev->reset.last_us);
+}
+static DEVICE_ATTR_RO(reset_time_us);
+
+/* Low-latency profile, see mt7927_game_mode_set() */
+static ssize_t game_mode_show(struct device *d, struct device_attribute *attr,
+			      char *buf)
+{
+	struct mt7927_dev *dev = pci_get_drvdata(to_pci_dev(d));
+
+	return sysfs_emit(buf, "%d\n", READ_ONCE(dev->game.on));
+}
+
+static ssize_t game_mode_store(struct device *d, struct device_attribute *attr,
+			       const char *buf, size_t count)
+{
+	struct mt7927_dev *dev = pci_get_drvdata(to_pci_dev(d));
+	bool on;
+	int ret;
+
+	ret = kstrtobool(buf, &on);
+	if (ret)
+		return ret;
+
+	mt7927_game_mode_set(dev, on);
+
+	return count;
+}
+static DEVICE_ATTR_RW(game_mode);
+
+static struct attribute *mt7927_attrs[] = {
+	&dev_attr_probe_time_us.attr,
+	&dev_attr_resume_time_us.attr,
+	&dev_attr_reset_time_us.attr,
+	&dev_attr_game_mode.attr,
+	NULL,
+};
+ATTRIBUTE_GROUPS(mt7927);
+
 static struct pci_driver mt7927_pci_driver = {
 	.name = DRV_NAME,
 	.id_table = mt7927_pci_ids,
 	.probe = mt7927_probe,
 	.remove = mt7927_remove,
+	.driver.dev_groups = mt7927_groups,
+	.driver.probe_type = PROBE_PREFER_ASYNCHRONOUS,
+	.driver.pm = pm_sleep_ptr(&mt7927_pm_ops),
 };
 
-module_pci_driver(mt7927_pci_driver);
+static int __init mt7927_init(void)
+{
+	int ret;
+
+	/* Default debug_regs=true never goes through the param callback */
+	if (debug_regs)
+		static_branch_enable(&mt7927_trace_key);
+
+	mt7927_debugfs_root = debugfs_create_dir(DRV_NAME, NULL);
+
+	ret = pci_register_driver(&mt7927_pci_driver);
+	if (ret)
+		debugfs_remove_recursive(mt7927_debugfs_root);
+
+	return ret;
+}
+
+static void __exit mt7927_exit(void)
+{
+	pci_unregister_driver(&mt7927_pci_driver);
+	debugfs_remove_recursive(mt7927_debugfs_root);
+}
+
+module_init(mt7927_init);
+module_exit(mt7927_exit);
 
 MODULE_LICENSE("GPL");
 MODULE_AUTHOR("MT7927 Linux Driver Project");
 MODULE_DESCRIPTION("MediaTek MT7927 WiFi 7 Driver (AMD RZ738) - Debug Build");
 MODULE_VERSION(DRV_VERSION);
-MODULE_FIRMWARE("mediatek/mt7925/WIFI_MT7925_PATCH_MCU_1_1_hdr.bin");
-MODULE_FIRMWARE("mediatek/mt7925/WIFI_RAM_CODE_MT7925_1_1.bin");
+MODULE_FIRMWARE(MT7927_PATCH_FW);
+MODULE_FIRMWARE(MT7927_RAM_FW);
@@ -0,0 +1,294 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * MT7927 trace events
+ *
+ * Included from mt7927.c after struct mt7927_dev is defined. Use with
+ * perf or trace-cmd, e.g.:
+ *
+ *   trace-cmd record -e mt7927 modprobe mt7927
+ *
+ * Copyright (C) 2026 MT7927 Linux Driver Project
+ */
+
+#if !defined(__MT7927_TRACE_H) || defined(TRACE_HEADER_MULTI_READ)
+#define __MT7927_TRACE_H
+
+#include <linux/tracepoint.h>
+
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM mt7927
+
+#define MT7927_DEV_NAME_LEN	32
+#define DEV_ENTRY	__array(char, dev_name, MT7927_DEV_NAME_LEN)
+#define DEV_ASSIGN	strscpy(__entry->dev_name, pci_name(dev->pdev), \
+				MT7927_DEV_NAME_LEN)
+#define DEV_PR_FMT	"%s"
+#define DEV_PR_ARG	__entry->dev_name
+
+/* DMA descriptors */
+
+DECLARE_EVENT_CLASS(mt7927_desc,
+	TP_PROTO(struct mt7927_dev *dev, u8 ring, u16 idx, u32 len),
+
+	TP_ARGS(dev, ring, idx, len),
+
+	TP_STRUCT__entry(
+		DEV_ENTRY
+		__field(u8, ring)
+		__field(u16, idx)
+		__field(u32, len)
+	),
+
+	TP_fast_assign(
+		DEV_ASSIGN;
+		__entry->ring = ring;
+		__entry->idx = idx;
+		__entry->len = len;
+	),
+
+	TP_printk(DEV_PR_FMT " ring=%u idx=%u len=%u",
+		  DEV_PR_ARG, __entry->ring, __entry->idx, __entry->len)
+);
+
+DEFINE_EVENT(mt7927_desc, mt7927_desc_enqueue,
+	TP_PROTO(struct mt7927_dev *dev, u8 ring, u16 idx, u32 len),
+	TP_ARGS(dev, ring, idx, len)
+);
+
+DEFINE_EVENT(mt7927_desc, mt7927_desc_complete,
+	TP_PROTO(struct mt7927_dev *dev, u8 ring, u16 idx, u32 len),
+	TP_ARGS(dev, ring, idx, len)
+);
+
+TRACE_EVENT(mt7927_doorbell,
+	TP_PROTO(struct mt7927_dev *dev, bool rx, u8 ring, u16 cidx),
+
+	TP_ARGS(dev, rx, ring, cidx),
+
+	TP_STRUCT__entry(
+		DEV_ENTRY
+		__field(bool, rx)
+		__field(u8, ring)
+		__field(u16, cidx)
+	),
+
+	TP_fast_assign(
+		DEV_ASSIGN;
+		__entry->rx = rx;
+		__entry->ring = ring;
+		__entry->cidx = cidx;
+	),
+
+	TP_printk(DEV_PR_FMT " %s ring=%u cidx=%u",
+		  DEV_PR_ARG, __entry->rx ? "rx" : "tx", __entry->ring,
+		  __entry->cidx)
+);
+
+TRACE_EVENT(mt7927_ring_reset,
+	TP_PROTO(struct mt7927_dev *dev, bool rx, u8 ring, u16 didx,
+		 u16 pending),
+
+	TP_ARGS(dev, rx, ring, didx, pending),
+
+	TP_STRUCT__entry(
+		DEV_ENTRY
+		__field(bool, rx)
+		__field(u8, ring)
+		__field(u16, didx)
+		__field(u16, pending)
+	),
+
+	TP_fast_assign(
+		DEV_ASSIGN;
+		__entry->rx = rx;
+		__entry->ring = ring;
+		__entry->didx = didx;
+		__entry->pending = pending;
+	),
+
+	TP_printk(DEV_PR_FMT " %s ring=%u stuck didx=%u reposted=%u",
+		  DEV_PR_ARG, __entry->rx ? "rx" : "tx", __entry->ring,
+		  __entry->didx, __entry->pending)
+);
+
+TRACE_EVENT(mt7927_chip_reset,
+	TP_PROTO(struct mt7927_dev *dev, u32 mcu_cmd, u64 duration_us, int ret),
+
+	TP_ARGS(dev, mcu_cmd, duration_us, ret),
+
+	TP_STRUCT__entry(
+		DEV_ENTRY
+		__field(u32, mcu_cmd)
+		__field(u64, duration_us)
+		__field(int, ret)
+	),
+
+	TP_fast_assign(
+		DEV_ASSIGN;
+		__entry->mcu_cmd = mcu_cmd;
+		__entry->duration_us = duration_us;
+		__entry->ret = ret;
+	),
+
+	TP_printk(DEV_PR_FMT " mcu_cmd=0x%08x duration=%lluus ret=%d",
+		  DEV_PR_ARG, __entry->mcu_cmd, __entry->duration_us,
+		  __entry->ret)
+);
+
+/* MCU commands */
+
+TRACE_EVENT(mt7927_mcu_send,
+	TP_PROTO(struct mt7927_dev *dev, u8 cid, u8 seq, u32 len),
+
+	TP_ARGS(dev, cid, seq, len),
+
+	TP_STRUCT__entry(
+		DEV_ENTRY
+		__field(u8, cid)
+		__field(u8, seq)
+		__field(u32, len)
+	),
+
+	TP_fast_assign(
+		DEV_ASSIGN;
+		__entry->cid = cid;
+		__entry->seq = seq;
+		__entry->len = len;
+	),
+
+	TP_printk(DEV_PR_FMT " cid=0x%02x seq=%u len=%u",
+		  DEV_PR_ARG, __entry->cid, __entry->seq, __entry->len)
+);
+
+TRACE_EVENT(mt7927_mcu_response,
+	TP_PROTO(struct mt7927_dev *dev, u8 cid, u8 seq, s64 latency_us,
+		 int ret),
+
+	TP_ARGS(dev, cid, seq, latency_us, ret),
+
+	TP_STRUCT__entry(
+		DEV_ENTRY
+		__field(u8, cid)
+		__field(u8, seq)
+		__field(s64, latency_us)
+		__field(int, ret)
+	),
+
+	TP_fast_assign(
+		DEV_ASSIGN;
+		__entry->cid = cid;
+		__entry->seq = seq;
+		__entry->latency_us = latency_us;
+		__entry->ret = ret;
+	),
+
+	TP_printk(DEV_PR_FMT " cid=0x%02x seq=%u latency=%lldus ret=%d",
+		  DEV_PR_ARG, __entry->cid, __entry->seq,
+		  __entry->latency_us, __entry->ret)
+);
+
+/* Firmware download regions */
+
+TRACE_EVENT(mt7927_region_start,
+	TP_PROTO(struct mt7927_dev *dev, int idx, u32 addr, u32 len),
+
+	TP_ARGS(dev, idx, addr, len),
+
+	TP_STRUCT__entry(
+		DEV_ENTRY
+		__field(int, idx)
+		__field(u32, addr)
+		__field(u32, len)
+	),
+
+	TP_fast_assign(
+		DEV_ASSIGN;
+		__entry->idx = idx;
+		__entry->addr = addr;
+		__entry->len = len;
+	),
+
+	TP_printk(DEV_PR_FMT " region=%d addr=0x%08x len=%u",
+		  DEV_PR_ARG, __entry->idx, __entry->addr, __entry->len)
+);
+
+TRACE_EVENT(mt7927_region_finish,
+	TP_PROTO(struct mt7927_dev *dev, int idx, u32 addr, s64 duration_us,
+		 int ret),
+
+	TP_ARGS(dev, idx, addr, duration_us, ret),
+
+	TP_STRUCT__entry(
+		DEV_ENTRY
+		__field(int, idx)
+		__field(u32, addr)
+		__field(s64, duration_us)
+		__field(int, ret)
+	),
+
+	TP_fast_assign(
+		DEV_ASSIGN;
+		__entry->idx = idx;
+		__entry->addr = addr;
+		__entry->duration_us = duration_us;
+		__entry->ret = ret;
+	),
+
+	TP_printk(DEV_PR_FMT " region=%d addr=0x%08x duration=%lldus ret=%d",
+		  DEV_PR_ARG, __entry->idx, __entry->addr,
+		  __entry->duration_us, __entry->ret)
+);
+
+/* ROM/firmware state (MT_CONN_ON_MISC) */
+
+TRACE_EVENT(mt7927_conn_misc,
+	TP_PROTO(struct mt7927_dev *dev, u32 old, u32 new),
+
+	TP_ARGS(dev, old, new),
+
+	TP_STRUCT__entry(
+		DEV_ENTRY
+		__field(u32, old)
+		__field(u32, new)
+	),
+
+	TP_fast_assign(
+		DEV_ASSIGN;
+		__entry->old = old;
+		__entry->new = new;
+	),
+
+	TP_printk(DEV_PR_FMT " 0x%08x -> 0x%08x (state %u -> %u)",
+		  DEV_PR_ARG, __entry->old, __entry->new,
+		  __entry->old & 0xf, __entry->new & 0xf)
+);
+
+/* Runtime power save */
+
+TRACE_EVENT(mt7927_pm_wake,
+	TP_PROTO(struct mt7927_dev *dev, u64 latency_us),
+
+	TP_ARGS(dev, latency_us),
+
+	TP_STRUCT__entry(
+		DEV_ENTRY
+		__field(u64, latency_us)
+	),
+
+	TP_fast_assign(
+		DEV_ASSIGN;
+		__entry->latency_us = latency_us;
+	),
+
+	TP_printk(DEV_PR_FMT " latency=%lluus",
+		  DEV_PR_ARG, __entry->latency_us)
+);
+
+#endif /* __MT7927_TRACE_H */
+
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE mt7927_trace
+
+#include <trace/define_trace.h>
@@ -21,6 +21,8 @@
 #include <linux/delay.h>
 #include <linux/dma-mapping.h>
 #include <linux/interrupt.h>
+#include <linux/sizes.h>
+#include <linux/iopoll.h>
 
 #define DRV_NAME "mt7927"
 #define DRV_VERSION "2.21.0"
@@ -285,6 +287,10 @@ struct mt76_desc {
 #define MT_DMA_CTL_LAST_SEC0		BIT(16)
 #define MT_DMA_CTL_DMA_DONE		BIT(31)
 
+/* info word: bits 35:32 of buf0/buf1 */
+#define MT_DMA_CTL_SDP0_H		GENMASK(3, 0)
+#define MT_DMA_CTL_SDP1_H		GENMASK(19, 16)
+
 /* =============================================================================
  * Firmware Definitions
  * =============================================================================
@@ -422,13 +428,16 @@ struct mt76_connac2_patch_hdr {
  * =============================================================================
  */
 
+/* One cache line per ring, so neighbouring rings never share one */
 struct mt7927_ring {
 	struct mt76_desc *desc;
 	dma_addr_t desc_dma;
 	int size;
 	int idx;
-	bool allocated;
-};
+} ____cacheline_aligned_in_smp;
+
+static_assert(IS_ALIGNED(sizeof(struct mt7927_ring), SMP_CACHE_BYTES));
+static_assert(sizeof(struct mt76_desc) == 16);
 
 struct mt7927_dev {
 	struct pci_dev *pdev;
@@ -441,8 +450,10 @@ struct mt7927_dev {
 
 	u8 mcu_seq;
 
-	struct mt7927_ring tx_ring[32];
-	struct mt7927_ring rx_ring[8];
+	struct mt7927_ring *tx_ring[32];	/* Allocated on first use */
+	struct mt7927_ring *rx_ring[8];
+	u32 tx_ring_base;		/* HOST or MCU ring bank, see dma_init */
+	u32 rx_ring_base;
 
 	void *fw_buf;
 	dma_addr_t fw_buf_dma;
@@ -456,27 +467,53 @@ struct mt7927_dev {
  * =============================================================================
  */
 
-static inline u32 mt7927_rr(struct mt7927_dev *dev, u32 offset)
+/*
+ * BAR0 is 2MB on every MT7927 we have seen. Constant offsets are checked
+ * against this at build time; probe refuses anything smaller.
+ */
+#define MT7927_BAR0_MIN_SIZE		SZ_2M
+
+#define MT7927_REG(offset)						\
+	((offset) + BUILD_BUG_ON_ZERO((offset) > MT7927_BAR0_MIN_SIZE - sizeof(u32)))
+
+static inline u32 __mt7927_rr(struct mt7927_dev *dev, u32 offset)
 {
-	if (offset >= dev->regs_len)
-		return 0xdeadbeef;
 	return readl(dev->regs + offset);
 }
 
-static inline void mt7927_wr(struct mt7927_dev *dev, u32 offset, u32 val)
+static inline void __mt7927_wr(struct mt7927_dev *dev, u32 offset, u32 val)
 {
-	if (offset < dev->regs_len)
-		writel(val, dev->regs + offset);
+	writel(val, dev->regs + offset);
 }
 
-static inline void mt7927_set(struct mt7927_dev *dev, u32 offset, u32 bits)
+static inline void __mt7927_set(struct mt7927_dev *dev, u32 offset, u32 bits)
 {
-	mt7927_wr(dev, offset, mt7927_rr(dev, offset) | bits);
+	__mt7927_wr(dev, offset, __mt7927_rr(dev, offset) | bits);
 }
 
-static inline void mt7927_clear(struct mt7927_dev *dev, u32 offset, u32 bits)
+static inline void __mt7927_clear(struct mt7927_dev *dev, u32 offset, u32 bits)
 {
-	mt7927_wr(dev, offset, mt7927_rr(dev, offset) & ~bits);
+	__mt7927_wr(dev, offset, __mt7927_rr(dev, offset) & ~bits);
+}
+
+/* Constant offsets only - non-constant offsets fail to build */
+#define mt7927_rr(dev, offset)		__mt7927_rr(dev, MT7927_REG(offset))
+#define mt7927_wr(dev, offset, val)	__mt7927_wr(dev, MT7927_REG(offset), val)
+#define mt7927_set(dev, offset, bits)	__mt7927_set(dev, MT7927_REG(offset), bits)
+#define mt7927_clear(dev, offset, bits)	__mt7927_clear(dev, MT7927_REG(offset), bits)
+
+/* Computed offsets - bounds checked at runtime */
+static u32 mt7927_rr_checked(struct mt7927_dev *dev, u32 offset)
+{
+	if (offset > dev->regs_len - sizeof(u32))
+		return 0xdeadbeef;
+	return __mt7927_rr(dev, offset);
+}
+
+static void mt7927_wr_checked(struct mt7927_dev *dev, u32 offset, u32 val)
+{
+	if (offset <= dev->regs_len - sizeof(u32))
+		__mt7927_wr(dev, offset, val);
 }
 
 /* =============================================================================
@@ -484,39 +521,53 @@ static inline void mt7927_clear(struct mt7927_dev *dev, u32 offset, u32 bits)
  * =============================================================================
  */
 
-static int mt7927_ring_alloc(struct mt7927_dev *dev, struct mt7927_ring *ring, int size)
+/* Rings only exist once a queue is brought up; unused slots stay NULL */
+static int mt7927_ring_alloc(struct mt7927_dev *dev, struct mt7927_ring **pring, int size)
 {
+	struct mt7927_ring *ring = *pring;
+
+	if (ring)
+		return 0;
+
+	ring = kzalloc_node(sizeof(*ring), GFP_KERNEL, dev_to_node(&dev->pdev->dev));
+	if (!ring)
+		return -ENOMEM;
+
 	ring->size = size;
-	ring->idx = 0;
 	ring->desc = dma_alloc_coherent(&dev->pdev->dev,
 					size * sizeof(struct mt76_desc),
 					&ring->desc_dma, GFP_KERNEL);
-	if (!ring->desc)
+	if (!ring->desc) {
+		kfree(ring);
 		return -ENOMEM;
+	}
 
 	memset(ring->desc, 0, size * sizeof(struct mt76_desc));
-	ring->allocated = true;
+	*pring = ring;
 	return 0;
 }
 
-static void mt7927_ring_free(struct mt7927_dev *dev, struct mt7927_ring *ring)
+static void mt7927_ring_free(struct mt7927_dev *dev, struct mt7927_ring **pring)
 {
-	if (ring->allocated && ring->desc) {
-		dma_free_coherent(&dev->pdev->dev,
-				  ring->size * sizeof(struct mt76_desc),
-				  ring->desc, ring->desc_dma);
-		ring->desc = NULL;
-		ring->allocated = false;
-	}
+	struct mt7927_ring *ring = *pring;
+
+	if (!ring)
+		return;
+
+	dma_free_coherent(&dev->pdev->dev,
+			  ring->size * sizeof(struct mt76_desc),
+			  ring->desc, ring->desc_dma);
+	kfree(ring);
+	*pring = NULL;
 }
 
 static void mt7927_ring_setup(struct mt7927_dev *dev, u32 base_reg,
 			      struct mt7927_ring *ring)
 {
-	/* Write lower 32 bits of DMA address - this is all we need for 32-bit DMA */
-	mt7927_wr(dev, base_reg + MT_RING_BASE, lower_32_bits(ring->desc_dma));
-	mt7927_wr(dev, base_reg + MT_RING_CNT, ring->size);
-	mt7927_wr(dev, base_reg + MT_RING_CIDX, 0);
+	/* Rings are coherent memory, below 4 GB (see probe) */
+	mt7927_wr_checked(dev, base_reg + MT_RING_BASE, lower_32_bits(ring->desc_dma));
+	mt7927_wr_checked(dev, base_reg + MT_RING_CNT, ring->size);
+	mt7927_wr_checked(dev, base_reg + MT_RING_CIDX, 0);
 }
 
 /* =============================================================================
@@ -524,6 +575,68 @@ static void mt7927_ring_setup(struct mt7927_dev *dev, u32 base_reg,
  * =============================================================================
  */
 
+/* Reset ring pointers and enable both engines */
+static void mt7927_dma_start(struct mt7927_dev *dev)
+{
+	u32 val;
+
+	mt7927_wr(dev, MT_WFDMA0_RST_DTX_PTR, ~0);
+	mt7927_wr(dev, MT_WFDMA0_RST_DRX_PTR, ~0);
+	mt7927_wr(dev, MT_WFDMA0_PRI_DLY_INT_CFG0, 0);
+
+	val = MT_WFDMA0_GLO_CFG_TX_WB_DDONE |
+	      MT_WFDMA0_GLO_CFG_FIFO_LITTLE_ENDIAN |
+	      MT_WFDMA0_GLO_CFG_CSR_DISP_BASE_PTR_CHAIN_EN |
+	      MT_WFDMA0_GLO_CFG_OMIT_RX_INFO_PFET2 |
+	      MT_WFDMA0_GLO_CFG_OMIT_TX_INFO |
+	      MT_WFDMA0_GLO_CFG_CLK_GAT_DIS |
+	      (3 << 4);
+
+	mt7927_wr(dev, MT_WFDMA0_GLO_CFG, val);
+	mt7927_set(dev, MT_WFDMA0_GLO_CFG,
+		   MT_WFDMA0_GLO_CFG_TX_DMA_EN | MT_WFDMA0_GLO_CFG_RX_DMA_EN);
+
+	val = mt7927_rr(dev, MT_WFDMA0_GLO_CFG);
+	if ((val & (MT_WFDMA0_GLO_CFG_TX_DMA_EN | MT_WFDMA0_GLO_CFG_RX_DMA_EN)) ==
+	    (MT_WFDMA0_GLO_CFG_TX_DMA_EN | MT_WFDMA0_GLO_CFG_RX_DMA_EN)) {
+		dev->dma_ready = true;
+		dev_info(&dev->pdev->dev, "[DMA] DMA enabled: GLO_CFG=0x%08x\n", val);
+	}
+}
+
+/*
+ * Re-program rings kept across suspend: prefetch, BASE/CNT and CIDX on
+ * the bank dma_init() picked. Nothing is reset or allocated.
+ */
+static void mt7927_dma_restore(struct mt7927_dev *dev)
+{
+	int i;
+
+	mt7927_set(dev, MT_WFDMA0_GLO_CFG, MT_WFDMA0_GLO_CFG_CLK_GAT_DIS);
+
+	mt7927_wr(dev, MT_WFDMA0_TX_RING15_EXT_CTRL, PREFETCH_TX_RING15);
+	mt7927_wr(dev, MT_WFDMA0_TX_RING16_EXT_CTRL, PREFETCH_TX_RING16);
+	mt7927_wr(dev, MT_WFDMA0_RX_RING0_EXT_CTRL, PREFETCH_RX_RING0);
+
+	for (i = 0; i < ARRAY_SIZE(dev->tx_ring); i++) {
+		if (!dev->tx_ring[i])
+			continue;
+		dev->tx_ring[i]->idx = 0;
+		mt7927_ring_setup(dev, dev->tx_ring_base + i * MT_TX_RING_SIZE,
+				  dev->tx_ring[i]);
+	}
+
+	for (i = 0; i < ARRAY_SIZE(dev->rx_ring); i++) {
+		if (!dev->rx_ring[i])
+			continue;
+		dev->rx_ring[i]->idx = 0;
+		mt7927_ring_setup(dev, dev->rx_ring_base + i * MT_RX_RING_SIZE,
+				  dev->rx_ring[i]);
+	}
+
+	mt7927_dma_start(dev);
+}
+
 static int mt7927_dma_init(struct mt7927_dev *dev)
 {
 	u32 val, base_reg, readback, mcu_base_reg;
@@ -611,9 +724,9 @@ static int mt7927_dma_init(struct mt7927_dev *dev)
 	/* Test HOST Ring16 */
 	base_reg = MT_TX_RING_BASE + MT_TX_RING_FWDL * MT_TX_RING_SIZE;
 	dev_info(&dev->pdev->dev, "[DMA] HOST Ring16: Writing BASE=0x%08x to reg 0x%05x\n",
-		 lower_32_bits(dev->tx_ring[MT_TX_RING_FWDL].desc_dma), base_reg);
-	mt7927_ring_setup(dev, base_reg, &dev->tx_ring[MT_TX_RING_FWDL]);
-	readback = mt7927_rr(dev, base_reg + MT_RING_BASE);
+		 lower_32_bits(dev->tx_ring[MT_TX_RING_FWDL]->desc_dma), base_reg);
+	mt7927_ring_setup(dev, base_reg, dev->tx_ring[MT_TX_RING_FWDL]);
+	readback = mt7927_rr_checked(dev, base_reg + MT_RING_BASE);
 	dev_info(&dev->pdev->dev, "[DMA] HOST Ring16: Readback = 0x%08x %s\n",
 		 readback, (readback != 0) ? "OK!" : "FAILED");
 	if (readback != 0)
@@ -624,16 +737,16 @@ static int mt7927_dma_init(struct mt7927_dev *dev)
 	/* Test MCU Ring16 */
 	mcu_base_reg = MT_MCU_TX_RING_BASE + MT_TX_RING_FWDL * MT_TX_RING_SIZE;
 	dev_info(&dev->pdev->dev, "[DMA] MCU Ring16: Writing BASE=0x%08x to reg 0x%05x\n",
-		 lower_32_bits(dev->tx_ring[MT_TX_RING_FWDL].desc_dma), mcu_base_reg);
-	mt7927_ring_setup(dev, mcu_base_reg, &dev->tx_ring[MT_TX_RING_FWDL]);
-	readback = mt7927_rr(dev, mcu_base_reg + MT_RING_BASE);
+		 lower_32_bits(dev->tx_ring[MT_TX_RING_FWDL]->desc_dma), mcu_base_reg);
+	mt7927_ring_setup(dev, mcu_base_reg, dev->tx_ring[MT_TX_RING_FWDL]);
+	readback = mt7927_rr_checked(dev, mcu_base_reg + MT_RING_BASE);
 	dev_info(&dev->pdev->dev, "[DMA] MCU Ring16: Readback = 0x%08x %s\n",
 		 readback, (readback != 0) ? "OK!" : "FAILED");
 	if (readback != 0)
 		mcu_works = true;
 
 	/* Also read HOST to see if MCU write affected it */
-	readback = mt7927_rr(dev, base_reg + MT_RING_BASE);
+	readback = mt7927_rr_checked(dev, base_reg + MT_RING_BASE);
 	dev_info(&dev->pdev->dev, "[DMA] HOST Ring16 after MCU write: 0x%08x\n", readback);
 
 	/* Configure remaining rings using whichever method works */
@@ -641,30 +754,34 @@ static int mt7927_dma_init(struct mt7927_dev *dev)
 
 	if (mcu_works) {
 		dev_info(&dev->pdev->dev, "[DMA] Using MCU WPDMA (0x2xxx) for rings\n");
+		dev->tx_ring_base = MT_MCU_TX_RING_BASE;
+		dev->rx_ring_base = MT_MCU_RX_RING_BASE;
 
 		/* TX Ring 16 (FWDL) */
 		mcu_base_reg = MT_MCU_TX_RING_BASE + MT_TX_RING_FWDL * MT_TX_RING_SIZE;
-		mt7927_ring_setup(dev, mcu_base_reg, &dev->tx_ring[MT_TX_RING_FWDL]);
+		mt7927_ring_setup(dev, mcu_base_reg, dev->tx_ring[MT_TX_RING_FWDL]);
 
 		/* TX Ring 15 (MCU) */
 		mcu_base_reg = MT_MCU_TX_RING_BASE + MT_TX_RING_MCU_WM * MT_TX_RING_SIZE;
-		mt7927_ring_setup(dev, mcu_base_reg, &dev->tx_ring[MT_TX_RING_MCU_WM]);
+		mt7927_ring_setup(dev, mcu_base_reg, dev->tx_ring[MT_TX_RING_MCU_WM]);
 
 		/* RX Ring 0 (MCU events) */
 		mcu_base_reg = MT_MCU_RX_RING_BASE + MT_RX_RING_MCU * MT_RX_RING_SIZE;
-		mt7927_ring_setup(dev, mcu_base_reg, &dev->rx_ring[MT_RX_RING_MCU]);
+		mt7927_ring_setup(dev, mcu_base_reg, dev->rx_ring[MT_RX_RING_MCU]);
 	} else if (host_works) {
 		dev_info(&dev->pdev->dev, "[DMA] Using HOST WFDMA (0xD4xxx) for rings\n");
+		dev->tx_ring_base = MT_TX_RING_BASE;
+		dev->rx_ring_base = MT_RX_RING_BASE;
 
 		/* TX Ring 16 already set up above */
 
 		/* TX Ring 15 */
 		base_reg = MT_TX_RING_BASE + MT_TX_RING_MCU_WM * MT_TX_RING_SIZE;
-		mt7927_ring_setup(dev, base_reg, &dev->tx_ring[MT_TX_RING_MCU_WM]);
+		mt7927_ring_setup(dev, base_reg, dev->tx_ring[MT_TX_RING_MCU_WM]);
 
 		/* RX Ring 0 */
 		base_reg = MT_RX_RING_BASE + MT_RX_RING_MCU * MT_RX_RING_SIZE;
-		mt7927_ring_setup(dev, base_reg, &dev->rx_ring[MT_RX_RING_MCU]);
+		mt7927_ring_setup(dev, base_reg, dev->rx_ring[MT_RX_RING_MCU]);
 	} else {
 		dev_err(&dev->pdev->dev, "[DMA] NEITHER HOST nor MCU ring registers work!\n");
 		dev_err(&dev->pdev->dev, "[DMA] This may require different initialization\n");
@@ -672,28 +789,7 @@ static int mt7927_dma_init(struct mt7927_dev *dev)
 	}
 
 	/* Step 7: Reset ring pointers and enable DMA */
-	mt7927_wr(dev, MT_WFDMA0_RST_DTX_PTR, ~0);
-	mt7927_wr(dev, MT_WFDMA0_RST_DRX_PTR, ~0);
-	mt7927_wr(dev, MT_WFDMA0_PRI_DLY_INT_CFG0, 0);
-
-	val = MT_WFDMA0_GLO_CFG_TX_WB_DDONE |
-	      MT_WFDMA0_GLO_CFG_FIFO_LITTLE_ENDIAN |
-	      MT_WFDMA0_GLO_CFG_CSR_DISP_BASE_PTR_CHAIN_EN |
-	      MT_WFDMA0_GLO_CFG_OMIT_RX_INFO_PFET2 |
-	      MT_WFDMA0_GLO_CFG_OMIT_TX_INFO |
-	      MT_WFDMA0_GLO_CFG_CLK_GAT_DIS |
-	      (3 << 4);
-
-	mt7927_wr(dev, MT_WFDMA0_GLO_CFG, val);
-	mt7927_set(dev, MT_WFDMA0_GLO_CFG,
-		   MT_WFDMA0_GLO_CFG_TX_DMA_EN | MT_WFDMA0_GLO_CFG_RX_DMA_EN);
-
-	val = mt7927_rr(dev, MT_WFDMA0_GLO_CFG);
-	if ((val & (MT_WFDMA0_GLO_CFG_TX_DMA_EN | MT_WFDMA0_GLO_CFG_RX_DMA_EN)) ==
-	    (MT_WFDMA0_GLO_CFG_TX_DMA_EN | MT_WFDMA0_GLO_CFG_RX_DMA_EN)) {
-		dev->dma_ready = true;
-		dev_info(&dev->pdev->dev, "[DMA] DMA enabled: GLO_CFG=0x%08x\n", val);
-	}
+	mt7927_dma_start(dev);
 
 	/*
 	 * Step 8: Set DUMMY_CR to indicate DMA needs reinit
@@ -768,31 +864,35 @@ static int mt7927_wfsys_reset(struct mt7927_dev *dev)
 	return -ETIMEDOUT;
 }
 
+/*
+ * FW -> driver ownership round trip. OWN_SYNC is polled every 10us instead
+ * of sleeping a fixed 50ms between the two steps; the handshake itself
+ * says when firmware has taken ownership.
+ */
 static int mt7927_power_handoff(struct mt7927_dev *dev)
 {
+	ktime_t start;
 	u32 val;
-	int i;
+	int ret;
 
 	mt7927_wr(dev, MT_LPCTL_BAR_OFS, PCIE_LPCR_HOST_SET_OWN);
-	for (i = 0; i < 100; i++) {
-		val = mt7927_rr(dev, MT_LPCTL_BAR_OFS);
-		if (val & PCIE_LPCR_HOST_OWN_SYNC)
-			break;
-		msleep(1);
-	}
-
-	msleep(50);
+	ret = read_poll_timeout(__mt7927_rr, val, val & PCIE_LPCR_HOST_OWN_SYNC,
+				10, 100 * USEC_PER_MSEC, false,
+				dev, MT7927_REG(MT_LPCTL_BAR_OFS));
+	if (ret)
+		dev_warn(&dev->pdev->dev, "[PWR] FW ownership timeout (continuing)\n");
 
+	start = ktime_get();
 	mt7927_wr(dev, MT_LPCTL_BAR_OFS, PCIE_LPCR_HOST_CLR_OWN);
-	for (i = 0; i < 500; i++) {
-		val = mt7927_rr(dev, MT_LPCTL_BAR_OFS);
-		if (!(val & PCIE_LPCR_HOST_OWN_SYNC)) {
-			dev_info(&dev->pdev->dev, "[PWR] Driver ownership OK\n");
-			return 0;
-		}
-		msleep(1);
-	}
-	return -ETIMEDOUT;
+	ret = read_poll_timeout(__mt7927_rr, val, !(val & PCIE_LPCR_HOST_OWN_SYNC),
+				10, 500 * USEC_PER_MSEC, false,
+				dev, MT7927_REG(MT_LPCTL_BAR_OFS));
+	if (ret)
+		return ret;
+
+	dev_info(&dev->pdev->dev, "[PWR] Driver ownership OK (%lld us)\n",
+		 ktime_us_delta(ktime_get(), start));
+	return 0;
 }
 
 static int mt7927_conninfra_wakeup(struct mt7927_dev *dev)
@@ -881,20 +981,20 @@ static void mt7927_dump_debug_regs(struct mt7927_dev *dev, const char *label)
 	dev_info(&dev->pdev->dev, "ConnInfra HOST (0x0E0000):\n");
 	for (i = 0; i < 0x100; i += 0x10) {
 		dev_info(&dev->pdev->dev, "  +0x%03x: %08x %08x %08x %08x\n", i,
-			 mt7927_rr(dev, CONN_INFRA_HOST_BAR_OFS + i),
-			 mt7927_rr(dev, CONN_INFRA_HOST_BAR_OFS + i + 4),
-			 mt7927_rr(dev, CONN_INFRA_HOST_BAR_OFS + i + 8),
-			 mt7927_rr(dev, CONN_INFRA_HOST_BAR_OFS + i + 12));
+			 mt7927_rr_checked(dev, CONN_INFRA_HOST_BAR_OFS + i),
+			 mt7927_rr_checked(dev, CONN_INFRA_HOST_BAR_OFS + i + 4),
+			 mt7927_rr_checked(dev, CONN_INFRA_HOST_BAR_OFS + i + 8),
+			 mt7927_rr_checked(dev, CONN_INFRA_HOST_BAR_OFS + i + 12));
 	}
 
 	/* WFSYS region (0x0F0000) - first 256 bytes */
 	dev_info(&dev->pdev->dev, "WFSYS (0x0F0000):\n");
 	for (i = 0; i < 0x200; i += 0x10) {
 		dev_info(&dev->pdev->dev, "  +0x%03x: %08x %08x %08x %08x\n", i,
-			 mt7927_rr(dev, FIXED_MAP_CONN_INFRA + i),
-			 mt7927_rr(dev, FIXED_MAP_CONN_INFRA + i + 4),
-			 mt7927_rr(dev, FIXED_MAP_CONN_INFRA + i + 8),
-			 mt7927_rr(dev, FIXED_MAP_CONN_INFRA + i + 12));
+			 mt7927_rr_checked(dev, FIXED_MAP_CONN_INFRA + i),
+			 mt7927_rr_checked(dev, FIXED_MAP_CONN_INFRA + i + 4),
+			 mt7927_rr_checked(dev, FIXED_MAP_CONN_INFRA + i + 8),
+			 mt7927_rr_checked(dev, FIXED_MAP_CONN_INFRA + i + 12));
 	}
 
 	/* WFDMA key registers */
@@ -905,17 +1005,17 @@ static void mt7927_dump_debug_regs(struct mt7927_dev *dev, const char *label)
 
 	/* Ring 15 (MCU WM) */
 	val = MT_TX_RING_BASE + MT_TX_RING_MCU_WM * MT_TX_RING_SIZE;
-	dev_info(&dev->pdev->dev, "  TX Ring15 BASE: 0x%08x\n", mt7927_rr(dev, val));
-	dev_info(&dev->pdev->dev, "  TX Ring15 CNT: 0x%08x\n", mt7927_rr(dev, val + 4));
-	dev_info(&dev->pdev->dev, "  TX Ring15 CIDX: 0x%08x\n", mt7927_rr(dev, val + 8));
-	dev_info(&dev->pdev->dev, "  TX Ring15 DIDX: 0x%08x\n", mt7927_rr(dev, val + 12));
+	dev_info(&dev->pdev->dev, "  TX Ring15 BASE: 0x%08x\n", mt7927_rr_checked(dev, val));
+	dev_info(&dev->pdev->dev, "  TX Ring15 CNT: 0x%08x\n", mt7927_rr_checked(dev, val + 4));
+	dev_info(&dev->pdev->dev, "  TX Ring15 CIDX: 0x%08x\n", mt7927_rr_checked(dev, val + 8));
+	dev_info(&dev->pdev->dev, "  TX Ring15 DIDX: 0x%08x\n", mt7927_rr_checked(dev, val + 12));
 
 	/* Ring 16 (FWDL) */
 	val = MT_TX_RING_BASE + MT_TX_RING_FWDL * MT_TX_RING_SIZE;
-	dev_info(&dev->pdev->dev, "  TX Ring16 BASE: 0x%08x\n", mt7927_rr(dev, val));
-	dev_info(&dev->pdev->dev, "  TX Ring16 CNT: 0x%08x\n", mt7927_rr(dev, val + 4));
-	dev_info(&dev->pdev->dev, "  TX Ring16 CIDX: 0x%08x\n", mt7927_rr(dev, val + 8));
-	dev_info(&dev->pdev->dev, "  TX Ring16 DIDX: 0x%08x\n", mt7927_rr(dev, val + 12));
+	dev_info(&dev->pdev->dev, "  TX Ring16 BASE: 0x%08x\n", mt7927_rr_checked(dev, val));
+	dev_info(&dev->pdev->dev, "  TX Ring16 CNT: 0x%08x\n", mt7927_rr_checked(dev, val + 4));
+	dev_info(&dev->pdev->dev, "  TX Ring16 CIDX: 0x%08x\n", mt7927_rr_checked(dev, val + 8));
+	dev_info(&dev->pdev->dev, "  TX Ring16 DIDX: 0x%08x\n", mt7927_rr_checked(dev, val + 12));
 
 	/* Additional MCU state registers */
 	dev_info(&dev->pdev->dev, "Interrupt registers:\n");
@@ -1215,12 +1315,12 @@ static void mt7927_scan_writable_regs(struct mt7927_dev *dev)
 		if (test_regs[i].addr >= dev->regs_len)
 			continue;
 
-		before = mt7927_rr(dev, test_regs[i].addr);
-		mt7927_wr(dev, test_regs[i].addr, test_val);
-		after = mt7927_rr(dev, test_regs[i].addr);
+		before = mt7927_rr_checked(dev, test_regs[i].addr);
+		mt7927_wr_checked(dev, test_regs[i].addr, test_val);
+		after = mt7927_rr_checked(dev, test_regs[i].addr);
 
 		/* Restore original value */
-		mt7927_wr(dev, test_regs[i].addr, before);
+		mt7927_wr_checked(dev, test_regs[i].addr, before);
 
 		if (after == test_val) {
 			dev_info(&dev->pdev->dev, "[SCAN] 0x%05x %-20s: WRITABLE! (was 0x%08x)\n",
@@ -1285,11 +1385,11 @@ static int mt7927_wait_tx_done(struct mt7927_dev *dev, int ring_idx)
 	u32 cidx, didx, didx_initial;
 	int i;
 
-	cidx = mt7927_rr(dev, base + MT_RING_CIDX);
-	didx_initial = mt7927_rr(dev, base + MT_RING_DIDX);
+	cidx = mt7927_rr_checked(dev, base + MT_RING_CIDX);
+	didx_initial = mt7927_rr_checked(dev, base + MT_RING_DIDX);
 
 	for (i = 0; i < DMA_TX_DONE_TIMEOUT_MS * 10; i++) {
-		didx = mt7927_rr(dev, base + MT_RING_DIDX);
+		didx = mt7927_rr_checked(dev, base + MT_RING_DIDX);
 		if (didx == cidx)
 			return 0;
 		usleep_range(100, 200);
@@ -1306,13 +1406,13 @@ static int mt7927_wait_tx_done(struct mt7927_dev *dev, int ring_idx)
 static int mt7927_mcu_send_cmd(struct mt7927_dev *dev, u8 cmd,
 			       const void *data, size_t len)
 {
-	struct mt7927_ring *ring = &dev->tx_ring[MT_TX_RING_MCU_WM];
+	struct mt7927_ring *ring = dev->tx_ring[MT_TX_RING_MCU_WM];
 	struct mt76_connac2_mcu_txd *txd;
 	struct mt76_desc *desc;
 	u32 ctrl, host_cidx_addr, mcu_cidx_addr, readback;
 	int idx;
 
-	if (!ring->allocated || !dev->cmd_buf)
+	if (!ring || !dev->cmd_buf)
 		return -EINVAL;
 
 	txd = (struct mt76_connac2_mcu_txd *)dev->cmd_buf;
@@ -1344,8 +1444,9 @@ static int mt7927_mcu_send_cmd(struct mt7927_dev *dev, u8 cmd,
 	desc->buf0 = cpu_to_le32(lower_32_bits(dev->cmd_buf_dma));
 	ctrl = FIELD_PREP(MT_DMA_CTL_SD_LEN0, sizeof(*txd) + len) | MT_DMA_CTL_LAST_SEC0;
 	desc->ctrl = cpu_to_le32(ctrl);
-	desc->buf1 = cpu_to_le32(upper_32_bits(dev->cmd_buf_dma));  /* Upper bits for 64-bit addr */
-	desc->info = 0;
+	desc->buf1 = 0;
+	desc->info = cpu_to_le32(FIELD_PREP(MT_DMA_CTL_SDP0_H,
+					    upper_32_bits(dev->cmd_buf_dma)));
 
 	wmb();
 
@@ -1359,16 +1460,20 @@ static int mt7927_mcu_send_cmd(struct mt7927_dev *dev, u8 cmd,
 	mcu_cidx_addr = MT_MCU_TX_RING_BASE + MT_TX_RING_MCU_WM * MT_TX_RING_SIZE + MT_RING_CIDX;
 
 	/* Write to HOST CIDX (0xD43F8) */
-	mt7927_wr(dev, host_cidx_addr, ring->idx);
+	mt7927_wr(dev, MT_TX_RING_BASE + MT_TX_RING_MCU_WM * MT_TX_RING_SIZE + MT_RING_CIDX,
+		  ring->idx);
 	wmb();
-	readback = mt7927_rr(dev, host_cidx_addr);
+	readback = mt7927_rr(dev, MT_TX_RING_BASE + MT_TX_RING_MCU_WM * MT_TX_RING_SIZE +
+			     MT_RING_CIDX);
 	dev_info(&dev->pdev->dev, "[MCU_CMD] Host CIDX write %d -> readback %d (addr 0x%05x)\n",
 		 ring->idx, readback, host_cidx_addr);
 
 	/* Also write to MCU WPDMA CIDX (0x23F8) */
-	mt7927_wr(dev, mcu_cidx_addr, ring->idx);
+	mt7927_wr(dev, MT_MCU_TX_RING_BASE + MT_TX_RING_MCU_WM * MT_TX_RING_SIZE + MT_RING_CIDX,
+		  ring->idx);
 	wmb();
-	readback = mt7927_rr(dev, mcu_cidx_addr);
+	readback = mt7927_rr(dev, MT_MCU_TX_RING_BASE + MT_TX_RING_MCU_WM * MT_TX_RING_SIZE +
+			     MT_RING_CIDX);
 	dev_info(&dev->pdev->dev, "[MCU_CMD] MCU CIDX write %d -> readback %d (addr 0x%05x)\n",
 		 ring->idx, readback, mcu_cidx_addr);
 
@@ -1438,14 +1543,14 @@ static int mt7927_mcu_init_download(struct mt7927_dev *dev, u32 addr, u32 len, u
  */
 static int mt7927_fw_start_via_ring16(struct mt7927_dev *dev, u32 addr)
 {
-	struct mt7927_ring *ring = &dev->tx_ring[MT_TX_RING_FWDL];
+	struct mt7927_ring *ring = dev->tx_ring[MT_TX_RING_FWDL];
 	struct mt76_connac2_mcu_txd *txd;
 	struct mt76_desc *desc;
 	struct mt76_connac_fw_start *fw_start;
 	u32 ctrl;
 	int idx;
 
-	if (!ring->allocated || !dev->fw_buf)
+	if (!ring || !dev->fw_buf)
 		return -EINVAL;
 
 	dev_info(&dev->pdev->dev, "[FW] Trying FW_START via Ring 16 (FWDL)...\n");
@@ -1479,8 +1584,9 @@ static int mt7927_fw_start_via_ring16(struct mt7927_dev *dev, u32 addr)
 	desc->buf0 = cpu_to_le32(lower_32_bits(dev->fw_buf_dma));
 	ctrl = FIELD_PREP(MT_DMA_CTL_SD_LEN0, sizeof(*txd) + sizeof(*fw_start)) | MT_DMA_CTL_LAST_SEC0;
 	desc->ctrl = cpu_to_le32(ctrl);
-	desc->buf1 = cpu_to_le32(upper_32_bits(dev->fw_buf_dma));
-	desc->info = 0;
+	desc->buf1 = 0;
+	desc->info = cpu_to_le32(FIELD_PREP(MT_DMA_CTL_SDP0_H,
+					    upper_32_bits(dev->fw_buf_dma)));
 
 	wmb();
 
@@ -1730,13 +1836,13 @@ static int mt7927_mcu_start_firmware(struct mt7927_dev *dev, u32 addr)
  */
 static int mt7927_fw_scatter(struct mt7927_dev *dev, const u8 *data, size_t len)
 {
-	struct mt7927_ring *ring = &dev->tx_ring[MT_TX_RING_FWDL];
+	struct mt7927_ring *ring = dev->tx_ring[MT_TX_RING_FWDL];
 	struct mt76_connac2_mcu_txd *txd;
 	struct mt76_desc *desc;
 	u32 ctrl;
 	int idx;
 
-	if (!ring->allocated || !dev->fw_buf)
+	if (!ring || !dev->fw_buf)
 		return -EINVAL;
 
 	txd = (struct mt76_connac2_mcu_txd *)dev->fw_buf;
@@ -1763,8 +1869,9 @@ static int mt7927_fw_scatter(struct mt7927_dev *dev, const u8 *data, size_t len)
 	desc->buf0 = cpu_to_le32(lower_32_bits(dev->fw_buf_dma));
 	ctrl = FIELD_PREP(MT_DMA_CTL_SD_LEN0, sizeof(*txd) + len) | MT_DMA_CTL_LAST_SEC0;
 	desc->ctrl = cpu_to_le32(ctrl);
-	desc->buf1 = cpu_to_le32(upper_32_bits(dev->fw_buf_dma));  /* Upper bits for 64-bit addr */
-	desc->info = 0;
+	desc->buf1 = 0;
+	desc->info = cpu_to_le32(FIELD_PREP(MT_DMA_CTL_SDP0_H,
+					    upper_32_bits(dev->fw_buf_dma)));
 
 	wmb();
 
@@ -2067,7 +2174,7 @@ static int mt7927_probe(struct pci_dev *pdev, const struct pci_device_id *id)
 	dev_info(&pdev->dev, "# MT7927 WiFi 7 Driver v%s\n", DRV_VERSION);
 	dev_info(&pdev->dev, "############################################\n");
 
-	dev = kzalloc(sizeof(*dev), GFP_KERNEL);
+	dev = kzalloc_node(sizeof(*dev), GFP_KERNEL, dev_to_node(&pdev->dev));
 	if (!dev)
 		return -ENOMEM;
 
@@ -2084,12 +2191,23 @@ static int mt7927_probe(struct pci_dev *pdev, const struct pci_device_id *id)
 		goto err_free;
 
 	pci_set_master(pdev);
-	ret = dma_set_mask_and_coherent(&pdev->dev, DMA_BIT_MASK(32));
+	/* 36-bit streaming buffers via SDP0_H; rings stay below 4 GB */
+	ret = dma_set_mask(&pdev->dev, DMA_BIT_MASK(36));
+	if (ret)
+		ret = dma_set_mask(&pdev->dev, DMA_BIT_MASK(32));
+	if (!ret)
+		ret = dma_set_coherent_mask(&pdev->dev, DMA_BIT_MASK(32));
 	if (ret)
 		goto err_free;
 
 	dev->regs = pcim_iomap_table(pdev)[0];
 	dev->regs_len = pci_resource_len(pdev, 0);
+	if (dev->regs_len < MT7927_BAR0_MIN_SIZE) {
+		dev_err(&pdev->dev, "BAR0 too small: 0x%llx\n",
+			(unsigned long long)dev->regs_len);
+		ret = -ENODEV;
+		goto err_free;
+	}
 
 	ret = mt7927_power_handoff(dev);
 	if (ret)
@@ -2165,6 +2283,72 @@ static void mt7927_remove(struct pci_dev *pdev)
 	}
 }
 
+/*
+ * Suspend stops DMA but keeps rings and buffers; resume re-programs the
+ * rings and only reloads firmware if it did not survive. The reload goes
+ * through request_firmware(), which the firmware loader serves from its
+ * suspend cache.
+ */
+static int mt7927_suspend(struct device *d)
+{
+	struct mt7927_dev *dev = pci_get_drvdata(to_pci_dev(d));
+	u32 val;
+	int ret;
+
+	if (dev->dma_ready) {
+		mt7927_set(dev, MT_MCU_CMD, MT_MCU_CMD_STOP_DMA);
+		mt7927_clear(dev, MT_WFDMA0_GLO_CFG,
+			     MT_WFDMA0_GLO_CFG_TX_DMA_EN | MT_WFDMA0_GLO_CFG_RX_DMA_EN);
+
+		ret = read_poll_timeout(__mt7927_rr, val,
+					!(val & (MT_WFDMA0_GLO_CFG_TX_DMA_BUSY |
+						 MT_WFDMA0_GLO_CFG_RX_DMA_BUSY)),
+					10, DMA_BUSY_TIMEOUT_MS * USEC_PER_MSEC, false,
+					dev, MT7927_REG(MT_WFDMA0_GLO_CFG));
+		if (ret)
+			dev_warn(d, "[PM] DMA busy on suspend (continuing)\n");
+		dev->dma_ready = false;
+	}
+
+	mt7927_wr(dev, MT_LPCTL_BAR_OFS, PCIE_LPCR_HOST_SET_OWN);
+	dev_info(d, "[PM] Suspended, rings kept\n");
+	return 0;
+}
+
+static int mt7927_resume(struct device *d)
+{
+	struct mt7927_dev *dev = pci_get_drvdata(to_pci_dev(d));
+	ktime_t start = ktime_get();
+	u32 val;
+	int ret;
+
+	ret = mt7927_power_handoff(dev);
+	if (ret)
+		dev_warn(d, "[PM] Driver ownership timeout on resume\n");
+
+	/* DMA never came up, nothing to restore */
+	if (!dev->tx_ring[MT_TX_RING_FWDL] || !dev->tx_ring_base)
+		return 0;
+
+	mt7927_dma_restore(dev);
+
+	val = mt7927_rr(dev, MT_CONN_MISC_BAR_OFS);
+	if (dev->fw_loaded &&
+	    (val & MT_TOP_MISC2_FW_N9_RDY) != MT_TOP_MISC2_FW_N9_RDY) {
+		dev_info(d, "[PM] Firmware lost (MISC=0x%08x), reloading\n", val);
+		dev->fw_loaded = false;
+		ret = mt7927_load_firmware(dev);
+		if (ret)
+			dev_warn(d, "[PM] FW reload failed: %d\n", ret);
+	}
+
+	dev_info(d, "[PM] Resumed in %lld us\n",
+		 ktime_us_delta(ktime_get(), start));
+	return 0;
+}
+
+static DEFINE_SIMPLE_DEV_PM_OPS(mt7927_pm_ops, mt7927_suspend, mt7927_resume);
+
 static const struct pci_device_id mt7927_pci_ids[] = {
 	{ PCI_DEVICE(MT7927_VENDOR_ID, MT7927_DEVICE_ID) },
 	{ PCI_DEVICE(MT7927_VENDOR_ID, MT6639_DEVICE_ID) },
@@ -2177,6 +2361,7 @@ static struct pci_driver mt7927_driver = {
 	.id_table	= mt7927_pci_ids,
 	.probe		= mt7927_probe,
 	.remove		= mt7927_remove,
+	.driver.pm	= pm_sleep_ptr(&mt7927_pm_ops),
 };
 
 module_pci_driver(mt7927_driver);
@@ -135,6 +135,12 @@ echo "REGISTER DUMPS (hex values):"
 echo "=========================================="
 dmesg | grep -E 'mt7927.*0x'
 
+echo ""
+echo "=========================================="
+echo "REGISTER TRACE (last 200 accesses):"
+echo "=========================================="
+cat /sys/kernel/debug/mt7927/*/regtrace 2>/dev/null | tail -200 || echo "  (debugfs not mounted)"
+
 echo ""
 echo "=========================================="
 echo "IOMMU/DMA ERRORS (if any):"